@@ -0,0 +1,52 @@
+/*
+ * bytes - fixed-width numbers in byte buffers, for the files that segstore and docstore write
+ *         See bytes.h for usage.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdint.h>
+#include "bytes.h"
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** bytes_putU32 ****************/
+/* see bytes.h for documentation */
+void bytes_putU32(unsigned char* bytes, const uint32_t value)
+{
+  for (int i = 0; i < 4; i++) {
+    bytes[i] = (unsigned char) (value >> (8 * i));
+  }
+}
+
+/**************** bytes_getU32 ****************/
+/* see bytes.h for documentation */
+uint32_t bytes_getU32(const unsigned char* bytes)
+{
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+/**************** bytes_putU64 ****************/
+/* see bytes.h for documentation */
+void bytes_putU64(unsigned char* bytes, const uint64_t value)
+{
+  for (int i = 0; i < 8; i++) {
+    bytes[i] = (unsigned char) (value >> (8 * i));
+  }
+}
+
+/**************** bytes_getU64 ****************/
+/* see bytes.h for documentation */
+uint64_t bytes_getU64(const unsigned char* bytes)
+{
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
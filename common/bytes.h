@@ -0,0 +1,30 @@
+/*
+ * bytes - fixed-width numbers in byte buffers, for the files that segstore and docstore write
+ *
+ * A number is stored little-endian, one byte at a time, so that a file reads back the same on any
+ * machine, whatever its byte order, and the buffer need not be aligned.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdint.h>
+
+/**************** bytes_putU32 ****************/
+/* Store value in the 4 bytes at bytes, little-endian.
+ */
+void bytes_putU32(unsigned char* bytes, const uint32_t value);
+
+/**************** bytes_getU32 ****************/
+/* Return the value stored in the 4 bytes at bytes, little-endian.
+ */
+uint32_t bytes_getU32(const unsigned char* bytes);
+
+/**************** bytes_putU64 ****************/
+/* Store value in the 8 bytes at bytes, little-endian.
+ */
+void bytes_putU64(unsigned char* bytes, const uint64_t value);
+
+/**************** bytes_getU64 ****************/
+/* Return the value stored in the 8 bytes at bytes, little-endian.
+ */
+uint64_t bytes_getU64(const unsigned char* bytes);
@@ -0,0 +1,159 @@
+/*
+ * doccounts - a set of counters keyed by docID
+ *             See doccounts.h for usage.
+ *
+ * The counters are an array of (docID, count) pairs sorted by docID, doubled in size when full.
+ * A docID greater than every other is appended; any other is found by binary search, and inserted
+ * (if new) by moving the pairs after it up by one.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "../libcs50/mem.h"
+#include "doccounts.h"
+
+/* pair_t: one counter */
+typedef struct pair {
+  docid_t docID;
+  int count;
+} pair_t;
+
+/* doccounts_t: structure to represent a set of counters
+ * The innards should not be visible to users of the doccounts module.
+ */
+typedef struct doccounts {
+  pair_t* pairs;              // sorted by docID
+  size_t numPairs;
+  size_t capacity;
+} doccounts_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static size_t findPair(const doccounts_t* ctrs, const docid_t docID);
+static pair_t* insertPair(doccounts_t* ctrs, const size_t at, const docid_t docID);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const size_t MIN_CAPACITY = 4;         // pairs in the first array
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** doccounts_new ****************/
+/* see doccounts.h for documentation */
+doccounts_t* doccounts_new(void)
+{
+  return mem_assert(calloc(1, sizeof(doccounts_t)), "failed allocating memory for doccounts");
+}
+
+/**************** doccounts_add ****************/
+/* see doccounts.h for documentation */
+int doccounts_add(doccounts_t* ctrs, const docid_t docID)
+{
+  if (ctrs == NULL || docID < 1) {
+    return 0;
+  }
+
+  size_t at = findPair(ctrs, docID);
+  pair_t* pair = (at < ctrs->numPairs && ctrs->pairs[at].docID == docID) ? &ctrs->pairs[at]
+                                                                          : insertPair(ctrs, at, docID);
+  return ++pair->count;
+}
+
+/**************** doccounts_get ****************/
+/* see doccounts.h for documentation */
+int doccounts_get(doccounts_t* ctrs, const docid_t docID)
+{
+  if (ctrs == NULL) {
+    return 0;
+  }
+
+  size_t at = findPair(ctrs, docID);
+  return (at < ctrs->numPairs && ctrs->pairs[at].docID == docID) ? ctrs->pairs[at].count : 0;
+}
+
+/**************** doccounts_set ****************/
+/* see doccounts.h for documentation */
+bool doccounts_set(doccounts_t* ctrs, const docid_t docID, const int count)
+{
+  if (ctrs == NULL || docID < 1 || count < 0) {
+    return false;
+  }
+
+  size_t at = findPair(ctrs, docID);
+  pair_t* pair = (at < ctrs->numPairs && ctrs->pairs[at].docID == docID) ? &ctrs->pairs[at]
+                                                                          : insertPair(ctrs, at, docID);
+  pair->count = count;
+  return true;
+}
+
+/**************** doccounts_iterate ****************/
+/* see doccounts.h for documentation */
+void doccounts_iterate(doccounts_t* ctrs, void* arg,
+                       void (*itemfunc)(void* arg, const docid_t docID, const int count))
+{
+  if (ctrs == NULL || itemfunc == NULL) {
+    return;
+  }
+
+  for (size_t i = 0; i < ctrs->numPairs; i++) {
+    (*itemfunc)(arg, ctrs->pairs[i].docID, ctrs->pairs[i].count);
+  }
+}
+
+/**************** doccounts_delete ****************/
+/* see doccounts.h for documentation */
+void doccounts_delete(doccounts_t* ctrs)
+{
+  if (ctrs != NULL) {
+    free(ctrs->pairs);
+    free(ctrs);
+  }
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** findPair ****************/
+/* Return the index of the first pair whose docID is not less than docID (numPairs if there is none).
+ */
+static size_t findPair(const doccounts_t* ctrs, const docid_t docID)
+{
+  // The common case, as the indexer adds and the querier builds sets in docID order
+  if (ctrs->numPairs == 0 || ctrs->pairs[ctrs->numPairs - 1].docID < docID) {
+    return ctrs->numPairs;
+  }
+
+  size_t low = 0;
+  size_t high = ctrs->numPairs;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (ctrs->pairs[mid].docID < docID) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**************** insertPair ****************/
+/* Insert a counter of 0 for docID at index at (as findPair returned), growing the array if it is full,
+ * and return it.
+ */
+static pair_t* insertPair(doccounts_t* ctrs, const size_t at, const docid_t docID)
+{
+  if (ctrs->numPairs == ctrs->capacity) {
+    ctrs->capacity = (ctrs->capacity == 0) ? MIN_CAPACITY : 2 * ctrs->capacity;
+    ctrs->pairs = mem_assert(realloc(ctrs->pairs, ctrs->capacity * sizeof(pair_t)),
+                             "failed allocating memory for doccounts");
+  }
+  memmove(&ctrs->pairs[at + 1], &ctrs->pairs[at], (ctrs->numPairs - at) * sizeof(pair_t));
+  ctrs->numPairs++;
+  ctrs->pairs[at].docID = docID;
+  ctrs->pairs[at].count = 0;
+  return &ctrs->pairs[at];
+}
@@ -0,0 +1,63 @@
+/*
+ * doccounts - a set of counters keyed by docID, as the index keeps for each word
+ *
+ * Like libcs50's counters, but with 64-bit docIDs as keys (see docid.h). The counters are kept in
+ * an array sorted by docID, so they are found by binary search, and iterated over in docID order;
+ * the indexer adds docIDs in increasing order, which appends to the array.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdbool.h>
+#include "docid.h"
+
+/***********************************************************************/
+/* doccounts_t: opaque struct representing a set of (docID, count) counters */
+typedef struct doccounts doccounts_t;
+
+/**************** doccounts_new ****************/
+/* Allocate and initialize an empty doccounts_t set.
+ *
+ * We return:
+ *   pointer to new doccounts_t struct
+ *
+ * Caller is responsible for:
+ *   later calling doccounts_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+doccounts_t* doccounts_new(void);
+
+/**************** doccounts_add ****************/
+/* Increment the counter of docID, creating it (at 1) if there is none.
+ *
+ * We return:
+ *   the counter's new value, or 0 if ctrs is NULL or docID < 1
+ */
+int doccounts_add(doccounts_t* ctrs, const docid_t docID);
+
+/**************** doccounts_get ****************/
+/* Return the counter of docID, or 0 if there is none (or ctrs is NULL).
+ */
+int doccounts_get(doccounts_t* ctrs, const docid_t docID);
+
+/**************** doccounts_set ****************/
+/* Set the counter of docID to count, creating it if there is none.
+ *
+ * We return:
+ *   false if ctrs is NULL, docID < 1 or count < 0; true otherwise
+ */
+bool doccounts_set(doccounts_t* ctrs, const docid_t docID, const int count);
+
+/**************** doccounts_iterate ****************/
+/* Call itemfunc with arg on each (docID, count) counter, in increasing order of docID.
+ * We do nothing if ctrs or itemfunc is NULL. The set must not be changed by itemfunc.
+ */
+void doccounts_iterate(doccounts_t* ctrs, void* arg,
+                       void (*itemfunc)(void* arg, const docid_t docID, const int count));
+
+/**************** doccounts_delete ****************/
+/* Free all memory associated with the set; we do nothing if ctrs is NULL.
+ */
+void doccounts_delete(doccounts_t* ctrs);
@@ -0,0 +1,23 @@
+/*
+ * docid - the type of the document IDs that pages are saved, indexed and ranked under
+ *
+ * Pages are numbered 1, 2, 3... in the order the crawler saves them. A docID is 64 bits wide, so that
+ * no corpus outgrows it; to print or scan one, use PRIdocid and SCNdocid, as in
+ * printf("%" PRIdocid "\n", docID).
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdint.h>
+#include <inttypes.h>
+
+/***********************************************************************/
+/* docid_t: a document ID; valid ones are >= 1 */
+typedef int64_t docid_t;
+
+/* printf and scanf conversions for a docid_t */
+#define PRIdocid PRId64
+#define SCNdocid SCNd64
+
+/* characters in the longest docID, with its sign and the terminating NUL */
+#define DOCID_CHARS 21
@@ -0,0 +1,307 @@
+/*
+ * docstore - a table of document metadata (URL, depth, length) by docID, for looking pages up without
+ * reading their page files
+ *
+ * see docstore.h for more information.
+ *
+ * A docstore file holds a header (the magic 'TSEd', the restart interval in 4 bytes, the number of
+ * docIDs in 8), then an offset of 8 bytes for each docID from 1 up, into the records that follow them.
+ * Every number in the header and the offsets is little-endian. A record is a series of varints
+ * (7 bits a byte, low bits first, the high bit set on all bytes but the last): the length of the prefix
+ * its URL shares with that of the docID before it, the length of the rest of its URL, then the rest of
+ * its URL itself, then its depth and its length.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "../libcs50/mem.h"
+#include "bytes.h"
+#include "docstore.h"
+
+/* *********************************************************************** */
+/* Private types */
+
+/* docstore_t: structure to represent a docstore, either built in memory or mapped from a file
+ * The innards should not be visible to users of the docstore module.
+ */
+typedef struct docstore {
+  docid_t numDocs;             // docIDs 1 up to numDocs are in the docstore
+  uint64_t restart;            // records between URLs held whole
+  const unsigned char* offsets; // offsets of records, 8 bytes each (mapped, or within 'table')
+  const unsigned char* records; // records, recordsLength bytes (mapped, or within 'buffer')
+  size_t recordsLength;
+  // only while building
+  unsigned char* table;        // offsets added, room for tableSize
+  size_t tableSize;
+  unsigned char* buffer;       // records added, room for bufferSize
+  size_t bufferSize;
+  char* lastURL;               // URL of docID numDocs, to front-code the next against
+  // only when loaded
+  void* map;                   // the whole file, mapLength bytes
+  size_t mapLength;
+} docstore_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static void appendBytes(docstore_t* docs, const void* bytes, const size_t length);
+static void appendVarint(docstore_t* docs, uint64_t value);
+static bool readVarint(const unsigned char* bytes, const size_t length, size_t* position, uint64_t* value);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const char DOCSTORE_MAGIC[4] = { 'T', 'S', 'E', 'd' };
+static const size_t OFFSET_BYTES = 8;          // of an offset
+static const size_t MIN_BUFFER = 4096;         // smallest room for records, in bytes
+#define HEADER_BYTES 16                        // magic, restart interval, number of docIDs
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** docstore_new ****************/
+/* see docstore.h for documentation */
+docstore_t* docstore_new(void)
+{
+  docstore_t* docs = mem_assert(calloc(1, sizeof(docstore_t)), "failed allocating memory for docstore");
+  docs->restart = DOCSTORE_RESTART;
+  docs->lastURL = mem_assert(calloc(1, 1), "failed allocating memory for docstore");
+  return docs;
+}
+
+/**************** docstore_add ****************/
+/* see docstore.h for documentation */
+bool docstore_add(docstore_t* docs, const docid_t docID, const char* URL, const int depth, const size_t length)
+{
+  if (docs == NULL || URL == NULL || docs->map != NULL || docID != docs->numDocs + 1 || depth < 0) {
+    return false;
+  }
+
+  // Room for one more offset
+  if ((size_t) docID * OFFSET_BYTES > docs->tableSize) {
+    docs->tableSize = (docs->tableSize == 0) ? 1024 * OFFSET_BYTES : 2 * docs->tableSize;
+    docs->table = mem_assert(realloc(docs->table, docs->tableSize), "failed allocating memory for docstore");
+    docs->offsets = docs->table;
+  }
+  bytes_putU64(docs->table + (docID - 1) * OFFSET_BYTES, (uint64_t) docs->recordsLength);
+
+  // The URL, front-coded against the last one unless a block starts here
+  size_t shared = 0;
+  if ((uint64_t) (docID - 1) % docs->restart != 0) {
+    while (URL[shared] != '\0' && URL[shared] == docs->lastURL[shared]) {
+      shared++;
+    }
+  }
+  size_t URLLength = strlen(URL);
+  appendVarint(docs, shared);
+  appendVarint(docs, URLLength - shared);
+  appendBytes(docs, URL + shared, URLLength - shared);
+  appendVarint(docs, (uint64_t) depth);
+  appendVarint(docs, (uint64_t) length);
+
+  free(docs->lastURL);
+  docs->lastURL = mem_assert(malloc(URLLength + 1), "failed allocating memory for docstore");
+  memcpy(docs->lastURL, URL, URLLength + 1);
+  docs->numDocs = docID;
+  return true;
+}
+
+/**************** docstore_save ****************/
+/* see docstore.h for documentation */
+bool docstore_save(docstore_t* docs, const char* filename)
+{
+  if (docs == NULL || filename == NULL) {
+    return false;
+  }
+  FILE* fp = fopen(filename, "w");
+  if (fp == NULL) {
+    return false;
+  }
+
+  unsigned char header[HEADER_BYTES];
+  memcpy(header, DOCSTORE_MAGIC, 4);
+  bytes_putU32(header + 4, (uint32_t) docs->restart);
+  bytes_putU64(header + 8, (uint64_t) docs->numDocs);
+  size_t offsetsLength = (size_t) docs->numDocs * OFFSET_BYTES;
+  bool saved = fwrite(header, 1, HEADER_BYTES, fp) == HEADER_BYTES
+               && (offsetsLength == 0 || fwrite(docs->offsets, 1, offsetsLength, fp) == offsetsLength)
+               && (docs->recordsLength == 0
+                   || fwrite(docs->records, 1, docs->recordsLength, fp) == docs->recordsLength);
+  return (fclose(fp) == 0) && saved;
+}
+
+/**************** docstore_load ****************/
+/* see docstore.h for documentation */
+docstore_t* docstore_load(const char* filename)
+{
+  if (filename == NULL) {
+    return NULL;
+  }
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || (size_t) status.st_size < HEADER_BYTES) {
+    close(fd);
+    return NULL;
+  }
+  void* map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);                   // the mapping outlives it
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  // The header must be ours, and the offsets fit in the file
+  const unsigned char* bytes = map;
+  size_t mapLength = status.st_size;
+  uint64_t restart = bytes_getU32(bytes + 4);
+  uint64_t numDocs = bytes_getU64(bytes + 8);
+  if (memcmp(bytes, DOCSTORE_MAGIC, 4) != 0 || restart == 0
+      || numDocs > (mapLength - HEADER_BYTES) / OFFSET_BYTES) {
+    munmap(map, mapLength);
+    return NULL;
+  }
+
+  docstore_t* docs = mem_assert(calloc(1, sizeof(docstore_t)), "failed allocating memory for docstore");
+  docs->numDocs = (docid_t) numDocs;
+  docs->restart = restart;
+  docs->offsets = bytes + HEADER_BYTES;
+  docs->records = docs->offsets + numDocs * OFFSET_BYTES;
+  docs->recordsLength = mapLength - HEADER_BYTES - numDocs * OFFSET_BYTES;
+  docs->map = map;
+  docs->mapLength = mapLength;
+  return docs;
+}
+
+/**************** docstore_find ****************/
+/* see docstore.h for documentation */
+char* docstore_find(docstore_t* docs, const docid_t docID, int* depth, size_t* length)
+{
+  if (docs == NULL || docID < 1 || docID > docs->numDocs) {
+    return NULL;
+  }
+
+  // Rebuild the URL from the start of its block, each record adding to the prefix it shares
+  docid_t first = docID - (docid_t) ((uint64_t) (docID - 1) % docs->restart);
+  char* URL = NULL;
+  size_t URLLength = 0;
+  uint64_t recordDepth = 0, recordLength = 0;
+  for (docid_t id = first; id <= docID; id++) {
+    size_t position = bytes_getU64(docs->offsets + (id - 1) * OFFSET_BYTES);
+    uint64_t shared, suffix;
+    if (!readVarint(docs->records, docs->recordsLength, &position, &shared)
+        || !readVarint(docs->records, docs->recordsLength, &position, &suffix)
+        || shared > URLLength || (id == first && shared != 0)
+        || suffix > docs->recordsLength - position) {
+      free(URL);
+      return NULL;
+    }
+    URL = mem_assert(realloc(URL, shared + suffix + 1), "failed allocating memory for URL");
+    memcpy(URL + shared, docs->records + position, suffix);
+    position += suffix;
+    URLLength = shared + suffix;
+    URL[URLLength] = '\0';
+    if (id == docID
+        && (!readVarint(docs->records, docs->recordsLength, &position, &recordDepth)
+            || !readVarint(docs->records, docs->recordsLength, &position, &recordLength)
+            || recordDepth > INT32_MAX)) {
+      free(URL);
+      return NULL;
+    }
+  }
+
+  if (depth != NULL) {
+    *depth = (int) recordDepth;
+  }
+  if (length != NULL) {
+    *length = (size_t) recordLength;
+  }
+  return URL;
+}
+
+/**************** docstore_size ****************/
+/* see docstore.h for documentation */
+docid_t docstore_size(docstore_t* docs)
+{
+  return (docs == NULL) ? 0 : docs->numDocs;
+}
+
+/**************** docstore_delete ****************/
+/* see docstore.h for documentation */
+void docstore_delete(docstore_t* docs)
+{
+  if (docs == NULL) {
+    return;
+  }
+  if (docs->map != NULL) {
+    munmap(docs->map, docs->mapLength);
+  }
+  free(docs->table);
+  free(docs->buffer);
+  free(docs->lastURL);
+  free(docs);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** appendBytes ****************/
+/* Append length bytes to the records being built, making room for them as needed. */
+static void appendBytes(docstore_t* docs, const void* bytes, const size_t length)
+{
+  if (docs->recordsLength + length > docs->bufferSize) {
+    size_t size = (docs->bufferSize == 0) ? MIN_BUFFER : docs->bufferSize;
+    while (docs->recordsLength + length > size) {
+      size *= 2;
+    }
+    docs->buffer = mem_assert(realloc(docs->buffer, size), "failed allocating memory for docstore");
+    docs->bufferSize = size;
+    docs->records = docs->buffer;
+  }
+  memcpy(docs->buffer + docs->recordsLength, bytes, length);
+  docs->recordsLength += length;
+}
+
+/**************** appendVarint ****************/
+/* Append value to the records being built, as a varint. */
+static void appendVarint(docstore_t* docs, uint64_t value)
+{
+  unsigned char bytes[10];
+  size_t length = 0;
+  while (value >= 0x80) {
+    bytes[length++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  bytes[length++] = (unsigned char) value;
+  appendBytes(docs, bytes, length);
+}
+
+/**************** readVarint ****************/
+/* Read a varint at *position of length bytes into *value, moving *position past it;
+ * return false if it runs past the bytes, or past 64 bits.
+ */
+static bool readVarint(const unsigned char* bytes, const size_t length, size_t* position, uint64_t* value)
+{
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*position >= length) {
+      return false;
+    }
+    unsigned char byte = bytes[(*position)++];
+    result |= (uint64_t) (byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,110 @@
+/*
+ * docstore - a table of document metadata (URL, depth, length) by docID, for looking pages up without
+ * reading their page files
+ *
+ * The indexer, which loads every page in docID order anyway, builds a docstore as it goes and saves it
+ * next to the index (see indexer.c); the querier loads it to print the URLs of its results. A saved
+ * docstore is a file of fixed-width offsets, one per docID, into records that hold each page's URL,
+ * depth, and length (of its HTML; 0 for an alias, see pagedir_save). URLs are front-coded: a record
+ * holds only what its URL does not share with the URL of the docID before it, as consecutive pages of
+ * a crawl mostly share their site and path; every DOCSTORE_RESTART-th record holds its URL whole, so
+ * that looking up a docID decodes at most that many records. A docstore is loaded by mapping its file
+ * into memory, read-only, so that neither loading it nor looking a docID up reads the file as such.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "docid.h"
+
+/***********************************************************************/
+/* docstore_t: opaque struct representing a docstore, being built or loaded
+ */
+typedef struct docstore docstore_t;
+
+/* Records between URLs held whole */
+#define DOCSTORE_RESTART 16
+
+/**************** docstore_new ****************/
+/* Allocate and initialize a new, empty docstore, to be added to.
+ *
+ * We return:
+ *   pointer to new docstore_t struct
+ *
+ * Caller is responsible for:
+ *   later calling docstore_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+docstore_t* docstore_new(void);
+
+/**************** docstore_add ****************/
+/* Add the metadata of the next docID: the first call adds docID 1, the next docID 2, and so on.
+ *
+ * Caller provides:
+ *   docs    pointer to docstore_t struct made by docstore_new
+ *   docID   the docID (must be one more than the last added, as docIDs are dense)
+ *   URL     the page's URL (copied)
+ *   depth   its depth
+ *   length  the length of its HTML
+ *
+ * We return:
+ *   true if added; false on NULL arguments, a loaded docstore, or a docID out of turn
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+bool docstore_add(docstore_t* docs, const docid_t docID, const char* URL, const int depth, const size_t length);
+
+/**************** docstore_save ****************/
+/* Save a docstore to a file, which is overwritten.
+ *
+ * We return:
+ *   true if saved; false on NULL arguments, or if the file cannot be written
+ */
+bool docstore_save(docstore_t* docs, const char* filename);
+
+/**************** docstore_load ****************/
+/* Load a docstore saved by docstore_save, by mapping its file into memory.
+ *
+ * We return:
+ *   pointer to new docstore_t struct, or NULL on NULL filename, or if the file cannot be read or
+ *   mapped, or is no docstore
+ *
+ * Caller is responsible for:
+ *   later calling docstore_delete with returned pointer (which unmaps the file)
+ *
+ * Limitations:
+ *   the file should not be overwritten in place while loaded (docstore_save of the indexer writes a new
+ *   file over it, which leaves the mapping with the old one)
+ */
+docstore_t* docstore_load(const char* filename);
+
+/**************** docstore_find ****************/
+/* Look up the metadata of a docID.
+ *
+ * Caller provides:
+ *   docs    pointer to docstore_t struct, built or loaded
+ *   docID   the docID to look up
+ *   depth, length  where to store the depth and length of the page, if not NULL
+ *
+ * We return:
+ *   the page's URL, which the caller must later free; or NULL on NULL docs, if docID is not in the
+ *   docstore, or if its records are malformed
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+char* docstore_find(docstore_t* docs, const docid_t docID, int* depth, size_t* length);
+
+/**************** docstore_size ****************/
+/* Return the number of docIDs in a docstore (they being 1 up to that), or 0 if docs is NULL.
+ */
+docid_t docstore_size(docstore_t* docs);
+
+/**************** docstore_delete ****************/
+/* Free all memory associated with a docstore, and unmap its file if it was loaded; nothing if docs is NULL.
+ */
+void docstore_delete(docstore_t* docs);
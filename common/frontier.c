@@ -0,0 +1,902 @@
+/*
+ * frontier - priority queue of webpages waiting to be crawled
+ *            See frontier.h for usage.
+ *
+ * The frontier orders (priority, seq, page) entries, where seq is the insertion count; comparing
+ * seq on equal priorities makes the order stable. Entries are kept in one queue per site (the part
+ * of the URL between "://" and the next '/'), each an array-backed binary min-heap, and the sites
+ * with entries are themselves kept in a binary min-heap ordered by their first entry. The first
+ * entry of the first site is thus the first entry of the frontier, and frontier_extractIf, which
+ * accepts or rejects pages site by site, passes over a busy site in one step however many pages
+ * it has waiting.
+ *
+ * Once spilling is enabled and the pages in memory outnumber maxInMemory, the worse half of their
+ * entries is picked out (by quickselect, in linear time, with no full sort) and written to a segment
+ * file and freed. A segment holds
+ * its entries sorted by URL, each URL front-coded against the one before it (the length of the
+ * prefix they share, then the rest), with all numbers as variable-length integers. Each segment
+ * remembers its best entry; whenever that beats the first entry in memory (or there is none), the
+ * segment is read back in and its file removed; if that leaves more than maxInMemory pages in memory,
+ * the worse half of them is spilled again at once.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "../libcs50/mem.h"
+#include "../libcs50/hashtable.h"
+#include "../libcs50/webpage.h"
+#include "../libcs50/file.h"
+#include "frontier.h"
+
+/* entry_t: one webpage in the frontier
+ */
+typedef struct entry {
+  long priority;
+  unsigned long seq;
+  webpage_t* page;
+} entry_t;
+
+/* site_t: the pages of one site
+ */
+typedef struct site {
+  entry_t* heap;                  // heap[0] has the site's lowest (priority, seq)
+  int size;
+  int capacity;
+  int slot;                       // where the site is in the frontier's queue, or -1 if it has no pages
+} site_t;
+
+/* segment_t: pages spilled to one file
+ */
+typedef struct segment {
+  char* path;
+  entry_t first;                  // priority and seq of its best entry (page is NULL)
+  int count;                      // entries in the file
+} segment_t;
+
+/* frontier_t: structure to represent a frontier
+ * The innards should not be visible to users of the frontier module.
+ */
+typedef struct frontier {
+  hashtable_t* siteTable;         // site -> site_t
+  site_t** sites;                 // every site that has had pages, in order of arrival
+  int numSites;
+  int maxSites;                   // allocated size of sites and queue
+  site_t** queue;                 // heap of the sites with pages, queue[0] having the lowest first entry
+  int numQueued;
+  int size;                       // pages in memory, in all sites
+  unsigned long seq;              // pages inserted so far
+  frontier_priority_t priority;
+  void* arg;
+  hashtable_t* hosts;             // for FRONTIER_HOST: host -> pages inserted from it so far
+  char* spillDir;                 // where to spill pages, or NULL to keep all in memory
+  int maxInMemory;                // pages in memory that trigger a spill
+  segment_t* segments;            // spilled pages
+  int numSegments;
+  int maxSegments;                // allocated size of segments
+  int numSpilled;                 // pages in all segments
+  int nextSegment;                // number in the name of the next segment file
+} frontier_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static frontier_t* newFrontier(frontier_priority_t priority, void* arg);
+static site_t* findSite(frontier_t* frontier, const char* url);
+static void push(frontier_t* frontier, const entry_t entry);
+static entry_t pop(frontier_t* frontier);
+static void sitePush(site_t* site, const entry_t entry);
+static entry_t sitePop(site_t* site);
+static void enqueue(frontier_t* frontier, site_t* site);
+static site_t* dequeue(frontier_t* frontier);
+static void siftUp(frontier_t* frontier, int i);
+static void siftDown(frontier_t* frontier, int i);
+static bool before(const entry_t* a, const entry_t* b);
+static void selectBest(entry_t* entries, const int numEntries, const int k);
+static int compareURLs(const void* a, const void* b);
+static void spillWorst(frontier_t* frontier);
+static void unspill(frontier_t* frontier);
+static void loadSegment(frontier_t* frontier, const int which);
+static entry_t* readSegment(const segment_t* segment);
+static void putNumber(FILE* fp, unsigned long number);
+static bool getNumber(FILE* fp, unsigned long* number);
+static long byDepth(void* arg, const webpage_t* page, const unsigned long seq);
+static long byDiscovery(void* arg, const webpage_t* page, const unsigned long seq);
+static long byHost(void* arg, const webpage_t* page, const unsigned long seq);
+static long* hostCount(hashtable_t* hosts, const char* url);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const int INITIAL_CAPACITY = 8;        // entries allocated for a new site
+static const int HOST_SLOTS = 101;            // hashtable slots for FRONTIER_HOST
+static const int SITE_SLOTS = 1009;           // hashtable slots for sites; a crawl may span many
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** frontier_new ****************/
+/* see frontier.h for documentation */
+frontier_t* frontier_new(const frontier_order_t order)
+{
+  switch (order) {
+  case FRONTIER_DISCOVERY:
+    return newFrontier(byDiscovery, NULL);
+  case FRONTIER_HOST: {
+    frontier_t* frontier = newFrontier(byHost, NULL);
+    frontier->hosts = mem_assert(hashtable_new(HOST_SLOTS), "failed allocating memory for frontier hosts");
+    frontier->arg = frontier->hosts;
+    return frontier;
+  }
+  case FRONTIER_DEPTH:
+  default:
+    return newFrontier(byDepth, NULL);
+  }
+}
+
+/**************** frontier_newCustom ****************/
+/* see frontier.h for documentation */
+frontier_t* frontier_newCustom(frontier_priority_t priority, void* arg)
+{
+  if (priority == NULL) {
+    return NULL;
+  }
+  return newFrontier(priority, arg);
+}
+
+/**************** frontier_insert ****************/
+/* see frontier.h for documentation */
+void frontier_insert(frontier_t* frontier, webpage_t* page)
+{
+  if (frontier == NULL || page == NULL) {
+    return;
+  }
+
+  entry_t entry = { .seq = frontier->seq, .page = page };
+  entry.priority = frontier->priority(frontier->arg, page, frontier->seq);
+  frontier->seq++;
+  push(frontier, entry);
+
+  if (frontier->spillDir != NULL && frontier->size > frontier->maxInMemory) {
+    spillWorst(frontier);
+  }
+}
+
+/**************** frontier_insertAll ****************/
+/* see frontier.h for documentation */
+void frontier_insertAll(frontier_t* frontier, webpage_t* pages[], const int numPages)
+{
+  if (frontier == NULL || pages == NULL || numPages <= 0) {
+    return;
+  }
+
+  for (int i = 0; i < numPages; i++) {
+    frontier_insert(frontier, pages[i]);
+  }
+}
+
+/**************** frontier_extract ****************/
+/* see frontier.h for documentation */
+webpage_t* frontier_extract(frontier_t* frontier)
+{
+  if (frontier == NULL) {
+    return NULL;
+  }
+
+  unspill(frontier);
+  if (frontier->size == 0) {
+    return NULL;
+  }
+  return pop(frontier).page;
+}
+
+/**************** frontier_extractMany ****************/
+/* see frontier.h for documentation */
+int frontier_extractMany(frontier_t* frontier, webpage_t* pages[], const int maxPages)
+{
+  if (frontier == NULL || pages == NULL) {
+    return 0;
+  }
+
+  int numPages = 0;
+  while (numPages < maxPages) {
+    unspill(frontier);
+    if (frontier->size == 0) {
+      break;
+    }
+    pages[numPages++] = pop(frontier).page;
+  }
+  return numPages;
+}
+
+/**************** frontier_extractIf ****************/
+/* see frontier.h for documentation */
+webpage_t* frontier_extractIf(frontier_t* frontier, bool (*accept)(void* arg, webpage_t* page), void* arg)
+{
+  if (frontier == NULL || accept == NULL) {
+    return NULL;
+  }
+  unspill(frontier);
+  if (frontier->size == 0) {
+    return NULL;
+  }
+
+  // Offer each site's first page in order until one is accepted, setting aside the rejected sites
+  site_t** rejected = mem_assert(malloc(frontier->numQueued * sizeof(site_t*)), "failed allocating memory for frontier");
+  int numRejected = 0;
+  webpage_t* page = NULL;
+  while (frontier->numQueued > 0) {
+    if (accept(arg, frontier->queue[0]->heap[0].page)) {
+      page = pop(frontier).page;
+      break;
+    }
+    rejected[numRejected++] = dequeue(frontier);
+  }
+
+  // Put the rejected sites back, with all their pages
+  for (int i = 0; i < numRejected; i++) {
+    enqueue(frontier, rejected[i]);
+  }
+  free(rejected);
+
+  return page;
+}
+
+/**************** frontier_size ****************/
+/* see frontier.h for documentation */
+int frontier_size(frontier_t* frontier)
+{
+  return (frontier == NULL) ? 0 : frontier->size + frontier->numSpilled;
+}
+
+/**************** frontier_spill ****************/
+/* see frontier.h for documentation */
+bool frontier_spill(frontier_t* frontier, const char* directory, const int maxInMemory)
+{
+  if (frontier == NULL || directory == NULL || maxInMemory < 2 || frontier->spillDir != NULL) {
+    return false;
+  }
+
+  frontier->spillDir = mem_assert(malloc(strlen(directory) + 1), "failed allocating memory for frontier");
+  strcpy(frontier->spillDir, directory);
+  frontier->maxInMemory = maxInMemory;
+  if (frontier->size > maxInMemory) {
+    spillWorst(frontier);
+  }
+  return true;
+}
+
+/**************** frontier_save ****************/
+/* see frontier.h for documentation */
+bool frontier_save(frontier_t* frontier, FILE* fp)
+{
+  if (frontier == NULL || fp == NULL) {
+    return false;
+  }
+
+  fprintf(fp, "%d\n", frontier_size(frontier));
+  for (int s = 0; s < frontier->numSites; s++) {
+    site_t* site = frontier->sites[s];
+    for (int i = 0; i < site->size; i++) {
+      entry_t* entry = &site->heap[i];
+      fprintf(fp, "%ld %lu %d %s\n", entry->priority, entry->seq, webpage_getDepth(entry->page),
+              webpage_getURL(entry->page));
+    }
+  }
+
+  // Spilled entries are read back one segment at a time, leaving the segment files in place
+  for (int s = 0; s < frontier->numSegments; s++) {
+    entry_t* entries = readSegment(&frontier->segments[s]);
+    for (int i = 0; i < frontier->segments[s].count; i++) {
+      fprintf(fp, "%ld %lu %d %s\n", entries[i].priority, entries[i].seq, webpage_getDepth(entries[i].page),
+              webpage_getURL(entries[i].page));
+      webpage_delete(entries[i].page);
+    }
+    free(entries);
+  }
+
+  return ferror(fp) == 0;
+}
+
+/**************** frontier_load ****************/
+/* see frontier.h for documentation */
+bool frontier_load(frontier_t* frontier, FILE* fp)
+{
+  int count;
+  if (frontier == NULL || fp == NULL || fscanf(fp, "%d ", &count) != 1 || count < 0) {
+    return false;
+  }
+
+  for (int i = 0; i < count; i++) {
+    entry_t entry;
+    int depth;
+    if (fscanf(fp, "%ld %lu %d ", &entry.priority, &entry.seq, &depth) != 3) {
+      return false;
+    }
+    char* url = file_readLine(fp);
+    if (url == NULL) {
+      return false;
+    }
+    entry.page = webpage_new(url, depth, NULL);
+
+    // Later pages must come after this one, in insertion order and (for FRONTIER_HOST) in its host's turn
+    if (entry.seq >= frontier->seq) {
+      frontier->seq = entry.seq + 1;
+    }
+    if (frontier->hosts != NULL) {
+      long* hostPages = hostCount(frontier->hosts, url);
+      if (entry.priority >= *hostPages) {
+        *hostPages = entry.priority + 1;
+      }
+    }
+
+    push(frontier, entry);
+    if (frontier->spillDir != NULL && frontier->size > frontier->maxInMemory) {
+      spillWorst(frontier);
+    }
+  }
+  return true;
+}
+
+/**************** frontier_delete ****************/
+/* see frontier.h for documentation */
+void frontier_delete(frontier_t* frontier, void (*pagedelete)(void* page))
+{
+  if (frontier == NULL) {
+    return;
+  }
+
+  for (int s = 0; s < frontier->numSites; s++) {
+    site_t* site = frontier->sites[s];
+    for (int i = 0; pagedelete != NULL && i < site->size; i++) {
+      pagedelete(site->heap[i].page);
+    }
+    free(site->heap);
+    free(site);
+  }
+  hashtable_delete(frontier->siteTable, NULL);
+  free(frontier->sites);
+  free(frontier->queue);
+  if (frontier->hosts != NULL) {
+    hashtable_delete(frontier->hosts, free);
+  }
+  for (int i = 0; i < frontier->numSegments; i++) {
+    unlink(frontier->segments[i].path);
+    free(frontier->segments[i].path);
+  }
+  free(frontier->segments);
+  free(frontier->spillDir);
+  free(frontier);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** newFrontier ****************/
+/* Allocate an empty frontier with the given priority function.
+ */
+static frontier_t* newFrontier(frontier_priority_t priority, void* arg)
+{
+  frontier_t* frontier = mem_assert(malloc(sizeof(frontier_t)), "failed allocating memory for frontier");
+  frontier->siteTable = mem_assert(hashtable_new(SITE_SLOTS), "failed allocating memory for frontier sites");
+  frontier->sites = NULL;
+  frontier->numSites = 0;
+  frontier->maxSites = 0;
+  frontier->queue = NULL;
+  frontier->numQueued = 0;
+  frontier->size = 0;
+  frontier->seq = 0;
+  frontier->priority = priority;
+  frontier->arg = arg;
+  frontier->hosts = NULL;
+  frontier->spillDir = NULL;
+  frontier->maxInMemory = 0;
+  frontier->segments = NULL;
+  frontier->numSegments = 0;
+  frontier->maxSegments = 0;
+  frontier->numSpilled = 0;
+  frontier->nextSegment = 0;
+  return frontier;
+}
+
+/**************** findSite ****************/
+/* Return the queue of url's site (the part of the URL between "://" and the next '/'), creating
+ * an empty one if the site has none yet.
+ */
+static site_t* findSite(frontier_t* frontier, const char* url)
+{
+  const char* start = strstr(url, "://");
+  start = (start == NULL) ? url : start + strlen("://");
+  size_t length = strcspn(start, "/");
+  char name[length + 1];
+  memcpy(name, start, length);
+  name[length] = '\0';
+
+  site_t* site = hashtable_find(frontier->siteTable, name);
+  if (site == NULL) {
+    site = mem_assert(malloc(sizeof(site_t)), "failed allocating memory for frontier site");
+    site->heap = NULL;
+    site->size = 0;
+    site->capacity = 0;
+    site->slot = -1;
+    hashtable_insert(frontier->siteTable, name, site);
+
+    // The queue never holds more sites than there are, so it grows along with sites
+    if (frontier->numSites == frontier->maxSites) {
+      frontier->maxSites = (frontier->maxSites == 0) ? 8 : 2 * frontier->maxSites;
+      frontier->sites = mem_assert(realloc(frontier->sites, frontier->maxSites * sizeof(site_t*)),
+                                   "failed allocating memory for frontier sites");
+      frontier->queue = mem_assert(realloc(frontier->queue, frontier->maxSites * sizeof(site_t*)),
+                                   "failed allocating memory for frontier sites");
+    }
+    frontier->sites[frontier->numSites++] = site;
+  }
+  return site;
+}
+
+/**************** push ****************/
+/* Add an entry to its site's queue, and move the site up the frontier's queue if it now comes sooner.
+ */
+static void push(frontier_t* frontier, const entry_t entry)
+{
+  site_t* site = findSite(frontier, webpage_getURL(entry.page));
+  sitePush(site, entry);
+  frontier->size++;
+
+  if (site->slot < 0) {
+    enqueue(frontier, site);
+  } else if (site->heap[0].page == entry.page) {
+    siftUp(frontier, site->slot);
+  }
+}
+
+/**************** pop ****************/
+/* Remove and return the first entry of the first site (so of the frontier, which must not be empty),
+ * moving the site down the frontier's queue, or out of it if it has no pages left.
+ */
+static entry_t pop(frontier_t* frontier)
+{
+  site_t* site = frontier->queue[0];
+  entry_t first = sitePop(site);
+  frontier->size--;
+
+  if (site->size == 0) {
+    dequeue(frontier);
+  } else {
+    siftDown(frontier, 0);
+  }
+  return first;
+}
+
+/**************** sitePush ****************/
+/* Add an entry to a site's heap, sifting it up into place.
+ */
+static void sitePush(site_t* site, const entry_t entry)
+{
+  if (site->size == site->capacity) {
+    site->capacity = (site->capacity == 0) ? INITIAL_CAPACITY : 2 * site->capacity;
+    site->heap = mem_assert(realloc(site->heap, site->capacity * sizeof(entry_t)),
+                            "failed allocating memory for frontier");
+  }
+
+  int i = site->size++;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!before(&entry, &site->heap[parent])) {
+      break;
+    }
+    site->heap[i] = site->heap[parent];
+    i = parent;
+  }
+  site->heap[i] = entry;
+}
+
+/**************** sitePop ****************/
+/* Remove and return the first entry of a site's non-empty heap, sifting the last entry down into its place.
+ */
+static entry_t sitePop(site_t* site)
+{
+  entry_t first = site->heap[0];
+  entry_t last = site->heap[--site->size];
+
+  int i = 0;
+  while (true) {
+    int child = 2 * i + 1;
+    if (child >= site->size) {
+      break;
+    }
+    if (child + 1 < site->size && before(&site->heap[child + 1], &site->heap[child])) {
+      child++;
+    }
+    if (!before(&site->heap[child], &last)) {
+      break;
+    }
+    site->heap[i] = site->heap[child];
+    i = child;
+  }
+  if (site->size > 0) {
+    site->heap[i] = last;
+  }
+
+  return first;
+}
+
+/**************** enqueue ****************/
+/* Add a site with pages (and not already queued) to the frontier's queue.
+ */
+static void enqueue(frontier_t* frontier, site_t* site)
+{
+  site->slot = frontier->numQueued++;
+  frontier->queue[site->slot] = site;
+  siftUp(frontier, site->slot);
+}
+
+/**************** dequeue ****************/
+/* Remove and return the first site of the frontier's non-empty queue; its pages stay with it.
+ */
+static site_t* dequeue(frontier_t* frontier)
+{
+  site_t* first = frontier->queue[0];
+  first->slot = -1;
+
+  site_t* last = frontier->queue[--frontier->numQueued];
+  if (frontier->numQueued > 0) {
+    frontier->queue[0] = last;
+    last->slot = 0;
+    siftDown(frontier, 0);
+  }
+  return first;
+}
+
+/**************** siftUp ****************/
+/* Move the site in slot i of the frontier's queue up to where its first entry belongs.
+ */
+static void siftUp(frontier_t* frontier, int i)
+{
+  site_t* site = frontier->queue[i];
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!before(&site->heap[0], &frontier->queue[parent]->heap[0])) {
+      break;
+    }
+    frontier->queue[i] = frontier->queue[parent];
+    frontier->queue[i]->slot = i;
+    i = parent;
+  }
+  frontier->queue[i] = site;
+  site->slot = i;
+}
+
+/**************** siftDown ****************/
+/* Move the site in slot i of the frontier's queue down to where its first entry belongs.
+ */
+static void siftDown(frontier_t* frontier, int i)
+{
+  site_t* site = frontier->queue[i];
+  while (true) {
+    int child = 2 * i + 1;
+    if (child >= frontier->numQueued) {
+      break;
+    }
+    if (child + 1 < frontier->numQueued
+        && before(&frontier->queue[child + 1]->heap[0], &frontier->queue[child]->heap[0])) {
+      child++;
+    }
+    if (!before(&frontier->queue[child]->heap[0], &site->heap[0])) {
+      break;
+    }
+    frontier->queue[i] = frontier->queue[child];
+    frontier->queue[i]->slot = i;
+    i = child;
+  }
+  frontier->queue[i] = site;
+  site->slot = i;
+}
+
+/**************** before ****************/
+/* Return true if entry a comes before entry b: lower priority, or same priority and inserted earlier.
+ */
+static bool before(const entry_t* a, const entry_t* b)
+{
+  return a->priority < b->priority || (a->priority == b->priority && a->seq < b->seq);
+}
+
+/**************** selectBest ****************/
+/* Rearrange entries so that the first k (0 < k < numEntries) are the k that come first in the
+ * frontier's order, in no particular order among themselves: quickselect, with the middle entry
+ * of each range as pivot, so linear time on average.
+ */
+static void selectBest(entry_t* entries, const int numEntries, const int k)
+{
+  int low = 0;
+  int high = numEntries - 1;
+  while (low < high) {
+    // Partition [low..high] around the pivot, which ends up in slot 'store'
+    entry_t pivot = entries[(low + high) / 2];
+    entries[(low + high) / 2] = entries[high];
+    entries[high] = pivot;
+    int store = low;
+    for (int i = low; i < high; i++) {
+      if (before(&entries[i], &pivot)) {
+        entry_t swap = entries[i];
+        entries[i] = entries[store];
+        entries[store++] = swap;
+      }
+    }
+    entries[high] = entries[store];
+    entries[store] = pivot;
+
+    // Carry on in the side that holds the k-th boundary
+    if (store == k) {
+      return;
+    } else if (store < k) {
+      low = store + 1;
+    } else {
+      high = store - 1;
+    }
+  }
+}
+
+/**************** compareURLs ****************/
+/* qsort comparison of entries by the URL of their page.
+ */
+static int compareURLs(const void* a, const void* b)
+{
+  return strcmp(webpage_getURL(((const entry_t*) a)->page), webpage_getURL(((const entry_t*) b)->page));
+}
+
+/**************** spillWorst ****************/
+/* Move the worse half of the pages in memory to a new segment file.
+ * Program crashes cleanly if the file cannot be written.
+ */
+static void spillWorst(frontier_t* frontier)
+{
+  // Take every entry out of the sites and pick out the best half; the rest are the worst entries
+  entry_t* entries = mem_assert(malloc(frontier->size * sizeof(entry_t)), "failed allocating memory for frontier");
+  int numEntries = 0;
+  for (int s = 0; s < frontier->numSites; s++) {
+    site_t* site = frontier->sites[s];
+    memcpy(&entries[numEntries], site->heap, site->size * sizeof(entry_t));
+    numEntries += site->size;
+    site->size = 0;
+    site->slot = -1;
+  }
+  frontier->numQueued = 0;
+  frontier->size = 0;
+
+  int keep = numEntries / 2;
+  selectBest(entries, numEntries, keep);
+  entry_t* worst = &entries[keep];
+  int numWorst = numEntries - keep;
+
+  segment_t segment = { .first = worst[0], .count = numWorst };
+  for (int i = 1; i < numWorst; i++) {
+    if (before(&worst[i], &segment.first)) {
+      segment.first = worst[i];
+    }
+  }
+  segment.first.page = NULL;
+  int pathLength = strlen(frontier->spillDir) + strlen("/frontier-.seg") + 12;
+  segment.path = mem_assert(malloc(pathLength), "failed allocating memory for frontier segment");
+  snprintf(segment.path, pathLength, "%s/frontier-%d.seg", frontier->spillDir, frontier->nextSegment++);
+
+  FILE* fp = fopen(segment.path, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "could not write frontier segment %s\n", segment.path);
+    exit(1);
+  }
+
+  // Write the entries in URL order, each URL front-coded against the previous one
+  qsort(worst, numWorst, sizeof(entry_t), compareURLs);
+  const char* previous = "";
+  for (int i = 0; i < numWorst; i++) {
+    const char* url = webpage_getURL(worst[i].page);
+    size_t shared = 0;
+    while (previous[shared] != '\0' && previous[shared] == url[shared]) {
+      shared++;
+    }
+    size_t rest = strlen(&url[shared]);
+    putNumber(fp, shared);
+    putNumber(fp, rest);
+    fwrite(&url[shared], 1, rest, fp);
+    putNumber(fp, webpage_getDepth(worst[i].page));
+    putNumber(fp, ((unsigned long) worst[i].priority << 1) ^ (unsigned long) (worst[i].priority >> 63)); // zigzag
+    putNumber(fp, worst[i].seq);
+    previous = url;
+  }
+  if (fclose(fp) != 0) {
+    fprintf(stderr, "could not write frontier segment %s\n", segment.path);
+    exit(1);
+  }
+
+  // The worst pages are on disk now; the rest go back to their sites
+  for (int i = 0; i < numWorst; i++) {
+    webpage_delete(worst[i].page);
+  }
+  for (int i = 0; i < keep; i++) {
+    push(frontier, entries[i]);
+  }
+  free(entries);
+  frontier->numSpilled += numWorst;
+
+  if (frontier->numSegments == frontier->maxSegments) {
+    frontier->maxSegments = (frontier->maxSegments == 0) ? 8 : 2 * frontier->maxSegments;
+    frontier->segments = mem_assert(realloc(frontier->segments, frontier->maxSegments * sizeof(segment_t)),
+                                    "failed allocating memory for frontier segments");
+  }
+  frontier->segments[frontier->numSegments++] = segment;
+}
+
+/**************** unspill ****************/
+/* Load segments back in for as long as the best spilled entry beats the first entry in memory
+ * (or there is none), so that the first entry in memory is the best entry of the whole frontier.
+ */
+static void unspill(frontier_t* frontier)
+{
+  while (frontier->numSegments > 0) {
+    int best = 0;
+    for (int i = 1; i < frontier->numSegments; i++) {
+      if (before(&frontier->segments[i].first, &frontier->segments[best].first)) {
+        best = i;
+      }
+    }
+    if (frontier->numQueued > 0 && !before(&frontier->segments[best].first, &frontier->queue[0]->heap[0])) {
+      return;
+    }
+    loadSegment(frontier, best);
+  }
+}
+
+/**************** loadSegment ****************/
+/* Read segment number 'which' back into the sites, and remove its file; then, if the pages in memory
+ * are more than maxInMemory, spill the worse half of them again (which, as the segment was read
+ * because its best page comes next, never includes that page).
+ * Program crashes cleanly if the file cannot be read, or a new segment written.
+ */
+static void loadSegment(frontier_t* frontier, const int which)
+{
+  segment_t segment = frontier->segments[which];
+  frontier->segments[which] = frontier->segments[--frontier->numSegments];
+
+  entry_t* entries = readSegment(&segment);
+  for (int i = 0; i < segment.count; i++) {
+    push(frontier, entries[i]);
+  }
+  free(entries);
+
+  unlink(segment.path);
+  free(segment.path);
+  frontier->numSpilled -= segment.count;
+
+  if (frontier->size > frontier->maxInMemory) {
+    spillWorst(frontier);
+  }
+}
+
+/**************** readSegment ****************/
+/* Read the entries of a segment file into a new array, each with a new webpage_t (and no HTML);
+ * the caller is responsible for freeing both. The file itself is left alone.
+ * Program crashes cleanly if the file cannot be read.
+ */
+static entry_t* readSegment(const segment_t* segment)
+{
+  FILE* fp = fopen(segment->path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "could not read frontier segment %s\n", segment->path);
+    exit(1);
+  }
+
+  entry_t* entries = mem_assert(malloc(segment->count * sizeof(entry_t)), "failed allocating memory for frontier segment");
+  size_t urlSize = 256;
+  char* url = mem_assert(malloc(urlSize), "failed allocating memory for frontier URL");
+  url[0] = '\0';
+  for (int i = 0; i < segment->count; i++) {
+    unsigned long shared, rest, depth, priority, seq;
+    if (!getNumber(fp, &shared) || !getNumber(fp, &rest) || shared > strlen(url)) {
+      fprintf(stderr, "frontier segment %s is corrupt\n", segment->path);
+      exit(1);
+    }
+    if (shared + rest + 1 > urlSize) {
+      urlSize = 2 * (shared + rest + 1);
+      url = mem_assert(realloc(url, urlSize), "failed allocating memory for frontier URL");
+    }
+    if (fread(&url[shared], 1, rest, fp) != rest
+        || !getNumber(fp, &depth) || !getNumber(fp, &priority) || !getNumber(fp, &seq)) {
+      fprintf(stderr, "frontier segment %s is corrupt\n", segment->path);
+      exit(1);
+    }
+    url[shared + rest] = '\0';
+
+    char* pageURL = mem_assert(malloc(shared + rest + 1), "failed allocating memory for frontier URL");
+    strcpy(pageURL, url);
+    entries[i].seq = seq;
+    entries[i].page = webpage_new(pageURL, depth, NULL);
+    entries[i].priority = (long) (priority >> 1) ^ -(long) (priority & 1); // undo zigzag
+  }
+  free(url);
+  fclose(fp);
+
+  return entries;
+}
+
+/**************** putNumber ****************/
+/* Write number as a variable-length integer: 7 bits per byte, low bits first,
+ * the high bit set on every byte but the last.
+ */
+static void putNumber(FILE* fp, unsigned long number)
+{
+  while (number >= 0x80) {
+    fputc((int) (number & 0x7f) | 0x80, fp);
+    number >>= 7;
+  }
+  fputc((int) number, fp);
+}
+
+/**************** getNumber ****************/
+/* Read a number written by putNumber; return false at end of file.
+ */
+static bool getNumber(FILE* fp, unsigned long* number)
+{
+  *number = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = fgetc(fp);
+    if (c == EOF) {
+      return false;
+    }
+    *number |= (unsigned long) (c & 0x7f) << shift;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************** byDepth ****************/
+/* Priority for FRONTIER_DEPTH: the page's depth.
+ */
+static long byDepth(void* arg, const webpage_t* page, const unsigned long seq)
+{
+  return webpage_getDepth(page);
+}
+
+/**************** byDiscovery ****************/
+/* Priority for FRONTIER_DISCOVERY: the same for all, so that insertion order decides.
+ */
+static long byDiscovery(void* arg, const webpage_t* page, const unsigned long seq)
+{
+  return 0;
+}
+
+/**************** byHost ****************/
+/* Priority for FRONTIER_HOST: how many pages from the same host were inserted before this one.
+ * arg is the hashtable counting them.
+ */
+static long byHost(void* arg, const webpage_t* page, const unsigned long seq)
+{
+  return (*hostCount(arg, webpage_getURL(page)))++;
+}
+
+/**************** hostCount ****************/
+/* Return the count of pages inserted so far from url's host (the part of the URL between "://"
+ * and the next '/'), creating it as 0 if the host has none yet.
+ */
+static long* hostCount(hashtable_t* hosts, const char* url)
+{
+  const char* start = strstr(url, "://");
+  start = (start == NULL) ? url : start + strlen("://");
+  size_t length = strcspn(start, "/");
+  char host[length + 1];
+  memcpy(host, start, length);
+  host[length] = '\0';
+
+  long* count = hashtable_find(hosts, host);
+  if (count == NULL) {
+    count = mem_assert(malloc(sizeof(long)), "failed allocating memory for frontier host");
+    *count = 0;
+    hashtable_insert(hosts, host, count);
+  }
+  return count;
+}
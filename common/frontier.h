@@ -0,0 +1,182 @@
+/*
+ * frontier - priority queue of webpages waiting to be crawled
+ *
+ * The frontier hands out webpages in order of a priority computed when each one is inserted
+ * (lowest first), breaking ties by insertion order. Built-in orders crawl breadth-first (by depth),
+ * in discovery order, or round-robin across hosts; callers may supply their own priority instead.
+ * Pages are queued per site (host[:port]), so that a caller picking pages by site, as a crawler
+ * waiting on busy hosts does with frontier_extractIf, deals with each site once, not with each page.
+ *
+ * A frontier can also be told to keep only so many pages in memory, spilling the rest to files
+ * on disk and reading them back as the pages in memory run out (see frontier_spill).
+ *
+ * The frontier does no locking; callers that share one between threads must serialize access.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "../libcs50/webpage.h"
+
+/***********************************************************************/
+/* frontier_t: opaque struct representing a frontier
+ */
+typedef struct frontier frontier_t;
+
+/* frontier_order_t: built-in orders
+ *   FRONTIER_DEPTH      shallowest pages first, i.e., a breadth-first crawl
+ *   FRONTIER_DISCOVERY  pages in the order they were inserted
+ *   FRONTIER_HOST       each host's first page, then each host's second page, and so on,
+ *                       so that no host hogs the crawl
+ */
+typedef enum { FRONTIER_DEPTH, FRONTIER_DISCOVERY, FRONTIER_HOST } frontier_order_t;
+
+/* frontier_priority_t: computes the priority of a page as it is inserted; lower comes first.
+ *   arg   the arg given to frontier_newCustom
+ *   page  the page being inserted
+ *   seq   number of pages inserted before this one
+ */
+typedef long (*frontier_priority_t)(void* arg, const webpage_t* page, const unsigned long seq);
+
+/**************** frontier_new ****************/
+/* Allocate and initialize an empty frontier with a built-in order.
+ *
+ * Caller provides:
+ *   order  one of the frontier_order_t values
+ *
+ * We return:
+ *   pointer to new frontier_t struct
+ *
+ * Caller is responsible for:
+ *   later calling frontier_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+frontier_t* frontier_new(const frontier_order_t order);
+
+/**************** frontier_newCustom ****************/
+/* Allocate and initialize an empty frontier with a caller-supplied priority.
+ *
+ * Caller provides:
+ *   priority  function computing each page's priority (must not be NULL)
+ *   arg       anything; passed along to priority
+ *
+ * We return, and the caller is responsible for, the same as frontier_new
+ */
+frontier_t* frontier_newCustom(frontier_priority_t priority, void* arg);
+
+/**************** frontier_insert ****************/
+/* Add a webpage to the frontier; the frontier takes it over until it is extracted.
+ *
+ * Caller provides:
+ *   frontier  pointer to valid frontier_t struct
+ *   page      pointer to webpage_t struct (ignored if NULL)
+ */
+void frontier_insert(frontier_t* frontier, webpage_t* page);
+
+/**************** frontier_insertAll ****************/
+/* Add numPages webpages to the frontier, as if by frontier_insert in array order.
+ */
+void frontier_insertAll(frontier_t* frontier, webpage_t* pages[], const int numPages);
+
+/**************** frontier_extract ****************/
+/* Remove and return the webpage with the lowest priority, or NULL if the frontier is empty.
+ */
+webpage_t* frontier_extract(frontier_t* frontier);
+
+/**************** frontier_extractMany ****************/
+/* Remove up to maxPages webpages, in priority order, into pages[].
+ *
+ * We return:
+ *   the number of webpages stored in pages (0 if the frontier is empty)
+ */
+int frontier_extractMany(frontier_t* frontier, webpage_t* pages[], const int maxPages);
+
+/**************** frontier_extractIf ****************/
+/* Remove and return the webpage with the lowest priority among the sites whose first webpage
+ * accept returns true for, leaving the others in the frontier with their priorities unchanged.
+ *
+ * Caller provides:
+ *   frontier  pointer to valid frontier_t struct
+ *   accept    function called on the first webpage of each site, sites in priority order, until it
+ *             returns true; a site it rejects is passed over with all its webpages. It must not
+ *             modify the frontier
+ *   arg       anything; passed along to accept
+ *
+ * We return:
+ *   the accepted webpage, or NULL if accept accepted none (or the frontier is empty)
+ *
+ * Limitations:
+ *   takes time proportional to the number of sites rejected, times the log of the number of sites;
+ *   of the pages spilled to disk, considers only those that come before all pages in memory
+ */
+webpage_t* frontier_extractIf(frontier_t* frontier, bool (*accept)(void* arg, webpage_t* page), void* arg);
+
+/**************** frontier_size ****************/
+/* Return the number of webpages in the frontier (0 if frontier is NULL).
+ */
+int frontier_size(frontier_t* frontier);
+
+/**************** frontier_spill ****************/
+/* Bound the number of webpages the frontier keeps in memory. Whenever more than maxInMemory are
+ * in memory, the worse half of them is written to a new segment file in directory and freed;
+ * segments are read back in as soon as their best page comes next, so the order of the frontier
+ * is unaffected.
+ *
+ * Caller provides:
+ *   frontier     pointer to valid frontier_t struct, not already spilling
+ *   directory    existing, writable directory, for the frontier's own use until frontier_delete
+ *   maxInMemory  most webpages to keep in memory (must be >= 2)
+ *
+ * We return:
+ *   true if spilling is now enabled, false on invalid arguments
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if a segment file cannot be written or read back
+ *
+ * Limitations:
+ *   reading a segment back briefly holds its webpages on top of those already in memory, until
+ *   the frontier spills again;
+ *   webpages come back from disk as new webpage_t structs with the same URL and depth (and no HTML)
+ */
+bool frontier_spill(frontier_t* frontier, const char* directory, const int maxInMemory);
+
+/**************** frontier_save ****************/
+/* Write every webpage in the frontier (including those spilled to disk), with its priority and
+ * place in insertion order, to an open file, leaving the frontier unchanged.
+ *
+ * Caller provides:
+ *   frontier  pointer to valid frontier_t struct
+ *   fp        file open for writing
+ *
+ * We return:
+ *   true on success, false on NULL arguments or a write error
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if a segment file cannot be read
+ *
+ * Limitations:
+ *   the file is text, one webpage per line after a count; URLs must not contain newlines
+ */
+bool frontier_save(frontier_t* frontier, FILE* fp);
+
+/**************** frontier_load ****************/
+/* Add the webpages written by frontier_save to a frontier, with the priorities they had then
+ * (rather than computing new ones); webpages inserted afterwards come after them in insertion order.
+ *
+ * Caller provides:
+ *   frontier  pointer to valid frontier_t struct, normally new (and set to spill, if it should)
+ *   fp        file open for reading, positioned where frontier_save started writing
+ *
+ * We return:
+ *   true on success, false on NULL arguments or malformed input (the webpages read so far stay in)
+ */
+bool frontier_load(frontier_t* frontier, FILE* fp);
+
+/**************** frontier_delete ****************/
+/* Delete the frontier, calling pagedelete (if not NULL) on each webpage still in memory,
+ * and removing any segment files it has spilled to disk.
+ */
+void frontier_delete(frontier_t* frontier, void (*pagedelete)(void* page));
@@ -0,0 +1,241 @@
+/*
+ * idmap - map from 64-bit keys (docIDs, content hashes) to 64-bit values
+ *         See idmap.h for usage.
+ *
+ * The table is two arrays, keys and values, a power of two in size; key 0 marks an empty slot, so the
+ * value of key 0, if any, is kept apart from the table. A key's home slot is the top bits of the key
+ * times 2^64 over the golden ratio. Removing a key shifts back the keys after it that would otherwise
+ * no longer be found from their home slots, so that the table needs no markers of removed keys.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "../libcs50/mem.h"
+#include "idmap.h"
+
+/* *********************************************************************** */
+/* Private types */
+
+/* idmap_t: structure to represent a map
+ * The innards should not be visible to users of the idmap module.
+ */
+typedef struct idmap {
+  uint64_t* keys;             // 0 meaning empty
+  int64_t* values;
+  size_t capacity;            // number of slots, a power of two
+  int bits;                   // log2 of capacity
+  size_t count;               // keys in the table (not counting key 0)
+  bool hasZero;               // whether key 0 is in the map
+  int64_t zeroValue;          // and its value
+} idmap_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static size_t homeSlot(const idmap_t* map, const uint64_t key);
+static bool findSlot(const idmap_t* map, const uint64_t key, size_t* slot);
+static void allocate(idmap_t* map, const int bits);
+static void grow(idmap_t* map);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const int MIN_BITS = 6;                // smallest table: 64 slots
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** idmap_new ****************/
+/* see idmap.h for documentation */
+idmap_t* idmap_new(const size_t expected)
+{
+  idmap_t* map = mem_assert(calloc(1, sizeof(idmap_t)), "failed allocating memory for idmap");
+
+  // Room for twice the expected number, so the table stays at most half full
+  int bits = MIN_BITS;
+  while (((size_t) 1 << bits) < 2 * expected) {
+    bits++;
+  }
+  allocate(map, bits);
+  return map;
+}
+
+/**************** idmap_find ****************/
+/* see idmap.h for documentation */
+int64_t* idmap_find(idmap_t* map, const uint64_t key)
+{
+  if (map == NULL) {
+    return NULL;
+  }
+  if (key == 0) {
+    return map->hasZero ? &map->zeroValue : NULL;
+  }
+
+  size_t slot;
+  return findSlot(map, key, &slot) ? &map->values[slot] : NULL;
+}
+
+/**************** idmap_set ****************/
+/* see idmap.h for documentation */
+int64_t* idmap_set(idmap_t* map, const uint64_t key, const int64_t value)
+{
+  if (map == NULL) {
+    return NULL;
+  }
+  if (key == 0) {
+    map->hasZero = true;
+    map->zeroValue = value;
+    return &map->zeroValue;
+  }
+
+  size_t slot;
+  if (!findSlot(map, key, &slot)) {
+    // Grow first if adding one would make the table more than half full
+    if (2 * (map->count + 1) > map->capacity) {
+      grow(map);
+      findSlot(map, key, &slot);
+    }
+    map->keys[slot] = key;
+    map->count++;
+  }
+  map->values[slot] = value;
+  return &map->values[slot];
+}
+
+/**************** idmap_remove ****************/
+/* see idmap.h for documentation */
+bool idmap_remove(idmap_t* map, const uint64_t key)
+{
+  if (map == NULL) {
+    return false;
+  }
+  if (key == 0) {
+    bool had = map->hasZero;
+    map->hasZero = false;
+    return had;
+  }
+
+  size_t hole;
+  if (!findSlot(map, key, &hole)) {
+    return false;
+  }
+
+  // Each key after the hole, up to the next empty slot, moves into it if the hole lies between the key's
+  // home slot and its slot (cyclically), as it would then not be found past the hole
+  size_t mask = map->capacity - 1;
+  for (size_t i = (hole + 1) & mask; map->keys[i] != 0; i = (i + 1) & mask) {
+    size_t home = homeSlot(map, map->keys[i]);
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      map->keys[hole] = map->keys[i];
+      map->values[hole] = map->values[i];
+      hole = i;
+    }
+  }
+  map->keys[hole] = 0;
+  map->count--;
+  return true;
+}
+
+/**************** idmap_size ****************/
+/* see idmap.h for documentation */
+size_t idmap_size(idmap_t* map)
+{
+  return (map == NULL) ? 0 : map->count + (map->hasZero ? 1 : 0);
+}
+
+/**************** idmap_iterate ****************/
+/* see idmap.h for documentation */
+void idmap_iterate(idmap_t* map, void* arg, void (*itemfunc)(void* arg, const uint64_t key, const int64_t value))
+{
+  if (map == NULL || itemfunc == NULL) {
+    return;
+  }
+  if (map->hasZero) {
+    (*itemfunc)(arg, 0, map->zeroValue);
+  }
+  for (size_t i = 0; i < map->capacity; i++) {
+    if (map->keys[i] != 0) {
+      (*itemfunc)(arg, map->keys[i], map->values[i]);
+    }
+  }
+}
+
+/**************** idmap_delete ****************/
+/* see idmap.h for documentation */
+void idmap_delete(idmap_t* map)
+{
+  if (map == NULL) {
+    return;
+  }
+  free(map->keys);
+  free(map->values);
+  free(map);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** homeSlot ****************/
+/* Return the slot where key is looked for first.
+ */
+static size_t homeSlot(const idmap_t* map, const uint64_t key)
+{
+  return (size_t) ((key * 0x9e3779b97f4a7c15ULL) >> (64 - map->bits));
+}
+
+/**************** findSlot ****************/
+/* Look for key (not 0) in the table. Return true if found; either way, *slot is where it is, or the
+ * empty slot where it would go.
+ */
+static bool findSlot(const idmap_t* map, const uint64_t key, size_t* slot)
+{
+  size_t mask = map->capacity - 1;
+  size_t i = homeSlot(map, key);
+  while (map->keys[i] != 0) {
+    if (map->keys[i] == key) {
+      *slot = i;
+      return true;
+    }
+    i = (i + 1) & mask;
+  }
+  *slot = i;
+  return false;
+}
+
+/**************** allocate ****************/
+/* Give the map an empty table of 2^bits slots.
+ */
+static void allocate(idmap_t* map, const int bits)
+{
+  map->bits = bits;
+  map->capacity = (size_t) 1 << bits;
+  map->keys = mem_assert(calloc(map->capacity, sizeof(uint64_t)), "failed allocating memory for idmap keys");
+  map->values = mem_assert(malloc(map->capacity * sizeof(int64_t)), "failed allocating memory for idmap values");
+  map->count = 0;
+}
+
+/**************** grow ****************/
+/* Double the table, reinserting every key.
+ */
+static void grow(idmap_t* map)
+{
+  uint64_t* oldKeys = map->keys;
+  int64_t* oldValues = map->values;
+  size_t oldCapacity = map->capacity;
+  size_t count = map->count;
+
+  allocate(map, map->bits + 1);
+  for (size_t i = 0; i < oldCapacity; i++) {
+    if (oldKeys[i] != 0) {
+      size_t slot;
+      findSlot(map, oldKeys[i], &slot);
+      map->keys[slot] = oldKeys[i];
+      map->values[slot] = oldValues[i];
+    }
+  }
+  map->count = count;
+  free(oldKeys);
+  free(oldValues);
+}
@@ -0,0 +1,85 @@
+/*
+ * idmap - map from 64-bit keys (docIDs, content hashes) to 64-bit values
+ *
+ * The map is an open-addressing table of keys and values, a power of two in size, with linear probing,
+ * that doubles whenever it becomes half full: a lookup touches one or two adjacent slots however many
+ * keys it holds, with no allocation per key, and no key is formatted or parsed as a string. Keys are
+ * spread over the table by Fibonacci hashing, so that dense keys (docIDs) and hashes alike do.
+ *
+ * The map does no locking; callers that share one between threads must serialize access.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/***********************************************************************/
+/* idmap_t: opaque struct representing a map
+ */
+typedef struct idmap idmap_t;
+
+/**************** idmap_new ****************/
+/* Allocate and initialize an empty map.
+ *
+ * Caller provides:
+ *   expected  number of keys expected (the map grows beyond it as needed; 0 for a small one)
+ *
+ * We return:
+ *   pointer to new idmap_t struct
+ *
+ * Caller is responsible for:
+ *   later calling idmap_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+idmap_t* idmap_new(const size_t expected);
+
+/**************** idmap_find ****************/
+/* Look up a key.
+ *
+ * We return:
+ *   pointer to the value of key, through which it may be changed; or NULL on NULL map, or if key is not
+ *   in the map
+ *
+ * IMPORTANT:
+ *   the pointer is good until the next idmap_set or idmap_remove on the map, which may move its values
+ */
+int64_t* idmap_find(idmap_t* map, const uint64_t key);
+
+/**************** idmap_set ****************/
+/* Set the value of a key, adding the key if it is not in the map.
+ *
+ * We return:
+ *   pointer to the value of key, as idmap_find; or NULL on NULL map
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+int64_t* idmap_set(idmap_t* map, const uint64_t key, const int64_t value);
+
+/**************** idmap_remove ****************/
+/* Remove a key, if it is in the map.
+ *
+ * We return:
+ *   true if it was removed; false on NULL map, or if key was not in the map
+ */
+bool idmap_remove(idmap_t* map, const uint64_t key);
+
+/**************** idmap_size ****************/
+/* Return the number of keys in the map, or 0 if map is NULL.
+ */
+size_t idmap_size(idmap_t* map);
+
+/**************** idmap_iterate ****************/
+/* Call itemfunc(arg, key, value) on every key of the map, in no particular order; nothing on NULL map or
+ * itemfunc. itemfunc must not change the map.
+ */
+void idmap_iterate(idmap_t* map, void* arg, void (*itemfunc)(void* arg, const uint64_t key, const int64_t value));
+
+/**************** idmap_delete ****************/
+/* Free all memory associated with a map; nothing if map is NULL.
+ */
+void idmap_delete(idmap_t* map);
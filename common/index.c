@@ -6,8 +6,8 @@
 
 #include "../libcs50/mem.h"
 #include "../libcs50/hashtable.h"
-#include "../libcs50/counters.h"
 #include "../libcs50/file.h"
+#include "doccounts.h"
 #include "index.h"
 
 /* index_t: structure to represent an index that maps from words to (docID, count) pairs
@@ -21,7 +21,7 @@ typedef struct index {
 /* Private function prototypes */
 
 static void wordprint(void* arg, const char* key, void* item);
-static void pairprint(void* arg, const int key, const int count);
+static void pairprint(void* arg, const docid_t key, const int count);
 
 /* *********************************************************************** */
 /* Public methods */
@@ -41,49 +41,49 @@ index_t* index_new(int numSlots)
 
 /**************** index_add ****************/
 /* see index.h for documentation */
-void index_add(index_t* index, char* word, int docID)
+void index_add(index_t* index, char* word, docid_t docID)
 {
   if (index == NULL || docID < 1) {
     return;
   }
 
   // Get counter set of word
-  counters_t* IDToOccurrences = hashtable_find(index->words, word);
+  doccounts_t* IDToOccurrences = hashtable_find(index->words, word);
 
   // If no counter set, create one and insert it
   if (IDToOccurrences == NULL) {
-    IDToOccurrences = counters_new();
+    IDToOccurrences = doccounts_new();
     hashtable_insert(index->words, word, IDToOccurrences);
   }
 
   // Add one to counter corresponding to docID
-  counters_add(IDToOccurrences, docID);
+  doccounts_add(IDToOccurrences, docID);
 }
 
 /**************** index_set ****************/
 /* see index.h for documentation */
-void index_set(index_t* index, char* word, int docID, int count)
+void index_set(index_t* index, char* word, docid_t docID, int count)
 {
   if (index == NULL || docID < 1) {
     return;
   }
 
   // Get counter set of word
-  counters_t* IDToOccurrences = hashtable_find(index->words, word);
+  doccounts_t* IDToOccurrences = hashtable_find(index->words, word);
 
   // If no counter set, create one and insert it
   if (IDToOccurrences == NULL) {
-    IDToOccurrences = counters_new();
+    IDToOccurrences = doccounts_new();
     hashtable_insert(index->words, word, IDToOccurrences);
   }
 
   // Set counter corresponding to docID to count
-  counters_set(IDToOccurrences, docID, count);
+  doccounts_set(IDToOccurrences, docID, count);
 }
 
 /**************** index_get ****************/
 /* see index.h for documentation */
-counters_t* index_get(index_t* index, char* word)
+doccounts_t* index_get(index_t* index, char* word)
 {
   if (index == NULL || word == NULL) {
     return NULL;
@@ -134,11 +134,11 @@ index_t* index_load(char* indexFilename)
   // Read word at the beginning of each line
   char* word = "";
   while ((word = file_readWord(indexFile)) != NULL) {
-    int docID = 0;
+    docid_t docID = 0;
     int count = 0;
 
     // Pull off one (docID, count) pair at a time
-    while ((fscanf(indexFile, "%d %d", &docID, &count)) == 2) {
+    while ((fscanf(indexFile, "%" SCNdocid " %d", &docID, &count)) == 2) {
       index_set(index, word, docID, count); // set count corresponding to docID of word
     }
 
@@ -159,7 +159,7 @@ void index_delete(index_t* index)
   }
 
   // Delete words hashtable
-  hashtable_delete(index->words, (void (*)(void*)) counters_delete);
+  hashtable_delete(index->words, (void (*)(void*)) doccounts_delete);
 
   // Free memory for index_t struct
   free(index);
@@ -181,8 +181,8 @@ static void wordprint(void* arg, const char* key, void* item)
   fprintf(indexFile, "%s ", key);
 
   // Print all (docID, count) pairs in the format 'docID count '
-  counters_t* IDToOccurrences = (counters_t*) item;
-  counters_iterate(IDToOccurrences, indexFile, pairprint);
+  doccounts_t* IDToOccurrences = (doccounts_t*) item;
+  doccounts_iterate(IDToOccurrences, indexFile, pairprint);
 
   // Print newline to file
   fprintf(indexFile, "\n");
@@ -191,11 +191,11 @@ static void wordprint(void* arg, const char* key, void* item)
 /* ****************** pairprint ***************************** */
 /* print a (docID, count) pair to a file in the format 'docID count'
  */
-static void pairprint(void* arg, const int key, const int count)
+static void pairprint(void* arg, const docid_t key, const int count)
 {
   // Cast void pointer to file pointer
   FILE* indexFile = (FILE*) arg;
 
   // Print (docID, count) pair to file in the format 'docID count '
-  fprintf(indexFile, "%d %d ", key, count);
+  fprintf(indexFile, "%" PRIdocid " %d ", key, count);
 }
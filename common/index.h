@@ -4,7 +4,7 @@
  * By Rodrigo Vega Ayllon - October 2024
  */
 
-#include "../libcs50/counters.h"
+#include "doccounts.h"
 
 /***********************************************************************/
 /* index_t: struct to represent an index that maps from word to (docID, count) pairs
@@ -34,7 +34,7 @@ index_t* index_new(int numSlots);
  * Caller provides:
  *   index  pointer to valid index_t struct
  *   word   word string
- *   docID  integer ID of webpage document (must be > 0)
+ *   docID  ID of webpage document (must be > 0)
  *
  * We guarantee:
  *   the counter's value will be >= 1, on successful return.
@@ -51,7 +51,7 @@ index_t* index_new(int numSlots);
  *   later deallocating that memory; thus, the caller is free to re-use or 
  *   deallocate its word string after this call.  
  */
-void index_add(index_t* index, char* word, int docID);
+void index_add(index_t* index, char* word, docid_t docID);
 
 /**************** index_set ****************/
 /* Set count of word's counter corresponding to document referenced by its ID
@@ -59,7 +59,7 @@ void index_add(index_t* index, char* word, int docID);
  * Caller provides:
  *   index  pointer to valid index_t struct
  *   word   word string
- *   docID  integer ID of webpage document (must be > 0)
+ *   docID  ID of webpage document (must be > 0)
  *   count  integer to be set as count of word's counter (must be >= 0)
  *
  * We do:
@@ -74,7 +74,7 @@ void index_add(index_t* index, char* word, int docID);
  *   later deallocating that memory; thus, the caller is free to re-use or 
  *   deallocate its word string after this call.  
  */
-void index_set(index_t* index, char* word, int docID, int count);
+void index_set(index_t* index, char* word, docid_t docID, int count);
 
 /**************** index_get ****************/
 /* Get counter set corresponding to word
@@ -87,7 +87,7 @@ void index_set(index_t* index, char* word, int docID, int count);
  *   NULL if index is NULL, word is NULL, or word is not in index
  *   otherwise, pointer to counter set of word
  */
-counters_t* index_get(index_t* index, char* word);
+doccounts_t* index_get(index_t* index, char* word);
 
 /**************** index_save ****************/
 /* Saves all index information to a file
@@ -0,0 +1,448 @@
+/*
+ * lzcodec - a fast LZ77 block codec, in the manner of LZ4, with optional shared dictionaries
+ *           See lzcodec.h for usage.
+ *
+ * The compressor keeps a table, indexed by a hash of 4 bytes, of the position where those 4 bytes were
+ * last seen; at each position it looks the 4 bytes there up, and if they were seen within reach of an
+ * offset, and are the same (not merely of the same hash), extends the match as far as it goes and emits
+ * a sequence. Positions are counted from the start of the dictionary, whose bytes come before the
+ * block's, so that one table covers both; a dictionary's own table is built once, and copied in for
+ * each block. Where nothing matches, the compressor moves on in ever larger steps, so that data which
+ * does not compress is gone through quickly. A match found in the dictionary stops at its end.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "../libcs50/mem.h"
+#include "lzcodec.h"
+
+/* lzcodec_dict_t: structure to represent a dictionary
+ * The innards should not be visible to users of the lzcodec module.
+ */
+typedef struct lzcodec_dict {
+  unsigned char* bytes;
+  size_t length;
+  uint32_t* table;            // table[hash]: position + 1 of the last 4 bytes of that hash, 0 for none
+} lzcodec_dict_t;
+
+/* candidate_t: a piece of a sample that may go in a dictionary being trained */
+typedef struct candidate {
+  const unsigned char* bytes; // SEGMENT_BYTES of them
+  uint64_t score;
+} candidate_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static unsigned char* putSequence(unsigned char* out, const unsigned char* end, const unsigned char* literals,
+                                  const size_t numLiterals, const size_t offset, const size_t matchLength);
+static unsigned char* putLength(unsigned char* out, size_t length);
+static bool getLength(const unsigned char** in, const unsigned char* end, size_t* length);
+static uint32_t hashOf(const uint32_t sequence);
+static uint32_t getU32(const unsigned char* bytes);
+static uint32_t gramHash(const unsigned char* bytes);
+static uint64_t scoreOf(const unsigned char* bytes, const uint32_t* counts);
+static int compareCandidates(const void* a, const void* b);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+#define HASH_BITS 13                          // of the match table's index: 8192 slots
+static const size_t MAX_OFFSET = 65535;       // farthest back a match may be
+static const int TOKEN_MAX = 15;              // largest count in a token's four bits
+static const int SKIP_SHIFT = 6;              // after each 64 positions without a match, step one further
+#define FAST_COPY 16                          // bytes copied at once for short literals and matches
+static const int GRAM_BYTES = 8;              // of the strings counted by the trainer
+static const int GRAM_BITS = 16;              // of the trainer's count table's index
+static const int SEGMENT_BYTES = 64;          // of a piece of a dictionary
+static const int SEGMENT_STEP = 16;           // between the starts of pieces considered
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** lzcodec_bound ****************/
+/* see lzcodec.h for documentation */
+size_t lzcodec_bound(const size_t length)
+{
+  // All literals: a token, the length in 255s, the bytes
+  return length + length / 255 + 16;
+}
+
+/**************** lzcodec_compress ****************/
+/* see lzcodec.h for documentation */
+size_t lzcodec_compress(const char* src, const size_t length, char* dst, const size_t capacity,
+                        const lzcodec_dict_t* dict)
+{
+  if (src == NULL || dst == NULL) {
+    return 0;
+  }
+
+  const unsigned char* in = (const unsigned char*) src;
+  const unsigned char* base = (dict == NULL) ? NULL : dict->bytes;
+  const size_t baseLength = (dict == NULL) ? 0 : dict->length;
+  unsigned char* out = (unsigned char*) dst;
+  const unsigned char* outEnd = out + capacity;
+
+  uint32_t table[1 << HASH_BITS];
+  if (dict == NULL) {
+    memset(table, 0, sizeof(table));
+  } else {
+    memcpy(table, dict->table, sizeof(table));
+  }
+
+  // Look for a match at every position with 4 bytes left (stepping further after a run of misses)
+  size_t anchor = 0;          // the first byte not yet emitted
+  size_t pos = 0;
+  size_t misses = 0;
+  while (length >= LZCODEC_MIN_MATCH && pos <= length - LZCODEC_MIN_MATCH) {
+    uint32_t sequence = getU32(in + pos);
+    uint32_t* slot = &table[hashOf(sequence)];
+    size_t here = baseLength + pos;
+    size_t seen = *slot;
+    *slot = here + 1;
+
+    if (seen != 0 && here - (seen - 1) <= MAX_OFFSET) {
+      // In the dictionary, a match can go no further than its end
+      size_t ref = seen - 1;
+      const unsigned char* match = (ref < baseLength) ? base + ref : in + (ref - baseLength);
+      size_t limit = length - pos;
+      if (ref < baseLength && baseLength - ref < limit) {
+        limit = baseLength - ref;
+      }
+      if (limit >= LZCODEC_MIN_MATCH && getU32(match) == sequence) {
+        size_t matchLength = LZCODEC_MIN_MATCH;
+        while (matchLength < limit && in[pos + matchLength] == match[matchLength]) {
+          matchLength++;
+        }
+        out = putSequence(out, outEnd, in + anchor, pos - anchor, here - ref, matchLength);
+        if (out == NULL) {
+          return 0;
+        }
+        pos += matchLength;
+        anchor = pos;
+        misses = 0;
+
+        // The bytes just before the next position are worth remembering, as markup repeats in runs
+        if (pos + 2 <= length) {
+          table[hashOf(getU32(in + pos - 2))] = baseLength + pos - 2 + 1;
+        }
+        continue;
+      }
+    }
+    pos += 1 + (misses++ >> SKIP_SHIFT);
+  }
+
+  // The rest are literals
+  out = putSequence(out, outEnd, in + anchor, length - anchor, 0, 0);
+  return (out == NULL) ? 0 : (size_t) (out - (unsigned char*) dst);
+}
+
+/**************** lzcodec_decompress ****************/
+/* see lzcodec.h for documentation */
+bool lzcodec_decompress(const char* src, const size_t length, char* dst, const size_t dstLength,
+                        const lzcodec_dict_t* dict)
+{
+  if (src == NULL || dst == NULL) {
+    return false;
+  }
+
+  const unsigned char* in = (const unsigned char*) src;
+  const unsigned char* inEnd = in + length;
+  unsigned char* out = (unsigned char*) dst;
+  unsigned char* outEnd = out + dstLength;
+  const size_t baseLength = (dict == NULL) ? 0 : dict->length;
+
+  while (in < inEnd) {
+    // Literals
+    unsigned token = *in++;
+    size_t numLiterals = token >> 4;
+    if (numLiterals == (size_t) TOKEN_MAX && !getLength(&in, inEnd, &numLiterals)) {
+      return false;
+    }
+    if (numLiterals > (size_t) (inEnd - in) || numLiterals > (size_t) (outEnd - out)) {
+      return false;
+    }
+    if (numLiterals <= (size_t) FAST_COPY && inEnd - in >= FAST_COPY && outEnd - out >= FAST_COPY) {
+      memcpy(out, in, FAST_COPY);   // a fixed-size copy, of a few bytes too many, overwritten next
+    } else {
+      memcpy(out, in, numLiterals);
+    }
+    in += numLiterals;
+    out += numLiterals;
+    if (in == inEnd) {
+      return (out == outEnd);       // the last sequence, with literals only
+    }
+
+    // Match
+    if (inEnd - in < 2) {
+      return false;
+    }
+    size_t offset = in[0] | ((size_t) in[1] << 8);
+    in += 2;
+    size_t matchLength = token & TOKEN_MAX;
+    if (matchLength == (size_t) TOKEN_MAX && !getLength(&in, inEnd, &matchLength)) {
+      return false;
+    }
+    matchLength += LZCODEC_MIN_MATCH;
+    size_t produced = out - (unsigned char*) dst;
+    if (offset == 0 || offset > produced + baseLength || matchLength > (size_t) (outEnd - out)) {
+      return false;
+    }
+
+    // A short match in the block, overlapping its copy by half or less, is copied in two fixed-size halves
+    if (offset <= produced && matchLength <= (size_t) FAST_COPY && offset >= (size_t) FAST_COPY / 2
+        && outEnd - out >= FAST_COPY) {
+      memcpy(out, out - offset, FAST_COPY / 2);
+      memcpy(out + FAST_COPY / 2, out - offset + FAST_COPY / 2, FAST_COPY / 2);
+      out += matchLength;
+      continue;
+    }
+
+    // A match reaching back before the block starts in the dictionary, and may run on into the block
+    if (offset > produced) {
+      size_t fromDict = offset - produced;
+      size_t copied = (fromDict < matchLength) ? fromDict : matchLength;
+      memcpy(out, dict->bytes + baseLength - fromDict, copied);
+      out += copied;
+      matchLength -= copied;
+      if (matchLength == 0) {
+        continue;
+      }
+    }
+    const unsigned char* match = out - offset;
+    if (offset >= matchLength) {
+      memcpy(out, match, matchLength);
+      out += matchLength;
+    } else {
+      // Overlapping: the match repeats the last offset bytes
+      for (size_t i = 0; i < matchLength; i++) {
+        *out++ = *match++;
+      }
+    }
+  }
+  return false;                     // no last sequence
+}
+
+/**************** lzcodec_dict_train ****************/
+/* see lzcodec.h for documentation */
+size_t lzcodec_dict_train(const char* samples[], const size_t lengths[], const int numSamples,
+                          char* dict, const size_t capacity)
+{
+  if (samples == NULL || lengths == NULL || dict == NULL || numSamples < 2) {
+    return 0;
+  }
+
+  // Count, for (the hash of) every 8-byte string, the number of samples it appears in
+  size_t slots = (size_t) 1 << GRAM_BITS;
+  uint32_t* counts = mem_assert(calloc(slots, sizeof(uint32_t)), "failed allocating memory for dictionary");
+  int* lastSample = mem_assert(malloc(slots * sizeof(int)), "failed allocating memory for dictionary");
+  for (size_t h = 0; h < slots; h++) {
+    lastSample[h] = -1;
+  }
+  size_t numCandidates = 0;
+  for (int s = 0; s < numSamples; s++) {
+    const unsigned char* sample = (const unsigned char*) samples[s];
+    for (size_t i = 0; sample != NULL && i + GRAM_BYTES <= lengths[s]; i++) {
+      uint32_t h = gramHash(sample + i);
+      if (lastSample[h] != s) {
+        lastSample[h] = s;
+        counts[h]++;
+      }
+    }
+    if (sample != NULL && lengths[s] >= (size_t) SEGMENT_BYTES) {
+      numCandidates += (lengths[s] - SEGMENT_BYTES) / SEGMENT_STEP + 1;
+    }
+  }
+  free(lastSample);
+
+  // Score every piece by how widely its strings are shared, and take the best first
+  candidate_t* candidates = mem_assert(malloc((numCandidates + 1) * sizeof(candidate_t)),
+                                       "failed allocating memory for dictionary");
+  size_t n = 0;
+  for (int s = 0; s < numSamples; s++) {
+    const unsigned char* sample = (const unsigned char*) samples[s];
+    for (size_t i = 0; sample != NULL && i + SEGMENT_BYTES <= lengths[s]; i += SEGMENT_STEP) {
+      candidates[n].bytes = sample + i;
+      candidates[n].score = scoreOf(sample + i, counts);
+      n++;
+    }
+  }
+  qsort(candidates, n, sizeof(candidate_t), compareCandidates);
+
+  // Each piece taken makes its strings worthless to the rest, so a piece is scored again before it is
+  // taken, and passed over if it has lost more than half its worth to those taken before it; the best
+  // go at the end of the dictionary, nearest the blocks to be compressed against it
+  size_t room = (capacity < LZCODEC_DICT_BYTES) ? capacity : LZCODEC_DICT_BYTES;
+  size_t filled = 0;
+  for (size_t c = 0; c < n && candidates[c].score > 0 && filled + SEGMENT_BYTES <= room; c++) {
+    uint64_t score = scoreOf(candidates[c].bytes, counts);
+    if (score == 0 || score * 2 < candidates[c].score) {
+      continue;
+    }
+    filled += SEGMENT_BYTES;
+    memcpy(dict + room - filled, candidates[c].bytes, SEGMENT_BYTES);
+    for (int i = 0; i + GRAM_BYTES <= SEGMENT_BYTES; i++) {
+      counts[gramHash(candidates[c].bytes + i)] = 0;
+    }
+  }
+  memmove(dict, dict + room - filled, filled);
+  free(candidates);
+  free(counts);
+  return filled;
+}
+
+/**************** lzcodec_dict_new ****************/
+/* see lzcodec.h for documentation */
+lzcodec_dict_t* lzcodec_dict_new(const char* bytes, const size_t length)
+{
+  if (bytes == NULL || length == 0 || length > LZCODEC_DICT_BYTES) {
+    return NULL;
+  }
+
+  lzcodec_dict_t* dict = mem_assert(malloc(sizeof(lzcodec_dict_t)), "failed allocating memory for dictionary");
+  dict->bytes = mem_assert(malloc(length), "failed allocating memory for dictionary");
+  memcpy(dict->bytes, bytes, length);
+  dict->length = length;
+
+  // Later positions overwrite earlier ones, as the compressor's own do
+  dict->table = mem_assert(calloc((size_t) 1 << HASH_BITS, sizeof(uint32_t)), "failed allocating memory for dictionary");
+  for (size_t i = 0; i + LZCODEC_MIN_MATCH <= length; i++) {
+    dict->table[hashOf(getU32(dict->bytes + i))] = i + 1;
+  }
+  return dict;
+}
+
+/**************** lzcodec_dict_delete ****************/
+/* see lzcodec.h for documentation */
+void lzcodec_dict_delete(lzcodec_dict_t* dict)
+{
+  if (dict != NULL) {
+    free(dict->bytes);
+    free(dict->table);
+    free(dict);
+  }
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** putSequence ****************/
+/* Write a sequence at out, before end: numLiterals literals, then a match of matchLength bytes offset
+ * back, or none if offset is 0 (the last sequence). Return where it ends, or NULL if it does not fit.
+ */
+static unsigned char* putSequence(unsigned char* out, const unsigned char* end, const unsigned char* literals,
+                                  const size_t numLiterals, const size_t offset, const size_t matchLength)
+{
+  size_t matchCount = (offset == 0) ? 0 : matchLength - LZCODEC_MIN_MATCH;
+  size_t most = 1 + numLiterals / 255 + 1 + numLiterals + 2 + matchCount / 255 + 1;
+  if ((size_t) (end - out) < most) {
+    return NULL;
+  }
+
+  *out++ = ((numLiterals < (size_t) TOKEN_MAX) ? numLiterals : TOKEN_MAX) << 4
+           | ((matchCount < (size_t) TOKEN_MAX) ? matchCount : TOKEN_MAX);
+  if (numLiterals >= (size_t) TOKEN_MAX) {
+    out = putLength(out, numLiterals - TOKEN_MAX);
+  }
+  memcpy(out, literals, numLiterals);
+  out += numLiterals;
+  if (offset == 0) {
+    return out;
+  }
+
+  *out++ = offset & 0xff;
+  *out++ = offset >> 8;
+  if (matchCount >= (size_t) TOKEN_MAX) {
+    out = putLength(out, matchCount - TOKEN_MAX);
+  }
+  return out;
+}
+
+/**************** putLength ****************/
+/* Write the rest of a count past a token's 15 at out, as bytes of 255 and a last one below; return
+ * where it ends.
+ */
+static unsigned char* putLength(unsigned char* out, size_t length)
+{
+  while (length >= 255) {
+    *out++ = 255;
+    length -= 255;
+  }
+  *out++ = length;
+  return out;
+}
+
+/**************** getLength ****************/
+/* Read the rest of a count past a token's 15 from *in, before end, adding it to *length and moving *in
+ * past it. Return false if it runs past end.
+ */
+static bool getLength(const unsigned char** in, const unsigned char* end, size_t* length)
+{
+  unsigned byte;
+  do {
+    if (*in >= end) {
+      return false;
+    }
+    byte = *(*in)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/**************** hashOf ****************/
+/* Return the index in a match table of 4 bytes (Fibonacci hashing).
+ */
+static uint32_t hashOf(const uint32_t sequence)
+{
+  return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/**************** getU32 ****************/
+/* Return the 4 bytes at bytes, as a number (in no particular byte order, as only equality matters).
+ */
+static uint32_t getU32(const unsigned char* bytes)
+{
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+/**************** gramHash ****************/
+/* Return the index in the trainer's count table of the 8 bytes at bytes.
+ */
+static uint32_t gramHash(const unsigned char* bytes)
+{
+  uint64_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return (value * 0x9e3779b97f4a7c15ULL) >> (64 - GRAM_BITS);
+}
+
+/**************** scoreOf ****************/
+/* Return the worth of a piece of a sample for a dictionary: the sum, over its 8-byte strings found in
+ * more than one sample, of the number of samples they are found in.
+ */
+static uint64_t scoreOf(const unsigned char* bytes, const uint32_t* counts)
+{
+  uint64_t score = 0;
+  for (int i = 0; i + GRAM_BYTES <= SEGMENT_BYTES; i++) {
+    uint32_t count = counts[gramHash(bytes + i)];
+    if (count > 1) {
+      score += count;
+    }
+  }
+  return score;
+}
+
+/**************** compareCandidates ****************/
+/* qsort comparison function for candidates, best score first.
+ */
+static int compareCandidates(const void* a, const void* b)
+{
+  uint64_t x = ((const candidate_t*) a)->score;
+  uint64_t y = ((const candidate_t*) b)->score;
+  return (x < y) - (x > y);
+}
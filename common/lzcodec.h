@@ -0,0 +1,120 @@
+/*
+ * lzcodec - a fast LZ77 block codec, in the manner of LZ4, with optional shared dictionaries
+ *
+ * A block is compressed into a series of sequences, each a run of literal bytes followed by a match: a
+ * copy of earlier bytes, given as a 16-bit offset back from where it goes and a length. A sequence
+ * starts with a token byte whose high four bits count the literals and low four the match length less
+ * LZCODEC_MIN_MATCH; a count of 15 carries on in the bytes after (each 255 adding 255 and going on, any
+ * other ending it), the literals follow, then the offset (2 bytes, little-endian) and the rest of the
+ * match length. The last sequence has literals only, and ends the block. Matches are found through a
+ * table of where each 4-byte sequence was last seen, so that compressing takes a single pass, and
+ * decompressing is little more than copying.
+ *
+ * A dictionary is a block of bytes that a block may be compressed against as if they came right before
+ * it, so that even a small block finds matches in it; the same dictionary must be given to decompress
+ * the block. lzcodec_dict_train builds one out of a sample of blocks, from the byte strings common to
+ * most of them (for webpages, the markup every page of a site shares).
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/***********************************************************************/
+/* lzcodec_dict_t: opaque struct representing a dictionary, ready to compress against
+ */
+typedef struct lzcodec_dict lzcodec_dict_t;
+
+/* Shortest match encoded */
+#define LZCODEC_MIN_MATCH 4
+
+/* Largest dictionary (32 KiB), half the reach of an offset */
+#define LZCODEC_DICT_BYTES (32 << 10)
+
+/**************** lzcodec_bound ****************/
+/* Return the most bytes a block of length bytes may be compressed into.
+ */
+size_t lzcodec_bound(const size_t length);
+
+/**************** lzcodec_compress ****************/
+/* Compress a block.
+ *
+ * Caller provides:
+ *   src       the block's bytes, of which there are length
+ *   dst       where to write the compressed block, room for capacity bytes (lzcodec_bound(length) always
+ *             being enough)
+ *   dict      dictionary to compress against, or NULL for none
+ *
+ * We return:
+ *   the number of bytes written to dst; or 0 on NULL src or dst, or if they do not fit in capacity
+ *
+ * Notes:
+ *   a block that does not compress comes out a little longer than it went in; callers may prefer to
+ *   keep it as it is
+ */
+size_t lzcodec_compress(const char* src, const size_t length, char* dst, const size_t capacity,
+                        const lzcodec_dict_t* dict);
+
+/**************** lzcodec_decompress ****************/
+/* Decompress a block.
+ *
+ * Caller provides:
+ *   src       the compressed block, of length bytes
+ *   dst       where to write the block, room for exactly dstLength bytes, the length it had
+ *   dict      the dictionary it was compressed against, or NULL for none
+ *
+ * We return:
+ *   true if the block was decompressed into exactly dstLength bytes; false on NULL src or dst, or if it
+ *   is malformed, or does not decompress to dstLength bytes (as when compressed against another
+ *   dictionary, or none)
+ *
+ * Notes:
+ *   no byte is read from outside src nor written outside dst, whatever src holds; dst is not
+ *   NUL-terminated
+ */
+bool lzcodec_decompress(const char* src, const size_t length, char* dst, const size_t dstLength,
+                        const lzcodec_dict_t* dict);
+
+/**************** lzcodec_dict_train ****************/
+/* Build a dictionary out of a sample of blocks.
+ *
+ * Caller provides:
+ *   samples, lengths   the numSamples blocks, and their lengths
+ *   dict               where to write the dictionary, room for capacity bytes (at most
+ *                      LZCODEC_DICT_BYTES are used)
+ *
+ * We return:
+ *   the length of the dictionary written to dict; 0 if the sample shares nothing worth keeping (as a
+ *   sample of fewer than two blocks does)
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ *
+ * Notes:
+ *   the dictionary is made of 64-byte pieces of the samples, those sharing the most 8-byte strings with
+ *   the most other samples first; it is best trained on some dozens of blocks or more, like those to be
+ *   compressed against it
+ */
+size_t lzcodec_dict_train(const char* samples[], const size_t lengths[], const int numSamples,
+                          char* dict, const size_t capacity);
+
+/**************** lzcodec_dict_new ****************/
+/* Make a dictionary of length bytes (copied; at most LZCODEC_DICT_BYTES), as lzcodec_dict_train wrote.
+ *
+ * We return:
+ *   pointer to new lzcodec_dict_t struct, or NULL on NULL bytes, or a length of 0 or past
+ *   LZCODEC_DICT_BYTES
+ *
+ * Caller is responsible for:
+ *   later calling lzcodec_dict_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+lzcodec_dict_t* lzcodec_dict_new(const char* bytes, const size_t length);
+
+/**************** lzcodec_dict_delete ****************/
+/* Free all memory associated with a dictionary (NULL being no dictionary).
+ */
+void lzcodec_dict_delete(lzcodec_dict_t* dict);
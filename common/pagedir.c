@@ -1,55 +1,233 @@
-/* 
+/*
  * pagedir - utility functions for outputting a page to the appropriate text file
  *           See pagedir.h for usage.
  *
+ * Page files live in one of three layouts, recorded in the '.crawler' marker: version 1 puts every page
+ * file right in pageDirectory (the marker is empty); version 2 ('pagedir 2') puts page docID in
+ * pageDirectory/XX/YY/docID, where XX and YY are the two bytes of a 16-bit hash of docID, in hex, so
+ * that no directory holds more than a small share of a large crawl; version 3 ('pagedir 3') has no page
+ * files, but appends each page's bytes, as a page file would hold them, to a segstore in pageDirectory.
+ * readPage, pageExists, removePage and writePage are the only functions that tell the layouts apart
+ * when it comes to a single page.
+ *
+ * Compression is a matter of a page's HTML alone, whatever the layout: writePage compresses it (see
+ * compressHTML), noting the codec on the depth line, and parsePage and viewPage, which every load goes
+ * through, decompress it (see decompressHTML).
+ *
  * By Rodrigo Vega Ayllon - October 2024
  */
 
+#define _GNU_SOURCE       // fmemopen
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "pagedir.h"
+#include "segstore.h"
+#include "lzcodec.h"
+#include "idmap.h"
 #include "../libcs50/mem.h"
 #include "../libcs50/webpage.h"
 #include "../libcs50/file.h"
+#include "../libcs50/hash64.h"
+
+/* *********************************************************************** */
+/* Private types */
+
+/* aliasList_t: the aliases of a docID, as collected from canonicals */
+typedef struct aliasList {
+  docid_t docID;
+  docid_t* aliases;
+  int numAliases;
+} aliasList_t;
+
+/* claim_t: the pages a save of docID claimed under contentsLock, to write and read outside it (see claimPages) */
+typedef struct claim {
+  docid_t docID;
+  uint64_t hash;              // of the HTML being saved
+  docid_t candidate;          // page saved with the same hash, to compare HTML with; 0 if none
+  docid_t* aliases;           // aliases of docID, in docID order, whose content may move; NULL if none
+  int numAliases;
+} claim_t;
+
+/* mapping_t: a page file mapped into memory, for the view of it to unmap */
+typedef struct mapping {
+  void* address;
+  size_t length;
+} mapping_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static int layoutOf(const char* pageDirectory);
+static pagedir_compress_t compressionOf(const char* pageDirectory);
+static int markerOf(const char* pageDirectory, pagedir_compress_t* compress);
+static int readLayout(const char* pageDirectory, pagedir_compress_t* compress);
+static bool writeLayout(const char* pageDirectory, const int layout, const pagedir_compress_t compress);
+static int pagePath(char* path, const size_t size, const char* pageDirectory, const docid_t docID, const char* suffix);
+static int shardPath(char* path, const size_t size, const char* pageDirectory, const docid_t docID, const char* suffix);
+static bool makeShard(const char* pageDirectory, const docid_t docID);
+static docid_t pageFileID(const char* directory, const char* name, bool* part);
+static int removeFrom(const char* directory, const docid_t docID);
+static bool movePages(const char* from, const char* pageDirectory, int* moved);
+static segstore_t* storeOf(const char* pageDirectory);
+static char* readPage(const char* pageDirectory, const docid_t docID, size_t* length);
+static webpage_t* parsePage(const char* pageDirectory, char* bytes, const size_t length, const bool withHTML);
+static webpage_t* viewPage(const char* pageDirectory, const char* bytes, const size_t length,
+                           void (*release)(void* arg), void* arg);
+static bool parseDepth(const char* depthString, const char* end, int* depth, pagedir_compress_t* codec,
+                       size_t* htmlLength);
+static char* compressHTML(const char* pageDirectory, const char* HTML, const size_t length, size_t* packedLength,
+                          const char** tag);
+static char* decompressHTML(const char* pageDirectory, const pagedir_compress_t codec, const char* packed,
+                            const size_t length, const size_t htmlLength);
+static lzcodec_dict_t* dictionaryOf(const char* pageDirectory);
+static void trainDictionary(const char* pageDirectory);
+static void unmapPage(void* arg);
+static bool pageExists(const char* pageDirectory, const docid_t docID);
+static void removePage(const char* pageDirectory, const docid_t docID);
+static void writePage(const char* pageDirectory, const docid_t docID, const char* URL, const int depth, const char* HTML);
+static void claimPages(claim_t* claim);
+static bool claimable(const docid_t docID, const bool write);
+static void markClaim(const docid_t docID, const bool write);
+static void releaseClaim(const docid_t docID);
+static docid_t findCanonical(const char* pageDirectory, const char* HTML, const claim_t* claim);
+static docid_t moveContent(const char* pageDirectory, const claim_t* claim, const char* HTML, uint64_t* oldHash);
+static void recordSave(const char* pageDirectory, claim_t* claim, const docid_t canonical, const docid_t holder,
+                       const uint64_t oldHash);
+static void collectAlias(void* arg, const uint64_t key, const int64_t canonical);
+static int compareDocIDs(const void* a, const void* b);
+static void loadContents(const char* pageDirectory);
+static void forgetContents(void);
+static void appendContents(const char* pageDirectory, const docid_t docID, const uint64_t hash, const docid_t canonical);
+static void noteCanonical(const docid_t docID, const docid_t canonical);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const int FLAT_LAYOUT = 1;             // page files right in pageDirectory
+static const int SHARDED_LAYOUT = 2;          // page files in pageDirectory/XX/YY
+static const int SEGMENT_LAYOUT = 3;          // pages in a segstore in pageDirectory
+static const char* LZ_TAG = "lz";             // on the depth line of HTML compressed without a dictionary
+static const char* LZ_DICT_TAG = "lzd";       // and with one
+
+/* The content hashes of the pages saved in one pageDirectory, as pagedir_save needs them: each hash maps
+ * to the docID of the page saved with that content; and which pages are aliases of which, so that a page's
+ * content can be moved to one of its aliases before it is overwritten. The tables grow with the crawl (see
+ * idmap.h), so that looking a page up in them takes the same time at a million pages as at a thousand.
+ * Guarded by contentsLock, which pagedir_save holds only to look pages up and claim them, then to record
+ * what it saved; the pages a save is writing or reading meanwhile are in claims, and a save that needs one
+ * of them waits on claimsReleased.
+ */
+static char* contentsDirectory = NULL;        // the pageDirectory they are for, or NULL if not loaded
+static idmap_t* contents = NULL;              // content hash -> docID
+static idmap_t* canonicals = NULL;            // docID of a page that is or was an alias -> canonical docID
+static idmap_t* aliasCounts = NULL;           // docID of a page with aliases -> number of them
+static idmap_t* claims = NULL;                // docID of a page claimed -> -1 if being written, or readers
+static pthread_mutex_t contentsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t claimsReleased = PTHREAD_COND_INITIALIZER;
+
+/* The layout of the last pageDirectory whose marker was read, and whether its pages are compressed, so
+ * that building a page path costs no read of the marker; guarded by layoutLock, which is never held while
+ * taking contentsLock.
+ */
+static char* layoutDirectory = NULL;          // the pageDirectory it is for, or NULL if none yet
+static int layoutVersion = 0;
+static pagedir_compress_t layoutCompress = PAGEDIR_PLAIN;
+static pthread_mutex_t layoutLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The segstore of the last pageDirectory in the segment layout whose pages were used, kept open; guarded
+ * by storeLock, which may be taken while holding contentsLock, but not the other way around.
+ */
+static char* storeDirectory = NULL;           // the pageDirectory it is for, or NULL if none open
+static segstore_t* store = NULL;
+static pthread_mutex_t storeLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The shared dictionary of the last pageDirectory whose pages were compressed or decompressed with one,
+ * read from its '.dictionary' once there is one, and kept until another directory's is needed; guarded by
+ * dictLock, which is never held while taking another lock.
+ */
+static char* dictDirectory = NULL;            // the pageDirectory it is for, or NULL if none yet
+static lzcodec_dict_t* dictionary = NULL;     // NULL until '.dictionary' is read
+static bool dictTrained = false;              // whether training one was tried, by this process
+static pthread_mutex_t dictLock = PTHREAD_MUTEX_INITIALIZER;
 
 /* *********************************************************************** */
 /* Public methods */
 
 /**************** pagedir_init ****************/
 /* see pagedir.h for documentation */
-bool pagedir_init(const char* pageDirectory)
+bool pagedir_init(const char* pageDirectory, const pagedir_store_t storeKind, const pagedir_compress_t compressKind)
 {
   if (pageDirectory == NULL) {
     fprintf(stderr, "pageDirectory string is NULL\n");
     exit(1);
   }
 
-  // Construct '.crawler' file path and create/overwrite it
+  // Construct '.crawler' file path
   int dotfilePathLength = strlen("/.crawler") + strlen(pageDirectory) + 1;
   char dotfilePath[dotfilePathLength];
   snprintf(dotfilePath, dotfilePathLength, "%s/.crawler", pageDirectory);
-  FILE* dotfile = fopen(dotfilePath, "w");
- 
-  if (dotfile == NULL) { // if failed creating/overwriting it
-    return false;
-  } else {
-    fclose(dotfile);
-    return true;
+
+  // A directory crawled before keeps its layout, if it is one we know, and its compression; a new one
+  // gets those of storeKind and compressKind
+  if (access(dotfilePath, F_OK) == 0) {
+    return (access(dotfilePath, W_OK) == 0 && layoutOf(pageDirectory) != 0);
   }
+  return writeLayout(pageDirectory, (storeKind == PAGEDIR_SEGMENTS) ? SEGMENT_LAYOUT : SHARDED_LAYOUT, compressKind);
 }
 
 /**************** pagedir_save ****************/
 /* see pagedir.h for documentation */
-void pagedir_save(const webpage_t* page, const char* pageDirectory, const int docID)
+docid_t pagedir_save(const webpage_t* page, const char* pageDirectory, const docid_t docID)
 {
   if (page == NULL) {
     fprintf(stderr, "page webpage_t pointer is NULL\n");
     exit(1);
   }
 
-  FILE* pageFile = pagedir_open(pageDirectory, docID, "w");
-  fprintf(pageFile, "%s\n%d\n%s", webpage_getURL(page), webpage_getDepth(page), webpage_getHTML(page));
-  fclose(pageFile);
+  if (pageDirectory == NULL) {
+    fprintf(stderr, "pageDirectory string is NULL\n");
+    exit(1);
+  }
+
+  const char* HTML = (webpage_getHTML(page) == NULL) ? "" : webpage_getHTML(page);
+  uint64_t hash = hash64_string(HTML);
+
+  // Past the sample of pages a shared dictionary is trained on, it is trained (once), for this page and those after
+  if (docID > PAGEDIR_DICT_SAMPLE && compressionOf(pageDirectory) == PAGEDIR_LZ_DICT) {
+    trainDictionary(pageDirectory);
+  }
+
+  // Only looking up and claiming the pages this save needs is done under the lock, so that saves of other
+  // pages go on meanwhile, waiting only for a page claimed by another
+  claim_t claim = { docID, hash, 0, NULL, 0 };
+  pthread_mutex_lock(&contentsLock);
+  loadContents(pageDirectory);
+  claimPages(&claim);
+  pthread_mutex_unlock(&contentsLock);
+
+  // If other pages are aliases of this one, and its content is about to change, they keep the old content
+  uint64_t oldHash = 0;
+  docid_t holder = moveContent(pageDirectory, &claim, HTML, &oldHash);
+
+  // If a page was saved with the same content, this page becomes its alias when their HTML matches too;
+  // an alias has no HTML of its own
+  docid_t canonical = findCanonical(pageDirectory, HTML, &claim);
+  writePage(pageDirectory, docID, webpage_getURL(page), webpage_getDepth(page), (canonical == docID) ? HTML : "");
+
+  pthread_mutex_lock(&contentsLock);
+  recordSave(pageDirectory, &claim, canonical, holder, oldHash);
+  pthread_mutex_unlock(&contentsLock);
+  return canonical;
 }
 
 /**************** pagedir_validate ****************/
@@ -65,75 +243,1398 @@ bool pagedir_validate(const char* pageDirectory)
   int dotfilePathLength = strlen(pageDirectory) + strlen("/.crawler") + 1;
   char dotfilePath[dotfilePathLength];
   snprintf(dotfilePath, dotfilePathLength, "%s/.crawler", pageDirectory);
+  if (access(dotfilePath, R_OK) != 0 || layoutOf(pageDirectory) == 0) {
+    return false;
+  }
 
-  // Construct '1' file path
-  int pagePathLength = strlen(pageDirectory) + 3; // add 3 to account for '/', '1' and NULL character
-  char pagePath[pagePathLength];
-  snprintf(pagePath, pagePathLength, "%s/1", pageDirectory);
-
-  // Check for existence and readibility of both '.crawler' and '1' files
-  return (access(pagePath, R_OK) == 0 && access(dotfilePath, R_OK) == 0);
+  // Check for existence of the page of docID 1, wherever the layout puts it
+  return pageExists(pageDirectory, 1);
 }
 
 /**************** pagedir_load ****************/
 /* see pagedir.h for documentation */
-webpage_t* pagedir_load(const char* pageDirectory, const int docID)
+webpage_t* pagedir_load(const char* pageDirectory, const docid_t docID)
+{
+  if (pageDirectory == NULL) {
+    fprintf(stderr, "pageDirectory string is NULL\n");
+    exit(1);
+  }
+
+  // Read the whole page at once, and split it into URL, depth and HTML
+  size_t length = 0;
+  char* bytes = readPage(pageDirectory, docID, &length);
+  return (bytes == NULL) ? NULL : parsePage(pageDirectory, bytes, length, true);
+}
+
+/**************** pagedir_loadView ****************/
+/* see pagedir.h for documentation */
+webpage_t* pagedir_loadView(const char* pageDirectory, const docid_t docID)
 {
-  // Convert docID int to string
-  char docIDString[6] = "";
-  snprintf(docIDString, 6, "%d", docID);
+  if (pageDirectory == NULL) {
+    fprintf(stderr, "pageDirectory string is NULL\n");
+    exit(1);
+  }
 
-  // Construct page file path
-  int pagePathLength = strlen(pageDirectory) + strlen("/") + strlen(docIDString) + 1;
-  char pagePath[pagePathLength];
-  snprintf(pagePath, pagePathLength, "%s/%s", pageDirectory, docIDString);
+  // In the segment layout, the page is viewed in the store's mapping of its segment, which stays
+  if (layoutOf(pageDirectory) == SEGMENT_LAYOUT) {
+    size_t length = 0;
+    pthread_mutex_lock(&storeLock);
+    const char* bytes = segstore_map(storeOf(pageDirectory), docID, &length);
+    pthread_mutex_unlock(&storeLock);
+    return (bytes == NULL) ? pagedir_load(pageDirectory, docID) : viewPage(pageDirectory, bytes, length, NULL, NULL);
+  }
 
-  // Check if page file doesn't exist or is not readable
-  if (access(pagePath, R_OK) != 0) {
+  // Otherwise the page file is mapped, to be unmapped when the view is deleted
+  int pagePathLength = pagePath(NULL, 0, pageDirectory, docID, "") + 1;
+  char path[pagePathLength];
+  pagePath(path, pagePathLength, pageDirectory, docID, "");
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
     return NULL;
   }
+  struct stat status;
+  void* address = (fstat(fd, &status) != 0 || status.st_size == 0) ? MAP_FAILED
+                  : mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    return NULL;
+  }
+  mapping_t* mapping = mem_assert(malloc(sizeof(mapping_t)), "failed allocating memory for page mapping");
+  mapping->address = address;
+  mapping->length = status.st_size;
+  return viewPage(pageDirectory, address, status.st_size, unmapPage, mapping);
+}
 
-  // Open page file
-  FILE* pageFile = pagedir_open(pageDirectory, docID, "r");
+/**************** pagedir_open ****************/
+/* see pagedir.h for documentation */
+FILE* pagedir_open(const char* pageDirectory, const docid_t docID, char* mode)
+{
+  if (pageDirectory == NULL) {
+    fprintf(stderr, "pageDirectory string is NULL\n");
+    exit(1);
+  }
+
+  // In the segment layout, the page is read into a stream of its own, which cannot be written
+  if (layoutOf(pageDirectory) == SEGMENT_LAYOUT) {
+    if (mode[0] != 'r' || strchr(mode, '+') != NULL) {
+      fprintf(stderr, "pages in the segment store of %s cannot be opened for writing\n", pageDirectory);
+      exit(1);
+    }
+    size_t length = 0;
+    char* bytes = mem_assert(readPage(pageDirectory, docID, &length), "failed opening file pageFile");
+    FILE* pageFile = mem_assert(fmemopen(NULL, length + 1, "w+"), "failed opening file pageFile");
+    if (fwrite(bytes, 1, length, pageFile) != length) {
+      fprintf(stderr, "failed opening file pageFile\n");
+      exit(1);
+    }
+    free(bytes);
+    rewind(pageFile);
+    return pageFile;
+  }
 
-  // Read lines of page file and assign them to their corresponding variables
+  // Construct page file path
+  int pagePathLength = pagePath(NULL, 0, pageDirectory, docID, "") + 1;
+  char path[pagePathLength];
+  pagePath(path, pagePathLength, pageDirectory, docID, "");
+
+  // Open page file, creating its shard first if it is to be written and there is none yet
+  FILE* pageFile = fopen(path, mode);
+  if (pageFile == NULL && errno == ENOENT && mode[0] != 'r' && makeShard(pageDirectory, docID)) {
+    pageFile = fopen(path, mode);
+  }
+  mem_assert(pageFile, "failed opening file pageFile");
+
+  // Return file pointer
+  return pageFile;
+}
+
+/**************** pagedir_loadHeader ****************/
+/* see pagedir.h for documentation */
+webpage_t* pagedir_loadHeader(const char* pageDirectory, const docid_t docID)
+{
+  if (pageDirectory == NULL) {
+    fprintf(stderr, "pageDirectory string is NULL\n");
+    exit(1);
+  }
+
+  // A page in the segment store is read whole anyway
+  if (layoutOf(pageDirectory) == SEGMENT_LAYOUT) {
+    size_t length = 0;
+    char* bytes = readPage(pageDirectory, docID, &length);
+    return (bytes == NULL) ? NULL : parsePage(pageDirectory, bytes, length, false);
+  }
+
+  // Construct page file path
+  int pagePathLength = pagePath(NULL, 0, pageDirectory, docID, "") + 1;
+  char path[pagePathLength];
+  pagePath(path, pagePathLength, pageDirectory, docID, "");
+
+  FILE* pageFile = fopen(path, "r");
+  if (pageFile == NULL) {
+    return NULL;
+  }
+
+  // Read only the first two lines: URL and depth
   char* URL = file_readLine(pageFile);
   char* depthString = file_readLine(pageFile);
-  char* HTML = file_readFile(pageFile);
-
-  // Convert depth from string to int
+  fclose(pageFile);
+  if (URL == NULL || depthString == NULL) {
+    free(URL);
+    free(depthString);
+    return NULL;
+  }
   int depth = strtol(depthString, NULL, 10);
-
-  // Clean up
   free(depthString);
-  fclose(pageFile);
 
-  // Return pointer to webpage_t struct with page information
-  return webpage_new(URL, depth, HTML);
+  webpage_t* page = webpage_new(URL, depth, NULL);
+  if (page == NULL) {
+    free(URL);
+  }
+  return page;
 }
 
-/**************** pagedir_open ****************/
+/**************** pagedir_saveValidators ****************/
 /* see pagedir.h for documentation */
-FILE* pagedir_open(const char* pageDirectory, const int docID, char* mode)
+void pagedir_saveValidators(const char* pageDirectory, const docid_t docID, const char* etag, const char* lastModified)
 {
   if (pageDirectory == NULL) {
     fprintf(stderr, "pageDirectory string is NULL\n");
     exit(1);
   }
 
-  // Convert docID int to string
-  char docIDString[6] = "";
-  snprintf(docIDString, 6, "%d", docID);
+  // Values that would break the line format are left out
+  if (etag == NULL || strpbrk(etag, "\t\n") != NULL) {
+    etag = "";
+  }
+  if (lastModified == NULL || strpbrk(lastModified, "\t\n") != NULL) {
+    lastModified = "";
+  }
 
-  // Construct page file path
-  int pagePathLength = strlen(pageDirectory) + strlen("/") + strlen(docIDString) + 1;
-  char pagePath[pagePathLength];
-  snprintf(pagePath, pagePathLength, "%s/%s", pageDirectory, docIDString);
+  // Format the line first, so that it goes out in a single write
+  int lineLength = snprintf(NULL, 0, "%" PRIdocid "\t%s\t%s\n", docID, etag, lastModified);
+  char line[lineLength + 1];
+  snprintf(line, lineLength + 1, "%" PRIdocid "\t%s\t%s\n", docID, etag, lastModified);
+
+  int pathLength = strlen(pageDirectory) + strlen("/.validators") + 1;
+  char path[pathLength];
+  snprintf(path, pathLength, "%s/.validators", pageDirectory);
+  FILE* fp = fopen(path, "a");
+  if (fp == NULL || setvbuf(fp, NULL, _IOFBF, lineLength + 1) != 0
+      || fputs(line, fp) == EOF || fclose(fp) != 0) {
+    fprintf(stderr, "failed writing %s\n", path);
+    exit(1);
+  }
+}
+
+/**************** pagedir_loadValidators ****************/
+/* see pagedir.h for documentation */
+bool pagedir_loadValidators(const char* pageDirectory, void* arg,
+                            void (*itemfunc)(void* arg, const docid_t docID, const char* etag, const char* lastModified))
+{
+  if (pageDirectory == NULL || itemfunc == NULL) {
+    return false;
+  }
+
+  int pathLength = strlen(pageDirectory) + strlen("/.validators") + 1;
+  char path[pathLength];
+  snprintf(path, pathLength, "%s/.validators", pageDirectory);
+  if (access(path, F_OK) != 0) {
+    return true;
+  }
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    return false;
+  }
+
+  // Each line is docID, ETag and Last-Modified, separated by tabs
+  char* line;
+  while ((line = file_readLine(fp)) != NULL) {
+    char* etag = strchr(line, '\t');
+    char* lastModified = (etag == NULL) ? NULL : strchr(etag + 1, '\t');
+    if (lastModified != NULL) {
+      *etag++ = '\0';
+      *lastModified++ = '\0';
+      char* end = NULL;
+      docid_t docID = strtoll(line, &end, 10);
+      if (*end == '\0' && docID > 0) {
+        (*itemfunc)(arg, docID, etag, lastModified);
+      }
+    }
+    free(line);
+  }
+  fclose(fp);
+  return true;
+}
+
+/**************** pagedir_loadAliases ****************/
+/* see pagedir.h for documentation */
+bool pagedir_loadAliases(const char* pageDirectory, void* arg,
+                         void (*itemfunc)(void* arg, const docid_t docID, const docid_t canonicalDocID))
+{
+  if (pageDirectory == NULL || itemfunc == NULL) {
+    return false;
+  }
+
+  int pathLength = strlen(pageDirectory) + strlen("/.contents") + 1;
+  char path[pathLength];
+  snprintf(path, pathLength, "%s/.contents", pageDirectory);
+  if (access(path, F_OK) != 0) {
+    return true;
+  }
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    return false;
+  }
+
+  // Each line is docID, content hash and canonical docID, separated by tabs
+  docid_t docID, canonical;
+  char key[17];
+  while (fscanf(fp, "%" SCNdocid "\t%16s\t%" SCNdocid " ", &docID, key, &canonical) == 3) {
+    if (docID > 0 && canonical > 0) {
+      (*itemfunc)(arg, docID, canonical);
+    }
+  }
+  fclose(fp);
+  return true;
+}
+
+/**************** pagedir_trimContents ****************/
+/* see pagedir.h for documentation */
+void pagedir_trimContents(const char* pageDirectory, const docid_t docID)
+{
+  if (pageDirectory == NULL) {
+    fprintf(stderr, "pageDirectory string is NULL\n");
+    exit(1);
+  }
+
+  int pathLength = strlen(pageDirectory) + strlen("/.contents.part") + 1;
+  char path[pathLength];
+  char partPath[pathLength];
+  snprintf(path, pathLength, "%s/.contents", pageDirectory);
+  snprintf(partPath, pathLength, "%s/.contents.part", pageDirectory);
+
+  pthread_mutex_lock(&contentsLock);
+  forgetContents();
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    pthread_mutex_unlock(&contentsLock);
+    return;
+  }
+  FILE* out = fopen(partPath, "w");
+  if (out == NULL) {
+    fprintf(stderr, "failed writing %s\n", partPath);
+    exit(1);
+  }
+
+  // Keep the lines of pages below docID whose content is held below docID too; an alias of a page
+  // from docID on loses its page file as well
+  docid_t id, canonical;
+  char key[17];
+  while (fscanf(fp, "%" SCNdocid "\t%16s\t%" SCNdocid " ", &id, key, &canonical) == 3) {
+    if (id < docID && canonical < docID) {
+      fprintf(out, "%" PRIdocid "\t%s\t%" PRIdocid "\n", id, key, canonical);
+    } else if (id < docID) {
+      removePage(pageDirectory, id);
+    }
+  }
+  fclose(fp);
+  if (fclose(out) != 0 || rename(partPath, path) != 0) {
+    fprintf(stderr, "failed writing %s\n", path);
+    exit(1);
+  }
+  pthread_mutex_unlock(&contentsLock);
+}
+
+/**************** pagedir_removeFrom ****************/
+/* see pagedir.h for documentation */
+void pagedir_removeFrom(const char* pageDirectory, const docid_t docID)
+{
+  if (pageDirectory == NULL) {
+    fprintf(stderr, "pageDirectory string is NULL\n");
+    exit(1);
+  }
+
+  int layout = layoutOf(pageDirectory);
+  if (layout == SEGMENT_LAYOUT) {
+    pthread_mutex_lock(&storeLock);
+    int removed = segstore_remove(storeOf(pageDirectory), docID, true);
+    pthread_mutex_unlock(&storeLock);
+    if (removed < 0) {
+      fprintf(stderr, "failed writing the page store of %s\n", pageDirectory);
+      exit(1);
+    }
+    return;
+  }
+  if (layout != SHARDED_LAYOUT) {
+    removeFrom(pageDirectory, docID);
+    return;
+  }
+
+  // Every shard that exists, each a directory of page files
+  int shardLength = strlen(pageDirectory) + strlen("/xx/yy") + 1;
+  char shard[shardLength];
+  for (int high = 0; high < 256; high++) {
+    snprintf(shard, shardLength, "%s/%02x", pageDirectory, high);
+    if (access(shard, F_OK) != 0) {
+      continue;
+    }
+    for (int low = 0; low < 256; low++) {
+      snprintf(shard, shardLength, "%s/%02x/%02x", pageDirectory, high, low);
+      removeFrom(shard, docID);
+    }
+  }
+}
+
+/**************** pagedir_migrate ****************/
+/* see pagedir.h for documentation */
+int pagedir_migrate(const char* pageDirectory)
+{
+  if (pageDirectory == NULL) {
+    fprintf(stderr, "pageDirectory string is NULL\n");
+    exit(1);
+  }
+
+  int layout = layoutOf(pageDirectory);
+  if (layout == SHARDED_LAYOUT || layout == SEGMENT_LAYOUT) {
+    return 0;
+  }
+  if (layout != FLAT_LAYOUT) {
+    return -1;
+  }
+
+  // The page files move out of the way first, as a shard's directory may have the name of a page file
+  // ('12' is both); partly written ones were never saved, so they go
+  int stageLength = strlen(pageDirectory) + strlen("/.migrating") + 1;
+  char stage[stageLength];
+  snprintf(stage, stageLength, "%s/.migrating", pageDirectory);
+  if ((mkdir(stage, 0777) != 0 && errno != EEXIST) || !movePages(pageDirectory, stage, NULL)) {
+    return -1;
+  }
+
+  // Then into their shards
+  int moved = 0;
+  if (!movePages(stage, pageDirectory, &moved)) {
+    return -1;
+  }
+  rmdir(stage);
+
+  // The marker changes last, so that a directory left half-moved still reads as flat, to be migrated again
+  return writeLayout(pageDirectory, SHARDED_LAYOUT, PAGEDIR_PLAIN) ? moved : -1;
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** layoutOf ****************/
+/* Return the layout of pageDirectory, as its '.crawler' marker records it (see markerOf).
+ */
+static int layoutOf(const char* pageDirectory)
+{
+  return markerOf(pageDirectory, NULL);
+}
+
+/**************** compressionOf ****************/
+/* Return how the pages of pageDirectory are compressed, as its '.crawler' marker records it (see markerOf).
+ */
+static pagedir_compress_t compressionOf(const char* pageDirectory)
+{
+  pagedir_compress_t compress = PAGEDIR_PLAIN;
+  markerOf(pageDirectory, &compress);
+  return compress;
+}
+
+/**************** markerOf ****************/
+/* Return the layout of pageDirectory, setting *compress (if compress is not NULL) to how its pages are
+ * compressed, as its '.crawler' marker records them (see readLayout); the marker is read once, until
+ * another directory's is.
+ */
+static int markerOf(const char* pageDirectory, pagedir_compress_t* compress)
+{
+  pthread_mutex_lock(&layoutLock);
+  if (layoutDirectory == NULL || strcmp(layoutDirectory, pageDirectory) != 0) {
+    free(layoutDirectory);
+    layoutDirectory = mem_assert(malloc(strlen(pageDirectory) + 1), "failed allocating memory for layout");
+    strcpy(layoutDirectory, pageDirectory);
+    layoutVersion = readLayout(pageDirectory, &layoutCompress);
+  }
+  int layout = layoutVersion;
+  if (compress != NULL) {
+    *compress = layoutCompress;
+  }
+  pthread_mutex_unlock(&layoutLock);
+  return layout;
+}
+
+/**************** readLayout ****************/
+/* Read the '.crawler' marker of pageDirectory: empty for the flat layout (as markers were before there
+ * was another), or 'pagedir N' for layout N, then 'compress lz' or 'compress lz-dict' if its pages are
+ * compressed, setting *compress. Return the layout, or 0 if the marker cannot be read or names a layout
+ * (or compression) we do not know.
+ */
+static int readLayout(const char* pageDirectory, pagedir_compress_t* compress)
+{
+  int pathLength = strlen(pageDirectory) + strlen("/.crawler") + 1;
+  char path[pathLength];
+  snprintf(path, pathLength, "%s/.crawler", pageDirectory);
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    return 0;
+  }
+
+  int layout = 0;
+  char codec[16] = "";
+  *compress = PAGEDIR_PLAIN;
+  int c = getc(fp);
+  if (c == EOF) {
+    layout = FLAT_LAYOUT;
+  } else if (ungetc(c, fp) == EOF || fscanf(fp, "pagedir %d", &layout) != 1
+             || (layout != FLAT_LAYOUT && layout != SHARDED_LAYOUT && layout != SEGMENT_LAYOUT)) {
+    layout = 0;
+  } else if (fscanf(fp, " compress %15s", codec) == 1) {
+    if (strcmp(codec, "lz") == 0) {
+      *compress = PAGEDIR_LZ;
+    } else if (strcmp(codec, "lz-dict") == 0) {
+      *compress = PAGEDIR_LZ_DICT;
+    } else {
+      layout = 0;
+    }
+  }
+  fclose(fp);
+  return layout;
+}
+
+/**************** writeLayout ****************/
+/* Write the '.crawler' marker of pageDirectory for layout and compress, by way of '.crawler.part', and
+ * make them those known for pageDirectory. Return false if the marker could not be written.
+ */
+static bool writeLayout(const char* pageDirectory, const int layout, const pagedir_compress_t compress)
+{
+  int pathLength = strlen(pageDirectory) + strlen("/.crawler.part") + 1;
+  char path[pathLength];
+  char partPath[pathLength];
+  snprintf(path, pathLength, "%s/.crawler", pageDirectory);
+  snprintf(partPath, pathLength, "%s/.crawler.part", pageDirectory);
+
+  FILE* dotfile = fopen(partPath, "w");
+  if (dotfile == NULL) {
+    return false;
+  }
+  bool written = (fprintf(dotfile, "pagedir %d\n", layout) > 0);
+  if (compress != PAGEDIR_PLAIN) {
+    written = written && (fprintf(dotfile, "compress %s\n", (compress == PAGEDIR_LZ) ? "lz" : "lz-dict") > 0);
+  }
+  if (fclose(dotfile) != 0 || !written || rename(partPath, path) != 0) {
+    unlink(partPath);
+    return false;
+  }
+
+  pthread_mutex_lock(&layoutLock);
+  free(layoutDirectory);
+  layoutDirectory = mem_assert(malloc(strlen(pageDirectory) + 1), "failed allocating memory for layout");
+  strcpy(layoutDirectory, pageDirectory);
+  layoutVersion = layout;
+  layoutCompress = compress;
+  pthread_mutex_unlock(&layoutLock);
+  return true;
+}
+
+/**************** pagePath ****************/
+/* Write into path (of size bytes; snprintf rules) the path of the page file of docID in pageDirectory,
+ * in its layout, followed by suffix. Return the length of the whole path, as snprintf does.
+ */
+static int pagePath(char* path, const size_t size, const char* pageDirectory, const docid_t docID, const char* suffix)
+{
+  if (layoutOf(pageDirectory) == SHARDED_LAYOUT) {
+    return shardPath(path, size, pageDirectory, docID, suffix);
+  }
+  return snprintf(path, size, "%s/%" PRIdocid "%s", pageDirectory, docID, suffix);
+}
+
+/**************** shardPath ****************/
+/* As pagePath, in the sharded layout: the two bytes of a 16-bit hash of docID (from the SplitMix64
+ * finalizer, so that consecutive docIDs spread over all shards) name the two levels of directories.
+ */
+static int shardPath(char* path, const size_t size, const char* pageDirectory, const docid_t docID, const char* suffix)
+{
+  uint64_t h = (uint64_t) docID;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return snprintf(path, size, "%s/%02x/%02x/%" PRIdocid "%s", pageDirectory,
+                  (unsigned) (h >> 56), (unsigned) ((h >> 48) & 0xff), docID, suffix);
+}
+
+/**************** makeShard ****************/
+/* Create the directories of docID's shard in pageDirectory, if they do not exist; return false if they
+ * could not be created.
+ */
+static bool makeShard(const char* pageDirectory, const docid_t docID)
+{
+  int pathLength = shardPath(NULL, 0, pageDirectory, docID, "") + 1;
+  char path[pathLength];
+  shardPath(path, pathLength, pageDirectory, docID, "");
+
+  // Cut the path at each of the last two slashes in turn: first the top level, then the one below
+  char* low = strrchr(path, '/');
+  *low = '\0';
+  char* high = strrchr(path, '/');
+  *high = '\0';
+  bool made = (mkdir(path, 0777) == 0 || errno == EEXIST);
+  *high = '/';
+  return made && (mkdir(path, 0777) == 0 || errno == EEXIST);
+}
+
+/**************** pageFileID ****************/
+/* Return the docID of the page file named name in directory, setting *part if it is a partly written one
+ * ('docID.part'), or 0 if it is no page file (as the directories of shards are not).
+ */
+static docid_t pageFileID(const char* directory, const char* name, bool* part)
+{
+  char* end = NULL;
+  docid_t docID = strtoll(name, &end, 10);
+  *part = (strcmp(end, ".part") == 0);
+  if (end == name || name[0] < '0' || name[0] > '9' || docID < 1 || (*end != '\0' && !*part)) {
+    return 0;
+  }
+
+  int pathLength = strlen(directory) + strlen("/") + strlen(name) + 1;
+  char path[pathLength];
+  snprintf(path, pathLength, "%s/%s", directory, name);
+  struct stat status;
+  return (stat(path, &status) == 0 && S_ISREG(status.st_mode)) ? docID : 0;
+}
+
+/**************** removeFrom ****************/
+/* Remove the page files in directory whose docIDs are docID or more, and any partly written ones
+ * ('docID.part') among them. Return the number removed.
+ */
+static int removeFrom(const char* directory, const docid_t docID)
+{
+  DIR* dir = opendir(directory);
+  if (dir == NULL) {
+    return 0;
+  }
+
+  int removed = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    bool part = false;
+    docid_t id = pageFileID(directory, entry->d_name, &part);
+    if (id != 0 && id >= docID) {
+      int pathLength = strlen(directory) + strlen("/") + strlen(entry->d_name) + 1;
+      char path[pathLength];
+      snprintf(path, pathLength, "%s/%s", directory, entry->d_name);
+      removed += (unlink(path) == 0);
+    }
+  }
+  closedir(dir);
+  return removed;
+}
+
+/**************** movePages ****************/
+/* Move the page files in directory from, removing partly written ones: into pageDirectory itself if
+ * moved is NULL, or else into their shards in pageDirectory, counting them in *moved. Return false if
+ * one could not be moved.
+ */
+static bool movePages(const char* from, const char* pageDirectory, int* moved)
+{
+  DIR* dir = opendir(from);
+  if (dir == NULL) {
+    return false;
+  }
+
+  bool failed = false;
+  struct dirent* entry;
+  while (!failed && (entry = readdir(dir)) != NULL) {
+    bool part = false;
+    docid_t docID = pageFileID(from, entry->d_name, &part);
+    if (docID == 0) {
+      continue;
+    }
+    int pathLength = strlen(from) + strlen("/") + strlen(entry->d_name) + 1;
+    char path[pathLength];
+    snprintf(path, pathLength, "%s/%s", from, entry->d_name);
+    if (part) {
+      unlink(path);
+      continue;
+    }
+
+    int newPathLength = shardPath(NULL, 0, pageDirectory, docID, "") + 1;
+    char newPath[newPathLength];
+    if (moved == NULL) {
+      snprintf(newPath, newPathLength, "%s/%s", pageDirectory, entry->d_name);
+    } else {
+      shardPath(newPath, newPathLength, pageDirectory, docID, "");
+    }
+    if (rename(path, newPath) != 0 && (moved == NULL || errno != ENOENT || !makeShard(pageDirectory, docID)
+                                      || rename(path, newPath) != 0)) {
+      fprintf(stderr, "failed moving %s to %s\n", path, newPath);
+      failed = true;
+    } else if (moved != NULL) {
+      (*moved)++;
+    }
+  }
+  closedir(dir);
+  return !failed;
+}
+
+/**************** storeOf ****************/
+/* Return the segstore of pageDirectory, opening it (and closing that of another directory) if it is not
+ * open yet. The caller holds storeLock. Program crashes cleanly if it cannot be opened.
+ */
+static segstore_t* storeOf(const char* pageDirectory)
+{
+  if (storeDirectory != NULL && strcmp(storeDirectory, pageDirectory) == 0) {
+    return store;
+  }
+
+  segstore_close(store);
+  free(storeDirectory);
+  store = segstore_open(pageDirectory);
+  if (store == NULL) {
+    fprintf(stderr, "failed opening the page store of %s\n", pageDirectory);
+    exit(1);
+  }
+  storeDirectory = mem_assert(malloc(strlen(pageDirectory) + 1), "failed allocating memory for page store");
+  strcpy(storeDirectory, pageDirectory);
+  return store;
+}
+
+/**************** readPage ****************/
+/* Read the whole of page docID in pageDirectory, in its layout, with a single read where the layout
+ * allows. Return its bytes, NUL-terminated (setting *length to their number, if length is not NULL),
+ * which the caller must later free; or NULL if there is no such page, or it cannot be read.
+ */
+static char* readPage(const char* pageDirectory, const docid_t docID, size_t* length)
+{
+  if (layoutOf(pageDirectory) == SEGMENT_LAYOUT) {
+    pthread_mutex_lock(&storeLock);
+    char* bytes = segstore_read(storeOf(pageDirectory), docID, length);
+    pthread_mutex_unlock(&storeLock);
+    return bytes;
+  }
+
+  int pagePathLength = pagePath(NULL, 0, pageDirectory, docID, "") + 1;
+  char path[pagePathLength];
+  pagePath(path, pagePathLength, pageDirectory, docID, "");
+  FILE* pageFile = fopen(path, "r");
+  if (pageFile == NULL) {
+    return NULL;
+  }
+
+  // As many bytes as the file has, should it be rewritten meanwhile
+  struct stat status;
+  if (fstat(fileno(pageFile), &status) != 0) {
+    fclose(pageFile);
+    return NULL;
+  }
+  char* bytes = mem_assert(malloc(status.st_size + 1), "failed allocating memory for page");
+  size_t got = fread(bytes, 1, status.st_size, pageFile);
+  fclose(pageFile);
+  bytes[got] = '\0';
+  if (length != NULL) {
+    *length = got;
+  }
+  return bytes;
+}
+
+/**************** parsePage ****************/
+/* Split the length bytes of a page, as readPage returns them ('URL\ndepth\nHTML'), into a new webpage_t
+ * of pageDirectory, with NULL HTML if it has none or withHTML is false. The bytes are taken over: plain
+ * HTML is moved to their start, to become the page's, so that it is not copied again; compressed HTML is
+ * decompressed. Return NULL if they are malformed.
+ */
+static webpage_t* parsePage(const char* pageDirectory, char* bytes, const size_t length, const bool withHTML)
+{
+  char* depthString = strchr(bytes, '\n');
+  char* HTML = (depthString == NULL) ? NULL : strchr(depthString + 1, '\n');
+  int depth = 0;
+  pagedir_compress_t codec = PAGEDIR_PLAIN;
+  size_t htmlLength = 0;
+  if (HTML == NULL || !parseDepth(depthString + 1, HTML, &depth, &codec, &htmlLength)) {
+    free(bytes);
+    return NULL;
+  }
+  *depthString++ = '\0';
+  *HTML++ = '\0';
+
+  char* URL = mem_assert(malloc(strlen(bytes) + 1), "failed allocating memory for URL");
+  strcpy(URL, bytes);
+  if (withHTML && codec != PAGEDIR_PLAIN) {
+    char* packed = HTML;
+    HTML = decompressHTML(pageDirectory, codec, packed, bytes + length - packed, htmlLength);
+    free(bytes);
+    if (HTML == NULL) {
+      free(URL);
+      return NULL;
+    }
+  } else if (withHTML && *HTML != '\0') {
+    memmove(bytes, HTML, strlen(HTML) + 1);
+    HTML = bytes;
+  } else {
+    free(bytes);
+    HTML = NULL;
+  }
+
+  webpage_t* page = webpage_new(URL, depth, HTML);
+  if (page == NULL) {
+    free(URL);
+    free(HTML);
+  }
+  return page;
+}
+
+/**************** viewPage ****************/
+/* Split the length bytes of a page of pageDirectory ('URL\ndepth\nHTML') into a new webpage_t whose HTML
+ * is a view of them (see webpage_newView), release being called with arg when they are no longer needed;
+ * only the URL is copied. A page with no HTML is a page of its own, with NULL HTML, as is one with
+ * compressed HTML, which is decompressed into memory of its own; either releases the bytes at once, as
+ * does a malformed one, for which we return NULL.
+ */
+static webpage_t* viewPage(const char* pageDirectory, const char* bytes, const size_t length,
+                           void (*release)(void* arg), void* arg)
+{
+  const char* depthString = memchr(bytes, '\n', length);
+  const char* HTML = (depthString == NULL) ? NULL : memchr(depthString + 1, '\n', bytes + length - depthString - 1);
+  int depth = 0;
+  pagedir_compress_t codec = PAGEDIR_PLAIN;
+  size_t htmlLength = 0;
+  webpage_t* page = NULL;
+  if (HTML != NULL && parseDepth(depthString + 1, HTML, &depth, &codec, &htmlLength)) {
+    HTML++;
+    size_t bodyLength = bytes + length - HTML;
+    char* URL = mem_assert(malloc(depthString - bytes + 1), "failed allocating memory for URL");
+    memcpy(URL, bytes, depthString - bytes);
+    URL[depthString - bytes] = '\0';
+
+    if (codec != PAGEDIR_PLAIN) {
+      char* unpacked = decompressHTML(pageDirectory, codec, HTML, bodyLength, htmlLength);
+      page = (unpacked == NULL) ? NULL : webpage_new(URL, depth, unpacked);
+      if (page == NULL) {
+        free(URL);
+        free(unpacked);
+      }
+    } else {
+      page = (bodyLength == 0) ? webpage_new(URL, depth, NULL)
+                               : webpage_newView(URL, depth, HTML, bodyLength, release, arg);
+      if (page == NULL) {
+        free(URL);
+      } else if (bodyLength > 0) {
+        return page;
+      }
+    }
+  }
+  if (release != NULL) {
+    (*release)(arg);
+  }
+  return page;
+}
 
-  // Open page file
-  FILE* pageFile = fopen(pagePath, mode);
+/**************** unmapPage ****************/
+/* webpage_newView release function: arg is the mapping_t of a page file, which we unmap and free. */
+static void unmapPage(void* arg)
+{
+  mapping_t* mapping = arg;
+  munmap(mapping->address, mapping->length);
+  free(mapping);
+}
+
+/**************** parseDepth ****************/
+/* Parse the depth line of a page, from depthString up to end (its newline, or the NUL that replaced it):
+ * the depth, into *depth, and if the HTML is compressed ('depth lz length' or 'depth lzd length'), its
+ * codec and length before compression, into *codec and *htmlLength (*codec being PAGEDIR_PLAIN if not).
+ * Return false if the line names a codec but no length.
+ */
+static bool parseDepth(const char* depthString, const char* end, int* depth, pagedir_compress_t* codec,
+                       size_t* htmlLength)
+{
+  char* after = NULL;
+  *depth = strtol(depthString, &after, 10);     // stops at the newline, or the codec
+  *codec = PAGEDIR_PLAIN;
+  if (end - after > 5 && strncmp(after, " lzd ", 5) == 0) {
+    *codec = PAGEDIR_LZ_DICT;
+    after += 5;
+  } else if (end - after > 4 && strncmp(after, " lz ", 4) == 0) {
+    *codec = PAGEDIR_LZ;
+    after += 4;
+  } else {
+    return true;
+  }
+  if (*after < '0' || *after > '9') {
+    return false;
+  }
+  char* stop = NULL;
+  *htmlLength = strtoull(after, &stop, 10);
+  return (stop == end);
+}
+
+/**************** compressHTML ****************/
+/* Compress length bytes of HTML as pageDirectory has its pages compressed (against its dictionary, if it
+ * is to have one and it has been trained). Return the compressed bytes, which the caller must later
+ * free, setting *packedLength to their number and *tag to the codec's name for the depth line; or NULL if
+ * the HTML is to be saved plain, as pageDirectory is not compressed, or the HTML would not come out smaller.
+ */
+static char* compressHTML(const char* pageDirectory, const char* HTML, const size_t length, size_t* packedLength,
+                          const char** tag)
+{
+  pagedir_compress_t compress = compressionOf(pageDirectory);
+  if (compress == PAGEDIR_PLAIN || length == 0) {
+    return NULL;
+  }
+  lzcodec_dict_t* dict = (compress == PAGEDIR_LZ_DICT) ? dictionaryOf(pageDirectory) : NULL;
+
+  // No room for more than the HTML itself: what does not fit is not worth it
+  char* packed = mem_assert(malloc(length), "failed allocating memory for compressed page");
+  size_t compressed = lzcodec_compress(HTML, length, packed, length, dict);
+  if (compressed == 0) {
+    free(packed);
+    return NULL;
+  }
+  *packedLength = compressed;
+  *tag = (dict == NULL) ? LZ_TAG : LZ_DICT_TAG;
+  return packed;
+}
+
+/**************** decompressHTML ****************/
+/* Decompress length bytes of HTML compressed with codec into htmlLength bytes, against the dictionary of
+ * pageDirectory for PAGEDIR_LZ_DICT. Return them, NUL-terminated, which the caller must later free; or
+ * NULL if they do not decompress, or the dictionary cannot be read.
+ */
+static char* decompressHTML(const char* pageDirectory, const pagedir_compress_t codec, const char* packed,
+                            const size_t length, const size_t htmlLength)
+{
+  lzcodec_dict_t* dict = (codec == PAGEDIR_LZ_DICT) ? dictionaryOf(pageDirectory) : NULL;
+  if (codec == PAGEDIR_LZ_DICT && dict == NULL) {
+    return NULL;
+  }
+
+  // No byte decompresses into more than 255, so a larger length is corrupt, and not to be allocated
+  if (htmlLength / 255 > length) {
+    return NULL;
+  }
+  char* HTML = mem_assert(malloc(htmlLength + 1), "failed allocating memory for page");
+  if (!lzcodec_decompress(packed, length, HTML, htmlLength, dict)) {
+    free(HTML);
+    return NULL;
+  }
+  HTML[htmlLength] = '\0';
+  return HTML;
+}
+
+/**************** dictionaryOf ****************/
+/* Return the shared dictionary of pageDirectory, reading it from its '.dictionary' if it has not been
+ * read yet (dropping that of another directory); or NULL if there is none (yet), or it cannot be read.
+ */
+static lzcodec_dict_t* dictionaryOf(const char* pageDirectory)
+{
+  pthread_mutex_lock(&dictLock);
+  if (dictDirectory == NULL || strcmp(dictDirectory, pageDirectory) != 0) {
+    lzcodec_dict_delete(dictionary);
+    dictionary = NULL;
+    dictTrained = false;
+    free(dictDirectory);
+    dictDirectory = mem_assert(malloc(strlen(pageDirectory) + 1), "failed allocating memory for dictionary");
+    strcpy(dictDirectory, pageDirectory);
+  }
+
+  // Until there is one, it is looked for each time, as it may be trained meanwhile
+  if (dictionary == NULL) {
+    int pathLength = strlen(pageDirectory) + strlen("/.dictionary") + 1;
+    char path[pathLength];
+    snprintf(path, pathLength, "%s/.dictionary", pageDirectory);
+    FILE* fp = fopen(path, "r");
+    if (fp != NULL) {
+      char* bytes = mem_assert(malloc(LZCODEC_DICT_BYTES + 1), "failed allocating memory for dictionary");
+      size_t length = fread(bytes, 1, LZCODEC_DICT_BYTES + 1, fp);
+      fclose(fp);
+      dictionary = lzcodec_dict_new(bytes, length);
+      free(bytes);
+    }
+  }
+  lzcodec_dict_t* dict = dictionary;
+  pthread_mutex_unlock(&dictLock);
+  return dict;
+}
+
+/**************** trainDictionary ****************/
+/* Train the shared dictionary of pageDirectory on the HTML of its first PAGEDIR_DICT_SAMPLE pages, and
+ * write it to its '.dictionary', by way of '.dictionary.part', unless it has one already or training it
+ * was tried before; a sample that shares too little, or a dictionary that cannot be written, leaves it
+ * with none, its pages compressed without one. It is trained once, by the first save to get here; saves
+ * meanwhile compress their pages without it.
+ */
+static void trainDictionary(const char* pageDirectory)
+{
+  if (dictionaryOf(pageDirectory) != NULL) {
+    return;
+  }
+  pthread_mutex_lock(&dictLock);
+  bool tried = dictTrained;
+  dictTrained = true;
+  pthread_mutex_unlock(&dictLock);
+  if (tried) {
+    return;
+  }
+
+  // The sample: the pages with HTML of their own among the first ones, but only as much of each as
+  // lies within an offset's reach of a dictionary before it
+  webpage_t* pages[PAGEDIR_DICT_SAMPLE];
+  const char* samples[PAGEDIR_DICT_SAMPLE];
+  size_t lengths[PAGEDIR_DICT_SAMPLE];
+  int numSamples = 0;
+  for (docid_t docID = 1; docID <= PAGEDIR_DICT_SAMPLE; docID++) {
+    webpage_t* page = pagedir_load(pageDirectory, docID);
+    if (page != NULL && webpage_getHTML(page) != NULL) {
+      pages[numSamples] = page;
+      samples[numSamples] = webpage_getHTML(page);
+      lengths[numSamples] = strlen(samples[numSamples]);
+      if (lengths[numSamples] > LZCODEC_DICT_BYTES) {
+        lengths[numSamples] = LZCODEC_DICT_BYTES;
+      }
+      numSamples++;
+    } else {
+      webpage_delete(page);
+    }
+  }
+  char* bytes = mem_assert(malloc(LZCODEC_DICT_BYTES), "failed allocating memory for dictionary");
+  size_t length = lzcodec_dict_train(samples, lengths, numSamples, bytes, LZCODEC_DICT_BYTES);
+  for (int i = 0; i < numSamples; i++) {
+    webpage_delete(pages[i]);
+  }
+
+  // Written whole or not at all, to be read by the next dictionaryOf
+  int pathLength = strlen(pageDirectory) + strlen("/.dictionary.part") + 1;
+  char path[pathLength];
+  char partPath[pathLength];
+  snprintf(path, pathLength, "%s/.dictionary", pageDirectory);
+  snprintf(partPath, pathLength, "%s/.dictionary.part", pageDirectory);
+  FILE* fp = (length == 0) ? NULL : fopen(partPath, "w");
+  if (fp != NULL) {
+    bool written = (fwrite(bytes, 1, length, fp) == length);
+    if (fclose(fp) != 0 || !written || rename(partPath, path) != 0) {
+      unlink(partPath);
+    }
+  }
+  free(bytes);
+}
+
+/**************** pageExists ****************/
+/* Return true if there is a page of docID in pageDirectory (in the file layouts, a readable page file).
+ */
+static bool pageExists(const char* pageDirectory, const docid_t docID)
+{
+  if (layoutOf(pageDirectory) == SEGMENT_LAYOUT) {
+    pthread_mutex_lock(&storeLock);
+    bool exists = segstore_contains(storeOf(pageDirectory), docID);
+    pthread_mutex_unlock(&storeLock);
+    return exists;
+  }
+
+  int pagePathLength = pagePath(NULL, 0, pageDirectory, docID, "") + 1;
+  char path[pagePathLength];
+  pagePath(path, pagePathLength, pageDirectory, docID, "");
+  return (access(path, R_OK) == 0);
+}
+
+/**************** removePage ****************/
+/* Remove the page of docID from pageDirectory, if there is one. Program crashes cleanly if the segment
+ * store cannot be written.
+ */
+static void removePage(const char* pageDirectory, const docid_t docID)
+{
+  if (layoutOf(pageDirectory) == SEGMENT_LAYOUT) {
+    pthread_mutex_lock(&storeLock);
+    int removed = segstore_remove(storeOf(pageDirectory), docID, false);
+    pthread_mutex_unlock(&storeLock);
+    if (removed < 0) {
+      fprintf(stderr, "failed writing the page store of %s\n", pageDirectory);
+      exit(1);
+    }
+    return;
+  }
+
+  int pagePathLength = pagePath(NULL, 0, pageDirectory, docID, "") + 1;
+  char path[pagePathLength];
+  pagePath(path, pagePathLength, pageDirectory, docID, "");
+  unlink(path);
+}
+
+/**************** writePage ****************/
+/* Write a page: URL, depth and HTML, compressed if pageDirectory has it so (see compressHTML), with its
+ * codec and length on the depth line. A page file is written to the partial file 'docID.part' first and
+ * then renamed, so that it is never seen half-written; in the segment layout, the page is appended to
+ * the store, its first lines and HTML in one write. Program crashes cleanly if it cannot be written.
+ */
+static void writePage(const char* pageDirectory, const docid_t docID, const char* URL, const int depth, const char* HTML)
+{
+  size_t htmlLength = strlen(HTML);
+  size_t bodyLength = htmlLength;
+  const char* tag = NULL;
+  char* packed = compressHTML(pageDirectory, HTML, htmlLength, &bodyLength, &tag);
+  const char* body = (packed == NULL) ? HTML : packed;
+  int headerLength = (packed == NULL) ? snprintf(NULL, 0, "%s\n%d\n", URL, depth)
+                                      : snprintf(NULL, 0, "%s\n%d %s %zu\n", URL, depth, tag, htmlLength);
+  char header[headerLength + 1];
+  if (packed == NULL) {
+    snprintf(header, headerLength + 1, "%s\n%d\n", URL, depth);
+  } else {
+    snprintf(header, headerLength + 1, "%s\n%d %s %zu\n", URL, depth, tag, htmlLength);
+  }
+
+  if (layoutOf(pageDirectory) == SEGMENT_LAYOUT) {
+    const char* parts[] = { header, body };
+    const size_t lengths[] = { headerLength, bodyLength };
+
+    pthread_mutex_lock(&storeLock);
+    bool saved = segstore_save(storeOf(pageDirectory), docID, parts, lengths, 2);
+    pthread_mutex_unlock(&storeLock);
+    free(packed);
+    if (!saved) {
+      fprintf(stderr, "failed writing page %" PRIdocid " to the page store of %s\n", docID, pageDirectory);
+      exit(1);
+    }
+    return;
+  }
+
+  int pagePathLength = pagePath(NULL, 0, pageDirectory, docID, ".part") + 1;
+  char path[pagePathLength];
+  char partPath[pagePathLength];
+  pagePath(path, pagePathLength, pageDirectory, docID, "");
+  pagePath(partPath, pagePathLength, pageDirectory, docID, ".part");
+
+  // The first page saved in a shard creates it
+  FILE* pageFile = fopen(partPath, "w");
+  if (pageFile == NULL && errno == ENOENT && makeShard(pageDirectory, docID)) {
+    pageFile = fopen(partPath, "w");
+  }
   mem_assert(pageFile, "failed opening file pageFile");
+  bool written = (fwrite(header, 1, headerLength, pageFile) == (size_t) headerLength
+                  && fwrite(body, 1, bodyLength, pageFile) == bodyLength);
+  free(packed);
+  if (fclose(pageFile) != 0 || !written || rename(partPath, path) != 0) {
+    fprintf(stderr, "failed writing page file %s\n", path);
+    exit(1);
+  }
+}
 
-  // Return file pointer
-  return pageFile;
+/**************** claimPages ****************/
+/* Wait until the pages a save of claim->docID needs are free, then claim them all at once: docID itself,
+ * and its aliases if it has any (whose content may move), to write, so that no other save reads or writes
+ * them meanwhile; and the page recorded with the same content hash, if another, to read, so that no other
+ * save writes it meanwhile. A hash no page has yet is recorded for docID there and then, so that a save of
+ * the same content waits for this one, then compares with it. As a save claims all it needs at once, and
+ * waits for nothing while holding claims, saves never wait on each other in a circle.
+ * The caller holds contentsLock.
+ */
+static void claimPages(claim_t* claim)
+{
+  docid_t docID = claim->docID;
+  while (true) {
+    // The aliases of docID, in docID order
+    free(claim->aliases);
+    claim->aliases = NULL;
+    claim->numAliases = 0;
+    int64_t* count = idmap_find(aliasCounts, docID);
+    if (count != NULL && *count > 0) {
+      aliasList_t list = { docID, mem_assert(malloc(*count * sizeof(docid_t)), "failed allocating memory for aliases"), 0 };
+      idmap_iterate(canonicals, &list, collectAlias);
+      qsort(list.aliases, list.numAliases, sizeof(docid_t), compareDocIDs);
+      claim->aliases = list.aliases;
+      claim->numAliases = list.numAliases;
+    }
+
+    // The page with the same hash, unless it is docID, or one of its aliases (which hold no content, so
+    // the hash is recorded for one from before it became an alias)
+    docid_t* found = idmap_find(contents, claim->hash);
+    claim->candidate = (found == NULL || *found == docID) ? 0 : *found;
+    for (int i = 0; claim->candidate != 0 && i < claim->numAliases; i++) {
+      if (claim->aliases[i] == claim->candidate) {
+        claim->candidate = 0;
+      }
+    }
+
+    bool ready = claimable(docID, true) && (claim->candidate == 0 || claimable(claim->candidate, false));
+    for (int i = 0; ready && i < claim->numAliases; i++) {
+      ready = claimable(claim->aliases[i], true);
+    }
+    if (ready) {
+      break;
+    }
+    pthread_cond_wait(&claimsReleased, &contentsLock);
+  }
+
+  markClaim(docID, true);
+  for (int i = 0; i < claim->numAliases; i++) {
+    markClaim(claim->aliases[i], true);
+  }
+  if (claim->candidate != 0) {
+    markClaim(claim->candidate, false);
+  } else {
+    idmap_set(contents, claim->hash, docID);
+  }
+}
+
+/**************** claimable ****************/
+/* Return true if docID may be claimed to write (no save claims it) or to read (no save writes it).
+ * The caller holds contentsLock.
+ */
+static bool claimable(const docid_t docID, const bool write)
+{
+  int64_t* claimed = idmap_find(claims, docID);
+  return (claimed == NULL || (!write && *claimed > 0));
+}
+
+/**************** markClaim ****************/
+/* Claim docID to write, or as one more reader of it. The caller holds contentsLock, and checked that
+ * docID is claimable.
+ */
+static void markClaim(const docid_t docID, const bool write)
+{
+  int64_t* claimed = idmap_find(claims, docID);
+  if (write || claimed == NULL) {
+    idmap_set(claims, docID, write ? -1 : 1);
+  } else {
+    (*claimed)++;
+  }
+}
+
+/**************** releaseClaim ****************/
+/* Release a claim on docID: its writer's, or one reader's. The caller holds contentsLock, and wakes
+ * the saves waiting for claims once it has released its own.
+ */
+static void releaseClaim(const docid_t docID)
+{
+  int64_t* claimed = idmap_find(claims, docID);
+  if (claimed != NULL && (*claimed < 0 || --(*claimed) == 0)) {
+    idmap_remove(claims, docID);
+  }
+}
+
+/**************** findCanonical ****************/
+/* Return the docID of the page saved in pageDirectory with exactly this HTML, as claimPages found it
+ * (claim->candidate, claimed to read), or claim->docID if there is none. The candidate's page is read
+ * back to make sure its HTML matches, not only its hash; if not (or if it cannot be read), claim->docID
+ * holds the content (see recordSave). The caller does not hold contentsLock.
+ */
+static docid_t findCanonical(const char* pageDirectory, const char* HTML, const claim_t* claim)
+{
+  if (claim->candidate == 0) {
+    return claim->docID;
+  }
+
+  webpage_t* saved = pagedir_load(pageDirectory, claim->candidate);
+  const char* savedHTML = (saved == NULL || webpage_getHTML(saved) == NULL) ? "" : webpage_getHTML(saved);
+  bool same = (saved != NULL && strcmp(savedHTML, HTML) == 0);
+  webpage_delete(saved);
+  return same ? claim->candidate : claim->docID;
+}
+
+/**************** moveContent ****************/
+/* If other pages are aliases of claim->docID (claimed by claimPages, with it), and its page holds other
+ * HTML than that about to be saved under it, write that HTML to the page of the first of them (by docID)
+ * whose page can be read. Return that alias's docID, setting *oldHash to the hash of the HTML, for
+ * recordSave to make the others aliases of it; or 0 if no content was moved. The caller does not hold
+ * contentsLock.
+ */
+static docid_t moveContent(const char* pageDirectory, const claim_t* claim, const char* HTML, uint64_t* oldHash)
+{
+  if (claim->numAliases == 0) {
+    return 0;
+  }
+  webpage_t* old = pagedir_load(pageDirectory, claim->docID);
+  const char* oldHTML = (old == NULL || webpage_getHTML(old) == NULL) ? "" : webpage_getHTML(old);
+  if (old == NULL || strcmp(oldHTML, HTML) == 0) {
+    webpage_delete(old);
+    return 0;
+  }
+
+  *oldHash = hash64_string(oldHTML);
+  docid_t holder = 0;
+  for (int i = 0; holder == 0 && i < claim->numAliases; i++) {
+    webpage_t* alias = pagedir_loadHeader(pageDirectory, claim->aliases[i]);
+    if (alias != NULL) {
+      holder = claim->aliases[i];
+      writePage(pageDirectory, holder, webpage_getURL(alias), webpage_getDepth(alias), oldHTML);
+      webpage_delete(alias);
+    }
+  }
+  webpage_delete(old);
+  return holder;
+}
+
+/**************** recordSave ****************/
+/* Record a save of claim->docID, in memory and in '.contents': the content moved to holder, if not 0
+ * (which the other aliases become aliases of), then docID, with canonical holding its content; then
+ * release the claims of the save, and wake the saves waiting for them. The caller holds contentsLock.
+ */
+static void recordSave(const char* pageDirectory, claim_t* claim, const docid_t canonical, const docid_t holder,
+                       const uint64_t oldHash)
+{
+  docid_t docID = claim->docID;
+  if (holder != 0) {
+    appendContents(pageDirectory, holder, oldHash, holder);
+    for (int i = 0; i < claim->numAliases; i++) {
+      if (claim->aliases[i] != holder) {
+        appendContents(pageDirectory, claim->aliases[i], oldHash, holder);
+      }
+    }
+    docid_t* found = idmap_find(contents, oldHash);
+    if (found != NULL && *found == docID) {
+      *found = holder;
+    }
+  }
+
+  // A page recorded with the hash whose HTML did not match makes way for this one
+  if (claim->candidate != 0 && canonical == docID) {
+    idmap_set(contents, claim->hash, docID);
+  }
+  appendContents(pageDirectory, docID, claim->hash, canonical);
+
+  releaseClaim(docID);
+  for (int i = 0; i < claim->numAliases; i++) {
+    releaseClaim(claim->aliases[i]);
+  }
+  if (claim->candidate != 0) {
+    releaseClaim(claim->candidate);
+  }
+  free(claim->aliases);
+  claim->aliases = NULL;
+  pthread_cond_broadcast(&claimsReleased);
+}
+
+/**************** collectAlias ****************/
+/* idmap_iterate itemfunc over canonicals: arg is an aliasList_t, with room for all the aliases of its
+ * docID, to which each alias of it is added.
+ */
+static void collectAlias(void* arg, const uint64_t key, const int64_t canonical)
+{
+  aliasList_t* list = arg;
+  docid_t docID = (docid_t) key;
+  if (canonical == list->docID && docID != list->docID) {
+    list->aliases[list->numAliases++] = docID;
+  }
+}
+
+/**************** compareDocIDs ****************/
+/* qsort comparison function for docIDs, ascending.
+ */
+static int compareDocIDs(const void* a, const void* b)
+{
+  docid_t x = *(const docid_t*) a;
+  docid_t y = *(const docid_t*) b;
+  return (x > y) - (x < y);
+}
+
+/**************** loadContents ****************/
+/* Make the content tables those of pageDirectory, reading them from the '.contents' file there if they
+ * are for another directory (or none yet); as content holders, pages whose files are gone are left out.
+ * The caller holds contentsLock.
+ */
+static void loadContents(const char* pageDirectory)
+{
+  if (contentsDirectory != NULL && strcmp(contentsDirectory, pageDirectory) == 0) {
+    return;
+  }
+
+  forgetContents();
+  contents = idmap_new(0);
+  canonicals = idmap_new(0);
+  aliasCounts = idmap_new(0);
+  claims = idmap_new(0);
+  contentsDirectory = mem_assert(malloc(strlen(pageDirectory) + 1), "failed allocating memory for content table");
+  strcpy(contentsDirectory, pageDirectory);
+
+  int pathLength = strlen(pageDirectory) + strlen("/.contents") + 1;
+  char path[pathLength];
+  snprintf(path, pathLength, "%s/.contents", pageDirectory);
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    return;
+  }
+
+  // Of the pages saved with their own content, the last saved with each hash has it
+  docid_t docID, canonical;
+  uint64_t hash;
+  while (fscanf(fp, "%" SCNdocid "\t%16" SCNx64 "\t%" SCNdocid " ", &docID, &hash, &canonical) == 3) {
+    noteCanonical(docID, canonical);
+    if (docID != canonical) {
+      continue;
+    }
+    if (!pageExists(pageDirectory, docID)) {
+      continue;
+    }
+    idmap_set(contents, hash, docID);
+  }
+  fclose(fp);
+}
+
+/**************** forgetContents ****************/
+/* Free the content tables, if any, so that the next save loads them anew. The caller holds contentsLock.
+ */
+static void forgetContents(void)
+{
+  if (contentsDirectory != NULL) {
+    idmap_delete(contents);
+    idmap_delete(canonicals);
+    idmap_delete(aliasCounts);
+    idmap_delete(claims);
+    free(contentsDirectory);
+    contentsDirectory = NULL;
+  }
+}
+
+/**************** appendContents ****************/
+/* Append a line to the '.contents' file of pageDirectory: docID, its content hash (as 16 hex digits), and the docID of the
+ * page holding that content (docID itself unless it is an alias), and note which that is in memory.
+ * Each line goes out in a single write, as in pagedir_saveValidators. The caller holds contentsLock.
+ * Program crashes cleanly if the file cannot be written.
+ */
+static void appendContents(const char* pageDirectory, const docid_t docID, const uint64_t hash, const docid_t canonical)
+{
+  int lineLength = snprintf(NULL, 0, "%" PRIdocid "\t%016" PRIx64 "\t%" PRIdocid "\n", docID, hash, canonical);
+  char line[lineLength + 1];
+  snprintf(line, lineLength + 1, "%" PRIdocid "\t%016" PRIx64 "\t%" PRIdocid "\n", docID, hash, canonical);
+
+  int pathLength = strlen(pageDirectory) + strlen("/.contents") + 1;
+  char path[pathLength];
+  snprintf(path, pathLength, "%s/.contents", pageDirectory);
+  FILE* fp = fopen(path, "a");
+  if (fp == NULL || setvbuf(fp, NULL, _IOFBF, lineLength + 1) != 0
+      || fputs(line, fp) == EOF || fclose(fp) != 0) {
+    fprintf(stderr, "failed writing %s\n", path);
+    exit(1);
+  }
+  noteCanonical(docID, canonical);
+}
+
+/**************** noteCanonical ****************/
+/* Note in canonicals and aliasCounts that docID's content is now held by canonical (itself, unless it
+ * is an alias), taking it off the count of the page it was an alias of before, if any.
+ * The caller holds contentsLock.
+ */
+static void noteCanonical(const docid_t docID, const docid_t canonical)
+{
+  docid_t* previous = idmap_find(canonicals, docID);
+  docid_t before = (previous == NULL) ? docID : *previous;
+  if (previous != NULL) {
+    *previous = canonical;
+  } else if (canonical != docID) {
+    idmap_set(canonicals, docID, canonical);
+  }
+
+  // A page whose last alias goes is dropped from the counts, which thus hold only pages with aliases
+  if (before != docID) {
+    int64_t* count = idmap_find(aliasCounts, before);
+    if (count != NULL && --(*count) <= 0) {
+      idmap_remove(aliasCounts, before);
+    }
+  }
+  if (canonical != docID) {
+    int64_t* count = idmap_find(aliasCounts, canonical);
+    if (count == NULL) {
+      idmap_set(aliasCounts, canonical, 1);
+    } else {
+      (*count)++;
+    }
+  }
 }
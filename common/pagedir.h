@@ -1,16 +1,54 @@
 /* 
  * pagedir - utility functions for downloading, saving, and loading web pages
  *
+ * Each page is saved in a page file named by its docID, or in a segment store. A pageDirectory has one of
+ * three layouts, which its '.crawler' marker records: the flat layout (version 1, an empty marker, as
+ * crawlers before the sharded one wrote) keeps every page file in pageDirectory itself; the sharded layout
+ * (version 2, 'pagedir 2') keeps page docID in pageDirectory/XX/YY/docID, XX and YY being two hex digits
+ * each from a hash of docID, so that a directory of millions of pages has 65536 shards of a few dozen
+ * files each; the segment layout (version 3, 'pagedir 3') has no page files, but appends each page, with
+ * the same bytes a page file would hold, to a few large segment files (see segstore.h), so that saving a
+ * page creates no file, and loading the pages in docID order reads the segments sequentially.
+ * All the functions below find pages wherever the layout puts them; pagedir_migrate moves a flat
+ * pageDirectory to the sharded layout.
+ *
+ * A pageDirectory may also have its pages' HTML compressed (see lzcodec.h), as its marker records on a
+ * second line ('compress lz', or 'compress lz-dict' with a shared dictionary, trained on its first pages
+ * and kept in '.dictionary'). A compressed page has its codec and the HTML's length on its depth line
+ * ('depth lz length', or 'depth lzd length'), so that its URL and depth read as before; it is
+ * decompressed by the functions that load its HTML, and is saved plain if it would not come out smaller.
+ *
  * By Rodrigo Vega Ayllon - October 2024
  */
 
+#include <stdio.h>
+#include "docid.h"
 #include "../libcs50/webpage.h"
 
+/* pagedir_store_t: how pagedir_init stores the pages of a new pageDirectory
+ *   PAGEDIR_SEGMENTS  in segment files (the segment layout)
+ *   PAGEDIR_FILES     in a page file each (the sharded layout)
+ */
+typedef enum { PAGEDIR_SEGMENTS, PAGEDIR_FILES } pagedir_store_t;
+
+/* pagedir_compress_t: how pagedir_init has the HTML of the pages of a new pageDirectory saved
+ *   PAGEDIR_PLAIN     as it is
+ *   PAGEDIR_LZ        compressed
+ *   PAGEDIR_LZ_DICT   compressed, against a dictionary trained on the first PAGEDIR_DICT_SAMPLE pages
+ *                     once that many are saved (the pages saved before then are compressed without it)
+ */
+typedef enum { PAGEDIR_PLAIN, PAGEDIR_LZ, PAGEDIR_LZ_DICT } pagedir_compress_t;
+
+/* Pages whose HTML a shared dictionary is trained on */
+#define PAGEDIR_DICT_SAMPLE 64
+
 /**************** pagedir_init ****************/
 /* Initializes and validates that a directory is apt to write downloaded webpages to.
  *
  * Caller provides: 
  *  pageDirectory string representing the path of the directory
+ *  storeKind how to store the pages, if pageDirectory is new
+ *  compressKind how to save their HTML, if pageDirectory is new
  *
  * We return:
  *  true if directory can be written downloaded webpages to, false otherwise
@@ -18,26 +56,46 @@
  * IMPORTANT:
  *  program crashes cleanly if pageDirectory is NULL
  *  initialization/validation is performed by creating/checking the existence of a writable '.crawler' file inside pageDirectory
+ *  a pageDirectory with a '.crawler' file keeps the layout it records (we return false if it is one we do not know);
+ *  a new one gets the segment layout for PAGEDIR_SEGMENTS, or the sharded layout for PAGEDIR_FILES
+ *  likewise, one crawled before keeps compressing its pages or not, whatever compressKind is
  */
-bool pagedir_init(const char* pageDirectory);
+bool pagedir_init(const char* pageDirectory, const pagedir_store_t storeKind, const pagedir_compress_t compressKind);
 
 /**************** pagedir_save ****************/
-/* Writes information about a page to a page file.
+/* Writes information about a page to a page file, unless a page with exactly the same HTML was saved
+ * in pageDirectory already; then the page becomes an alias of that one, its page file holding only
+ * its URL and depth. Either way, a line recording the page's content hash, and which docID holds
+ * its content, is appended to the '.contents' file in pageDirectory (see pagedir_loadAliases).
  *
  * Caller provides:
  *  page  webpage_t struct pointer that has information about a webpage including the url, depth, and html
  *  pageDirectory string representing the path of the directory where this page file is located
  *  docID the unique document ID of the webpage that identifies its page file
  *
+ * We return:
+ *  docID if the page was saved with its HTML, or the docID of the page it is an alias of
+ *
  * IMPORTANT:
  *  program crashes cleanly if:
  *    any pointer argument is NULL
- *    file to write page information to cannot be opened
+ *    file to write page information to, or '.contents', cannot be opened or written
+ *  the page is written to 'docID.part' and then renamed to 'docID', so a page file, once it exists, is complete;
+ *  in the sharded layout, the first page saved in a shard creates its directories; in the segment layout,
+ *  the page is appended to the store, a crash leaving it saved whole or not at all
+ *  pages may be saved from several threads at once, and are compressed and written at once too; a save
+ *  waits for another only when both write, or one writes and the other reads, the same page: a page and
+ *  its aliases, or the page saved with the same content hash
+ *  in a pageDirectory compressed with a dictionary, saving a page past the first PAGEDIR_DICT_SAMPLE trains
+ *  the dictionary first, if there is none yet; it is written to '.dictionary.part' and then renamed
+ *  a page saved again under its docID with new HTML, when other pages are aliases of it, first has its old
+ *  HTML moved to the page file of the first of them (by docID), which the others become aliases of
  * 
  * Limitations:
- *  docID should be an integer of less than 6 digits; else, it gets cut off at the 5-digit mark, leading to unexpected behavior
+ *  the content hashes of one pageDirectory at a time are kept in memory; saving to another reads its '.contents' anew
+ *  finding the aliases whose content is to be moved takes a pass over all the aliases in pageDirectory
  */
-void pagedir_save(const webpage_t* page, const char* pageDirectory, const int docID);
+docid_t pagedir_save(const webpage_t* page, const char* pageDirectory, const docid_t docID);
 
 
 /**************** pagedir_validate ****************/
@@ -53,8 +111,8 @@ void pagedir_save(const webpage_t* page, const char* pageDirectory, const int do
  *  program crashes cleanly if pageDirectory is NULL
  * 
  * Limitations:
- *  a directory that is not crawler-produced might still give a false positive (if it just so happens that it has readable files
- *  named '.crawler' and '1')
+ *  a directory that is not crawler-produced might still give a false positive (if it just so happens that it has a readable
+ *  '.crawler' file naming a layout we know, and a page of docID 1 in that layout)
  */
 bool pagedir_validate(const char* pageDirectory);
 
@@ -66,8 +124,9 @@ bool pagedir_validate(const char* pageDirectory);
  *  docID the unique document ID of the page that identifies its page file
  *
  * We return:
- *  pointer to webpage_t struct containing all page information, or
- *  NULL if page file does not exist or is not readable in directory, or if there was an error constructing webpage_t struct
+ *  pointer to webpage_t struct containing all page information (with NULL HTML if the page is an alias,
+ *  or has no HTML), or
+ *  NULL if page does not exist or is not readable in directory, or is malformed
  *
  * We assume:
  *  all files in pageDirectory are crawler-produced
@@ -75,12 +134,41 @@ bool pagedir_validate(const char* pageDirectory);
  * IMPORTANT:
  *  program crashes cleanly if:
  *    any pointer argument is NULL
- *    file containing page information cannot be opened
- * 
+ *    memory could not be allocated
+ *  the page is read whole, with a single read where the layout allows, rather than line by line
+ *  compressed HTML is decompressed; a page whose HTML does not decompress (or whose dictionary is missing)
+ *  is malformed
+ *  pages may be loaded from several threads at once, and while others are saved
+ */
+webpage_t* pagedir_load(const char* pageDirectory, const docid_t docID);
+
+/**************** pagedir_loadView ****************/
+/* Loads a page as pagedir_load does, but without copying its HTML: the webpage_t returned is a view
+ * (see webpage_newView) whose HTML lies in a read-only memory mapping of the page file, or of the segment
+ * holding the page, and is NOT null-terminated (see webpage_getHTMLLength)
+ *
+ * Caller provides:
+ *  pageDirectory string representing the path of the directory where this page file is located
+ *  docID the unique document ID of the page that identifies its page file
+ *
+ * We return:
+ *  pointer to webpage_t struct as pagedir_load does (a page with no HTML, or with compressed HTML, which is
+ *  decompressed into memory of its own, being no view), or
+ *  NULL if page does not exist or is not readable in directory, or is malformed
+ *
+ * Caller is responsible for:
+ *  later calling webpage_delete, which unmaps a page file; and passing the page only to functions that
+ *  honor the HTML's length, such as webpage_getNextWord and webpage_getNextURL
+ *
+ * IMPORTANT:
+ *  program crashes cleanly if pageDirectory is NULL, or memory could not be allocated
+ *
  * Limitations:
- *  docID should be an integer of less than 6 digits; else, it gets cut off at the 5-digit mark, leading to unexpected behavior
+ *  in the segment layout, each segment is mapped whole once, and stays mapped until pages of another
+ *  pageDirectory are used: the views of its pages must be deleted before then; a page saved after its
+ *  segment was mapped is loaded as by pagedir_load
  */
-webpage_t* pagedir_load(const char* pageDirectory, const int docID);
+webpage_t* pagedir_loadView(const char* pageDirectory, const docid_t docID);
 
 /**************** pagedir_open ****************/
 /* Opens a file identified by docID in pageDirectory in a given mode
@@ -100,8 +188,127 @@ webpage_t* pagedir_load(const char* pageDirectory, const int docID);
  *  program crashes cleanly if:
  *    pageDirectory is NULL
  *    file containing page information cannot be opened in given mode
- * 
+ *    the page is in the segment layout, and mode is not for reading only
+ *  a file opened for writing in the sharded layout has its shard created first, if need be
+ *  in the segment layout, the stream returned holds a copy of the page, in memory
+ *  the page is as saved: its HTML is not decompressed (its first two lines, URL and depth, never are)
+ */
+FILE* pagedir_open(const char* pageDirectory, const docid_t docID, char* mode);
+
+/**************** pagedir_loadHeader ****************/
+/* Loads the URL and depth of a page, but not its HTML, from its page file
+ *
+ * Caller provides:
+ *  pageDirectory string representing the path of the directory where this page file is located
+ *  docID the unique document ID of the page that identifies its page file
+ *
+ * We return:
+ *  pointer to webpage_t struct with the page's URL and depth and NULL HTML, or
+ *  NULL if page file does not exist or is not readable in directory, or is malformed
+ *
+ * Limitations:
+ *  in the segment layout, the whole page is read
+ */
+webpage_t* pagedir_loadHeader(const char* pageDirectory, const docid_t docID);
+
+/**************** pagedir_saveValidators ****************/
+/* Records the ETag and Last-Modified values a page was served with, by appending a line to the
+ * '.validators' file in pageDirectory; a later line for the same docID overrides earlier ones.
+ *
+ * Caller provides:
+ *  pageDirectory string representing the path of the directory
+ *  docID the unique document ID of the page
+ *  etag, lastModified the values, each NULL or "" if the page had none
+ *
+ * IMPORTANT:
+ *  program crashes cleanly if pageDirectory is NULL or '.validators' cannot be written
+ *
+ * Limitations:
+ *  values containing tabs or newlines are not recorded
+ *  lines are appended with a single write each, so concurrent callers do not interleave
+ *  (on a local file system), but need not be in docID order
+ */
+void pagedir_saveValidators(const char* pageDirectory, const docid_t docID, const char* etag, const char* lastModified);
+
+/**************** pagedir_loadValidators ****************/
+/* Reads the '.validators' file of pageDirectory, calling itemfunc on each line, in the order written
+ * (so that for a given docID the last call carries its current values).
+ *
+ * Caller provides:
+ *  pageDirectory string representing the path of the directory
+ *  arg anything; passed along to itemfunc
+ *  itemfunc function called with arg, a docID, and its ETag and Last-Modified (each "" if none)
+ *
+ * We return:
+ *  true if the file was read (or does not exist: no page has validators), false if it is not readable
+ */
+bool pagedir_loadValidators(const char* pageDirectory, void* arg,
+                            void (*itemfunc)(void* arg, const docid_t docID, const char* etag, const char* lastModified));
+
+/**************** pagedir_loadAliases ****************/
+/* Reads the '.contents' file of pageDirectory, calling itemfunc for each page saved, in the order saved,
+ * with its docID and that of the page holding its content: its own, or the page it is an alias of.
+ * For a given docID the last call is current (a page may be saved more than once, when recrawled).
+ *
+ * Caller provides:
+ *  pageDirectory string representing the path of the directory
+ *  arg anything; passed along to itemfunc
+ *  itemfunc function called with arg, a docID, and its canonical docID
+ *
+ * We return:
+ *  true if the file was read (or does not exist: no page has an alias), false if it is not readable
+ */
+bool pagedir_loadAliases(const char* pageDirectory, void* arg,
+                         void (*itemfunc)(void* arg, const docid_t docID, const docid_t canonicalDocID));
+
+/**************** pagedir_trimContents ****************/
+/* Rewrites the '.contents' file of pageDirectory without the pages whose docIDs are docID or more,
+ * as when the page files from docID on have been removed, nor those whose content such a page holds;
+ * the page files of the latter are removed too. The content table kept in memory is dropped, to be read
+ * anew by the next pagedir_save.
+ *
+ * Caller provides:
+ *  pageDirectory string representing the path of the directory
+ *  docID the smallest docID to drop
+ *
+ * IMPORTANT:
+ *  program crashes cleanly if pageDirectory is NULL or '.contents' cannot be rewritten
+ *  the file is written to '.contents.part' and then renamed, so a crash leaves the old one whole
+ */
+void pagedir_trimContents(const char* pageDirectory, const docid_t docID);
+
+/**************** pagedir_removeFrom ****************/
+/* Removes the page files in pageDirectory whose docIDs are docID or more, and any partly written ones
+ * ('docID.part') among them, as when resuming a crawl from a checkpoint taken before they were saved.
+ *
+ * Caller provides:
+ *  pageDirectory string representing the path of the directory
+ *  docID the smallest docID to remove
+ *
+ * IMPORTANT:
+ *  program crashes cleanly if pageDirectory is NULL, or the segment store cannot be written
+ *
  * Limitations:
- *  docID should be an integer of less than 6 digits; else, it gets cut off at the 5-digit mark, leading to unexpected behavior
+ *  in the sharded layout, every shard is looked into, so that this takes time in the number of pages saved
+ *  in the segment layout, the pages removed are only marked so; their bytes stay in the segments
+ */
+void pagedir_removeFrom(const char* pageDirectory, const docid_t docID);
+
+/**************** pagedir_migrate ****************/
+/* Moves the page files of a pageDirectory in the flat layout into the sharded layout, and then records
+ * the new layout in its '.crawler' marker; partly written page files ('docID.part') are removed.
+ *
+ * Caller provides:
+ *  pageDirectory string representing the path of a crawler-produced directory
+ *
+ * We return:
+ *  the number of page files moved (0 if pageDirectory is in the sharded or segment layout already), or
+ *  -1 if its marker cannot be read or names a layout we do not know, or a page file could not be moved
+ *
+ * IMPORTANT:
+ *  program crashes cleanly if pageDirectory is NULL
+ *  no other program should use pageDirectory meanwhile
+ *  the marker changes only once every page file has moved; a migration cut short leaves a directory that
+ *  reads as flat (its moved pages missing), which migrating again completes
  */
-FILE* pagedir_open(const char* pageDirectory, const int docID, char* mode);
+int pagedir_migrate(const char* pageDirectory);
@@ -0,0 +1,216 @@
+/*
+ * politeness - per-host scheduler that keeps a crawler polite to each web server
+ *              See politeness.h for usage.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#define _GNU_SOURCE       // random, clock_gettime
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../libcs50/mem.h"
+#include "../libcs50/hashtable.h"
+#include "politeness.h"
+
+/* host_t: state of one host
+ */
+typedef struct host {
+  double tokens;          // requests the host may receive right now (up to burst)
+  double lastRefill;      // time tokens was last brought up to date
+  int active;             // requests in progress
+  int failures;           // consecutive failed requests
+  double notBefore;       // backed off until this time
+} host_t;
+
+/* politeness_t: structure to represent the scheduler
+ * The innards should not be visible to users of the politeness module.
+ */
+typedef struct politeness {
+  hashtable_t* hosts;     // host[:port] -> host_t
+  double rate;
+  int burst;
+  int maxConns;
+  pthread_mutex_t lock;
+} politeness_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static host_t* findHost(politeness_t* polite, const char* url, const bool create);
+static void refill(politeness_t* polite, host_t* host, const double t);
+static double now(void);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const int HOST_SLOTS = 101;            // hashtable slots; crawls visit few hosts
+static const double BACKOFF_BASE = 1.0;       // seconds of backoff after a first failure
+static const double BACKOFF_MAX = 60.0;       // longest backoff, in seconds
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** politeness_new ****************/
+/* see politeness.h for documentation */
+politeness_t* politeness_new(const double rate, const int burst, const int maxConns)
+{
+  if (rate < 0 || burst < 1 || maxConns < 1) {
+    return NULL;
+  }
+
+  politeness_t* polite = mem_assert(malloc(sizeof(politeness_t)), "failed allocating memory for politeness");
+  polite->hosts = mem_assert(hashtable_new(HOST_SLOTS), "failed allocating memory for politeness hosts");
+  polite->rate = rate;
+  polite->burst = burst;
+  polite->maxConns = maxConns;
+  pthread_mutex_init(&polite->lock, NULL);
+
+  return polite;
+}
+
+/**************** politeness_acquire ****************/
+/* see politeness.h for documentation */
+long politeness_acquire(politeness_t* polite, const char* url)
+{
+  if (polite == NULL || url == NULL) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&polite->lock);
+  host_t* host = findHost(polite, url, true);
+  if (host == NULL) {
+    pthread_mutex_unlock(&polite->lock);
+    return 0;
+  }
+
+  // Work out how long to wait, if at all: backoff first, then connections, then tokens;
+  // a host at maxConns has no time to wait for, only a release
+  double t = now();
+  refill(polite, host, t);
+  double wait = 0;
+  if (t < host->notBefore) {
+    wait = host->notBefore - t;
+  } else if (host->active >= polite->maxConns) {
+    pthread_mutex_unlock(&polite->lock);
+    return -1;
+  } else if (polite->rate > 0 && host->tokens < 1) {
+    wait = (1 - host->tokens) / polite->rate;
+  } else {
+    host->tokens -= 1;
+    host->active++;
+  }
+  pthread_mutex_unlock(&polite->lock);
+
+  // Round up, so that a wait is never reported as 0
+  long millis = (long) (wait * 1000);
+  return (wait > 0 && millis * 0.001 < wait) ? millis + 1 : millis;
+}
+
+/**************** politeness_release ****************/
+/* see politeness.h for documentation */
+void politeness_release(politeness_t* polite, const char* url, const bool success)
+{
+  if (polite == NULL || url == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&polite->lock);
+  host_t* host = findHost(polite, url, false);
+  if (host != NULL) {
+    if (host->active > 0) {
+      host->active--;
+    }
+
+    if (success) {
+      host->failures = 0;
+    } else {
+      // Exponential backoff with jitter: between half and all of BACKOFF_BASE * 2^(failures-1)
+      host->failures++;
+      double delay = BACKOFF_BASE;
+      for (int i = 1; i < host->failures && delay < BACKOFF_MAX; i++) {
+        delay *= 2;
+      }
+      if (delay > BACKOFF_MAX) {
+        delay = BACKOFF_MAX;
+      }
+      delay *= 0.5 + 0.5 * ((double) random() / RAND_MAX);
+      host->notBefore = now() + delay;
+    }
+  }
+  pthread_mutex_unlock(&polite->lock);
+}
+
+/**************** politeness_delete ****************/
+/* see politeness.h for documentation */
+void politeness_delete(politeness_t* polite)
+{
+  if (polite == NULL) {
+    return;
+  }
+
+  hashtable_delete(polite->hosts, free);
+  pthread_mutex_destroy(&polite->lock);
+  free(polite);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** findHost ****************/
+/* Find the state of url's host (the part between "://" and the next '/'), creating it
+ * (with a full bucket) if create is true and it does not exist yet.
+ * Return NULL if url has no host, or if it is not found and not created.
+ */
+static host_t* findHost(politeness_t* polite, const char* url, const bool create)
+{
+  const char* start = strstr(url, "://");
+  if (start == NULL) {
+    return NULL;
+  }
+  start += strlen("://");
+  size_t length = strcspn(start, "/");
+  if (length == 0) {
+    return NULL;
+  }
+
+  char key[length + 1];
+  memcpy(key, start, length);
+  key[length] = '\0';
+
+  host_t* host = hashtable_find(polite->hosts, key);
+  if (host == NULL && create) {
+    host = mem_assert(malloc(sizeof(host_t)), "failed allocating memory for politeness host");
+    host->tokens = polite->burst;
+    host->lastRefill = now();
+    host->active = 0;
+    host->failures = 0;
+    host->notBefore = 0;
+    hashtable_insert(polite->hosts, key, host);
+  }
+  return host;
+}
+
+/**************** refill ****************/
+/* Add the tokens the host has earned since it was last refilled, up to burst.
+ */
+static void refill(politeness_t* polite, host_t* host, const double t)
+{
+  host->tokens += (t - host->lastRefill) * polite->rate;
+  if (polite->rate == 0 || host->tokens > polite->burst) {
+    host->tokens = polite->burst;
+  }
+  host->lastRefill = t;
+}
+
+/**************** now ****************/
+/* Return the current time, in seconds, from a clock that never goes backwards.
+ */
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,82 @@
+/*
+ * politeness - per-host scheduler that keeps a crawler polite to each web server
+ *
+ * Each host (the host[:port] part of a URL) gets a token bucket that refills at 'rate' requests
+ * per second and holds at most 'burst' tokens, plus a limit of 'maxConns' requests in progress
+ * at once. A request may start only if its host has a token and a free connection. When a
+ * request to a host fails, the host is backed off: exponentially longer after each consecutive
+ * failure, with random jitter, so that a struggling server is not hammered by retries.
+ *
+ * Usage: before fetching a URL, call politeness_acquire; if it returns 0, fetch, then call
+ * politeness_release; otherwise, fetch something else (or wait) for the returned time, or, if it
+ * returns -1, until some request to the host is released (e.g., on a condition variable that the
+ * caller signals after each politeness_release).
+ *
+ * All functions are safe to call from several threads at once.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdbool.h>
+
+/***********************************************************************/
+/* politeness_t: opaque struct holding the state of every host seen so far
+ */
+typedef struct politeness politeness_t;
+
+/**************** politeness_new ****************/
+/* Allocate and initialize a new scheduler.
+ *
+ * Caller provides:
+ *   rate      requests per second allowed to each host (> 0), or 0 for no limit
+ *   burst     most requests a host may receive at once after being idle (must be >= 1)
+ *   maxConns  most requests in progress at once to each host (must be >= 1)
+ *
+ * We return:
+ *   pointer to new politeness_t struct, or NULL on any error
+ *
+ * Caller is responsible for:
+ *   later calling politeness_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+politeness_t* politeness_new(const double rate, const int burst, const int maxConns);
+
+/**************** politeness_acquire ****************/
+/* Ask whether a request for url may start now and, if so, account for it.
+ *
+ * Caller provides:
+ *   polite  pointer to valid politeness_t struct
+ *   url     URL about to be fetched
+ *
+ * We return:
+ *   0 if the request may start; the caller must later call politeness_release for it
+ *   -1 if the host is at maxConns: ask again once a request to it has been released
+ *   otherwise, milliseconds (> 0) to wait before asking again about this host
+ *
+ * IMPORTANT:
+ *   a URL with no recognizable host is always allowed
+ */
+long politeness_acquire(politeness_t* polite, const char* url);
+
+/**************** politeness_release ****************/
+/* Report that a request allowed by politeness_acquire is over.
+ *
+ * Caller provides:
+ *   polite   pointer to valid politeness_t struct
+ *   url      same URL as given to politeness_acquire
+ *   success  false if the request failed in a way that suggests the host is struggling (it could not
+ *            be reached, timed out, or answered with a server error), true otherwise
+ *
+ * We guarantee:
+ *   on failure, the host is backed off: no request to it is allowed for a random time between
+ *   half and all of a delay that doubles with each consecutive failure (up to a maximum);
+ *   a success resets the delay.
+ */
+void politeness_release(politeness_t* polite, const char* url, const bool success);
+
+/**************** politeness_delete ****************/
+/* Free all memory associated with the scheduler.
+ */
+void politeness_delete(politeness_t* polite);
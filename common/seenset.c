@@ -0,0 +1,386 @@
+/*
+ * seenset - set of URLs already seen by the crawler, kept as 64-bit fingerprints
+ *           See seenset.h for usage.
+ *
+ * An exact set is an array of fingerprints, a power of two in size, with linear probing; 0 marks
+ * an empty slot, so a URL whose fingerprint is 0 is stored as 1.
+ *
+ * An approximate set keeps no fingerprints, only a scalable Bloom filter: a list of filters, each
+ * twice the capacity of the one before and with BLOOM_EXTRA_BITS more bits per URL (so a lower
+ * false-positive rate, keeping the sum over all filters bounded). URLs go into the newest filter
+ * until it holds its capacity, when a new one is added; a URL is in the set if it is in any filter.
+ * A filter's bit positions come from the fingerprint by double hashing.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "../libcs50/mem.h"
+#include "../libcs50/hash64.h"
+#include "seenset.h"
+
+/* filter_t: one Bloom filter of an approximate set
+ */
+typedef struct filter {
+  uint64_t* bits;
+  size_t numBits;             // a power of two
+  size_t capacity;            // URLs it is meant to hold
+  size_t count;               // URLs added to it
+  int hashes;                 // bits set per URL
+} filter_t;
+
+/* seenset_t: structure to represent a set of seen URLs
+ * The innards should not be visible to users of the seenset module.
+ */
+typedef struct seenset {
+  uint64_t* slots;            // exact set: fingerprints, 0 meaning empty; NULL if approximate
+  size_t capacity;            // number of slots, a power of two
+  size_t count;               // URLs inserted
+  filter_t* filters;          // approximate set: its filters, oldest first; NULL if exact
+  int numFilters;
+} seenset_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static uint64_t fingerprint(const char* url);
+static bool contains(seenset_t* set, const uint64_t fp);
+static void add(seenset_t* set, const uint64_t fp);
+static bool findSlot(seenset_t* set, const uint64_t fp, size_t* slot);
+static void grow(seenset_t* set);
+static void addFilter(seenset_t* set, const size_t capacity);
+static void filterAdd(filter_t* filter, const uint64_t fp);
+static bool filterMayContain(const filter_t* filter, const uint64_t fp);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const size_t MIN_CAPACITY = 64;        // smallest table, or first filter
+static const int BLOOM_BITS = 16;             // bits per URL in the first filter: 0.05% false positives
+static const int BLOOM_EXTRA_BITS = 2;        // more bits per URL in each later filter
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** seenset_new ****************/
+/* see seenset.h for documentation */
+seenset_t* seenset_new(const int expected, const bool bloom)
+{
+  if (expected <= 0) {
+    return NULL;
+  }
+
+  seenset_t* set = mem_assert(calloc(1, sizeof(seenset_t)), "failed allocating memory for seenset");
+  if (bloom) {
+    addFilter(set, ((size_t) expected > MIN_CAPACITY) ? (size_t) expected : MIN_CAPACITY);
+    return set;
+  }
+
+  // Room for twice the expected number, so the table stays at most half full
+  size_t capacity = MIN_CAPACITY;
+  while (capacity < 2 * (size_t) expected) {
+    capacity *= 2;
+  }
+  set->slots = mem_assert(calloc(capacity, sizeof(uint64_t)), "failed allocating memory for seenset slots");
+  set->capacity = capacity;
+
+  return set;
+}
+
+/**************** seenset_insert ****************/
+/* see seenset.h for documentation */
+bool seenset_insert(seenset_t* set, const char* url)
+{
+  if (set == NULL || url == NULL) {
+    return false;
+  }
+
+  uint64_t fp = fingerprint(url);
+  if (contains(set, fp)) {
+    return false;
+  }
+  add(set, fp);
+  return true;
+}
+
+/**************** seenset_contains ****************/
+/* see seenset.h for documentation */
+bool seenset_contains(seenset_t* set, const char* url)
+{
+  if (set == NULL || url == NULL) {
+    return false;
+  }
+  return contains(set, fingerprint(url));
+}
+
+/**************** seenset_size ****************/
+/* see seenset.h for documentation */
+int seenset_size(seenset_t* set)
+{
+  return (set == NULL) ? 0 : set->count;
+}
+
+/**************** seenset_save ****************/
+/* see seenset.h for documentation */
+bool seenset_save(seenset_t* set, FILE* fp)
+{
+  if (set == NULL || fp == NULL) {
+    return false;
+  }
+
+  // An exact set is its count, then its fingerprints
+  if (set->filters == NULL) {
+    fprintf(fp, "%zu\n", set->count);
+    for (size_t i = 0; i < set->capacity; i++) {
+      if (set->slots[i] != 0) {
+        fprintf(fp, "%016llx\n", (unsigned long long) set->slots[i]);
+      }
+    }
+    return ferror(fp) == 0;
+  }
+
+  // An approximate set is "bloom" and its count, then each filter's shape and bits
+  fprintf(fp, "bloom %zu %d\n", set->count, set->numFilters);
+  for (int f = 0; f < set->numFilters; f++) {
+    filter_t* filter = &set->filters[f];
+    fprintf(fp, "%zu %zu %zu %d\n", filter->numBits, filter->capacity, filter->count, filter->hashes);
+    for (size_t i = 0; i < filter->numBits / 64; i++) {
+      fprintf(fp, "%016llx\n", (unsigned long long) filter->bits[i]);
+    }
+  }
+  return ferror(fp) == 0;
+}
+
+/**************** seenset_load ****************/
+/* see seenset.h for documentation */
+seenset_t* seenset_load(FILE* fp, const bool bloom)
+{
+  char first[16];
+  if (fp == NULL || fscanf(fp, "%15s ", first) != 1) {
+    return NULL;
+  }
+
+  // An approximate set, which only an approximate set can be made from
+  if (strcmp(first, "bloom") == 0) {
+    size_t count;
+    int numFilters;
+    if (!bloom || fscanf(fp, "%zu %d ", &count, &numFilters) != 2 || numFilters < 1) {
+      return NULL;
+    }
+    seenset_t* set = mem_assert(calloc(1, sizeof(seenset_t)), "failed allocating memory for seenset");
+    set->count = count;
+    for (int f = 0; f < numFilters; f++) {
+      size_t numBits, capacity, filterCount;
+      int hashes;
+      if (fscanf(fp, "%zu %zu %zu %d ", &numBits, &capacity, &filterCount, &hashes) != 4
+          || numBits < 64 || (numBits & (numBits - 1)) != 0 || hashes < 1) {
+        seenset_delete(set);
+        return NULL;
+      }
+      addFilter(set, capacity);
+      filter_t* filter = &set->filters[set->numFilters - 1];
+      if (filter->numBits != numBits || filter->hashes != hashes) {
+        seenset_delete(set);
+        return NULL;
+      }
+      filter->count = filterCount;
+      for (size_t i = 0; i < numBits / 64; i++) {
+        unsigned long long word;
+        if (fscanf(fp, "%llx ", &word) != 1) {
+          seenset_delete(set);
+          return NULL;
+        }
+        filter->bits[i] = word;
+      }
+    }
+    return set;
+  }
+
+  // An exact set, from which either kind can be made
+  char* end;
+  long count = strtol(first, &end, 10);
+  if (*end != '\0' || count < 0) {
+    return NULL;
+  }
+  seenset_t* set = seenset_new(count > 0 ? count : 1, bloom);
+  for (long i = 0; i < count; i++) {
+    unsigned long long fp64;
+    if (fscanf(fp, "%llx ", &fp64) != 1 || fp64 == 0) {
+      seenset_delete(set);
+      return NULL;
+    }
+    if (!contains(set, fp64)) {
+      add(set, fp64);
+    }
+  }
+  return set;
+}
+
+/**************** seenset_delete ****************/
+/* see seenset.h for documentation */
+void seenset_delete(seenset_t* set)
+{
+  if (set == NULL) {
+    return;
+  }
+
+  for (int f = 0; f < set->numFilters; f++) {
+    free(set->filters[f].bits);
+  }
+  free(set->filters);
+  free(set->slots);
+  free(set);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** fingerprint ****************/
+/* Return a 64-bit fingerprint of the URL, never 0: its hash64_string, so that every bit of the result
+ * depends on every bit of the URL.
+ */
+static uint64_t fingerprint(const char* url)
+{
+  uint64_t h = hash64_string(url);
+  return (h == 0) ? 1 : h;
+}
+
+/**************** contains ****************/
+/* Return true if fingerprint fp is in the set (for an approximate set, if it may be).
+ */
+static bool contains(seenset_t* set, const uint64_t fp)
+{
+  if (set->filters == NULL) {
+    size_t slot;
+    return findSlot(set, fp, &slot);
+  }
+
+  // Newest first: it is the largest, so the likeliest to hold a URL seen recently
+  for (int f = set->numFilters - 1; f >= 0; f--) {
+    if (filterMayContain(&set->filters[f], fp)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************** add ****************/
+/* Add fingerprint fp, known not to be in the set, growing the table or adding a filter as needed.
+ */
+static void add(seenset_t* set, const uint64_t fp)
+{
+  set->count++;
+  if (set->filters == NULL) {
+    // Grow first if adding one would make the table more than half full
+    if (2 * set->count > set->capacity) {
+      grow(set);
+    }
+    size_t slot;
+    findSlot(set, fp, &slot);
+    set->slots[slot] = fp;
+    return;
+  }
+
+  filter_t* newest = &set->filters[set->numFilters - 1];
+  if (newest->count >= newest->capacity) {
+    addFilter(set, 2 * newest->capacity);
+    newest = &set->filters[set->numFilters - 1];
+  }
+  filterAdd(newest, fp);
+  newest->count++;
+}
+
+/**************** findSlot ****************/
+/* Look for fingerprint fp in the table. Return true if found; either way, *slot is where it is,
+ * or the empty slot where it would go.
+ */
+static bool findSlot(seenset_t* set, const uint64_t fp, size_t* slot)
+{
+  size_t mask = set->capacity - 1;
+  size_t i = fp & mask;
+  while (set->slots[i] != 0) {
+    if (set->slots[i] == fp) {
+      *slot = i;
+      return true;
+    }
+    i = (i + 1) & mask;
+  }
+  *slot = i;
+  return false;
+}
+
+/**************** grow ****************/
+/* Double the table, reinserting every fingerprint.
+ */
+static void grow(seenset_t* set)
+{
+  uint64_t* old = set->slots;
+  size_t oldCapacity = set->capacity;
+
+  set->capacity = 2 * oldCapacity;
+  set->slots = mem_assert(calloc(set->capacity, sizeof(uint64_t)), "failed allocating memory for seenset slots");
+  for (size_t i = 0; i < oldCapacity; i++) {
+    if (old[i] != 0) {
+      size_t slot;
+      findSlot(set, old[i], &slot);
+      set->slots[slot] = old[i];
+    }
+  }
+  free(old);
+}
+
+/**************** addFilter ****************/
+/* Add an empty filter for capacity URLs, with BLOOM_EXTRA_BITS more bits per URL than the last one
+ * (BLOOM_BITS for the first), rounded up to a power of two bits in all, and the number of bits set
+ * per URL that minimizes false positives (bits per URL times ln 2).
+ */
+static void addFilter(seenset_t* set, const size_t capacity)
+{
+  set->filters = mem_assert(realloc(set->filters, (set->numFilters + 1) * sizeof(filter_t)),
+                            "failed allocating memory for seenset filters");
+  filter_t* filter = &set->filters[set->numFilters];
+  int bitsPerURL = BLOOM_BITS + set->numFilters * BLOOM_EXTRA_BITS;
+  set->numFilters++;
+
+  filter->numBits = 64;
+  while (filter->numBits < capacity * bitsPerURL) {
+    filter->numBits *= 2;
+  }
+  filter->bits = mem_assert(calloc(filter->numBits / 64, sizeof(uint64_t)), "failed allocating memory for seenset filter");
+  filter->capacity = capacity;
+  filter->count = 0;
+  filter->hashes = (int) (bitsPerURL * 0.693 + 0.5);
+}
+
+/**************** filterAdd ****************/
+/* Set the filter bits of fingerprint fp: bit positions h1 + i*h2, for i in [0..hashes),
+ * where h1 and h2 are the two halves of fp (h2 made odd, so the positions are distinct).
+ */
+static void filterAdd(filter_t* filter, const uint64_t fp)
+{
+  size_t mask = filter->numBits - 1;
+  uint64_t h1 = fp & 0xffffffff;
+  uint64_t h2 = (fp >> 32) | 1;
+  for (int i = 0; i < filter->hashes; i++) {
+    size_t bit = (h1 + i * h2) & mask;
+    filter->bits[bit / 64] |= (uint64_t) 1 << (bit % 64);
+  }
+}
+
+/**************** filterMayContain ****************/
+/* Return false if fingerprint fp is certainly not in the filter; true if it may be.
+ */
+static bool filterMayContain(const filter_t* filter, const uint64_t fp)
+{
+  size_t mask = filter->numBits - 1;
+  uint64_t h1 = fp & 0xffffffff;
+  uint64_t h2 = (fp >> 32) | 1;
+  for (int i = 0; i < filter->hashes; i++) {
+    size_t bit = (h1 + i * h2) & mask;
+    if ((filter->bits[bit / 64] & ((uint64_t) 1 << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
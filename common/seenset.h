@@ -0,0 +1,103 @@
+/*
+ * seenset - set of URLs already seen by the crawler, kept as 64-bit fingerprints
+ *
+ * Instead of the URLs themselves, the set keeps a 64-bit hash (fingerprint) of each, in an
+ * open-addressing table that doubles whenever it becomes half full: about 16 bytes per URL,
+ * and a lookup touches one or two adjacent slots. Two different URLs are mistaken for one another
+ * only if their fingerprints collide, which for a crawl of n URLs happens with probability about
+ * n^2 / 2^65 (about 1 in 10^5 for 10^7 URLs).
+ *
+ * Optionally, for crawls too large for even that, the set is approximate: a scalable Bloom filter
+ * takes the place of the table, at about 2 to 3 bytes per URL rather than 16 (the filter grows by
+ * adding larger, sparser filters as URLs arrive). The price is false positives: a URL never seen
+ * may be taken for one seen already, with probability under 0.1% however large the set grows,
+ * so an approximate set may skip a few pages an exact one would crawl. It never misses a URL seen.
+ *
+ * The set does no locking; callers that share one between threads must serialize access.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/***********************************************************************/
+/* seenset_t: opaque struct representing a set of seen URLs
+ */
+typedef struct seenset seenset_t;
+
+/**************** seenset_new ****************/
+/* Allocate and initialize an empty set.
+ *
+ * Caller provides:
+ *   expected  number of URLs expected (the set grows beyond it as needed; must be > 0)
+ *   bloom     false for an exact set; true for an approximate one (a Bloom filter)
+ *
+ * We return:
+ *   pointer to new seenset_t struct, or NULL if expected is not positive
+ *
+ * Caller is responsible for:
+ *   later calling seenset_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+seenset_t* seenset_new(const int expected, const bool bloom);
+
+/**************** seenset_insert ****************/
+/* Add a URL to the set.
+ *
+ * Caller provides:
+ *   set  pointer to valid seenset_t struct
+ *   url  URL string (the set keeps no reference to it)
+ *
+ * We return:
+ *   true if the URL was not in the set before (and now is), false if it was (or, for an approximate
+ *   set, may have been), or on NULL arguments
+ */
+bool seenset_insert(seenset_t* set, const char* url);
+
+/**************** seenset_contains ****************/
+/* Return true if the URL is in the set (for an approximate set, if it may be).
+ */
+bool seenset_contains(seenset_t* set, const char* url);
+
+/**************** seenset_size ****************/
+/* Return the number of URLs inserted into the set (0 if set is NULL).
+ */
+int seenset_size(seenset_t* set);
+
+/**************** seenset_save ****************/
+/* Write the set (its fingerprints, or for an approximate set its filters, since the URLs themselves
+ * are not kept) to an open file.
+ *
+ * Caller provides:
+ *   set  pointer to valid seenset_t struct
+ *   fp   file open for writing
+ *
+ * We return:
+ *   true on success, false on NULL arguments or a write error
+ */
+bool seenset_save(seenset_t* set, FILE* fp);
+
+/**************** seenset_load ****************/
+/* Allocate a set holding what seenset_save wrote.
+ *
+ * Caller provides:
+ *   fp     file open for reading, positioned where seenset_save started writing
+ *   bloom  whether the new set is to be approximate; an exact saved set can be loaded either way,
+ *          an approximate one only as approximate
+ *
+ * We return:
+ *   pointer to new seenset_t struct, or NULL on NULL fp, malformed input, or an approximate saved
+ *   set with bloom false
+ *
+ * Caller is responsible for:
+ *   later calling seenset_delete with returned pointer
+ */
+seenset_t* seenset_load(FILE* fp, const bool bloom);
+
+/**************** seenset_delete ****************/
+/* Free all memory associated with the set.
+ */
+void seenset_delete(seenset_t* set);
@@ -0,0 +1,419 @@
+/*
+ * segstore - an append-only store of records keyed by docID
+ *            See segstore.h for usage.
+ *
+ * A record in a segment is a 20-byte header (the magic 'TSEr', the docID and the length of the data,
+ * each number 8 bytes little-endian) and then the data. An entry of the table is 32 bytes: docID,
+ * segment, offset of the record's header in it, and the length of the data, each 8 bytes little-endian;
+ * a segment of all ones marks docID removed. Records are written and read with a single pwritev or
+ * preadv each, header and data together, at offsets the store keeps track of. Each segment mapped by
+ * segstore_map is mapped whole, once, as long as it was when mapped.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#define _GNU_SOURCE       // preadv, pwritev
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include "../libcs50/mem.h"
+#include "bytes.h"
+#include "segstore.h"
+
+/* location_t: where the latest record of a docID lies */
+typedef struct location {
+  int64_t segment;            // -1 if docID has no record
+  int64_t offset;             // of the record's header
+  int64_t length;             // of its data
+} location_t;
+
+/* segstore_t: structure to represent an open store
+ * The innards should not be visible to users of the segstore module.
+ */
+typedef struct segstore {
+  char* directory;
+  location_t* table;          // table[docID]
+  size_t tableSize;           // allocated size of table
+  int* fds;                   // fds[s]: segment s open for reading, or -1 if not opened yet
+  char** maps;                // maps[s]: segment s mapped, or NULL if not mapped yet
+  size_t* mapLengths;         // mapLengths[s]: bytes mapped of segment s
+  int numSegments;            // segments there are: 'pages.0' up to 'pages.<numSegments - 1>'
+  int writeFd;                // the last segment, open for writing, or -1 until the first save
+  int64_t writeEnd;           // its size
+  int indexFd;                // the table, open for appending, or -1 until the first save
+} segstore_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static void setLocation(segstore_t* store, const docid_t docID, const location_t location);
+static bool appendEntry(segstore_t* store, const docid_t docID, const location_t location);
+static bool openForWriting(segstore_t* store);
+static int segmentFd(segstore_t* store, const int segment);
+static void addSegments(segstore_t* store, const int numSegments);
+static void segmentPath(char* path, const size_t size, const char* directory, const int segment);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const char RECORD_MAGIC[4] = { 'T', 'S', 'E', 'r' };
+static const int HEADER_BYTES = 20;           // of a record
+static const int ENTRY_BYTES = 32;            // of an entry of the table
+static const size_t MIN_TABLE = 1024;         // smallest table, in docIDs
+#define PATH_EXTRA 32                         // bytes past the directory's in the path of a store file
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** segstore_open ****************/
+/* see segstore.h for documentation */
+segstore_t* segstore_open(const char* directory)
+{
+  if (directory == NULL) {
+    return NULL;
+  }
+
+  segstore_t* store = mem_assert(calloc(1, sizeof(segstore_t)), "failed allocating memory for segstore");
+  store->directory = mem_assert(malloc(strlen(directory) + 1), "failed allocating memory for segstore");
+  strcpy(store->directory, directory);
+  store->writeFd = -1;
+  store->indexFd = -1;
+
+  // The segments there are, none of them open yet
+  size_t pathLength = strlen(directory) + PATH_EXTRA;
+  char path[pathLength];
+  int numSegments = 0;
+  segmentPath(path, pathLength, directory, 0);
+  while (access(path, F_OK) == 0) {
+    segmentPath(path, pathLength, directory, ++numSegments);
+  }
+  addSegments(store, numSegments);
+
+  // The table, whose later entries override earlier ones; a torn last entry is left out
+  segmentPath(path, pathLength, directory, -1);
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL && access(path, F_OK) == 0) {
+    segstore_close(store);
+    return NULL;
+  }
+  unsigned char entry[ENTRY_BYTES];
+  while (fp != NULL && fread(entry, 1, ENTRY_BYTES, fp) == ENTRY_BYTES) {
+    docid_t docID = (docid_t) bytes_getU64(entry);
+    location_t location = { (int64_t) bytes_getU64(entry + 8), (int64_t) bytes_getU64(entry + 16), (int64_t) bytes_getU64(entry + 24) };
+    if (docID > 0 && location.segment < store->numSegments) {
+      setLocation(store, docID, location);
+    }
+  }
+  if (fp != NULL) {
+    fclose(fp);
+  }
+  return store;
+}
+
+/**************** segstore_save ****************/
+/* see segstore.h for documentation */
+bool segstore_save(segstore_t* store, const docid_t docID, const char* parts[], const size_t lengths[],
+                   const int numParts)
+{
+  if (store == NULL || docID < 1 || parts == NULL || lengths == NULL || numParts < 1 || numParts > SEGSTORE_MAX_PARTS) {
+    return false;
+  }
+  if (!openForWriting(store)) {
+    return false;
+  }
+
+  // Header and data go out together
+  size_t length = 0;
+  struct iovec iov[SEGSTORE_MAX_PARTS + 1];
+  for (int i = 0; i < numParts; i++) {
+    iov[i + 1].iov_base = (void*) parts[i];
+    iov[i + 1].iov_len = lengths[i];
+    length += lengths[i];
+  }
+  unsigned char header[HEADER_BYTES];
+  memcpy(header, RECORD_MAGIC, 4);
+  bytes_putU64(header + 4, (uint64_t) docID);
+  bytes_putU64(header + 12, (uint64_t) length);
+  iov[0].iov_base = header;
+  iov[0].iov_len = HEADER_BYTES;
+
+  location_t location = { store->numSegments - 1, store->writeEnd, (int64_t) length };
+  ssize_t written = pwritev(store->writeFd, iov, numParts + 1, store->writeEnd);
+  if (written != (ssize_t) (HEADER_BYTES + length)) {
+    return false;
+  }
+  store->writeEnd += written;
+
+  // Only then is the record found by its entry
+  if (!appendEntry(store, docID, location)) {
+    return false;
+  }
+  setLocation(store, docID, location);
+  return true;
+}
+
+/**************** segstore_read ****************/
+/* see segstore.h for documentation */
+char* segstore_read(segstore_t* store, const docid_t docID, size_t* length)
+{
+  if (!segstore_contains(store, docID)) {
+    return NULL;
+  }
+
+  location_t location = store->table[docID];
+  int fd = segmentFd(store, location.segment);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  // Header and data come in together, the header checked against the entry
+  unsigned char header[HEADER_BYTES];
+  char* data = mem_assert(malloc(location.length + 1), "failed allocating memory for record");
+  struct iovec iov[2] = { { header, HEADER_BYTES }, { data, location.length } };
+  ssize_t got = preadv(fd, iov, 2, location.offset);
+  if (got != HEADER_BYTES + location.length || memcmp(header, RECORD_MAGIC, 4) != 0
+      || bytes_getU64(header + 4) != (uint64_t) docID || bytes_getU64(header + 12) != (uint64_t) location.length) {
+    free(data);
+    return NULL;
+  }
+  data[location.length] = '\0';
+  if (length != NULL) {
+    *length = location.length;
+  }
+  return data;
+}
+
+/**************** segstore_map ****************/
+/* see segstore.h for documentation */
+const char* segstore_map(segstore_t* store, const docid_t docID, size_t* length)
+{
+  if (!segstore_contains(store, docID)) {
+    return NULL;
+  }
+
+  // The segment is mapped whole, the first time one of its records is asked for
+  location_t location = store->table[docID];
+  int s = location.segment;
+  if (store->maps[s] == NULL) {
+    int fd = segmentFd(store, s);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || status.st_size == 0) {
+      return NULL;
+    }
+    void* map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+      return NULL;
+    }
+    store->maps[s] = map;
+    store->mapLengths[s] = status.st_size;
+  }
+
+  // A record appended since is not in the mapping
+  if ((size_t) (location.offset + HEADER_BYTES + location.length) > store->mapLengths[s]) {
+    return NULL;
+  }
+  const unsigned char* header = (const unsigned char*) store->maps[s] + location.offset;
+  if (memcmp(header, RECORD_MAGIC, 4) != 0 || bytes_getU64(header + 4) != (uint64_t) docID
+      || bytes_getU64(header + 12) != (uint64_t) location.length) {
+    return NULL;
+  }
+  if (length != NULL) {
+    *length = location.length;
+  }
+  return (const char*) header + HEADER_BYTES;
+}
+
+/**************** segstore_contains ****************/
+/* see segstore.h for documentation */
+bool segstore_contains(segstore_t* store, const docid_t docID)
+{
+  return (store != NULL && docID > 0 && (size_t) docID < store->tableSize && store->table[docID].segment >= 0);
+}
+
+/**************** segstore_remove ****************/
+/* see segstore.h for documentation */
+int segstore_remove(segstore_t* store, const docid_t docID, const bool all)
+{
+  if (store == NULL || docID < 1) {
+    return 0;
+  }
+
+  int removed = 0;
+  location_t none = { -1, 0, 0 };
+  docid_t last = all ? (docid_t) store->tableSize - 1 : docID;
+  for (docid_t id = docID; id <= last; id++) {
+    if (segstore_contains(store, id)) {
+      if (!openForWriting(store) || !appendEntry(store, id, none)) {
+        return -1;
+      }
+      setLocation(store, id, none);
+      removed++;
+    }
+  }
+  return removed;
+}
+
+/**************** segstore_close ****************/
+/* see segstore.h for documentation */
+void segstore_close(segstore_t* store)
+{
+  if (store == NULL) {
+    return;
+  }
+
+  for (int s = 0; s < store->numSegments; s++) {
+    if (store->fds[s] >= 0) {
+      close(store->fds[s]);
+    }
+    if (store->maps[s] != NULL) {
+      munmap(store->maps[s], store->mapLengths[s]);
+    }
+  }
+  if (store->writeFd >= 0) {
+    close(store->writeFd);
+  }
+  if (store->indexFd >= 0) {
+    close(store->indexFd);
+  }
+  free(store->fds);
+  free(store->maps);
+  free(store->mapLengths);
+  free(store->table);
+  free(store->directory);
+  free(store);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** setLocation ****************/
+/* Record where the latest record of docID lies, growing the table if it does not reach docID.
+ */
+static void setLocation(segstore_t* store, const docid_t docID, const location_t location)
+{
+  if ((size_t) docID >= store->tableSize) {
+    size_t size = (store->tableSize == 0) ? MIN_TABLE : store->tableSize;
+    while (size <= (size_t) docID) {
+      size *= 2;
+    }
+    store->table = mem_assert(realloc(store->table, size * sizeof(location_t)), "failed allocating memory for segstore table");
+    for (size_t i = store->tableSize; i < size; i++) {
+      store->table[i].segment = -1;
+    }
+    store->tableSize = size;
+  }
+  store->table[docID] = location;
+}
+
+/**************** appendEntry ****************/
+/* Append an entry to the table file with a single write; return false if it could not be written.
+ */
+static bool appendEntry(segstore_t* store, const docid_t docID, const location_t location)
+{
+  unsigned char entry[ENTRY_BYTES];
+  bytes_putU64(entry, (uint64_t) docID);
+  bytes_putU64(entry + 8, (uint64_t) location.segment);
+  bytes_putU64(entry + 16, (uint64_t) location.offset);
+  bytes_putU64(entry + 24, (uint64_t) location.length);
+  return (write(store->indexFd, entry, ENTRY_BYTES) == ENTRY_BYTES);
+}
+
+/**************** openForWriting ****************/
+/* Make sure the table file is open for appending, and the last segment for writing; begin a new segment
+ * if there is none yet, or if the last holds SEGSTORE_SEGMENT_BYTES already. Return false on any error.
+ */
+static bool openForWriting(segstore_t* store)
+{
+  size_t pathLength = strlen(store->directory) + PATH_EXTRA;
+  char path[pathLength];
+  if (store->indexFd < 0) {
+    // A torn last entry goes, so that the entries appended after it are whole
+    segmentPath(path, pathLength, store->directory, -1);
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0
+        || (status.st_size % ENTRY_BYTES != 0 && ftruncate(fd, status.st_size - status.st_size % ENTRY_BYTES) != 0)) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      return false;
+    }
+    store->indexFd = fd;
+  }
+
+  if (store->writeFd < 0 && store->numSegments > 0) {
+    segmentPath(path, pathLength, store->directory, store->numSegments - 1);
+    struct stat status;
+    if ((store->writeFd = open(path, O_WRONLY)) < 0 || fstat(store->writeFd, &status) != 0) {
+      return false;
+    }
+    store->writeEnd = status.st_size;
+  }
+  if (store->writeFd >= 0 && store->writeEnd < SEGSTORE_SEGMENT_BYTES) {
+    return true;
+  }
+
+  // A new segment
+  if (store->writeFd >= 0) {
+    close(store->writeFd);
+  }
+  segmentPath(path, pathLength, store->directory, store->numSegments);
+  if ((store->writeFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+    return false;
+  }
+  addSegments(store, 1);
+  store->writeEnd = 0;
+  return true;
+}
+
+/**************** segmentFd ****************/
+/* Return a descriptor of segment open for reading, opening it the first time; or -1 if it cannot be opened.
+ */
+static int segmentFd(segstore_t* store, const int segment)
+{
+  if (store->fds[segment] < 0) {
+    size_t pathLength = strlen(store->directory) + PATH_EXTRA;
+    char path[pathLength];
+    segmentPath(path, pathLength, store->directory, segment);
+    store->fds[segment] = open(path, O_RDONLY);
+  }
+  return store->fds[segment];
+}
+
+/**************** addSegments ****************/
+/* Count numSegments more segments in the store, neither open nor mapped yet.
+ */
+static void addSegments(segstore_t* store, const int numSegments)
+{
+  int total = store->numSegments + numSegments;
+  store->fds = mem_assert(realloc(store->fds, (total + 1) * sizeof(int)), "failed allocating memory for segstore");
+  store->maps = mem_assert(realloc(store->maps, (total + 1) * sizeof(char*)), "failed allocating memory for segstore");
+  store->mapLengths = mem_assert(realloc(store->mapLengths, (total + 1) * sizeof(size_t)),
+                                 "failed allocating memory for segstore");
+  for (int s = store->numSegments; s < total; s++) {
+    store->fds[s] = -1;
+    store->maps[s] = NULL;
+    store->mapLengths[s] = 0;
+  }
+  store->numSegments = total;
+}
+
+/**************** segmentPath ****************/
+/* Write into path (of size bytes, at least strlen(directory) + PATH_EXTRA) the path of segment in
+ * directory, or that of the table if segment is -1.
+ */
+static void segmentPath(char* path, const size_t size, const char* directory, const int segment)
+{
+  if (segment < 0) {
+    snprintf(path, size, "%s/pages.idx", directory);
+  } else {
+    snprintf(path, size, "%s/pages.%d", directory, segment);
+  }
+}
@@ -0,0 +1,114 @@
+/*
+ * segstore - an append-only store of records keyed by docID, kept in a few large segment files
+ *
+ * Each record (a page file's worth of bytes, for pagedir) is appended to the current segment file,
+ * 'pages.N' in the store's directory, prefixed by its docID and length; a new segment is begun once
+ * the current one holds SEGSTORE_SEGMENT_BYTES or more. Where each docID's latest record lies is
+ * appended to 'pages.idx', a table of fixed-width entries (docID, segment, offset, length), which is
+ * read whole when the store is opened; so reading a record takes a single read of the segment file,
+ * which stays open, and saving one takes two appends, with no file created per record.
+ *
+ * A record is saved whole or not at all: its entry is appended only once the record itself has been
+ * written, and a torn entry at the end of the table (from a crash) is ignored, and cut off before the
+ * next entry is appended; a record written without its entry is dead space. Records saved again, or
+ * removed, leave their old bytes as dead space too.
+ *
+ * The store does no locking; callers that share one between threads must serialize access.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "docid.h"
+
+/***********************************************************************/
+/* segstore_t: opaque struct representing an open store
+ */
+typedef struct segstore segstore_t;
+
+/* Size past which a segment is not appended to (256 MiB) */
+#define SEGSTORE_SEGMENT_BYTES (256L << 20)
+
+/* Most pieces a record may be saved in */
+#define SEGSTORE_MAX_PARTS 4
+
+/**************** segstore_open ****************/
+/* Open the store in directory, reading its table ('pages.idx', if there is one yet).
+ *
+ * We return:
+ *   pointer to new segstore_t struct, or NULL on a NULL directory, or if the table is not readable
+ *
+ * Caller is responsible for:
+ *   later calling segstore_close with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ *
+ * Limitations:
+ *   the table in memory is an array indexed by docID, of 24 bytes per docID up to the largest saved, as
+ *   docIDs are meant to be dense (1, 2, 3...)
+ */
+segstore_t* segstore_open(const char* directory);
+
+/**************** segstore_save ****************/
+/* Append a record for docID, which replaces any record it had before.
+ *
+ * Caller provides:
+ *   store     pointer to valid segstore_t struct
+ *   docID     ID of the record (must be > 0)
+ *   parts     the record's bytes, in numParts pieces (1 to SEGSTORE_MAX_PARTS), written one after the
+ *             other, so that the caller need not copy them into one buffer first
+ *   lengths   the number of bytes in each piece
+ *
+ * We return:
+ *   true if saved; false on invalid arguments, or if a segment or the table could not be written
+ */
+bool segstore_save(segstore_t* store, const docid_t docID, const char* parts[], const size_t lengths[],
+                   const int numParts);
+
+/**************** segstore_read ****************/
+/* Read the record of docID.
+ *
+ * We return:
+ *   the record's bytes, NUL-terminated (setting *length to their number, if length is not NULL), which
+ *   the caller must later free; or NULL if there is no record for docID, it cannot be read, or it is
+ *   not the record the table says (a corrupt segment)
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+char* segstore_read(segstore_t* store, const docid_t docID, size_t* length);
+
+/**************** segstore_map ****************/
+/* Find the record of docID in a read-only memory mapping of its segment, without copying it.
+ *
+ * We return:
+ *   a pointer to the record's bytes, which are NOT null-terminated (setting *length to their number, if
+ *   length is not NULL), and stay valid until segstore_close; or NULL if there is no record for docID,
+ *   its segment cannot be mapped, the record was saved after its segment was mapped, or it is not the
+ *   record the table says; segstore_read may still read it in the first cases
+ *
+ * Limitations:
+ *   each segment is mapped whole, once; a segment being appended to is better read with segstore_read
+ */
+const char* segstore_map(segstore_t* store, const docid_t docID, size_t* length);
+
+/**************** segstore_contains ****************/
+/* Return true if there is a record for docID (without reading it), false otherwise.
+ */
+bool segstore_contains(segstore_t* store, const docid_t docID);
+
+/**************** segstore_remove ****************/
+/* Remove the records of docID and all greater docIDs (or only that of docID, if all is false), by
+ * appending entries that mark them removed to the table.
+ *
+ * We return:
+ *   the number of records removed, or -1 if the table could not be written
+ */
+int segstore_remove(segstore_t* store, const docid_t docID, const bool all);
+
+/**************** segstore_close ****************/
+/* Close the files of the store and free all memory associated with it.
+ */
+void segstore_close(segstore_t* store);
@@ -0,0 +1,302 @@
+/*
+ * simhash - SimHash fingerprints of webpages, and an index of them for finding near-duplicates
+ *           See simhash.h for usage.
+ *
+ * Each word is hashed with FNV-1a, and each shingle's hash combines the hashes of its words, in order,
+ * then goes through a final mix (from MurmurHash3) so that its bits are independent of one another
+ * (both from hash64, in libcs50).
+ *
+ * The index splits the 64 bits of a fingerprint into numBlocks blocks of (nearly) equal width, more than
+ * maxDistance of them. Two fingerprints within maxDistance of each other differ in at most that many
+ * blocks, so they agree in all of at least numBlocks - maxDistance of them: for each way of choosing
+ * that many blocks there is a table, keyed on the bits of the blocks chosen, of the fingerprints whose
+ * key falls in each slot (chained through the entries, newest first), and a lookup compares only against
+ * the fingerprints in the chains of the one it is given, one per table. numBlocks is the fewest for which
+ * every key has at least SLOT_BITS bits, so that fingerprints agreeing in a key only by chance are few:
+ * with a maxDistance up to 3 that is one block per key, maxDistance + 1 tables, but beyond that keys
+ * take two or three narrower blocks, and there are many more tables (the permuted tables of Manku et
+ * al., "Detecting Near-Duplicates for Web Crawling"). Keys are hashed to a slot, so a chain may hold
+ * other keys too.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../libcs50/mem.h"
+#include "../libcs50/hash64.h"
+#include "word.h"
+#include "simhash.h"
+
+/* entry_t: one fingerprint in the index
+ */
+typedef struct entry {
+  uint64_t fingerprint;
+  docid_t docID;
+} entry_t;
+
+/* simhash_t: structure to represent an index of fingerprints
+ * The innards should not be visible to users of the simhash module.
+ */
+typedef struct simhash {
+  int maxDistance;
+  int numTables;
+  uint64_t* keys;               // keys[t]: mask of the bits table t is keyed on
+  entry_t* entries;             // in insertion order
+  int* next;                    // next[e * numTables + t]: next entry in entry e's slot of table t, or -1
+  int numEntries;
+  int maxEntries;               // allocated size of entries
+  int* heads;                   // heads[(t << SLOT_BITS) + slot]: newest entry whose key falls in slot, or -1
+} simhash_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static void addShingle(int weights[64], const uint64_t hash);
+static int chooseBlocks(const int maxDistance);
+static uint64_t blockMask(const int numBlocks, const int b);
+static int slotOf(const simhash_t* index, const uint64_t fingerprint, const int t);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const uint64_t SHINGLE_MULTIPLIER = 0x9e3779b97f4a7c15ULL; // combines word hashes, in order
+static const int SLOT_BITS = 16;              // a table has 2^SLOT_BITS slots
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** simhash_fingerprint ****************/
+/* see simhash.h for documentation */
+bool simhash_fingerprint(webpage_t* page, uint64_t* fingerprint)
+{
+  if (page == NULL || fingerprint == NULL) {
+    return false;
+  }
+
+  // Slide a window of SIMHASH_SHINGLE word hashes over the page, adding each full window as a shingle
+  int weights[64] = { 0 };
+  uint64_t window[SIMHASH_SHINGLE];
+  int numWords = 0;
+  int pos = 0;
+  char* word;
+  while ((word = webpage_getNextWord(page, &pos)) != NULL) {
+    if (strlen(word) >= 3) {
+      word_normalizeWord(word);
+      window[numWords++ % SIMHASH_SHINGLE] = hash64_fnv1a(word);
+      if (numWords >= SIMHASH_SHINGLE) {
+        uint64_t hash = 0;
+        for (int i = numWords - SIMHASH_SHINGLE; i < numWords; i++) {
+          hash = hash * SHINGLE_MULTIPLIER + window[i % SIMHASH_SHINGLE];
+        }
+        addShingle(weights, hash);
+      }
+    }
+    free(word);
+  }
+
+  // A page too short for a full shingle has all its words as one
+  if (numWords == 0) {
+    return false;
+  }
+  if (numWords < SIMHASH_SHINGLE) {
+    uint64_t hash = 0;
+    for (int i = 0; i < numWords; i++) {
+      hash = hash * SHINGLE_MULTIPLIER + window[i];
+    }
+    addShingle(weights, hash);
+  }
+
+  *fingerprint = 0;
+  for (int bit = 0; bit < 64; bit++) {
+    if (weights[bit] > 0) {
+      *fingerprint |= (uint64_t) 1 << bit;
+    }
+  }
+  return true;
+}
+
+/**************** simhash_distance ****************/
+/* see simhash.h for documentation */
+int simhash_distance(const uint64_t a, const uint64_t b)
+{
+  return __builtin_popcountll(a ^ b);
+}
+
+/**************** simhash_new ****************/
+/* see simhash.h for documentation */
+simhash_t* simhash_new(const int maxDistance)
+{
+  if (maxDistance < 0 || maxDistance > SIMHASH_MAX_DISTANCE) {
+    return NULL;
+  }
+
+  simhash_t* index = mem_assert(malloc(sizeof(simhash_t)), "failed allocating memory for simhash");
+  index->maxDistance = maxDistance;
+  index->entries = NULL;
+  index->next = NULL;
+  index->numEntries = 0;
+  index->maxEntries = 0;
+
+  // One table for each choice of numBlocks - maxDistance blocks, in lexicographic order
+  int numBlocks = chooseBlocks(maxDistance);
+  int perKey = numBlocks - maxDistance;
+  int chosen[SIMHASH_MAX_DISTANCE + 1];
+  for (int i = 0; i < perKey; i++) {
+    chosen[i] = i;
+  }
+  index->numTables = 0;
+  index->keys = NULL;
+  for (;;) {
+    index->keys = mem_assert(realloc(index->keys, (index->numTables + 1) * sizeof(uint64_t)),
+                             "failed allocating memory for simhash keys");
+    uint64_t key = 0;
+    for (int i = 0; i < perKey; i++) {
+      key |= blockMask(numBlocks, chosen[i]);
+    }
+    index->keys[index->numTables++] = key;
+
+    // Next choice: bump the last block that can still move right, and put those after it just beyond
+    int i = perKey - 1;
+    while (i >= 0 && chosen[i] == numBlocks - perKey + i) {
+      i--;
+    }
+    if (i < 0) {
+      break;
+    }
+    chosen[i]++;
+    for (int j = i + 1; j < perKey; j++) {
+      chosen[j] = chosen[j - 1] + 1;
+    }
+  }
+
+  size_t tableBytes = (size_t) index->numTables * sizeof(int) << SLOT_BITS;
+  index->heads = mem_assert(malloc(tableBytes), "failed allocating memory for simhash tables");
+  memset(index->heads, 0xff, tableBytes); // all -1
+  return index;
+}
+
+/**************** simhash_insert ****************/
+/* see simhash.h for documentation */
+bool simhash_insert(simhash_t* index, const uint64_t fingerprint, const docid_t docID)
+{
+  if (index == NULL || docID <= 0) {
+    return false;
+  }
+
+  if (index->numEntries == index->maxEntries) {
+    index->maxEntries = (index->maxEntries == 0) ? 64 : 2 * index->maxEntries;
+    index->entries = mem_assert(realloc(index->entries, index->maxEntries * sizeof(entry_t)),
+                                "failed allocating memory for simhash entries");
+    index->next = mem_assert(realloc(index->next, (size_t) index->maxEntries * index->numTables * sizeof(int)),
+                             "failed allocating memory for simhash chains");
+  }
+
+  int e = index->numEntries++;
+  entry_t* entry = &index->entries[e];
+  entry->fingerprint = fingerprint;
+  entry->docID = docID;
+  for (int t = 0; t < index->numTables; t++) {
+    int* head = &index->heads[(t << SLOT_BITS) + slotOf(index, fingerprint, t)];
+    index->next[e * index->numTables + t] = *head;
+    *head = e;
+  }
+  return true;
+}
+
+/**************** simhash_find ****************/
+/* see simhash.h for documentation */
+docid_t simhash_find(simhash_t* index, const uint64_t fingerprint)
+{
+  if (index == NULL) {
+    return 0;
+  }
+
+  // An entry agreeing in several keys is met several times; that does no harm
+  int best = -1;
+  int bestDistance = index->maxDistance + 1;
+  for (int t = 0; t < index->numTables; t++) {
+    int e = index->heads[(t << SLOT_BITS) + slotOf(index, fingerprint, t)];
+    for (; e >= 0; e = index->next[e * index->numTables + t]) {
+      int distance = simhash_distance(fingerprint, index->entries[e].fingerprint);
+      if (distance < bestDistance || (distance == bestDistance && e < best)) {
+        best = e;
+        bestDistance = distance;
+      }
+    }
+  }
+  return (best < 0) ? 0 : index->entries[best].docID;
+}
+
+/**************** simhash_size ****************/
+/* see simhash.h for documentation */
+int simhash_size(simhash_t* index)
+{
+  return (index == NULL) ? 0 : index->numEntries;
+}
+
+/**************** simhash_delete ****************/
+/* see simhash.h for documentation */
+void simhash_delete(simhash_t* index)
+{
+  if (index == NULL) {
+    return;
+  }
+
+  free(index->heads);
+  free(index->keys);
+  free(index->next);
+  free(index->entries);
+  free(index);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** addShingle ****************/
+/* Add a shingle's hash to the weights: +1 to weights[i] if bit i of its mixed hash is set, -1 if not.
+ */
+static void addShingle(int weights[64], const uint64_t hash)
+{
+  uint64_t bits = hash64_mix(hash);
+  for (int bit = 0; bit < 64; bit++) {
+    weights[bit] += ((bits >> bit) & 1) ? 1 : -1;
+  }
+}
+
+/**************** chooseBlocks ****************/
+/* Return the fewest blocks, more than maxDistance, into which to split the 64 bits so that any
+ * numBlocks - maxDistance of them together are at least SLOT_BITS wide.
+ */
+static int chooseBlocks(const int maxDistance)
+{
+  int numBlocks = maxDistance + 1;
+  while ((numBlocks - maxDistance) * (64 / numBlocks) < SLOT_BITS) {
+    numBlocks++;
+  }
+  return numBlocks;
+}
+
+/**************** blockMask ****************/
+/* Return the mask of block b's bits (b in range [0..numBlocks)). The blocks split the 64 bits as
+ * evenly as they can, the first 64 % numBlocks of them one bit wider than the rest.
+ */
+static uint64_t blockMask(const int numBlocks, const int b)
+{
+  int narrow = 64 / numBlocks;
+  int wide = 64 % numBlocks;
+  int width = (b < wide) ? narrow + 1 : narrow;
+  int start = b * narrow + ((b < wide) ? b : wide);
+
+  uint64_t mask = (width < 64) ? ((uint64_t) 1 << width) - 1 : ~(uint64_t) 0;
+  return mask << start;
+}
+
+/**************** slotOf ****************/
+/* Return the slot of table t (t in range [0..numTables)) for a fingerprint: its key bits, hashed.
+ */
+static int slotOf(const simhash_t* index, const uint64_t fingerprint, const int t)
+{
+  uint64_t value = hash64_mix(fingerprint & index->keys[t]);
+  return (int) (value & (((uint64_t) 1 << SLOT_BITS) - 1));
+}
@@ -0,0 +1,112 @@
+/*
+ * simhash - SimHash fingerprints of webpages, and an index of them for finding near-duplicates
+ *
+ * A page's fingerprint is a 64-bit SimHash of its word shingles (each run of SIMHASH_SHINGLE
+ * consecutive words): every shingle is hashed, and bit i of the fingerprint is set if more of the
+ * shingle hashes have bit i set than not. Pages that share most of their shingles thus get
+ * fingerprints that differ in few bits, and the number of differing bits (the Hamming distance)
+ * measures how different the pages are. For pages of a few hundred words or more, a distance of 3 or
+ * less marks near-duplicates; shorter pages, having fewer shingles, need a larger one (a one-word edit
+ * to a page of fifty words moves its fingerprint by about 7).
+ *
+ * The index keeps fingerprints so as to find one within a given Hamming distance of another without
+ * comparing against all of them (see simhash_find).
+ *
+ * The index does no locking; callers that share one between threads must serialize access.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "docid.h"
+#include "../libcs50/webpage.h"
+
+/***********************************************************************/
+/* simhash_t: opaque struct representing an index of fingerprints
+ */
+typedef struct simhash simhash_t;
+
+/* Largest Hamming distance the index can search within */
+#define SIMHASH_MAX_DISTANCE 7
+
+/* Words per shingle */
+#define SIMHASH_SHINGLE 3
+
+/**************** simhash_fingerprint ****************/
+/* Compute the fingerprint of a webpage's text.
+ *
+ * Caller provides:
+ *   page         pointer to webpage_t struct with HTML
+ *   fingerprint  where to store the fingerprint
+ *
+ * We return:
+ *   true if the fingerprint was computed; false on NULL arguments, or if the page has no words
+ *   (a page with fewer than SIMHASH_SHINGLE words has all of them as its one shingle)
+ *
+ * Notes:
+ *   words are read with webpage_getNextWord; words shorter than 3 letters are skipped and case is
+ *   ignored, as the indexer does
+ */
+bool simhash_fingerprint(webpage_t* page, uint64_t* fingerprint);
+
+/**************** simhash_distance ****************/
+/* Return the Hamming distance between two fingerprints: the number of bits in which they differ.
+ */
+int simhash_distance(const uint64_t a, const uint64_t b);
+
+/**************** simhash_new ****************/
+/* Allocate and initialize an empty index.
+ *
+ * Caller provides:
+ *   maxDistance  the Hamming distance within which simhash_find looks, in range [0..SIMHASH_MAX_DISTANCE]
+ *
+ * We return:
+ *   pointer to new simhash_t struct, or NULL if maxDistance is out of range
+ *
+ * Caller is responsible for:
+ *   later calling simhash_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+simhash_t* simhash_new(const int maxDistance);
+
+/**************** simhash_insert ****************/
+/* Add a fingerprint to the index, with the docID of its page.
+ *
+ * Caller provides:
+ *   index        pointer to valid simhash_t struct
+ *   fingerprint  as computed by simhash_fingerprint
+ *   docID        docID of the page (must be > 0)
+ *
+ * We return:
+ *   true if added, false on a NULL index or invalid docID
+ */
+bool simhash_insert(simhash_t* index, const uint64_t fingerprint, const docid_t docID);
+
+/**************** simhash_find ****************/
+/* Look for a fingerprint within the index's maxDistance of the one given.
+ *
+ * We return:
+ *   the docID of the nearest such fingerprint (of the first inserted, among equally near ones),
+ *   or 0 if there is none (or index is NULL)
+ *
+ * Limitations:
+ *   compares against only the fingerprints that agree with the one given in every bit of at least one
+ *   of several keys of 16 or more bits, as any fingerprint within maxDistance must, so that a lookup
+ *   among n fingerprints compares against about n / 65536 of them per key; but the keys needed grow
+ *   quickly with maxDistance: up to 3 it takes maxDistance + 1 of them, at 4, 5 and 6 it takes 15, 21
+ *   and 28, and at 7 it takes 120, with a table of 256 KiB each (and 4 bytes per fingerprint each)
+ */
+docid_t simhash_find(simhash_t* index, const uint64_t fingerprint);
+
+/**************** simhash_size ****************/
+/* Return the number of fingerprints in the index (0 if index is NULL).
+ */
+int simhash_size(simhash_t* index);
+
+/**************** simhash_delete ****************/
+/* Free all memory associated with the index.
+ */
+void simhash_delete(simhash_t* index);
@@ -0,0 +1,480 @@
+/*
+ * urlrules - rules that canonicalize the query of a URL, and heuristics that detect crawl traps
+ *            See urlrules.h for usage.
+ *
+ * A query is rewritten in place: its parameters are copied down over those stripped, then sorted by
+ * swapping neighbors, each swap of 'A&B' into 'B&A' done by reversing the pair and then each of its
+ * parts, so that nothing needs to be allocated. The trap heuristics read the URL where it is, but for
+ * the count of URLs per pattern, which keeps a hashtable from each pattern to its count; the hashtable
+ * is written out whole by urlrules_save, one count and pattern per line.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "../libcs50/mem.h"
+#include "../libcs50/file.h"
+#include "../libcs50/hashtable.h"
+#include "urlrules.h"
+
+/* urlrules_t: structure to represent a set of rules
+ * The innards should not be visible to users of the urlrules module.
+ */
+typedef struct urlrules {
+  char** strip;                 // parameter names to strip, each maybe ending in '*'
+  int numStrip;
+  int maxStrip;                 // allocated size of strip
+  bool sort;                    // whether to sort the parameters left
+  int maxRepeats;               // most times a path component may appear, or 0 for no limit
+  int calendarYears;            // most years a date may be from thisYear, or 0 for no limit
+  int maxPerPattern;            // most URLs counted per pattern, or 0 for no limit
+  int thisYear;                 // the current year, when the rules were made
+  hashtable_t* patterns;        // pattern -> int* number of URLs counted
+  int numPatterns;              // patterns in it
+} urlrules_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static bool isStripped(const urlrules_t* rules, const char* param, const size_t nameLength);
+static void sortParams(char* query);
+static int compareParams(const char* a, const size_t lengthA, const char* b, const size_t lengthB);
+static void reverse(char* s, const size_t length);
+static const char* pathOf(const char* url);
+static bool repeatsTooOften(const char* path, const int maxRepeats);
+static bool isDate(const char* url, const char* digits);
+static int* patternCount(urlrules_t* rules, const char* pattern);
+static void savePattern(void* arg, const char* pattern, void* item);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const char* DEFAULT_STRIP[] = { "utm_*", "fbclid", "gclid", "sessionid", "jsessionid", "phpsessid" };
+static const int PATTERN_SLOTS = 1009;        // hashtable slots for patterns
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** urlrules_new ****************/
+/* see urlrules.h for documentation */
+urlrules_t* urlrules_new(void)
+{
+  urlrules_t* rules = mem_assert(malloc(sizeof(urlrules_t)), "failed allocating memory for urlrules");
+  rules->strip = NULL;
+  rules->numStrip = 0;
+  rules->maxStrip = 0;
+  rules->sort = true;
+  rules->maxRepeats = 0;
+  rules->calendarYears = 0;
+  rules->maxPerPattern = 0;
+  time_t now = time(NULL);
+  rules->thisYear = gmtime(&now)->tm_year + 1900;
+  rules->patterns = mem_assert(hashtable_new(PATTERN_SLOTS), "failed allocating memory for urlrules patterns");
+  rules->numPatterns = 0;
+
+  for (int i = 0; i < (int) (sizeof(DEFAULT_STRIP) / sizeof(DEFAULT_STRIP[0])); i++) {
+    urlrules_strip(rules, DEFAULT_STRIP[i]);
+  }
+  return rules;
+}
+
+/**************** urlrules_strip ****************/
+/* see urlrules.h for documentation */
+bool urlrules_strip(urlrules_t* rules, const char* name)
+{
+  if (rules == NULL || name == NULL || *name == '\0') {
+    return false;
+  }
+
+  if (rules->numStrip == rules->maxStrip) {
+    rules->maxStrip = (rules->maxStrip == 0) ? 8 : 2 * rules->maxStrip;
+    rules->strip = mem_assert(realloc(rules->strip, rules->maxStrip * sizeof(char*)),
+                              "failed allocating memory for urlrules names");
+  }
+  char* copy = mem_assert(malloc(strlen(name) + 1), "failed allocating memory for urlrules name");
+  strcpy(copy, name);
+  rules->strip[rules->numStrip++] = copy;
+  return true;
+}
+
+/**************** urlrules_setSort ****************/
+/* see urlrules.h for documentation */
+void urlrules_setSort(urlrules_t* rules, const bool sort)
+{
+  if (rules != NULL) {
+    rules->sort = sort;
+  }
+}
+
+/**************** urlrules_setLimits ****************/
+/* see urlrules.h for documentation */
+void urlrules_setLimits(urlrules_t* rules, const int maxRepeats, const int calendarYears, const int maxPerPattern)
+{
+  if (rules == NULL) {
+    return;
+  }
+  if (maxRepeats >= 0) {
+    rules->maxRepeats = maxRepeats;
+  }
+  if (calendarYears >= 0) {
+    rules->calendarYears = calendarYears;
+  }
+  if (maxPerPattern >= 0) {
+    rules->maxPerPattern = maxPerPattern;
+  }
+}
+
+/**************** urlrules_canonicalize ****************/
+/* see urlrules.h for documentation */
+size_t urlrules_canonicalize(const urlrules_t* rules, char* url)
+{
+  if (rules == NULL || url == NULL) {
+    return 0;
+  }
+  char* query = strchr(url, '?');
+  if (query == NULL) {
+    return strlen(url);
+  }
+
+  // Copy the parameters kept down over those dropped; out never passes in, so they do not overlap badly
+  char* start = query + 1;
+  char* out = start;
+  for (char* in = start; *in != '\0'; ) {
+    size_t length = strcspn(in, "&");
+    size_t nameLength = strcspn(in, "=&");
+    if (length > 0 && !isStripped(rules, in, nameLength)) {
+      if (out != start) {
+        *out++ = '&';
+      }
+      memmove(out, in, length);
+      out += length;
+    }
+    in += length;
+    if (*in == '&') {
+      in++;
+    }
+  }
+  *out = '\0';
+
+  if (out == start) {
+    *query = '\0';
+    return query - url;
+  }
+  if (rules->sort) {
+    sortParams(start);
+  }
+  return out - url;
+}
+
+/**************** urlrules_isTrap ****************/
+/* see urlrules.h for documentation */
+urlrules_trap_t urlrules_isTrap(const urlrules_t* rules, const char* url)
+{
+  if (rules == NULL || url == NULL) {
+    return URLRULES_NO_TRAP;
+  }
+  const char* path = pathOf(url);
+
+  if (rules->maxRepeats > 0 && repeatsTooOften(path, rules->maxRepeats)) {
+    return URLRULES_REPEATS;
+  }
+
+  // Look at each run of exactly four digits that could be a year of a date
+  if (rules->calendarYears > 0) {
+    for (const char* c = path; *c != '\0'; ) {
+      size_t digits = strspn(c, "0123456789");
+      if (digits == 0) {
+        c++;
+        continue;
+      }
+      if (digits == 4 && isDate(url, c)) {
+        int year = strtol(c, NULL, 10);
+        if (abs(year - rules->thisYear) > rules->calendarYears) {
+          return URLRULES_CALENDAR;
+        }
+      }
+      c += digits;
+    }
+  }
+  return URLRULES_NO_TRAP;
+}
+
+/**************** urlrules_count ****************/
+/* see urlrules.h for documentation */
+bool urlrules_count(urlrules_t* rules, const char* url)
+{
+  if (rules == NULL || url == NULL) {
+    return false;
+  }
+  if (rules->maxPerPattern == 0) {
+    return true;
+  }
+
+  // The pattern: each run of digits becomes '#', and each query value is left out
+  char* pattern = mem_assert(malloc(strlen(url) + 1), "failed allocating memory for urlrules pattern");
+  char* out = pattern;
+  bool inQuery = false;
+  for (const char* c = url; *c != '\0'; ) {
+    if (isdigit((unsigned char) *c)) {
+      *out++ = '#';
+      c += strspn(c, "0123456789");
+    } else if (inQuery && *c == '=') {
+      *out++ = '=';
+      c += strcspn(c, "&");
+    } else {
+      inQuery = inQuery || (*c == '?');
+      *out++ = *c++;
+    }
+  }
+  *out = '\0';
+
+  int* count = patternCount(rules, pattern);
+  bool counted = (*count < rules->maxPerPattern);
+  if (counted) {
+    (*count)++;
+  }
+  free(pattern);
+  return counted;
+}
+
+/**************** urlrules_save ****************/
+/* see urlrules.h for documentation */
+bool urlrules_save(urlrules_t* rules, FILE* fp)
+{
+  if (rules == NULL || fp == NULL) {
+    return false;
+  }
+
+  fprintf(fp, "%d\n", rules->numPatterns);
+  hashtable_iterate(rules->patterns, fp, savePattern);
+  return ferror(fp) == 0;
+}
+
+/**************** urlrules_load ****************/
+/* see urlrules.h for documentation */
+bool urlrules_load(urlrules_t* rules, FILE* fp)
+{
+  int numPatterns;
+  if (rules == NULL || fp == NULL || fscanf(fp, "%d ", &numPatterns) != 1 || numPatterns < 0) {
+    return false;
+  }
+
+  for (int i = 0; i < numPatterns; i++) {
+    int count;
+    if (fscanf(fp, "%d ", &count) != 1 || count < 0) {
+      return false;
+    }
+    char* pattern = file_readLine(fp);
+    if (pattern == NULL) {
+      return false;
+    }
+    *patternCount(rules, pattern) = count;
+    free(pattern);
+  }
+  return true;
+}
+
+/**************** urlrules_delete ****************/
+/* see urlrules.h for documentation */
+void urlrules_delete(urlrules_t* rules)
+{
+  if (rules == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < rules->numStrip; i++) {
+    free(rules->strip[i]);
+  }
+  free(rules->strip);
+  hashtable_delete(rules->patterns, free);
+  free(rules);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** isStripped ****************/
+/* Return true if the parameter beginning at param, whose name is nameLength bytes long, is one the rules
+ * strip: its name matches one of theirs, ignoring case, or begins with one ending in '*'.
+ */
+static bool isStripped(const urlrules_t* rules, const char* param, const size_t nameLength)
+{
+  for (int i = 0; i < rules->numStrip; i++) {
+    const char* name = rules->strip[i];
+    size_t length = strlen(name);
+    bool prefix = (name[length - 1] == '*');
+    if (prefix) {
+      length--;
+    }
+    if (length > nameLength || (!prefix && length != nameLength)) {
+      continue;
+    }
+    size_t k = 0;
+    while (k < length && tolower((unsigned char) param[k]) == tolower((unsigned char) name[k])) {
+      k++;
+    }
+    if (k == length) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************** sortParams ****************/
+/* Sort the '&'-separated parameters of a query in place, bytewise (a parameter that is a prefix of
+ * another comes first).
+ */
+static void sortParams(char* query)
+{
+  bool swapped = true;
+  while (swapped) {
+    swapped = false;
+    char* a = query;
+    size_t lengthA = strcspn(a, "&");
+    while (a[lengthA] != '\0') {
+      char* b = a + lengthA + 1;
+      size_t lengthB = strcspn(b, "&");
+      if (compareParams(a, lengthA, b, lengthB) > 0) {
+        // 'A&B' -> 'B&A', after which A, moved up, is compared with what follows it
+        reverse(a, lengthA + 1 + lengthB);
+        reverse(a, lengthB);
+        reverse(a + lengthB + 1, lengthA);
+        a += lengthB + 1;
+        swapped = true;
+      } else {
+        a = b;
+        lengthA = lengthB;
+      }
+    }
+  }
+}
+
+/**************** compareParams ****************/
+/* Compare two parameters of the given lengths bytewise, as strcmp does.
+ */
+static int compareParams(const char* a, const size_t lengthA, const char* b, const size_t lengthB)
+{
+  int order = memcmp(a, b, (lengthA < lengthB) ? lengthA : lengthB);
+  if (order != 0) {
+    return order;
+  }
+  return (lengthA > lengthB) - (lengthA < lengthB);
+}
+
+/**************** reverse ****************/
+/* Reverse the first length bytes of s in place.
+ */
+static void reverse(char* s, const size_t length)
+{
+  for (size_t i = 0, j = length; i + 1 < j; i++, j--) {
+    char c = s[i];
+    s[i] = s[j - 1];
+    s[j - 1] = c;
+  }
+}
+
+/**************** pathOf ****************/
+/* Return where the path of a URL begins: at the first '/' after its 'scheme://host', or at its end if
+ * it has none.
+ */
+static const char* pathOf(const char* url)
+{
+  const char* host = strstr(url, "://");
+  host = (host == NULL) ? url : host + 3;
+  return host + strcspn(host, "/?");
+}
+
+/**************** repeatsTooOften ****************/
+/* Return true if some (non-empty) component of the path, which ends at '?' or at its end, appears in it
+ * more than maxRepeats times.
+ */
+static bool repeatsTooOften(const char* path, const int maxRepeats)
+{
+  const char* end = path + strcspn(path, "?");
+  for (const char* s = path; s < end; ) {
+    s += strspn(s, "/");
+    size_t length = strcspn(s, "/?");
+    if (length == 0) {
+      break;
+    }
+
+    // Count the same component from here on
+    int count = 0;
+    for (const char* t = s; t < end; ) {
+      t += strspn(t, "/");
+      size_t other = strcspn(t, "/?");
+      if (other == 0) {
+        break;
+      }
+      if (other == length && memcmp(s, t, length) == 0 && ++count > maxRepeats) {
+        return true;
+      }
+      t += other;
+    }
+    s += length;
+  }
+  return false;
+}
+
+/**************** isDate ****************/
+/* Return true if the four digits at digits, within url, look like the year of a date: a year from 1900
+ * to 2199 followed by a month ('2031/05', '2031-5', ...), or the value of a query parameter whose name
+ * has 'year' in it ('year=2031', 'cal_year=2031').
+ */
+static bool isDate(const char* url, const char* digits)
+{
+  int year = strtol(digits, NULL, 10);
+  if (year < 1900 || year > 2199) {
+    return false;
+  }
+
+  // Followed by a separator and a month of one or two digits
+  const char* after = digits + 4;
+  if (*after != '\0' && strchr("/-_.", *after) != NULL) {
+    size_t monthDigits = strspn(after + 1, "0123456789");
+    int month = strtol(after + 1, NULL, 10);
+    if (monthDigits >= 1 && monthDigits <= 2 && month >= 1 && month <= 12) {
+      return true;
+    }
+  }
+
+  // The value of a 'year' parameter
+  if (digits > url && digits[-1] == '=') {
+    const char* name = digits - 1;
+    while (name > url && name[-1] != '?' && name[-1] != '&') {
+      name--;
+    }
+    for (const char* c = name; c + 4 <= digits - 1; c++) {
+      if (tolower((unsigned char) c[0]) == 'y' && tolower((unsigned char) c[1]) == 'e'
+          && tolower((unsigned char) c[2]) == 'a' && tolower((unsigned char) c[3]) == 'r') {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**************** patternCount ****************/
+/* Return the count of URLs of a pattern, adding the pattern with a count of 0 if it has none yet.
+ */
+static int* patternCount(urlrules_t* rules, const char* pattern)
+{
+  int* count = hashtable_find(rules->patterns, pattern);
+  if (count == NULL) {
+    count = mem_assert(calloc(1, sizeof(int)), "failed allocating memory for urlrules count");
+    hashtable_insert(rules->patterns, pattern, count);
+    rules->numPatterns++;
+  }
+  return count;
+}
+
+/**************** savePattern ****************/
+/* hashtable_iterate itemfunc over the patterns: write one count and its pattern to the file, arg.
+ */
+static void savePattern(void* arg, const char* pattern, void* item)
+{
+  fprintf(arg, "%d %s\n", *(int*) item, pattern);
+}
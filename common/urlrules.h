@@ -0,0 +1,149 @@
+/*
+ * urlrules - rules that canonicalize the query of a URL, and heuristics that detect crawl traps
+ *
+ * URLs that differ only in tracking or session parameters ('utm_source', 'sessionid', ...), or in the
+ * order of their parameters, name the same page; urlrules_canonicalize strips the parameters named by
+ * the rules and sorts the rest, so that such URLs become one. Some sites also link to an unbounded
+ * number of URLs that lead nowhere new: paths that repeat a component ('/a/b/a/b/a/b/...'), calendars
+ * with a link to the next month forever, or listings whose URLs differ only in a counter. A URL is taken
+ * for a trap (see urlrules_isTrap and urlrules_count) if:
+ *   some component of its path appears more than maxRepeats times in it;
+ *   it holds a date (a year and a month, as in '2031/05' or 'year=2031') more than calendarYears
+ *   years from the current year;
+ *   maxPerPattern URLs of the same pattern (the URL with each run of digits, and each query value,
+ *   blanked out) have been counted already.
+ * Each limit is off when 0, as all are unless set (see urlrules_setLimits). The counts per pattern can
+ * be saved with a crawl's checkpoint and loaded again when it resumes (see urlrules_save).
+ *
+ * Rules do no locking; once set, they may be read by several threads at once, except that callers
+ * that share rules between threads must serialize urlrules_count, urlrules_save and urlrules_load.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/***********************************************************************/
+/* urlrules_t: opaque struct representing a set of rules
+ */
+typedef struct urlrules urlrules_t;
+
+/* Why urlrules_isTrap takes a URL for a trap */
+typedef enum {
+  URLRULES_NO_TRAP,           // none of the heuristics applies
+  URLRULES_REPEATS,           // a path component appears more than maxRepeats times
+  URLRULES_CALENDAR           // a date too far from the current year
+} urlrules_trap_t;
+
+/**************** urlrules_new ****************/
+/* Allocate and initialize the default rules: strip the parameters 'utm_*', 'fbclid', 'gclid',
+ * 'sessionid', 'jsessionid' and 'phpsessid' (names are matched ignoring case), and sort the rest; the
+ * trap heuristics are all off.
+ *
+ * We return:
+ *   pointer to new urlrules_t struct
+ *
+ * Caller is responsible for:
+ *   later calling urlrules_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+urlrules_t* urlrules_new(void);
+
+/**************** urlrules_strip ****************/
+/* Add a parameter name to strip from queries; a name ending in '*' strips every parameter beginning
+ * with what comes before it.
+ *
+ * We return:
+ *   true if added, false on NULL arguments or an empty name
+ */
+bool urlrules_strip(urlrules_t* rules, const char* name);
+
+/**************** urlrules_setSort ****************/
+/* Set whether the parameters left in a query are sorted (they are by default).
+ */
+void urlrules_setSort(urlrules_t* rules, const bool sort);
+
+/**************** urlrules_setLimits ****************/
+/* Set the limits of the trap heuristics (see above), each 0 to turn that heuristic off, or negative to
+ * leave it as it is.
+ */
+void urlrules_setLimits(urlrules_t* rules, const int maxRepeats, const int calendarYears, const int maxPerPattern);
+
+/**************** urlrules_canonicalize ****************/
+/* Canonicalize the query of a (normalized) URL in place: drop empty parameters and those the rules
+ * strip, sort the rest if the rules say so, and drop the '?' if nothing is left.
+ *
+ * Caller provides:
+ *   rules  pointer to valid urlrules_t struct
+ *   url    normalized URL, without a fragment
+ *
+ * We return:
+ *   the length of the canonical URL (never more than that of url), or 0 on NULL arguments
+ *
+ * Notes:
+ *   allocates nothing; the parameters are sorted in place, which takes time quadratic in their
+ *   number, few as they usually are
+ */
+size_t urlrules_canonicalize(const urlrules_t* rules, char* url);
+
+/**************** urlrules_isTrap ****************/
+/* Return why a (canonical) URL looks like a crawl trap by its path or its dates, or URLRULES_NO_TRAP
+ * if it does not (or on NULL arguments).
+ */
+urlrules_trap_t urlrules_isTrap(const urlrules_t* rules, const char* url);
+
+/**************** urlrules_count ****************/
+/* Count a (canonical) URL against the limit on URLs of its pattern.
+ *
+ * Caller provides:
+ *   rules  pointer to valid urlrules_t struct
+ *   url    a URL not counted before (a URL counted twice counts twice)
+ *
+ * We return:
+ *   true if counted; false if maxPerPattern URLs of its pattern have been counted already (or on
+ *   NULL arguments), in which case it is not
+ *
+ * Limitations:
+ *   the count of every pattern seen is kept, for as long as the rules are
+ */
+bool urlrules_count(urlrules_t* rules, const char* url);
+
+/**************** urlrules_save ****************/
+/* Write the count of URLs of each pattern counted so far to an open file.
+ *
+ * Caller provides:
+ *   rules  pointer to valid urlrules_t struct
+ *   fp     file open for writing
+ *
+ * We return:
+ *   true on success, false on NULL arguments or a write error
+ *
+ * Limitations:
+ *   the file is text, one pattern per line after a count; URLs must not contain newlines
+ */
+bool urlrules_save(urlrules_t* rules, FILE* fp);
+
+/**************** urlrules_load ****************/
+/* Set the counts of the patterns written by urlrules_save to what they were then, as if their URLs had
+ * been counted again; the counts of other patterns are left as they are.
+ *
+ * Caller provides:
+ *   rules  pointer to valid urlrules_t struct, normally new
+ *   fp     file open for reading, positioned where urlrules_save started writing
+ *
+ * We return:
+ *   true on success, false on NULL arguments or malformed input (the counts read so far are set)
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+bool urlrules_load(urlrules_t* rules, FILE* fp);
+
+/**************** urlrules_delete ****************/
+/* Free all memory associated with the rules.
+ */
+void urlrules_delete(urlrules_t* rules);
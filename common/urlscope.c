@@ -0,0 +1,143 @@
+/*
+ * urlscope - the scope of a crawl: which URLs it may fetch
+ *            See urlscope.h for usage.
+ *
+ * The prefixes are kept as a byte trie in an array of nodes, node 0 being the root (the empty
+ * prefix). Each node links to its first child and to its next sibling, and is marked terminal if
+ * a prefix ends there; prefixes that share a beginning share nodes. A URL is in scope if walking
+ * the trie along its bytes reaches a terminal node.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../libcs50/mem.h"
+#include "urlscope.h"
+
+/* node_t: one node of the trie, reached from its parent by one byte
+ */
+typedef struct node {
+  unsigned char byte;         // the byte leading here from the parent
+  bool terminal;              // whether a prefix ends here
+  int child;                  // index of the first child, or -1
+  int sibling;                // index of the next child of the same parent, or -1
+} node_t;
+
+/* urlscope_t: structure to represent a scope
+ * The innards should not be visible to users of the urlscope module.
+ */
+typedef struct urlscope {
+  node_t* nodes;              // nodes[0] is the root
+  int numNodes;
+  int maxNodes;               // allocated size of nodes
+} urlscope_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static int findChild(const urlscope_t* scope, const int node, const unsigned char byte);
+static int addChild(urlscope_t* scope, const int node, const unsigned char byte);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const int INITIAL_NODES = 64;          // nodes allocated for a new scope
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** urlscope_new ****************/
+/* see urlscope.h for documentation */
+urlscope_t* urlscope_new(void)
+{
+  urlscope_t* scope = mem_assert(malloc(sizeof(urlscope_t)), "failed allocating memory for urlscope");
+  scope->nodes = mem_assert(malloc(INITIAL_NODES * sizeof(node_t)), "failed allocating memory for urlscope nodes");
+  scope->maxNodes = INITIAL_NODES;
+  scope->nodes[0] = (node_t) { .byte = 0, .terminal = false, .child = -1, .sibling = -1 };
+  scope->numNodes = 1;
+  return scope;
+}
+
+/**************** urlscope_add ****************/
+/* see urlscope.h for documentation */
+bool urlscope_add(urlscope_t* scope, const char* prefix)
+{
+  if (scope == NULL || prefix == NULL || *prefix == '\0') {
+    return false;
+  }
+
+  int node = 0;
+  for (const unsigned char* c = (const unsigned char*) prefix; *c != '\0'; c++) {
+    int next = findChild(scope, node, *c);
+    node = (next >= 0) ? next : addChild(scope, node, *c);
+  }
+  scope->nodes[node].terminal = true;
+  return true;
+}
+
+/**************** urlscope_contains ****************/
+/* see urlscope.h for documentation */
+bool urlscope_contains(const urlscope_t* scope, const char* url)
+{
+  if (scope == NULL || url == NULL) {
+    return false;
+  }
+
+  // Stop at the first prefix found, or where the URL leaves the trie
+  int node = 0;
+  for (const unsigned char* c = (const unsigned char*) url; node >= 0; c++) {
+    if (scope->nodes[node].terminal) {
+      return true;
+    }
+    if (*c == '\0') {
+      break;
+    }
+    node = findChild(scope, node, *c);
+  }
+  return false;
+}
+
+/**************** urlscope_delete ****************/
+/* see urlscope.h for documentation */
+void urlscope_delete(urlscope_t* scope)
+{
+  if (scope == NULL) {
+    return;
+  }
+
+  free(scope->nodes);
+  free(scope);
+}
+
+/* *********************************************************************** */
+/* Private methods */
+
+/**************** findChild ****************/
+/* Return the index of the child of node reached by byte, or -1 if there is none.
+ */
+static int findChild(const urlscope_t* scope, const int node, const unsigned char byte)
+{
+  int child = scope->nodes[node].child;
+  while (child >= 0 && scope->nodes[child].byte != byte) {
+    child = scope->nodes[child].sibling;
+  }
+  return child;
+}
+
+/**************** addChild ****************/
+/* Add a (non-terminal, childless) child to node, reached by byte, and return its index.
+ */
+static int addChild(urlscope_t* scope, const int node, const unsigned char byte)
+{
+  if (scope->numNodes == scope->maxNodes) {
+    scope->maxNodes *= 2;
+    scope->nodes = mem_assert(realloc(scope->nodes, scope->maxNodes * sizeof(node_t)),
+                              "failed allocating memory for urlscope nodes");
+  }
+
+  int child = scope->numNodes++;
+  scope->nodes[child] = (node_t) { .byte = byte, .terminal = false, .child = -1, .sibling = scope->nodes[node].child };
+  scope->nodes[node].child = child;
+  return child;
+}
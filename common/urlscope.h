@@ -0,0 +1,55 @@
+/*
+ * urlscope - the scope of a crawl: which URLs it may fetch
+ *
+ * A scope is a set of URL prefixes; a (normalized) URL is in scope if it begins with one of them. The
+ * prefixes are compiled into a trie as they are added, so checking a URL allocates nothing and reads
+ * each of its bytes at most once, however many prefixes the scope has.
+ *
+ * A scope does no locking; once built, it may be read by several threads at once.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdbool.h>
+
+/***********************************************************************/
+/* urlscope_t: opaque struct representing a scope
+ */
+typedef struct urlscope urlscope_t;
+
+/**************** urlscope_new ****************/
+/* Allocate and initialize an empty scope, in which no URL is.
+ *
+ * We return:
+ *   pointer to new urlscope_t struct
+ *
+ * Caller is responsible for:
+ *   later calling urlscope_delete with returned pointer
+ *
+ * IMPORTANT:
+ *   program crashes cleanly if memory could not be allocated
+ */
+urlscope_t* urlscope_new(void);
+
+/**************** urlscope_add ****************/
+/* Add a prefix to the scope.
+ *
+ * Caller provides:
+ *   scope   pointer to valid urlscope_t struct
+ *   prefix  non-empty, normalized URL prefix (the scope keeps a copy)
+ *
+ * We return:
+ *   true if the prefix was added, false on NULL arguments or an empty prefix
+ */
+bool urlscope_add(urlscope_t* scope, const char* prefix);
+
+/**************** urlscope_contains ****************/
+/* Return true if the (normalized) URL begins with one of the scope's prefixes; false if not, or on
+ * NULL arguments.
+ */
+bool urlscope_contains(const urlscope_t* scope, const char* url);
+
+/**************** urlscope_delete ****************/
+/* Free all memory associated with the scope.
+ */
+void urlscope_delete(urlscope_t* scope);
@@ -1,18 +1,168 @@
 /* 
- * crawler - standalone program that crawls the web and retrieves webpages starting from a "seed" URL
+ * crawler - standalone program that crawls the web and retrieves webpages starting from "seed" URLs
  *
  * By Rodrigo Vega Ayllon - October 2024
  */
 
+#define _GNU_SOURCE       // srandom, clock_gettime
+
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <pthread.h>
 #include "../common/pagedir.h"
+#include "../common/politeness.h"
+#include "../common/frontier.h"
+#include "../common/seenset.h"
+#include "../common/urlscope.h"
+#include "../common/urlrules.h"
+#include "../common/simhash.h"
 #include "../libcs50/webpage.h"
-#include "../libcs50/bag.h"
+#include "../libcs50/fetcher.h"
 #include "../libcs50/hashtable.h"
+#include "../libcs50/file.h"
 #include "../libcs50/mem.h"
 
-static void parseArgs(const int argc, char* argv[], char** seedURL, char** pageDirectory, int* maxDepth);
-static void crawl(char* seedURL, char* pageDirectory, const int maxDepth);
-static void pageScan(webpage_t* page, bag_t* pagesToCrawl, hashtable_t* pagesSeen);
+/* options_t: command-line options
+ */
+typedef struct options {
+  int numWorkers;               // threads fetching pages concurrently
+  int maxInFlight;              // pages fetched at once by a single-threaded fetcher, or 0 to use threads
+  double rate;                  // requests per second to each host, or 0 for no limit
+  int burst;                    // requests a host may receive at once after being idle
+  int hostConns;                // requests in progress at once to each host
+  frontier_order_t order;       // order in which pages are crawled
+  int maxInMemory;              // pages to crawl kept in memory before spilling to disk, or 0 for no limit
+  bool bloom;                   // whether pagesSeen is a Bloom filter (approximate) rather than exact
+  int checkpointSecs;           // seconds between checkpoints, or 0 for none
+  bool resume;                  // whether to resume from the checkpoint in pageDirectory
+  bool recrawl;                 // whether to refresh the pages already in pageDirectory
+  int maxBytes;                 // longest page to download, in bytes, or 0 for no limit
+  double connectSecs;           // deadline to connect to a host, in seconds, or 0 for none
+  double firstByteSecs;         // deadline for a response to start once the request is sent, or 0 for none
+  double fetchSecs;             // deadline for the whole fetch of a page, or 0 for none
+  char* specFile;               // file listing the seeds and scope, or NULL to crawl from seedURL
+  int nearDistance;             // Hamming distance within which pages are near-duplicates, or -1 to keep them
+  pagedir_store_t store;        // how a new pageDirectory stores its pages
+  pagedir_compress_t compress;  // and whether it compresses their HTML
+} options_t;
+
+/* spec_t: what to crawl, as given by seedURL or by a spec file
+ */
+typedef struct spec {
+  char** seeds;                 // normalized seed URLs, each in scope
+  int numSeeds;
+  urlscope_t* scope;            // URLs that may be crawled
+  urlrules_t* rules;            // how to canonicalize queries, and which URLs are taken for traps
+} spec_t;
+
+/* held_t: a webpage taken from pagesToCrawl and not done with yet, as recorded in checkpoints
+ */
+typedef struct held {
+  webpage_t* page;              // NULL if the slot is free
+  docid_t docID;                // docID claimed for it, or 0 if none yet
+} held_t;
+
+/* crawl_t: state shared by all fetch workers of a crawl
+ * Every field but seeds, pageDirectory, maxDepth, checkpointSecs, knownDocIDs, scope (read-only once the
+ * crawl starts) and polite (which has its own lock) is guarded by 'lock'; of rules, only the counts of
+ * urlrules_count are, the rest being read-only once the crawl starts.
+ */
+typedef struct crawl {
+  char** seeds;                 // where the crawl started
+  int numSeeds;
+  frontier_t* pagesToCrawl;     // webpages waiting to be fetched, in the order to fetch them
+  politeness_t* polite;         // per-host limits on fetching
+  seenset_t* pagesSeen;         // URLs already added to pagesToCrawl
+  urlscope_t* scope;            // URLs that may be crawled
+  urlrules_t* rules;            // how to canonicalize queries, and which URLs are taken for traps
+  int traps;                    // URLs skipped as crawl traps
+  simhash_t* fingerprints;      // fingerprints of the pages saved, or NULL if near-duplicates are kept
+  int nearDups;                 // pages skipped as near-duplicates
+  hashtable_t* knownDocIDs;     // when recrawling, URL -> docID of the pages already saved; else NULL
+  char* pageDirectory;          // where pages are saved
+  int maxDepth;                 // maximum crawl depth
+  docid_t nextDocID;            // docID of the next page to be saved
+  int busyWorkers;              // workers currently holding a page
+  held_t* held;                 // webpages taken from pagesToCrawl and not done with yet
+  int maxHeld;                  // allocated size of held
+  int checkpointSecs;           // seconds between checkpoints, or 0 for none
+  time_t nextCheckpoint;        // when the next checkpoint is due
+  int timedOut[WEBPAGE_TOTAL_MISSED + 1]; // fetches that missed each deadline, by webpage_deadline_t
+  pthread_mutex_t lock;
+  pthread_cond_t workReady;     // signaled on new pages, or when the crawl is over
+} crawl_t;
+
+/* readiness_t: what takeReadyPage learns about the hosts of the webpages it passes over
+ */
+typedef struct readiness {
+  politeness_t* polite;         // whom to ask
+  long waitMillis;              // shortest wait for a host seen so far, or -1
+} readiness_t;
+
+/* crawled_t: the pages already in pageDirectory, in docID order, as loadCrawled reads them
+ */
+typedef struct crawled {
+  webpage_t** pages;            // pages[docID - 1]
+  int numPages;
+} crawled_t;
+
+static const int MAX_WORKERS = 64;      // upper bound on --workers
+static const int MAX_IN_FLIGHT = 1000;  // upper bound on --async
+static const double MAX_RATE = 1000;    // upper bound on --rate
+static const int MAX_BURST = 100;       // upper bound on --burst
+static const int MAX_HOST_CONNS = 64;   // upper bound on --host-conns
+static const int MAX_IN_MEMORY = 100000000; // upper bound on --spill
+static const int SEEN_EXPECTED = 1024;  // URLs pagesSeen is first sized for; it grows as needed
+static const int MAX_CHECKPOINT = 86400; // upper bound on --checkpoint
+static const char* CHECKPOINT_HEADER = "crawler checkpoint 2"; // first line of a checkpoint file
+static const char* CHECKPOINT_HEADER_V1 = "crawler checkpoint 1"; // that of one without pattern counts
+static const int MAX_BYTES = 1 << 30;   // upper bound on --max-bytes
+static const int DEFAULT_MAX_BYTES = 10 << 20; // 10 MiB, far more than any page of HTML needs
+static const double MAX_TIMEOUT = 3600; // upper bound on --connect-timeout, --first-byte-timeout, --fetch-timeout
+static const double DEFAULT_CONNECT_TIMEOUT = 10;    // seconds
+static const double DEFAULT_FIRST_BYTE_TIMEOUT = 30; // seconds
+static const double DEFAULT_FETCH_TIMEOUT = 120;     // seconds
+
+#ifndef NOSLEEP // CS50 students: please don't turn off the politeness limit!
+static const double DEFAULT_RATE = 1;   // one request per second to each host, to lighten load on servers
+#else
+static const double DEFAULT_RATE = 0;   // no limit
+#endif
+
+static void usage(void);
+static int optionValue(const char* option, const char* value);
+static double optionNumber(const char* option, const char* value);
+static frontier_order_t optionOrder(const char* option, const char* value);
+static pagedir_store_t optionStore(const char* option, const char* value);
+static pagedir_compress_t optionCompress(const char* option, const char* value);
+static void parseArgs(const int argc, char* argv[], const char* seedURL, char** pageDirectory, int* maxDepth,
+                      options_t* options, spec_t* spec);
+static void readSpec(const char* path, spec_t* spec);
+static bool readRule(urlrules_t* rules, const char* directive, const char* value);
+static void addSeed(spec_t* spec, char* seed, int* maxSeeds);
+static void crawl(spec_t* spec, char* pageDirectory, const int maxDepth, const options_t* options);
+static void insertSeeds(crawl_t* crawl);
+static void* crawlWorker(void* arg);
+static void crawlAsync(crawl_t* crawl, const int maxInFlight);
+static webpage_t* takeReadyPage(crawl_t* crawl, long* waitMillis);
+static bool hostReady(void* arg, webpage_t* webpage);
+static void waitForWork(crawl_t* crawl, const long waitMillis);
+static void pageFetched(void* arg, webpage_t* webpage, bool success);
+static void pageScan(webpage_t* page, crawl_t* crawl);
+static void holdPage(crawl_t* crawl, webpage_t* webpage, const docid_t docID);
+static void checkpoint(crawl_t* crawl);
+static void resumeCrawl(crawl_t* crawl, const bool bloom);
+static void finishHeldPage(crawl_t* crawl, webpage_t* webpage, const docid_t docID);
+static void aliasOf(void* arg, const docid_t docID, const docid_t canonicalDocID);
+static void removeFiles(const char* directory);
+static void loadCrawled(crawl_t* crawl, const bool bloom);
+static void loadFingerprints(crawl_t* crawl);
+static void setValidators(void* arg, const docid_t docID, const char* etag, const char* lastModified);
 
 /**************** main ****************/
 /* Entry point of the program. Validate correct usage, then simply call parseArgs and crawl.
@@ -25,68 +175,379 @@ static void pageScan(webpage_t* page, bag_t* pagesToCrawl, hashtable_t* pagesSee
  *  0 on success, 1 on failure
  *
  * Usage:
- *  ./crawler seedURL pageDirectory maxDepth
+ *  ./crawler [--workers N | --async N] [--rate R] [--burst N] [--host-conns N] [--order O] [--spill N] [--bloom]
+ *            [--checkpoint S] [--resume] [--recrawl] [--max-bytes N] [--connect-timeout S]
+ *            [--first-byte-timeout S] [--fetch-timeout S] [--near-dups D] [--store S] [--compress C]
+ *            {seedURL | --spec FILE} pageDirectory maxDepth
+ *    --workers N - number of threads fetching pages concurrently, in range [1..64] (default 1)
+ *    --async N - instead of threads, fetch up to N pages at once from one thread, N in range [1..1000]
+ *    --rate R - requests per second to each host, in range [0..1000], 0 meaning no limit (default 1)
+ *    --burst N - requests a host may receive at once after being idle, in range [1..100] (default 1)
+ *    --host-conns N - requests in progress at once to each host, in range [1..64] (default 2)
+ *    --order O - order in which to crawl pages: 'depth' (breadth-first, the default), 'discovery'
+ *      (first found, first crawled) or 'host' (round-robin across hosts)
+ *    --spill N - keep at most about N pages to crawl in memory, and the rest on disk, under
+ *      pageDirectory/.frontier, N in range [2..100000000] (default: keep all in memory)
+ *    --bloom - keep the URLs already seen in a Bloom filter, at 2 to 3 bytes per URL rather than 16,
+ *      at the cost of skipping about 1 in 1000 new URLs as if seen
+ *    --checkpoint S - every S seconds, in range [1..86400], save the state of the crawl to
+ *      pageDirectory/.checkpoint (default: never)
+ *    --resume - carry on with the crawl saved in pageDirectory/.checkpoint, rather than starting
+ *      from seedURL; seedURL (or the spec's first seed) and maxDepth must be those of the crawl saved
+ *    --recrawl - refresh the pages already in pageDirectory, fetching each again only if it has
+ *      changed (and saving it under the same docID), and crawl on from those that have
+ *    --max-bytes N - skip pages longer than N bytes, in range [0..1073741824], 0 meaning no limit
+ *      (default 10485760); pages whose Content-Type is not HTML are always skipped
+ *    --connect-timeout S - give up connecting to a host after S seconds, in range [0..3600], 0 meaning
+ *      never (default 10)
+ *    --first-byte-timeout S - give up on a page whose response has not started S seconds after the
+ *      request, in range [0..3600], 0 meaning never (default 30)
+ *    --fetch-timeout S - give up on a page not fetched in full after S seconds, in range [0..3600],
+ *      0 meaning never (default 120)
+ *    --near-dups D - skip pages whose text is a near-duplicate of a page already saved, that is, whose
+ *      SimHash fingerprint differs from it in at most D bits, D in range [0..7]; they are neither saved
+ *      nor scanned (default: keep them all)
+ *    --store S - how a new pageDirectory stores its pages: 'segments' (appended to a few large segment
+ *      files, the default) or 'files' (a page file each, in shards); one crawled before keeps its own
+ *    --compress C - whether a new pageDirectory compresses the HTML of its pages: 'none' (the default),
+ *      'lz' (with an LZ codec), or 'lz-dict' (the same, with a dictionary trained on its first pages, for
+ *      a better ratio on small pages); one crawled before keeps its own
  *    seedURL - 'internal' directory, to be used as the initial URL
+ *    --spec FILE - instead of seedURL, crawl from the seeds and within the scope listed in FILE: one
+ *      'seed URL' or 'scope PREFIX' per line, '#' starting a comment line; without a 'scope' line,
+ *      the scope is the 'internal' URLs. It may also set the URL rules (see urlrules.h), one per line:
+ *      'strip-param NAME' strips query parameter NAME (or those beginning with NAME, if it ends in '*')
+ *      besides the tracking and session ones stripped by default; 'sort-params off' leaves the order of
+ *      parameters alone; and 'max-repeats N', 'calendar-years N' and 'max-per-pattern N' set the limits
+ *      past which a URL is taken for a crawl trap and skipped (each off unless set, or set to 0)
  *    pageDirectory - (existing) directory in which to write downloaded webpages
  *    maxDepth - integer in range [0..10] indicating the maximum crawl depth
  */
 int main(const int argc, char* argv[])
 {
-  // Ensure correct number of arguments
-  if (argc != 4) {
-    fprintf(stderr, "usage: ./crawler seedURL pageDirectory maxDepth\n\tseedURL - 'internal' directory, to be used ");
-    fprintf(stderr, "as the initial URL\n\tpageDirectory - (existing) directory in which to write download webpages");
-    fprintf(stderr, "\n\tmaxDepth - integer in range [0..10] indicating the maximum crawl depth\n");
-    exit(1);
+  // Pull off options, which come before the positional arguments
+  options_t options = { .numWorkers = 1,
+                        .maxInFlight = 0, // 0 means: use worker threads instead
+                        .rate = DEFAULT_RATE, .burst = 1, .hostConns = 2,
+                        .order = FRONTIER_DEPTH, .maxInMemory = 0, .bloom = false,
+                        .checkpointSecs = 0, .resume = false, .recrawl = false,
+                        .maxBytes = DEFAULT_MAX_BYTES, .connectSecs = DEFAULT_CONNECT_TIMEOUT,
+                        .firstByteSecs = DEFAULT_FIRST_BYTE_TIMEOUT, .fetchSecs = DEFAULT_FETCH_TIMEOUT,
+                        .specFile = NULL, .nearDistance = -1, .store = PAGEDIR_SEGMENTS,
+                        .compress = PAGEDIR_PLAIN };
+  int argi = 1;
+  while (argi < argc && strncmp(argv[argi], "--", 2) == 0) {
+    if (strcmp(argv[argi], "--workers") == 0 && argi + 1 < argc) {
+      options.numWorkers = optionValue(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--async") == 0 && argi + 1 < argc) {
+      options.maxInFlight = optionValue(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--rate") == 0 && argi + 1 < argc) {
+      options.rate = optionNumber(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--burst") == 0 && argi + 1 < argc) {
+      options.burst = optionValue(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--host-conns") == 0 && argi + 1 < argc) {
+      options.hostConns = optionValue(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--order") == 0 && argi + 1 < argc) {
+      options.order = optionOrder(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--spill") == 0 && argi + 1 < argc) {
+      options.maxInMemory = optionValue(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--bloom") == 0) {
+      options.bloom = true;
+      argi++;
+    } else if (strcmp(argv[argi], "--checkpoint") == 0 && argi + 1 < argc) {
+      options.checkpointSecs = optionValue(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--resume") == 0) {
+      options.resume = true;
+      argi++;
+    } else if (strcmp(argv[argi], "--recrawl") == 0) {
+      options.recrawl = true;
+      argi++;
+    } else if (strcmp(argv[argi], "--max-bytes") == 0 && argi + 1 < argc) {
+      options.maxBytes = optionValue(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--connect-timeout") == 0 && argi + 1 < argc) {
+      options.connectSecs = optionNumber(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--first-byte-timeout") == 0 && argi + 1 < argc) {
+      options.firstByteSecs = optionNumber(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--fetch-timeout") == 0 && argi + 1 < argc) {
+      options.fetchSecs = optionNumber(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--near-dups") == 0 && argi + 1 < argc) {
+      options.nearDistance = optionValue(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--store") == 0 && argi + 1 < argc) {
+      options.store = optionStore(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--compress") == 0 && argi + 1 < argc) {
+      options.compress = optionCompress(argv[argi], argv[argi + 1]);
+      argi += 2;
+    } else if (strcmp(argv[argi], "--spec") == 0 && argi + 1 < argc) {
+      options.specFile = argv[argi + 1];
+      argi += 2;
+    } else {
+      usage();
+    }
+  }
+
+  // Ensure correct number of arguments: a spec file takes the place of seedURL
+  if (argc - argi != (options.specFile == NULL ? 3 : 2)) {
+    usage();
   }
+  char* seedURL = (options.specFile == NULL) ? argv[argi++] : NULL;
+  char** args = &argv[argi];
 
   // Convert maxDepth to integer
   char* end = NULL; // pointer to pointer to first character after numeric value
-  int maxDepth = strtol(argv[3], &end, 10);
+  int maxDepth = strtol(args[1], &end, 10);
   if (*end != '\0') {
     fprintf(stderr, "maxDepth could not be converted to integer\n");
     exit(1);
   }
 
   // Parse command-line arguments
-  parseArgs(argc, argv, &argv[1], &argv[2], &maxDepth);
+  spec_t spec;
+  parseArgs(argc, argv, seedURL, &args[0], &maxDepth, &options, &spec);
 
   // Crawl the web
-  crawl(argv[1], argv[2], maxDepth);
+  crawl(&spec, args[0], maxDepth, &options);
 
   exit(0);
 }
 
+/**************** usage ****************/
+/* Print usage message to stderr and exit non-zero. */
+static void usage(void)
+{
+  fprintf(stderr, "usage: ./crawler [--workers N | --async N] [--rate R] [--burst N] [--host-conns N] [--order O] [--spill N] [--bloom] ");
+  fprintf(stderr, "[--checkpoint S] [--resume] [--recrawl] [--max-bytes N] [--connect-timeout S] ");
+  fprintf(stderr, "[--first-byte-timeout S] [--fetch-timeout S] [--near-dups D] [--store S] [--compress C] ");
+  fprintf(stderr, "{seedURL | --spec FILE} pageDirectory maxDepth\n\t--workers N - number ");
+  fprintf(stderr, "of threads fetching pages concurrently, in range [1..%d] (default 1)\n", MAX_WORKERS);
+  fprintf(stderr, "\t--async N - instead of threads, fetch up to N pages at once from one thread, ");
+  fprintf(stderr, "N in range [1..%d]\n", MAX_IN_FLIGHT);
+  fprintf(stderr, "\t--rate R - requests per second to each host, in range [0..%g], 0 meaning no limit ", MAX_RATE);
+  fprintf(stderr, "(default %g)\n\t--burst N - requests a host may receive at once after being idle, ", DEFAULT_RATE);
+  fprintf(stderr, "in range [1..%d] (default 1)\n\t--host-conns N - requests in progress at once ", MAX_BURST);
+  fprintf(stderr, "to each host, in range [1..%d] (default 2)\n", MAX_HOST_CONNS);
+  fprintf(stderr, "\t--order O - order in which to crawl pages: 'depth' (breadth-first, the default), ");
+  fprintf(stderr, "'discovery' (first found, first crawled) or 'host' (round-robin across hosts)\n");
+  fprintf(stderr, "\t--spill N - keep at most about N pages to crawl in memory, and the rest on disk, under ");
+  fprintf(stderr, "pageDirectory/.frontier, N in range [2..%d] (default: keep all in memory)\n", MAX_IN_MEMORY);
+  fprintf(stderr, "\t--bloom - keep the URLs already seen in a Bloom filter, at 2 to 3 bytes per URL ");
+  fprintf(stderr, "rather than 16, at the cost of skipping about 1 in 1000 new URLs as if seen\n");
+  fprintf(stderr, "\t--checkpoint S - every S seconds, in range [1..%d], save the state of the crawl ", MAX_CHECKPOINT);
+  fprintf(stderr, "to pageDirectory/.checkpoint (default: never)\n\t--resume - carry on with the crawl saved ");
+  fprintf(stderr, "in pageDirectory/.checkpoint; seedURL (or the spec's first seed) and maxDepth must be those ");
+  fprintf(stderr, "of the crawl saved\n");
+  fprintf(stderr, "\t--recrawl - refresh the pages already in pageDirectory, fetching each again only if it has ");
+  fprintf(stderr, "changed (and saving it under the same docID), and crawl on from those that have\n");
+  fprintf(stderr, "\t--max-bytes N - skip pages longer than N bytes, in range [0..%d], 0 meaning no limit ", MAX_BYTES);
+  fprintf(stderr, "(default %d); pages whose Content-Type is not HTML are always skipped\n", DEFAULT_MAX_BYTES);
+  fprintf(stderr, "\t--connect-timeout S - give up connecting to a host after S seconds, in range [0..%g], ", MAX_TIMEOUT);
+  fprintf(stderr, "0 meaning never (default %g)\n\t--first-byte-timeout S - give up on a page whose ", DEFAULT_CONNECT_TIMEOUT);
+  fprintf(stderr, "response has not started S seconds after the request, in range [0..%g], 0 meaning never ", MAX_TIMEOUT);
+  fprintf(stderr, "(default %g)\n\t--fetch-timeout S - give up on a page not fetched in full ", DEFAULT_FIRST_BYTE_TIMEOUT);
+  fprintf(stderr, "after S seconds, in range [0..%g], 0 meaning never (default %g)\n", MAX_TIMEOUT, DEFAULT_FETCH_TIMEOUT);
+  fprintf(stderr, "\t--near-dups D - skip pages whose text is a near-duplicate of a page already saved, that is, ");
+  fprintf(stderr, "whose SimHash fingerprint differs from it in at most D bits, D in range [0..%d]; ", SIMHASH_MAX_DISTANCE);
+  fprintf(stderr, "they are neither saved nor scanned (default: keep them all)\n");
+  fprintf(stderr, "\t--store S - how a new pageDirectory stores its pages: 'segments' (appended to a few large ");
+  fprintf(stderr, "segment files, the default) or 'files' (a page file each, in shards); one crawled before keeps its own\n");
+  fprintf(stderr, "\t--compress C - whether a new pageDirectory compresses the HTML of its pages: 'none' (the ");
+  fprintf(stderr, "default), 'lz' (with an LZ codec), or 'lz-dict' (the same, with a dictionary trained on its first ");
+  fprintf(stderr, "pages, for a better ratio on small pages); one crawled before keeps its own\n");
+  fprintf(stderr, "\tseedURL - 'internal' directory, to be used ");
+  fprintf(stderr, "as the initial URL\n\t--spec FILE - instead of seedURL, crawl from the seeds and within ");
+  fprintf(stderr, "the scope listed in FILE: one 'seed URL' or 'scope PREFIX' per line, '#' starting a comment ");
+  fprintf(stderr, "line; without a 'scope' line, the scope is the 'internal' URLs. It may also set URL rules: ");
+  fprintf(stderr, "'strip-param NAME' (NAME ending in '*' for a prefix), 'sort-params off', and the crawl-trap ");
+  fprintf(stderr, "limits 'max-repeats N', 'calendar-years N' and 'max-per-pattern N' (each off unless set, or ");
+  fprintf(stderr, "set to 0)\n\tpageDirectory - (existing) directory in which to write download webpages");
+  fprintf(stderr, "\n\tmaxDepth - integer in range [0..10] indicating the maximum crawl depth\n");
+  exit(1);
+}
+
+/**************** optionValue ****************/
+/* Convert the value of an integer-valued option, or exit non-zero if it is not an integer.
+ *
+ * Caller provides: 
+ *  option  name of the option, for the error message
+ *  value   string following the option on the command line
+ *
+ * We return:
+ *  the integer value
+ */
+static int optionValue(const char* option, const char* value)
+{
+  char* end = NULL;
+  int result = strtol(value, &end, 10);
+  if (*value == '\0' || *end != '\0') {
+    fprintf(stderr, "%s value %s could not be converted to integer\n", option, value);
+    exit(1);
+  }
+  return result;
+}
+
+/**************** optionNumber ****************/
+/* Convert the value of a number-valued option, or exit non-zero if it is not a number.
+ *
+ * Caller provides: 
+ *  option  name of the option, for the error message
+ *  value   string following the option on the command line
+ *
+ * We return:
+ *  the value
+ */
+static double optionNumber(const char* option, const char* value)
+{
+  char* end = NULL;
+  double result = strtod(value, &end);
+  if (*value == '\0' || *end != '\0') {
+    fprintf(stderr, "%s value %s could not be converted to a number\n", option, value);
+    exit(1);
+  }
+  return result;
+}
+
+/**************** optionOrder ****************/
+/* Convert the value of the crawl order option, or exit non-zero if it names no order.
+ *
+ * Caller provides: 
+ *  option  name of the option, for the error message
+ *  value   string following the option on the command line
+ *
+ * We return:
+ *  the order
+ */
+static frontier_order_t optionOrder(const char* option, const char* value)
+{
+  if (strcmp(value, "depth") == 0) {
+    return FRONTIER_DEPTH;
+  } else if (strcmp(value, "discovery") == 0) {
+    return FRONTIER_DISCOVERY;
+  } else if (strcmp(value, "host") == 0) {
+    return FRONTIER_HOST;
+  }
+  fprintf(stderr, "%s value %s is not one of depth, discovery, host\n", option, value);
+  exit(1);
+}
+
+/**************** optionStore ****************/
+/* Convert the value of the page store option, or exit non-zero if it names no store.
+ *
+ * Caller provides: 
+ *  option  name of the option, for the error message
+ *  value   string following the option on the command line
+ *
+ * We return:
+ *  the store
+ */
+static pagedir_store_t optionStore(const char* option, const char* value)
+{
+  if (strcmp(value, "segments") == 0) {
+    return PAGEDIR_SEGMENTS;
+  } else if (strcmp(value, "files") == 0) {
+    return PAGEDIR_FILES;
+  }
+  fprintf(stderr, "%s value %s is not one of segments, files\n", option, value);
+  exit(1);
+}
+
+/**************** optionCompress ****************/
+/* Convert the value of the compression option, or exit non-zero if it names no compression.
+ *
+ * Caller provides: 
+ *  option  name of the option, for the error message
+ *  value   string following the option on the command line
+ *
+ * We return:
+ *  the compression
+ */
+static pagedir_compress_t optionCompress(const char* option, const char* value)
+{
+  if (strcmp(value, "none") == 0) {
+    return PAGEDIR_PLAIN;
+  } else if (strcmp(value, "lz") == 0) {
+    return PAGEDIR_LZ;
+  } else if (strcmp(value, "lz-dict") == 0) {
+    return PAGEDIR_LZ_DICT;
+  }
+  fprintf(stderr, "%s value %s is not one of none, lz, lz-dict\n", option, value);
+  exit(1);
+}
+
 /**************** parseArgs ****************/
 /* Parse/modify command-line arguments so they meet minimum functionality requirements.
  *
  * Caller provides: 
  *  argc  number of command-line arguments
  *  argv  string array of the command-line arguments
- *  seedURL pointer to seed URL string
+ *  seedURL seed URL string, or NULL if options->specFile names a spec file instead
  *  pageDirectory pointer to page directory string (where pages will be saved)
  *  maxDepth pointer to integer indicating the maximum crawl depth
+ *  options pointer to options_t struct holding the options given (or their defaults)
+ *  spec pointer to spec_t struct, which we fill in with the seeds and scope of the crawl
  *
  * We only return on success, exit non-zero otherwise
  *
  * We assume:
+ *  seedURL, or each seed of the spec file, normalizes and is in scope
  *  maxDepth should be in the range [0..10]
+ *  numWorkers should be in the range [1..MAX_WORKERS]
+ *  maxInFlight should be 0, or in the range [1..MAX_IN_FLIGHT] if numWorkers is 1
+ *  rate should be in the range [0..MAX_RATE], burst in [1..MAX_BURST], hostConns in [1..MAX_HOST_CONNS]
+ *  maxInMemory should be 0, or in the range [2..MAX_IN_MEMORY]
+ *  checkpointSecs should be 0, or in the range [1..MAX_CHECKPOINT]
+ *  recrawl is not combined with checkpointSecs or resume
+ *  maxBytes should be in the range [0..MAX_BYTES]
+ *  connectSecs, firstByteSecs and fetchSecs should be in the range [0..MAX_TIMEOUT]
+ *  nearDistance should be -1, or in the range [0..SIMHASH_MAX_DISTANCE]
  */
-static void parseArgs(const int argc, char* argv[], char** seedURL, char** pageDirectory, int* maxDepth)
+static void parseArgs(const int argc, char* argv[], const char* seedURL, char** pageDirectory, int* maxDepth,
+                      options_t* options, spec_t* spec)
 { 
-  // Ensure seedURL is normalized
-  if ((*seedURL = normalizeURL(*seedURL)) == NULL) {
-    fprintf(stderr, "seedURL could not be normalized\n");
-    exit(1); 
+  spec->seeds = NULL;
+  spec->numSeeds = 0;
+  spec->scope = urlscope_new();
+  spec->rules = urlrules_new();
+  if (options->specFile != NULL) {
+    // Read the seeds and scope from the spec file
+    readSpec(options->specFile, spec);
+  } else {
+    // Ensure seedURL is normalized
+    char* seed = normalizeURL(seedURL);
+    if (seed == NULL) {
+      fprintf(stderr, "seedURL could not be normalized\n");
+      exit(1); 
+    }
+
+    // Ensure seedURL is internal
+    urlscope_add(spec->scope, INTERNAL_PREFIX);
+    if (urlscope_contains(spec->scope, seed) == false) {
+      fprintf(stderr, "seedURL %s is not internal\n", seed);
+      exit(1);
+    }
+    int maxSeeds = 0;
+    addSeed(spec, seed, &maxSeeds);
   }
 
-  // Ensure seedURL is internal
-  if (isInternalURL(*seedURL) == false) {
-    fprintf(stderr, "seedURL %s is not internal\n", *seedURL);
-    exit(1);
+  // Canonicalize the seeds' queries as those of the links found will be
+  for (int i = 0; i < spec->numSeeds; i++) {
+    urlrules_canonicalize(spec->rules, spec->seeds[i]);
   }
+
   // Ensure pageDirectory is initialized
-  if (pagedir_init(*pageDirectory) == false) {
+  if (pagedir_init(*pageDirectory, options->store, options->compress) == false) {
     fprintf(stderr, "failed opening .crawler file in pageDirectory %s\n", *pageDirectory);
     exit(1);
   }
@@ -96,95 +557,1031 @@ static void parseArgs(const int argc, char* argv[], char** seedURL, char** pageD
     fprintf(stderr, "maxDepth %d is not in range [0..10]\n", *maxDepth);
     exit(1);
   }
+
+  // Ensure numWorkers is in range [1..MAX_WORKERS]
+  if (options->numWorkers < 1 || options->numWorkers > MAX_WORKERS) {
+    fprintf(stderr, "number of workers %d is not in range [1..%d]\n", options->numWorkers, MAX_WORKERS);
+    exit(1);
+  }
+
+  // Ensure maxInFlight is in range [1..MAX_IN_FLIGHT], if given, and not combined with worker threads
+  if (options->maxInFlight < 0 || options->maxInFlight > MAX_IN_FLIGHT) {
+    fprintf(stderr, "number of asynchronous fetches %d is not in range [1..%d]\n", options->maxInFlight,
+            MAX_IN_FLIGHT);
+    exit(1);
+  }
+  if (options->maxInFlight > 0 && options->numWorkers > 1) {
+    fprintf(stderr, "--workers and --async cannot be used together\n");
+    exit(1);
+  }
+
+  // Ensure the politeness limits are in range
+  if (!(options->rate >= 0 && options->rate <= MAX_RATE)) {
+    fprintf(stderr, "rate %g is not in range [0..%g]\n", options->rate, MAX_RATE);
+    exit(1);
+  }
+  if (options->burst < 1 || options->burst > MAX_BURST) {
+    fprintf(stderr, "burst %d is not in range [1..%d]\n", options->burst, MAX_BURST);
+    exit(1);
+  }
+  if (options->hostConns < 1 || options->hostConns > MAX_HOST_CONNS) {
+    fprintf(stderr, "connections per host %d is not in range [1..%d]\n", options->hostConns, MAX_HOST_CONNS);
+    exit(1);
+  }
+
+  // Ensure the frontier's memory limit, if given, is in range
+  if (options->maxInMemory != 0 && (options->maxInMemory < 2 || options->maxInMemory > MAX_IN_MEMORY)) {
+    fprintf(stderr, "pages kept in memory %d is not in range [2..%d]\n", options->maxInMemory, MAX_IN_MEMORY);
+    exit(1);
+  }
+
+  // Ensure the checkpoint interval, if given, is in range
+  if (options->checkpointSecs < 0 || options->checkpointSecs > MAX_CHECKPOINT) {
+    fprintf(stderr, "checkpoint interval %d is not in range [1..%d]\n", options->checkpointSecs, MAX_CHECKPOINT);
+    exit(1);
+  }
+  if (options->recrawl && (options->checkpointSecs > 0 || options->resume)) {
+    fprintf(stderr, "--recrawl cannot be used with --checkpoint or --resume\n");
+    exit(1);
+  }
+
+  // Ensure the page size limit is in range
+  if (options->maxBytes < 0 || options->maxBytes > MAX_BYTES) {
+    fprintf(stderr, "page size limit %d is not in range [0..%d]\n", options->maxBytes, MAX_BYTES);
+    exit(1);
+  }
+
+  // Ensure the deadlines are in range
+  const double timeouts[] = { options->connectSecs, options->firstByteSecs, options->fetchSecs };
+  for (int i = 0; i < 3; i++) {
+    if (!(timeouts[i] >= 0 && timeouts[i] <= MAX_TIMEOUT)) {
+      fprintf(stderr, "timeout %g is not in range [0..%g]\n", timeouts[i], MAX_TIMEOUT);
+      exit(1);
+    }
+  }
+
+  // Ensure the near-duplicate distance, if given, is in range
+  if (options->nearDistance < -1 || options->nearDistance > SIMHASH_MAX_DISTANCE) {
+    fprintf(stderr, "near-duplicate distance %d is not in range [0..%d]\n", options->nearDistance, SIMHASH_MAX_DISTANCE);
+    exit(1);
+  }
+}
+
+/**************** readSpec ****************/
+/* Read the seeds and scope of a crawl from a spec file: one directive per line, either 'seed URL',
+ * 'scope PREFIX' or a URL rule (see readRule), with blank lines and lines beginning with '#' ignored.
+ * Seeds and prefixes are normalized like any URL; if there is no 'scope' line, the scope is INTERNAL_PREFIX.
+ *
+ * Caller provides: 
+ *  path pathname of the spec file
+ *  spec pointer to spec_t struct with no seeds yet, an empty scope, and the default rules
+ *
+ * We only return on success; we exit non-zero if the file cannot be read, if a line is not a
+ * directive, if a URL cannot be normalized, or if there is no seed or a seed is out of scope
+ */
+static void readSpec(const char* path, spec_t* spec)
+{
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "could not read spec file %s\n", path);
+    exit(1);
+  }
+
+  int maxSeeds = 0;
+  bool scoped = false;
+  char* line;
+  for (int lineNumber = 1; (line = file_readLine(fp)) != NULL; lineNumber++) {
+    // Split the line into its directive and URL
+    char* directive = line + strspn(line, " \t");
+    size_t directiveLength = strcspn(directive, " \t\r");
+    char* url = directive + directiveLength;
+    url += strspn(url, " \t");
+    url[strcspn(url, " \t\r")] = '\0';
+    directive[directiveLength] = '\0';
+    if (*directive == '\0' || *directive == '#') {
+      free(line);
+      continue;
+    }
+
+    bool isSeed = (strcmp(directive, "seed") == 0);
+    if (!isSeed && strcmp(directive, "scope") != 0 && *url != '\0' && readRule(spec->rules, directive, url)) {
+      free(line);
+      continue;
+    }
+    if ((!isSeed && strcmp(directive, "scope") != 0) || *url == '\0') {
+      fprintf(stderr, "spec file %s line %d is not 'seed URL', 'scope PREFIX' or a URL rule\n", path, lineNumber);
+      exit(1);
+    }
+    char* normalURL = normalizeURL(url);
+    if (normalURL == NULL) {
+      fprintf(stderr, "spec file %s line %d: %s could not be normalized\n", path, lineNumber, url);
+      exit(1);
+    }
+    free(line);
+
+    if (isSeed) {
+      addSeed(spec, normalURL, &maxSeeds);
+    } else {
+      urlscope_add(spec->scope, normalURL);
+      free(normalURL);
+      scoped = true;
+    }
+  }
+  fclose(fp);
+
+  // Ensure there is a scope, and that every seed is in it
+  if (!scoped) {
+    urlscope_add(spec->scope, INTERNAL_PREFIX);
+  }
+  if (spec->numSeeds == 0) {
+    fprintf(stderr, "spec file %s has no seed\n", path);
+    exit(1);
+  }
+  for (int i = 0; i < spec->numSeeds; i++) {
+    if (urlscope_contains(spec->scope, spec->seeds[i]) == false) {
+      fprintf(stderr, "seed %s is not in the scope of spec file %s\n", spec->seeds[i], path);
+      exit(1);
+    }
+  }
+}
+
+/**************** readRule ****************/
+/* Apply a URL rule of a spec file to rules: 'strip-param NAME', 'sort-params on|off', or one of the
+ * crawl-trap limits 'max-repeats N', 'calendar-years N' and 'max-per-pattern N', N a non-negative integer.
+ *
+ * We return:
+ *  true if the directive is a rule with a valid value, false if not
+ */
+static bool readRule(urlrules_t* rules, const char* directive, const char* value)
+{
+  if (strcmp(directive, "strip-param") == 0) {
+    return urlrules_strip(rules, value);
+  }
+  if (strcmp(directive, "sort-params") == 0) {
+    bool on = (strcmp(value, "on") == 0);
+    if (on || strcmp(value, "off") == 0) {
+      urlrules_setSort(rules, on);
+      return true;
+    }
+    return false;
+  }
+
+  char* end = NULL;
+  long limit = strtol(value, &end, 10);
+  if (*end != '\0' || limit < 0 || limit > INT_MAX) {
+    return false;
+  }
+  if (strcmp(directive, "max-repeats") == 0) {
+    urlrules_setLimits(rules, limit, -1, -1);
+  } else if (strcmp(directive, "calendar-years") == 0) {
+    urlrules_setLimits(rules, -1, limit, -1);
+  } else if (strcmp(directive, "max-per-pattern") == 0) {
+    urlrules_setLimits(rules, -1, -1, limit);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**************** addSeed ****************/
+/* Append a seed, which the spec takes over, to spec->seeds, whose allocated size is *maxSeeds.
+ */
+static void addSeed(spec_t* spec, char* seed, int* maxSeeds)
+{
+  if (spec->numSeeds == *maxSeeds) {
+    *maxSeeds = (*maxSeeds == 0) ? 4 : 2 * *maxSeeds;
+    spec->seeds = mem_assert(realloc(spec->seeds, *maxSeeds * sizeof(char*)), "seeds array could not be allocated\n");
+  }
+  spec->seeds[spec->numSeeds++] = seed;
 }
 
 /**************** crawl ****************/
-/* Crawl from seedURL to maxDepth and save pages in pageDirectory.
+/* Crawl from the seeds of spec to maxDepth, within its scope, and save pages in pageDirectory.
  *
  * Caller provides: 
- *  seedURL seed URL string
+ *  spec pointer to spec_t struct with the seed URLs, scope and URL rules, all of which we free when done
  *  pageDirectory page directory string (where pages will be saved)
  *  maxDepth integer indicating the maximum crawl depth
+ *  options pointer to options_t struct: how many pages to fetch at once, the per-host limits,
+ *    the crawl order, how many pages to crawl may stay in memory, whether pagesSeen has a Bloom filter,
+ *    how often to checkpoint, whether to resume or recrawl, the longest page to download, and the deadlines
+ *    of each fetch
+ *
+ * Pages are saved with docIDs 1, 2, 3... in the order their fetches complete,
+ * so pageDirectory has no gaps in docIDs regardless of numWorkers or maxInFlight.
+ * Fetches from each host are held to the rate, burst and hostConns limits of the options,
+ * and a host whose fetches fail is backed off (see politeness.h).
+ * With options->maxInMemory, pages to crawl beyond that many spill to files in pageDirectory/.frontier,
+ * which is removed when the crawl is over.
+ * With options->checkpointSecs, the state of the crawl is saved to pageDirectory/.checkpoint that often
+ * (see checkpoint); with options->resume, the crawl carries on from there (see resumeCrawl).
+ * The checkpoint is removed once the crawl is over.
+ * With options->recrawl, the pages already in pageDirectory are fetched again if changed (see loadCrawled).
+ * Pages that are not HTML, or longer than options->maxBytes, are skipped as soon as their response header
+ * shows it (see pageFetched).
+ * A fetch that misses one of the deadlines of the options fails (and backs off its host), and is logged as
+ * timed out; if any did, the crawl ends by telling how many missed each deadline.
+ * With options->nearDistance, a page whose text nearly duplicates that of a page already saved is logged
+ * as such and dropped (see pageFetched); if any was, the crawl ends by telling how many.
+ * Links that look like crawl traps are skipped (see pageScan); if any was, the crawl ends by telling how many.
  */
-static void crawl(char* seedURL, char* pageDirectory, const int maxDepth)
+static void crawl(spec_t* spec, char* pageDirectory, const int maxDepth, const options_t* options)
 {
-  // Initialize pagesSeen hashtable and insert seedURL
-  hashtable_t* pagesSeen = mem_assert(hashtable_new(maxDepth + 1), "pagesSeen hashtable could not be initialized\n");
-  if (hashtable_insert(pagesSeen, seedURL, "") == false) {
-    fprintf(stderr, "could not insert seedURL %s to pagesSeen hashtable\n", seedURL);
-    exit(1);
+  crawl_t crawl = { .seeds = spec->seeds, .numSeeds = spec->numSeeds, .scope = spec->scope, .rules = spec->rules, .traps = 0, .pageDirectory = pageDirectory, .maxDepth = maxDepth, .nextDocID = 1,
+                    .busyWorkers = 0, .held = NULL, .maxHeld = 0, .checkpointSecs = options->checkpointSecs,
+                    .knownDocIDs = NULL, .fingerprints = NULL, .nearDups = 0 };
+
+  // Seed the random jitter of backoffs, so that crawlers do not retry in lockstep
+  srandom(time(NULL) ^ getpid());
+  crawl.polite = mem_assert(politeness_new(options->rate, options->burst, options->hostConns),
+                            "politeness scheduler could not be initialized\n");
+
+  pthread_mutex_init(&crawl.lock, NULL);
+  pthread_cond_init(&crawl.workReady, NULL);
+
+  // Have webpage_fetch (and the fetcher) give up on pages that are too long
+  webpage_setMaxBody(options->maxBytes);
+
+  // ... and on those that take too long (the deadlines are in milliseconds)
+  webpage_setDeadlines(options->connectSecs * 1000, options->firstByteSecs * 1000, options->fetchSecs * 1000);
+
+  // Initialize pagesToCrawl frontier
+  crawl.pagesToCrawl = frontier_new(options->order);
+
+  // Let pagesToCrawl spill to disk, if asked to
+  int spillDirLength = strlen(pageDirectory) + strlen("/.frontier") + 1;
+  char spillDir[spillDirLength];
+  snprintf(spillDir, spillDirLength, "%s/.frontier", pageDirectory);
+  if (options->maxInMemory > 0) {
+    removeFiles(spillDir); // left by a crawl that was killed; a checkpoint of it has their pages
+    if ((mkdir(spillDir, 0700) != 0 && errno != EEXIST)
+        || frontier_spill(crawl.pagesToCrawl, spillDir, options->maxInMemory) == false) {
+      fprintf(stderr, "could not spill pages to crawl to %s\n", spillDir);
+      exit(1);
+    }
   }
 
-  // Initialize pagesToCrawl bag and insert webpage with seedURL as URL, 0 as depth, and no HTML (yet)
-  bag_t* pagesToCrawl = mem_assert(bag_new(), "pagesToCrawl bag could not be initialized\n");
-  bag_insert(pagesToCrawl, webpage_new(seedURL, 0, NULL));
-  
-  // Crawl webpages to be crawled
-  int docID = 1;
-  webpage_t* webpage = NULL;
-  while ((webpage = bag_extract(pagesToCrawl)) != NULL) {
-    // Fetch webpage HTML
-    if (webpage_fetch(webpage) == true) {
-      printf("%d\tFetched: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+  if (options->resume) {
+    // Pick up pagesSeen, pagesToCrawl and nextDocID where the checkpoint left them
+    resumeCrawl(&crawl, options->bloom);
+  } else if (options->recrawl) {
+    // Start from the pages already saved, each to be fetched again if changed
+    loadCrawled(&crawl, options->bloom);
+  } else {
+    // Initialize pagesSeen set, and insert the seeds into it and into pagesToCrawl
+    crawl.pagesSeen = mem_assert(seenset_new(SEEN_EXPECTED, options->bloom), "pagesSeen set could not be initialized\n");
+    insertSeeds(&crawl);
+  }
+  crawl.nextCheckpoint = time(NULL) + crawl.checkpointSecs;
 
-      // Save webpage to pageDirectory
-      pagedir_save(webpage, pageDirectory, docID);
-      docID++;
+  // Fingerprint pages as they are saved, and those saved already, if near-duplicates are to be skipped
+  if (options->nearDistance >= 0) {
+    crawl.fingerprints = simhash_new(options->nearDistance);
+    loadFingerprints(&crawl);
+  }
 
-      // Scan webpage if we are not at maxDepth yet
-      if (webpage_getDepth(webpage) < maxDepth) {
-        printf("%d\tScanning: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
-        pageScan(webpage, pagesToCrawl, pagesSeen); // retrieve relevant links from HTML and enqueue their processing
+  if (options->maxInFlight > 0) {
+    // Crawl webpages to be crawled, all from this thread
+    crawlAsync(&crawl, options->maxInFlight);
+  } else {
+    // Crawl webpages to be crawled, with numWorkers threads pulling from pagesToCrawl
+    int numWorkers = options->numWorkers;
+    pthread_t workers[numWorkers];
+    for (int i = 0; i < numWorkers; i++) {
+      if (pthread_create(&workers[i], NULL, crawlWorker, &crawl) != 0) {
+        fprintf(stderr, "could not start crawl worker %d\n", i);
+        exit(1);
       }
     }
-    
-    webpage_delete(webpage);
+    for (int i = 0; i < numWorkers; i++) {
+      pthread_join(workers[i], NULL);
+    }
+  }
+
+  pthread_cond_destroy(&crawl.workReady);
+  pthread_mutex_destroy(&crawl.lock);
+
+  // Close connections kept open for reuse by webpage_fetch
+  webpage_closeConnections();
+
+  // Report the fetches that timed out, if any
+  int timedOut = crawl.timedOut[WEBPAGE_CONNECT_MISSED] + crawl.timedOut[WEBPAGE_FIRST_BYTE_MISSED]
+               + crawl.timedOut[WEBPAGE_TOTAL_MISSED];
+  if (timedOut > 0) {
+    printf("Timed out: %d fetches (%d connecting, %d awaiting a response, %d overall)\n", timedOut,
+           crawl.timedOut[WEBPAGE_CONNECT_MISSED], crawl.timedOut[WEBPAGE_FIRST_BYTE_MISSED],
+           crawl.timedOut[WEBPAGE_TOTAL_MISSED]);
+  }
+
+  // Report the near-duplicates skipped, if any
+  if (crawl.nearDups > 0) {
+    printf("Near-duplicates: %d pages skipped\n", crawl.nearDups);
+  }
+
+  // ... and the URLs skipped as crawl traps
+  if (crawl.traps > 0) {
+    printf("Crawl traps: %d URLs skipped\n", crawl.traps);
+  }
+
+  // The crawl is over, so any checkpoint is out of date
+  int checkpointPathLength = strlen(pageDirectory) + strlen("/.checkpoint") + 1;
+  char checkpointPath[checkpointPathLength];
+  snprintf(checkpointPath, checkpointPathLength, "%s/.checkpoint", pageDirectory);
+  unlink(checkpointPath);
+  free(crawl.held);
+  for (int i = 0; i < crawl.numSeeds; i++) {
+    free(crawl.seeds[i]);
+  }
+  free(crawl.seeds);
+
+  // Delete pagesSeen set, knownDocIDs and pagesToCrawl frontier
+  seenset_delete(crawl.pagesSeen);
+  if (crawl.knownDocIDs != NULL) {
+    hashtable_delete(crawl.knownDocIDs, free);
+  }
+  frontier_delete(crawl.pagesToCrawl, webpage_delete);
+  urlscope_delete(crawl.scope);
+  urlrules_delete(crawl.rules);
+  simhash_delete(crawl.fingerprints);
+  if (options->maxInMemory > 0) {
+    rmdir(spillDir);
+  }
+  politeness_delete(crawl.polite);
+}
+
+/**************** insertSeeds ****************/
+/* Insert each seed not yet in pagesSeen into it, and a webpage with (a copy of) it as URL, 0 as depth,
+ * and no HTML (yet) into pagesToCrawl; seeds listed twice are crawled once.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, with seeds, pagesSeen and pagesToCrawl set
+ */
+static void insertSeeds(crawl_t* crawl)
+{
+  for (int i = 0; i < crawl->numSeeds; i++) {
+    if (seenset_insert(crawl->pagesSeen, crawl->seeds[i])) {
+      char* seedCopy = mem_assert(malloc(strlen(crawl->seeds[i]) + 1), "seedURL could not be copied\n");
+      strcpy(seedCopy, crawl->seeds[i]);
+      frontier_insert(crawl->pagesToCrawl, webpage_new(seedCopy, 0, NULL));
+    }
+  }
+}
+
+/**************** crawlWorker ****************/
+/* Thread body of a fetch worker: repeatedly take a webpage from pagesToCrawl whose host may be
+ * fetched from now, fetch, save and scan it. A worker that finds only webpages of hosts that must
+ * wait sleeps until the soonest of them is ready, or until other workers add pages.
+ * The crawl is over once pagesToCrawl is empty and no worker holds a page (that could add more).
+ *
+ * Caller provides: 
+ *  arg pointer to crawl_t struct shared by all workers
+ *
+ * We return:
+ *  NULL, always
+ */
+static void* crawlWorker(void* arg)
+{
+  crawl_t* crawl = arg;
+
+  while (true) {
+    // Wait for a webpage to crawl, or for the crawl to be over
+    pthread_mutex_lock(&crawl->lock);
+    webpage_t* webpage = NULL;
+    long waitMillis = -1;
+    while ((webpage = takeReadyPage(crawl, &waitMillis)) == NULL && (waitMillis >= 0 || crawl->busyWorkers > 0)) {
+      waitForWork(crawl, waitMillis);
+    }
+    if (webpage == NULL) {
+      pthread_cond_broadcast(&crawl->workReady); // wake the others so they see it is over too
+      pthread_mutex_unlock(&crawl->lock);
+      return NULL;
+    }
+    crawl->busyWorkers++;
+    pthread_mutex_unlock(&crawl->lock);
+
+    // Fetch webpage HTML, then save and scan it
+    bool fetched = webpage_fetch(webpage);
+    pageFetched(crawl, webpage, fetched);
+
+    // Done with this webpage: its host has a connection free (see hostReady), and if that was the
+    // last one, idle workers may finish
+    pthread_mutex_lock(&crawl->lock);
+    crawl->busyWorkers--;
+    pthread_cond_broadcast(&crawl->workReady);
+    pthread_mutex_unlock(&crawl->lock);
+  }
+}
+
+/**************** crawlAsync ****************/
+/* Crawl with an event-driven fetcher instead of worker threads: keep up to maxInFlight pages
+ * from pagesToCrawl being fetched at once, and handle each as its fetch completes.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, with the seed page in pagesToCrawl
+ *  maxInFlight integer maximum number of pages being fetched at once
+ */
+static void crawlAsync(crawl_t* crawl, const int maxInFlight)
+{
+  fetcher_t* fetcher = mem_assert(fetcher_new(maxInFlight), "fetcher could not be initialized\n");
+
+  while (true) {
+    // Keep the fetcher supplied with pages to crawl whose hosts are ready (pageFetched adds new ones)
+    webpage_t* webpage = NULL;
+    long waitMillis = -1;
+    while (fetcher_pending(fetcher) < maxInFlight && (webpage = takeReadyPage(crawl, &waitMillis)) != NULL) {
+      fetcher_submit(fetcher, webpage, pageFetched, crawl);
+    }
+    if (fetcher_pending(fetcher) == 0 && waitMillis < 0) {
+      break; // nothing in flight and nothing left to crawl
+    }
+
+    // Let fetches progress, but no longer than until the next host is ready
+    if (fetcher_poll(fetcher, waitMillis) < 0) {
+      break;
+    }
+  }
+
+  fetcher_delete(fetcher);
+}
+
+/**************** takeReadyPage ****************/
+/* Take the first webpage from pagesToCrawl whose host may be fetched from now (see politeness_acquire),
+ * leaving the others in place. The webpage is held (see holdPage) until pageFetched is done with it.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, whose lock the caller holds (unless it is the only thread)
+ *  waitMillis pointer to long, set if we return NULL
+ *
+ * We return:
+ *  the webpage, to be fetched and handed to pageFetched; or
+ *  NULL if there is none, with *waitMillis set to how long until one may be ready,
+ *  or to -1 if pagesToCrawl is empty
+ */
+static webpage_t* takeReadyPage(crawl_t* crawl, long* waitMillis)
+{
+  readiness_t readiness = { .polite = crawl->polite, .waitMillis = -1 };
+  webpage_t* webpage = frontier_extractIf(crawl->pagesToCrawl, hostReady, &readiness);
+  *waitMillis = readiness.waitMillis;
+  if (webpage != NULL) {
+    holdPage(crawl, webpage, 0);
   }
+  return webpage;
+}
+
+/**************** hostReady ****************/
+/* Acceptance test for frontier_extractIf: is the webpage's host ready to be fetched from?
+ * If so, the fetch is accounted for with politeness_acquire; if not, note how long the host must wait,
+ * unless it is waiting for a connection to be free: then there is nothing to time, since whoever
+ * holds the connection wakes the waiters when done (crawlWorker), or the wait ends in fetcher_poll.
+ *
+ * Caller provides: 
+ *  arg pointer to readiness_t struct
+ *  webpage pointer to webpage_t struct
+ *
+ * We return:
+ *  true if the webpage may be fetched now
+ */
+static bool hostReady(void* arg, webpage_t* webpage)
+{
+  readiness_t* readiness = arg;
 
-  // Delete pagesSeen hashtable and pagesToCrawl bag
-  hashtable_delete(pagesSeen, NULL);
-  bag_delete(pagesToCrawl, NULL);
+  long wait = politeness_acquire(readiness->polite, webpage_getURL(webpage));
+  if (wait > 0 && (readiness->waitMillis < 0 || wait < readiness->waitMillis)) {
+    readiness->waitMillis = wait;
+  }
+  return wait == 0;
+}
+
+/**************** waitForWork ****************/
+/* Wait on workReady for a signal or, if waitMillis is not negative, at most waitMillis milliseconds.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, whose lock the caller holds
+ *  waitMillis longest time to wait, or -1 to wait for a signal however long it takes
+ */
+static void waitForWork(crawl_t* crawl, const long waitMillis)
+{
+  if (waitMillis < 0) {
+    pthread_cond_wait(&crawl->workReady, &crawl->lock);
+    return;
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += waitMillis / 1000;
+  deadline.tv_nsec += (waitMillis % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+  pthread_cond_timedwait(&crawl->workReady, &crawl->lock, &deadline);
+}
+
+/**************** pageFetched ****************/
+/* Handle a webpage whose fetch has completed: if successful, save it (and its validators) under
+ * the next docID, or under its docID if it is already in pageDirectory, and, if we are not at
+ * maxDepth yet, scan it for more pages to crawl. A page that has not changed (status 304) is left
+ * as it is, and one that was turned down, for not being HTML or being too long, is logged as ignored;
+ * one that missed a deadline is logged, and counted, as timed out. When near-duplicates are skipped, a
+ * new page whose fingerprint is near that of a page already saved is logged, and counted, as a
+ * near-duplicate, and neither saved nor scanned; any other new page has its fingerprint recorded.
+ * Either way, stop holding it, take a checkpoint if one is due, and delete it.
+ *
+ * Caller provides: 
+ *  arg pointer to crawl_t struct
+ *  webpage pointer to webpage_t struct that was fetched
+ *  success whether the fetch succeeded (and webpage has HTML)
+ */
+static void pageFetched(void* arg, webpage_t* webpage, bool success)
+{
+  crawl_t* crawl = arg;
+
+  // Free the fetch's slot for its host, backing the host off only if the fetch failed for want of a
+  // healthy server (no connection or response, a missed deadline, or a 5xx), not for a 404 or the like
+  int status = webpage_getStatus(webpage);
+  bool unchanged = (status == 304);
+  webpage_declined_t declined = webpage_getDeclined(webpage);
+  bool hostFailed = !success && (status == 0 || status >= 500 || webpage_getMissed(webpage) != WEBPAGE_IN_TIME);
+  politeness_release(crawl->polite, webpage_getURL(webpage), !hostFailed);
+
+  docid_t docID = 0;
+  docid_t original = 0; // docID of the page this one nearly duplicates, if any
+  if (success) {
+    // Fingerprint a new page's text, if near-duplicates are to be skipped (a page refetched keeps its docID)
+    docid_t* knownDocID = (crawl->knownDocIDs == NULL) ? NULL : hashtable_find(crawl->knownDocIDs, webpage_getURL(webpage));
+    uint64_t fingerprint;
+    bool fingerprinted = (crawl->fingerprints != NULL && knownDocID == NULL
+                          && simhash_fingerprint(webpage, &fingerprint));
+
+    // Claim the page's docID, or the next one if it is new, and note it for checkpoints;
+    // but a near-duplicate of a page already saved claims none
+    pthread_mutex_lock(&crawl->lock);
+    original = fingerprinted ? simhash_find(crawl->fingerprints, fingerprint) : 0;
+    if (original == 0) {
+      docID = (knownDocID != NULL) ? *knownDocID : crawl->nextDocID++;
+      holdPage(crawl, webpage, docID);
+      if (fingerprinted) {
+        simhash_insert(crawl->fingerprints, fingerprint, docID);
+      }
+    } else {
+      crawl->nearDups++;
+    }
+    pthread_mutex_unlock(&crawl->lock);
+  }
+
+  if (original != 0) {
+    printf("%d\tNearDup: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+  } else if (success) {
+    printf("%d\tFetched: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+
+    // Save webpage to pageDirectory, with what a later recrawl needs to ask whether it has changed;
+    // a page with the very same HTML as one saved before is saved as an alias of it (but still scanned,
+    // since its relative links may lead elsewhere)
+    if (pagedir_save(webpage, crawl->pageDirectory, docID) != docID) {
+      printf("%d\tAlias: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+    }
+    pagedir_saveValidators(crawl->pageDirectory, docID, webpage_getETag(webpage), webpage_getLastModified(webpage));
+
+    // Scan webpage if we are not at maxDepth yet
+    if (webpage_getDepth(webpage) < crawl->maxDepth) {
+      printf("%d\tScanning: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+      pageScan(webpage, crawl); // retrieve relevant links from HTML and enqueue their processing
+    }
+  } else if (unchanged) {
+    printf("%d\tUnchanged: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+  } else if (declined == WEBPAGE_NOT_HTML) {
+    printf("%d\tIgnType: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+  } else if (declined == WEBPAGE_TOO_LARGE) {
+    printf("%d\tIgnSize: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+  } else if (webpage_getMissed(webpage) != WEBPAGE_IN_TIME) {
+    printf("%d\tTimedOut: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+  }
+
+  // Done with the webpage; save the crawl, if it is time to
+  pthread_mutex_lock(&crawl->lock);
+  if (webpage_getMissed(webpage) != WEBPAGE_IN_TIME) {
+    crawl->timedOut[webpage_getMissed(webpage)]++;
+  }
+  holdPage(crawl, webpage, -1);
+  if (crawl->checkpointSecs > 0 && time(NULL) >= crawl->nextCheckpoint) {
+    checkpoint(crawl);
+    crawl->nextCheckpoint = time(NULL) + crawl->checkpointSecs;
+  }
+  pthread_mutex_unlock(&crawl->lock);
+
+  webpage_delete(webpage);
 }
 
 /**************** pageScan ****************/
-/* Given a webpage, scan the given page to extract any links (URLs), ignoring non-internal URLs
+/* Given a webpage, scan the given page to extract any links (URLs), ignoring URLs outside the crawl's scope
+ * and those that look like crawl traps.
+ * The links are all extracted at once, in one pass over the HTML (see webpage_getAllURLs), normalized and
+ * their queries canonicalized in place (see urlrules_canonicalize), then checked against the scope, the
+ * trap heuristics and pagesSeen and added to pagesToCrawl all at once, so that the crawl's lock is taken
+ * once per page rather than once per link. Filtering the links allocates nothing but the pattern of each
+ * new URL (see urlrules_count); only the URLs added to pagesToCrawl are copied.
  *
  * Caller provides: 
  *  page pointer to webpage_t struct
- *  pagesToCrawl pointer to bag_t struct that keeps track of pages to be crawled
- *  pagesSeen pointer to hashtable_t struct that keeps track of URLs already visited
+ *  crawl pointer to crawl_t struct whose pagesToCrawl and pagesSeen receive the links
  */
-static void pageScan(webpage_t* page, bag_t* pagesToCrawl, hashtable_t* pagesSeen)
+static void pageScan(webpage_t* page, crawl_t* crawl)
 {
-  // Initialize position (in HTML) and URL variables
-  int pos = 0;
-  char* URL  = NULL;
+  int depth = webpage_getDepth(page);
+
+  // Collect the URLs of all links, and normalize them in place (dropping those that cannot be),
+  // canonicalizing their queries too
+  int numURLs = 0;
+  char** links = mem_assert(webpage_getAllURLs(page, &numURLs), "links array could not be allocated\n");
+  int numLinks = 0;
+  for (int i = 0; i < numURLs; i++) {
+    if (normalizeURLInto(links[i], links[i], strlen(links[i]) + 1) > 0) {
+      urlrules_canonicalize(crawl->rules, links[i]);
+      links[numLinks++] = links[i];
+    }
+  }
 
   // Enqueue the processing of relevant URLs
-  while ((URL = webpage_getNextURL(page, &pos)) != NULL) {
-    char* normalURL = normalizeURL(URL);
-    printf("%d\tFound: %s\n", webpage_getDepth(page), normalURL);
-
-    // Ensure the URL is internal
-    if (isInternalURL(normalURL) == false) {
-      printf("%d\tIgnExtrn: %s\n", webpage_getDepth(page), normalURL);
-      free(URL);
-      free(normalURL);
+  webpage_t** newPages = mem_assert(malloc((numLinks + 1) * sizeof(webpage_t*)), "new pages array could not be allocated\n");
+  int numNewPages = 0;
+  pthread_mutex_lock(&crawl->lock);
+  for (int i = 0; i < numLinks; i++) {
+    char* normalURL = links[i];
+    printf("%d\tFound: %s\n", depth, normalURL);
+
+    // Ensure the URL is in scope
+    if (urlscope_contains(crawl->scope, normalURL) == false) {
+      printf("%d\tIgnExtrn: %s\n", depth, normalURL);
       continue;
     }
 
-    // Ensure the URL has not been visited already
-    if (hashtable_insert(pagesSeen, normalURL, "") == false) { 
-      printf("%d\tIgnDupl: %s\n", webpage_getDepth(page), normalURL);
-      free(URL);
-      free(normalURL);
+    // Ensure the URL does not look like a crawl trap, nor is new and of a pattern with too many URLs already
+    if (urlrules_isTrap(crawl->rules, normalURL) != URLRULES_NO_TRAP
+        || (!seenset_contains(crawl->pagesSeen, normalURL) && !urlrules_count(crawl->rules, normalURL))) {
+      printf("%d\tIgnTrap: %s\n", depth, normalURL);
+      crawl->traps++;
+      continue;
+    }
+
+    // Ensure the URL has not been visited already, and if so mark it as a webpage to crawl
+    if (seenset_insert(crawl->pagesSeen, normalURL) == false) {
+      printf("%d\tIgnDupl: %s\n", depth, normalURL);
+      continue;
+    }
+    printf("%d\tAdded: %s\n", depth, normalURL);
+    char* URL = mem_assert(malloc(strlen(normalURL) + 1), "URL could not be copied\n");
+    strcpy(URL, normalURL);
+    newPages[numNewPages++] = webpage_new(URL, depth + 1, NULL); // webpage_delete will free URL
+  }
+  frontier_insertAll(crawl->pagesToCrawl, newPages, numNewPages);
+  if (numNewPages > 0) {
+    pthread_cond_broadcast(&crawl->workReady);
+  }
+  pthread_mutex_unlock(&crawl->lock);
+
+  free(newPages);
+  free(links);
+}
+
+/**************** holdPage ****************/
+/* Record what has become of a webpage taken from pagesToCrawl, so that checkpoints include it.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, whose lock the caller holds (unless it is the only thread)
+ *  webpage pointer to webpage_t struct
+ *  docID 0 when the webpage is taken, its docID once it has one, or -1 when it is done with
+ */
+static void holdPage(crawl_t* crawl, webpage_t* webpage, const docid_t docID)
+{
+  // Find the webpage's slot, or a free one for a webpage just taken
+  webpage_t* find = (docID == 0) ? NULL : webpage;
+  int slot = 0;
+  while (slot < crawl->maxHeld && crawl->held[slot].page != find) {
+    slot++;
+  }
+  if (slot == crawl->maxHeld) {
+    if (find != NULL) {
+      return; // not held
+    }
+    crawl->maxHeld = (crawl->maxHeld == 0) ? 16 : 2 * crawl->maxHeld;
+    crawl->held = mem_assert(realloc(crawl->held, crawl->maxHeld * sizeof(held_t)), "held pages array could not be grown\n");
+    for (int i = slot; i < crawl->maxHeld; i++) {
+      crawl->held[i].page = NULL;
+    }
+  }
+
+  crawl->held[slot].page = (docID < 0) ? NULL : webpage;
+  crawl->held[slot].docID = docID;
+}
+
+/**************** checkpoint ****************/
+/* Save the state of the crawl to pageDirectory/.checkpoint: first seed, maxDepth and nextDocID, the held
+ * webpages (those taken from pagesToCrawl but not done with), then pagesSeen, pagesToCrawl, and the
+ * counts of URLs per pattern of the URL rules.
+ * The checkpoint is written to pageDirectory/.checkpoint.part and then renamed, so that a crash while
+ * writing leaves the previous checkpoint in place. A checkpoint that cannot be written is reported,
+ * and the crawl goes on.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, whose lock the caller holds
+ */
+static void checkpoint(crawl_t* crawl)
+{
+  int pathLength = strlen(crawl->pageDirectory) + strlen("/.checkpoint.part") + 1;
+  char path[pathLength];
+  char partPath[pathLength];
+  snprintf(path, pathLength, "%s/.checkpoint", crawl->pageDirectory);
+  snprintf(partPath, pathLength, "%s/.checkpoint.part", crawl->pageDirectory);
+
+  FILE* fp = fopen(partPath, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "could not write checkpoint %s\n", path);
+    return;
+  }
+
+  int numHeld = 0;
+  for (int i = 0; i < crawl->maxHeld; i++) {
+    numHeld += (crawl->held[i].page != NULL);
+  }
+  fprintf(fp, "%s\n%s\n%d %" PRIdocid " %d\n", CHECKPOINT_HEADER, crawl->seeds[0], crawl->maxDepth, crawl->nextDocID, numHeld);
+  for (int i = 0; i < crawl->maxHeld; i++) {
+    if (crawl->held[i].page != NULL) {
+      fprintf(fp, "%" PRIdocid " %d %s\n", crawl->held[i].docID, webpage_getDepth(crawl->held[i].page),
+              webpage_getURL(crawl->held[i].page));
+    }
+  }
+  bool saved = seenset_save(crawl->pagesSeen, fp) && frontier_save(crawl->pagesToCrawl, fp)
+               && urlrules_save(crawl->rules, fp);
+
+  if (fclose(fp) != 0 || !saved || rename(partPath, path) != 0) {
+    fprintf(stderr, "could not write checkpoint %s\n", path);
+    unlink(partPath);
+  }
+}
+
+/**************** resumeCrawl ****************/
+/* Restore the state of the crawl from pageDirectory/.checkpoint, as written by checkpoint: pagesSeen,
+ * pagesToCrawl, nextDocID and the pattern counts of the URL rules are as they were then (a checkpoint
+ * from before the counts were saved leaves them at 0). Page files saved since then (docIDs from nextDocID on)
+ * are removed, as their pages are in pagesToCrawl again. Held webpages without a docID go back to
+ * pagesToCrawl; those with one are finished off (see finishHeldPage).
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, with seeds, pageDirectory, maxDepth and rules set, and pagesToCrawl empty
+ *  bloom whether pagesSeen should have a Bloom filter
+ *
+ * We only return on success; we exit non-zero if there is no checkpoint, if it is of another crawl
+ * (different first seed or maxDepth), or if it is corrupt
+ */
+static void resumeCrawl(crawl_t* crawl, const bool bloom)
+{
+  int pathLength = strlen(crawl->pageDirectory) + strlen("/.checkpoint") + 1;
+  char path[pathLength];
+  snprintf(path, pathLength, "%s/.checkpoint", crawl->pageDirectory);
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "no checkpoint to resume from in %s\n", crawl->pageDirectory);
+    exit(1);
+  }
+
+  // Ensure the checkpoint is of this crawl
+  char* header = file_readLine(fp);
+  char* seedURL = file_readLine(fp);
+  int maxDepth, numHeld;
+  docid_t nextDocID;
+  bool counted = (header != NULL && strcmp(header, CHECKPOINT_HEADER) == 0);
+  bool valid = (header != NULL && (counted || strcmp(header, CHECKPOINT_HEADER_V1) == 0) && seedURL != NULL
+                && fscanf(fp, "%d %" SCNdocid " %d ", &maxDepth, &nextDocID, &numHeld) == 3 && nextDocID >= 1 && numHeld >= 0);
+  if (valid && (strcmp(seedURL, crawl->seeds[0]) != 0 || maxDepth != crawl->maxDepth)) {
+    fprintf(stderr, "checkpoint %s is of a crawl from %s to depth %d\n", path, seedURL, maxDepth);
+    exit(1);
+  }
+  free(header);
+  free(seedURL);
+
+  // Read the held webpages, then pagesSeen, pagesToCrawl and the pattern counts
+  webpage_t** heldPages = mem_assert(calloc(valid ? numHeld + 1 : 1, sizeof(webpage_t*)), "held pages array could not be allocated\n");
+  docid_t* heldDocIDs = mem_assert(calloc(valid ? numHeld + 1 : 1, sizeof(docid_t)), "held pages array could not be allocated\n");
+  for (int i = 0; valid && i < numHeld; i++) {
+    int depth;
+    char* URL = NULL;
+    valid = (fscanf(fp, "%" SCNdocid " %d ", &heldDocIDs[i], &depth) == 2 && heldDocIDs[i] >= 0 && heldDocIDs[i] < nextDocID
+             && (URL = file_readLine(fp)) != NULL);
+    if (valid) {
+      heldPages[i] = webpage_new(URL, depth, NULL);
+    }
+  }
+  valid = valid && (crawl->pagesSeen = seenset_load(fp, bloom)) != NULL && frontier_load(crawl->pagesToCrawl, fp)
+          && (!counted || urlrules_load(crawl->rules, fp));
+  fclose(fp);
+  if (!valid) {
+    fprintf(stderr, "checkpoint %s is corrupt (or was taken with --bloom, without which it cannot be resumed)\n", path);
+    exit(1);
+  }
+  crawl->nextDocID = nextDocID;
+
+  // Pages saved since the checkpoint will be crawled again, and are dropped from .contents along with their aliases
+  pagedir_removeFrom(crawl->pageDirectory, nextDocID);
+  pagedir_trimContents(crawl->pageDirectory, nextDocID);
+
+  // Carry on with the held webpages
+  for (int i = 0; i < numHeld; i++) {
+    if (heldDocIDs[i] == 0) {
+      frontier_insert(crawl->pagesToCrawl, heldPages[i]);
+    } else {
+      finishHeldPage(crawl, heldPages[i], heldDocIDs[i]);
+    }
+  }
+  free(heldPages);
+  free(heldDocIDs);
+}
+
+/**************** finishHeldPage ****************/
+/* Finish off a webpage that had claimed a docID when the checkpoint was taken, but may not have been
+ * saved or scanned: load it from its page file if that was saved (page files are never half-written),
+ * or else fetch it again and save it under its docID; then scan it, if we are not at maxDepth yet
+ * (links found before are ignored as duplicates), with the HTML of the page it is an alias of, if it is one.
+ * Either way, delete it.
+ * A webpage that cannot be fetched again is saved with no HTML, so that docIDs stay consecutive.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct
+ *  webpage pointer to webpage_t struct, with no HTML
+ *  docID docID claimed by the webpage
+ */
+static void finishHeldPage(crawl_t* crawl, webpage_t* webpage, const docid_t docID)
+{
+  webpage_t* saved = pagedir_load(crawl->pageDirectory, docID);
+  if (saved != NULL) {
+    webpage_delete(webpage);
+    webpage = saved;
+
+    // An alias has no HTML of its own; scan that of the page it is an alias of
+    docid_t alias[2] = { docID, docID };
+    pagedir_loadAliases(crawl->pageDirectory, alias, aliasOf);
+    webpage_t* original = (alias[1] == docID) ? NULL : pagedir_load(crawl->pageDirectory, alias[1]);
+    if (original != NULL && webpage_getHTML(original) != NULL) {
+      char* URL = mem_assert(malloc(strlen(webpage_getURL(webpage)) + 1), "URL could not be copied\n");
+      strcpy(URL, webpage_getURL(webpage));
+      char* HTML = mem_assert(malloc(strlen(webpage_getHTML(original)) + 1), "HTML could not be copied\n");
+      strcpy(HTML, webpage_getHTML(original));
+      webpage_t* copy = webpage_new(URL, webpage_getDepth(webpage), HTML);
+      webpage_delete(webpage);
+      webpage = copy;
+    }
+    webpage_delete(original);
+  } else {
+    if (webpage_fetch(webpage)) {
+      printf("%d\tFetched: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+    } else {
+      fprintf(stderr, "could not fetch %s again; saving it with no HTML as docID %" PRIdocid "\n",
+              webpage_getURL(webpage), docID);
+      char* URL = mem_assert(malloc(strlen(webpage_getURL(webpage)) + 1), "URL could not be copied\n");
+      strcpy(URL, webpage_getURL(webpage));
+      char* HTML = mem_assert(calloc(1, 1), "HTML could not be allocated\n");
+      webpage_t* empty = webpage_new(URL, webpage_getDepth(webpage), HTML);
+      webpage_delete(webpage);
+      webpage = empty;
+    }
+    if (pagedir_save(webpage, crawl->pageDirectory, docID) != docID) {
+      printf("%d\tAlias: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+    }
+  }
+
+  if (webpage_getDepth(webpage) < crawl->maxDepth) {
+    printf("%d\tScanning: %s\n", webpage_getDepth(webpage), webpage_getURL(webpage));
+    pageScan(webpage, crawl);
+  }
+  webpage_delete(webpage);
+}
+
+/**************** aliasOf ****************/
+/* pagedir_loadAliases itemfunc: arg points to two docIDs, a docID and the docID holding its content
+ * (initially itself), which is updated whenever docID comes by.
+ */
+static void aliasOf(void* arg, const docid_t docID, const docid_t canonicalDocID)
+{
+  docid_t* alias = arg;
+  if (docID == alias[0]) {
+    alias[1] = canonicalDocID;
+  }
+}
+
+/**************** removeFiles ****************/
+/* Remove the files in directory, if it exists (but not subdirectories, nor directory itself).
+ *
+ * Caller provides: 
+ *  directory directory path string
+ */
+static void removeFiles(const char* directory)
+{
+  DIR* dir = opendir(directory);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+      int pathLength = strlen(directory) + strlen("/") + strlen(entry->d_name) + 1;
+      char path[pathLength];
+      snprintf(path, pathLength, "%s/%s", directory, entry->d_name);
+      unlink(path);
+    }
+  }
+  closedir(dir);
+}
+
+/**************** loadCrawled ****************/
+/* Set up a recrawl of the pages already in pageDirectory (docIDs 1, 2, 3... up to the first missing):
+ * each goes into pagesSeen, knownDocIDs and pagesToCrawl, with the depth it was found at and the
+ * validators recorded for it (see pagedir_saveValidators), so that it is fetched again only if it
+ * has changed. New pages found on changed pages get docIDs after the last one. Seeds not among them
+ * are crawled as new.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, with seeds and pageDirectory set, and pagesToCrawl empty
+ *  bloom whether pagesSeen should have a Bloom filter
+ *
+ * We only return on success; we exit non-zero if pageDirectory holds no pages
+ */
+static void loadCrawled(crawl_t* crawl, const bool bloom)
+{
+  // Load the URL and depth of each page, in docID order
+  int numPages = 0;
+  int maxPages = 16;
+  webpage_t** pages = mem_assert(malloc(maxPages * sizeof(webpage_t*)), "pages array could not be allocated\n");
+  webpage_t* page;
+  while ((page = pagedir_loadHeader(crawl->pageDirectory, numPages + 1)) != NULL) {
+    if (numPages == maxPages) {
+      maxPages *= 2;
+      pages = mem_assert(realloc(pages, maxPages * sizeof(webpage_t*)), "pages array could not be grown\n");
+    }
+    pages[numPages++] = page;
+  }
+  if (numPages == 0) {
+    fprintf(stderr, "no pages to recrawl in %s\n", crawl->pageDirectory);
+    exit(1);
+  }
+
+  // Give them the validators they were last saved with
+  crawled_t crawled = { .pages = pages, .numPages = numPages };
+  if (!pagedir_loadValidators(crawl->pageDirectory, &crawled, setValidators)) {
+    fprintf(stderr, "could not read validators in %s; refetching every page\n", crawl->pageDirectory);
+  }
+
+  // They have all been seen, and keep their docIDs
+  crawl->pagesSeen = mem_assert(seenset_new(numPages > SEEN_EXPECTED ? numPages : SEEN_EXPECTED, bloom),
+                                "pagesSeen set could not be initialized\n");
+  crawl->knownDocIDs = mem_assert(hashtable_new(numPages + 1), "knownDocIDs hashtable could not be initialized\n");
+  for (int i = 0; i < numPages; i++) {
+    docid_t* docID = mem_assert(malloc(sizeof(docid_t)), "docID could not be allocated\n");
+    *docID = i + 1;
+    if (!seenset_insert(crawl->pagesSeen, webpage_getURL(pages[i]))
+        || !hashtable_insert(crawl->knownDocIDs, webpage_getURL(pages[i]), docID)) {
+      free(docID); // saved twice; the first docID wins
+      webpage_delete(pages[i]);
       continue;
     }
+    frontier_insert(crawl->pagesToCrawl, pages[i]);
+  }
+  free(pages);
+  crawl->nextDocID = numPages + 1;
 
-    // Initialize and mark it as a webpage to crawl
-    bag_insert(pagesToCrawl, webpage_new(normalURL, webpage_getDepth(page) + 1, NULL));
-    printf("%d\tAdded: %s\n", webpage_getDepth(page), normalURL);
-    
-    free(URL); // only free URL since webpage_delete will eventually take care of normalURL
+  // The seeds may be new
+  insertSeeds(crawl);
+}
+
+/**************** loadFingerprints ****************/
+/* Record the fingerprint of each page already in pageDirectory (docIDs 1 up to nextDocID), as when
+ * resuming or recrawling, so that new pages nearly duplicating them are skipped too.
+ *
+ * Caller provides: 
+ *  crawl pointer to crawl_t struct, with pageDirectory, nextDocID and fingerprints set
+ */
+static void loadFingerprints(crawl_t* crawl)
+{
+  for (docid_t docID = 1; docID < crawl->nextDocID; docID++) {
+    webpage_t* page = pagedir_load(crawl->pageDirectory, docID);
+    uint64_t fingerprint;
+    if (page != NULL && simhash_fingerprint(page, &fingerprint)) {
+      simhash_insert(crawl->fingerprints, fingerprint, docID);
+    }
+    webpage_delete(page);
+  }
+}
+
+/**************** setValidators ****************/
+/* Item function for pagedir_loadValidators: give the page with docID its validators.
+ *
+ * Caller provides: 
+ *  arg pointer to crawled_t struct
+ *  docID, etag, lastModified as read
+ */
+static void setValidators(void* arg, const docid_t docID, const char* etag, const char* lastModified)
+{
+  crawled_t* crawled = arg;
+  if (docID >= 1 && docID <= crawled->numPages) {
+    webpage_setValidators(crawled->pages[docID - 1], etag, lastModified);
   }
 }
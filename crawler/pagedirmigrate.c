@@ -0,0 +1,50 @@
+/* 
+ * pagedirmigrate - program that moves the page files of a crawler-produced directory from the flat
+ *                  layout into the sharded one (see pagedir.h)
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "../common/pagedir.h"
+
+/**************** main ****************/
+/* Entry point of the program. Validate correct usage and pageDirectory, then migrate it.
+ *
+ * Caller provides: 
+ *  argc  number of command-line arguments
+ *  argv  string array of the command-line arguments
+ *
+ * We return:
+ *  0 on success, 1 on failure
+ *
+ * Usage:
+ *  ./pagedirmigrate pageDirectory
+ *    pageDirectory - pathname of a directory produced by the crawler; no crawler, indexer or
+ *                    querier should be using it meanwhile
+ */
+int main(const int argc, char* argv[])
+{
+  // Ensure correct number of command-line arguments
+  if (argc != 2) {
+    fprintf(stderr, "usage: ./pagedirmigrate pageDirectory\n\tpageDirectory - pathname of a directory ");
+    fprintf(stderr, "produced by the crawler\n");
+    exit(1);
+  }
+
+  // Ensure pageDirectory is crawler-produced (a migration cut short leaves docID 1 moved, so it is not
+  // required then)
+  int moved = pagedir_migrate(argv[1]);
+  if (moved < 0) {
+    fprintf(stderr, "failed migrating pageDirectory %s\n", argv[1]);
+    exit(1);
+  }
+  if (pagedir_validate(argv[1]) == false) {
+    fprintf(stderr, "pageDirectory %s is not crawler-produced\n", argv[1]);
+    exit(1);
+  }
+
+  printf("%d page files moved\n", moved);
+  exit(0);
+}
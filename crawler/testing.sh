@@ -27,6 +27,63 @@
 # Out of range maxDepth
 ./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 11
 
+# Out of range number of workers
+./crawler --workers 0 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Non-numeric number of workers
+./crawler --workers many http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Both worker threads and asynchronous fetches
+./crawler --workers 4 --async 50 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Unknown option
+./crawler --bogus http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Out of range politeness limits
+./crawler --rate -1 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+./crawler --burst 0 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+./crawler --host-conns 0 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Non-numeric rate
+./crawler --rate fast http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Unknown crawl order
+./crawler --order random http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Unknown page store
+./crawler --store tape http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Unknown compression
+./crawler --compress zip http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Out of range frontier memory limit
+./crawler --spill 1 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Out of range checkpoint interval
+./crawler --checkpoint 100000 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Resume with no checkpoint to resume from
+./crawler --resume http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Recrawl combined with checkpointing
+./crawler --recrawl --checkpoint 10 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Out of range page size limit
+./crawler --max-bytes -1 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Out of range timeout
+./crawler --fetch-timeout 4000 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Out of range near-duplicate distance
+./crawler --near-dups 8 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
+# Spec file with a seed outside its scope
+printf 'seed http://cs50tse.cs.dartmouth.edu/tse/letters/index.html\nscope http://cs50tse.cs.dartmouth.edu/tse/toscrape/\n' > ../data/outside.spec
+./crawler --spec ../data/outside.spec ../data/letters 2
+
+# Spec file and seedURL both given
+./crawler --spec ../data/outside.spec http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2
+
 ## Run with valgrind over moderate-sized test case
 
 valgrind --leak-check=full --show-leak-kinds=all ./crawler http://cs50tse.cs.dartmouth.edu/tse/toscrape/index.html ../data/toscrape-1 1
@@ -45,6 +102,100 @@ valgrind --leak-check=full --show-leak-kinds=all ./crawler http://cs50tse.cs.dar
 # letters at depth 10
 ./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10 10
 
+# letters at depth 10, with 8 fetch workers
+./crawler --workers 8 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-w8 10
+
+# letters at depth 10, with up to 50 asynchronous fetches
+./crawler --async 50 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-a50 10
+
+# letters at depth 10, with 8 fetch workers allowed 10 requests per second, 4 at once
+./crawler --workers 8 --rate 10 --burst 4 --host-conns 4 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-r10 10
+
+# letters at depth 10, crawling pages in discovery order and round-robin across hosts
+./crawler --order discovery http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-od 10
+./crawler --order host http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-oh 10
+
+# letters at depth 10, keeping at most 2 pages to crawl in memory (same pages as letters-10)
+./crawler --spill 2 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-s2 10
+
+# letters at depth 1, with a page file per page (in shards) instead of segment files, as listed
+./crawler --store files http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-1-files 1
+cat ../data/letters-1-files/.crawler
+find ../data/letters-1-files -type f -name '[0-9]*' | wc -l
+ls ../data/letters-1
+
+# letters at depth 10, with compressed HTML in page files and in the segment store (same pages as letters-10,
+# their depth lines naming the codec); toscrape at depth 1, compressed against a dictionary trained on its first pages
+./crawler --store files --compress lz http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-lz 10
+cat ../data/letters-10-lz/.crawler
+./crawler --compress lz http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-lzs 10
+./crawler --compress lz-dict http://cs50tse.cs.dartmouth.edu/tse/toscrape/index.html ../data/toscrape-1-lzd 1
+ls -a ../data/toscrape-1-lzd
+
+# letters at depth 10, with a page size limit below that of the seed page (437 bytes), which is
+# logged as IgnSize and not saved or scanned, so nothing is crawled
+./crawler --max-bytes 430 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-s 10
+
+# letters at depth 10, with pagesSeen a Bloom filter (same pages as letters-10, barring a false positive)
+./crawler --bloom http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-b 10
+
+# letters at depth 10, checkpointing every second, killed after 5 seconds and then resumed (same pages as letters-10)
+timeout -s KILL 5 ./crawler --checkpoint 1 http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-cp 10
+./crawler --resume http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10-cp 10
+
+# letters at depth 10 again, into letters-10: unchanged pages are not fetched again, and keep their docIDs
+./crawler --recrawl http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-10 10
+
+# letters at depth 1 into a pageDirectory in the flat layout (its .crawler empty, as earlier crawlers left
+# it), which stays flat; then migrated to the sharded layout, and migrated again, which moves nothing
+mkdir -p ../data/letters-1-flat
+: > ../data/letters-1-flat/.crawler
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-1-flat 1
+ls ../data/letters-1-flat
+./pagedirmigrate ../data/letters-1-flat
+cat ../data/letters-1-flat/.crawler
+find ../data/letters-1-flat -type f -name '[0-9]*' | sort
+./pagedirmigrate ../data/letters-1-flat
+
+# Migrating a directory that is not crawler-produced
+./pagedirmigrate ../data/nonexistent
+
+# letters and toscrape at depth 1 in one crawl, each seed kept to its own site by the scope
+printf '# two sites\nseed http://cs50tse.cs.dartmouth.edu/tse/letters/index.html\nseed http://cs50tse.cs.dartmouth.edu/tse/toscrape/index.html\nscope http://cs50tse.cs.dartmouth.edu/tse/letters/\nscope http://cs50tse.cs.dartmouth.edu/tse/toscrape/\n' > ../data/two-sites.spec
+./crawler --spec ../data/two-sites.spec ../data/two-sites-1 1
+
+# a local site whose links have spaces in them, which are sent (and saved) as %20
+mkdir -p ../data/spaces-site ../data/spaces-1
+printf '<html><a href="sp ace.html">one</a> <a href=" two  spaces.html ">two</a></html>\n' > ../data/spaces-site/index.html
+printf '<html>one space</html>\n' > "../data/spaces-site/sp ace.html"
+printf '<html>two spaces</html>\n' > "../data/spaces-site/two  spaces.html"
+python3 -m http.server 8050 --bind 127.0.0.1 --directory ../data/spaces-site > /dev/null 2>&1 &
+sleep 1
+printf 'seed http://localhost:8050/index.html\nscope http://localhost:8050/\n' > ../data/spaces.spec
+./crawler --spec ../data/spaces.spec ../data/spaces-1 1
+kill $!
+
+# a local site with crawl traps and tracking parameters: the two links to a.html become one, and the
+# far-off calendar month (past calendar-years 10), the repeating path (past max-repeats 3) and the fourth
+# item (past max-per-pattern 3) are IgnTrap; the limits are off unless the spec sets them
+mkdir -p ../data/traps-site/cal/2099 ../data/traps-site/x/x/x/x ../data/traps-1
+printf '<html><a href="a.html?utm_source=x&b=2&a=1">a</a> <a href="a.html?a=1&b=2&SessionID=9">a</a> <a href="cal/2099/01.html">cal</a> <a href="x/x/x/x/y.html">x</a> <a href="item1.html">1</a> <a href="item2.html">2</a> <a href="item3.html">3</a> <a href="item4.html">4</a></html>\n' > ../data/traps-site/index.html
+for page in a.html cal/2099/01.html x/x/x/x/y.html item1.html item2.html item3.html item4.html; do
+  printf '<html>%s</html>\n' "$page" > "../data/traps-site/$page"
+done
+python3 -m http.server 8051 --bind 127.0.0.1 --directory ../data/traps-site > /dev/null 2>&1 &
+sleep 1
+printf 'seed http://localhost:8051/index.html\nscope http://localhost:8051/\nmax-repeats 3\ncalendar-years 10\nmax-per-pattern 3\n' > ../data/traps.spec
+./crawler --spec ../data/traps.spec ../data/traps-1 1
+kill $!
+
+# A spec file with a URL rule that is not one
+printf 'seed http://cs50tse.cs.dartmouth.edu/tse/letters/index.html\nmax-repeats many\n' > ../data/bad-rule.spec
+./crawler --spec ../data/bad-rule.spec ../data/letters 1
+
+# toscrape at depth 1, skipping pages whose text nearly duplicates one already saved (logged as NearDup)
+./crawler --near-dups 3 http://cs50tse.cs.dartmouth.edu/tse/toscrape/index.html ../data/toscrape-1-nd 1
+
 # toscrape at depth 0
 ./crawler http://cs50tse.cs.dartmouth.edu/tse/toscrape/index.html ../data/toscrape-0 0
 
@@ -6,16 +6,19 @@
 
 #include <string.h>
 #include "../common/index.h"
+#include "../common/docstore.h"
 #include "../common/pagedir.h"
 #include "../common/word.h"
 #include "../libcs50/webpage.h"
+#include "../libcs50/mem.h"
 
 static void parseArgs(char* pageDirectory, char* indexFilename);
-static index_t* indexBuild(char* pageDirectory);
-static void indexPage(index_t* index, webpage_t* page, int docID);
+static index_t* indexBuild(char* pageDirectory, docstore_t* docs);
+static void indexPage(index_t* index, webpage_t* page, docid_t docID);
 
 /**************** main ****************/
-/* Entry point of the program. Validate correct usage, then call parseArgs and save pageDirectory index to indexFilename.
+/* Entry point of the program. Validate correct usage, then call parseArgs and save pageDirectory index to indexFilename,
+ * and the docstore of its pages (see docstore.h) to indexFilename.docstore, for the querier.
  *
  * Caller provides: 
  *  argc  number of command-line arguments
@@ -42,14 +45,26 @@ int main(const int argc, char* argv[])
   // Parse command-line arguments
   parseArgs(argv[1], argv[2]);
 
-  // Build index from pageDirectory
-  index_t* index = indexBuild(argv[1]);
+  // Build index, and docstore, from pageDirectory
+  docstore_t* docs = docstore_new();
+  index_t* index = indexBuild(argv[1], docs);
 
   // Save index to indexFilename
   index_save(index, argv[2]);
 
-  // Delete index (in memory)
+  // Save docstore next to it
+  char* docsFilename = mem_assert(malloc(strlen(argv[2]) + strlen(".docstore") + 1),
+                                  "failed allocating memory for docstore filename");
+  sprintf(docsFilename, "%s.docstore", argv[2]);
+  if (!docstore_save(docs, docsFilename)) {
+    fprintf(stderr, "failed writing docstore file %s\n", docsFilename);
+    exit(1);
+  }
+  free(docsFilename);
+
+  // Delete index and docstore (in memory)
   index_delete(index);
+  docstore_delete(docs);
 
   exit(0);
 }
@@ -85,23 +100,28 @@ static void parseArgs(char* pageDirectory, char* indexFilename)
 }
 
 /**************** indexBuild ****************/
-/* Build an in-memory index from webpage files in pageDirectory.
+/* Build an in-memory index from webpage files in pageDirectory, adding the URL, depth, and HTML length of
+ * each page to docs as it goes.
  *
  * Caller provides: 
  *  pageDirectory pathname of directory produced by crawler
+ *  docs pointer to empty docstore_t struct
  *
  * We return:
  *  pointer to index_t struct built from page files in pageDirectory
  */
-static index_t* indexBuild(char* pageDirectory)
+static index_t* indexBuild(char* pageDirectory, docstore_t* docs)
 {
   // Initialize index
   index_t* index = index_new(600); // # of slots based on amount of data we expect to process
 
-  // Load webpage from each page file and scan it for words
+  // View each webpage where it is stored, without copying its HTML, and scan it for words; an alias (a
+  // page saved as an exact duplicate of another, see pagedir_save) has no HTML, so only the page holding
+  // its content is indexed
   webpage_t* page = NULL;
-  for (int docID = 1; (page = pagedir_load(pageDirectory, docID)) != NULL; docID++) {
+  for (docid_t docID = 1; (page = pagedir_loadView(pageDirectory, docID)) != NULL; docID++) {
     indexPage(index, page, docID);
+    docstore_add(docs, docID, webpage_getURL(page), webpage_getDepth(page), webpage_getHTMLLength(page));
     webpage_delete(page);
   }
 
@@ -114,9 +134,9 @@ static index_t* indexBuild(char* pageDirectory)
  * Caller provides: 
  *  index pointer to index_t struct
  *  page pointer to webpage_t struct holding information from a webpage document
- *  docID integer ID of webpage document
+ *  docID ID of webpage document
  */
-static void indexPage(index_t* index, webpage_t* page, int docID)
+static void indexPage(index_t* index, webpage_t* page, docid_t docID)
 {
   // Initialize variables
   char* word = "";
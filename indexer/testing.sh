@@ -56,6 +56,11 @@ valgrind --leak-check=full --show-leak-kinds=all ./indextest ../data/toscrape-1.
 ./indextest ../data/letters-3.index ../data/letters-3-copy.index
 ~/cs50-dev/shared/tse/indexcmp ../data/letters-3.index ~/cs50-dev/shared/tse/output/letters-3.index
 
+# letters at depth 10, crawled with and without compressed HTML (see crawler/testing.sh): the same index
+./indexer ../data/letters-10 ../data/letters-10.index
+./indexer ../data/letters-10-lz ../data/letters-10-lz.index
+~/cs50-dev/shared/tse/indexcmp ../data/letters-10-lz.index ../data/letters-10.index
+
 # toscrape at depth 0
 ./indexer ~/cs50-dev/shared/tse/output/toscrape-0 ../data/toscrape-0.index
 ./indextest ../data/toscrape-0.index ../data/toscrape-0-copy.index
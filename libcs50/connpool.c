@@ -0,0 +1,217 @@
+/*
+ * connpool - pool of idle, persistent connections to web servers.
+ *            See connpool.h for usage.
+ *
+ * The pool is a list of idle connections, most recently parked first,
+ * guarded by a mutex.  Pools are small (tens of connections), so we
+ * simply scan the list.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#define _GNU_SOURCE       // strdup, MSG_DONTWAIT
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "mem.h"
+#include "connpool.h"
+
+/* ***************************************** */
+/* Private types */
+
+/* conn_t: one idle connection */
+typedef struct conn {
+  char* hostname;               // host it is connected to
+  int port;                     // ... and port
+  FILE* fp;                     // the connection
+  time_t idleSince;             // when it was parked
+  struct conn* next;
+} conn_t;
+
+/* connpool_t: structure to represent the pool.
+ * The innards should not be visible to users of the connpool module.
+ */
+typedef struct connpool {
+  conn_t* conns;                // idle connections, most recent first
+  int numIdle;
+  int maxPerHost;
+  int maxIdle;
+  pthread_mutex_t lock;
+} connpool_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static bool isUsable(const conn_t* conn, const time_t now);
+static void deleteConn(conn_t* conn);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+// servers commonly drop idle connections after 5 seconds; don't cut it close
+static const time_t IDLE_TIMEOUT = 4;
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** connpool_new ****************/
+/* see connpool.h for documentation */
+connpool_t*
+connpool_new(const int maxPerHost, const int maxIdle)
+{
+  if (maxPerHost <= 0 || maxIdle <= 0) {
+    return NULL;
+  }
+
+  connpool_t* pool = mem_assert(malloc(sizeof(connpool_t)), "connpool_t");
+  pool->conns = NULL;
+  pool->numIdle = 0;
+  pool->maxPerHost = maxPerHost;
+  pool->maxIdle = maxIdle;
+  pthread_mutex_init(&pool->lock, NULL);
+
+  return pool;
+}
+
+/**************** connpool_get ****************/
+/* see connpool.h for documentation */
+FILE*
+connpool_get(connpool_t* pool, const char* hostname, const int port)
+{
+  if (pool == NULL || hostname == NULL) {
+    return NULL;
+  }
+
+  FILE* fp = NULL;
+  time_t now = time(NULL);
+
+  pthread_mutex_lock(&pool->lock);
+  for (conn_t** prevp = &pool->conns; *prevp != NULL && fp == NULL; ) {
+    conn_t* conn = *prevp;
+    if (conn->port != port || strcmp(conn->hostname, hostname) != 0) {
+      prevp = &conn->next;
+      continue;
+    }
+
+    // unlink it; hand it out if still usable, otherwise drop it
+    *prevp = conn->next;
+    pool->numIdle--;
+    if (isUsable(conn, now)) {
+      fp = conn->fp;
+      conn->fp = NULL;
+    }
+    deleteConn(conn);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return fp;
+}
+
+/**************** connpool_put ****************/
+/* see connpool.h for documentation */
+void
+connpool_put(connpool_t* pool, const char* hostname, const int port, FILE* conn)
+{
+  if (conn == NULL) {
+    return;
+  }
+  if (pool == NULL || hostname == NULL) {
+    fclose(conn);
+    return;
+  }
+
+  conn_t* new = mem_assert(malloc(sizeof(conn_t)), "conn_t");
+  new->hostname = mem_assert(strdup(hostname), "conn_t hostname");
+  new->port = port;
+  new->fp = conn;
+  new->idleSince = time(NULL);
+
+  pthread_mutex_lock(&pool->lock);
+
+  // count idle connections to this host, and find the oldest overall
+  int numHost = 0;
+  conn_t** oldestp = NULL;
+  for (conn_t** prevp = &pool->conns; *prevp != NULL; prevp = &(*prevp)->next) {
+    if ((*prevp)->port == port && strcmp((*prevp)->hostname, hostname) == 0) {
+      numHost++;
+    }
+    oldestp = prevp;
+  }
+
+  if (numHost >= pool->maxPerHost) {
+    // no room for another connection to this host
+    pthread_mutex_unlock(&pool->lock);
+    deleteConn(new);
+    return;
+  }
+  if (pool->numIdle >= pool->maxIdle && oldestp != NULL) {
+    // make room by dropping the connection idle the longest
+    conn_t* oldest = *oldestp;
+    *oldestp = NULL;
+    pool->numIdle--;
+    deleteConn(oldest);
+  }
+
+  new->next = pool->conns;
+  pool->conns = new;
+  pool->numIdle++;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/**************** connpool_delete ****************/
+/* see connpool.h for documentation */
+void
+connpool_delete(connpool_t* pool)
+{
+  if (pool == NULL) {
+    return;
+  }
+
+  while (pool->conns != NULL) {
+    conn_t* conn = pool->conns;
+    pool->conns = conn->next;
+    deleteConn(conn);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
+
+/***********************************************************************
+ * INTERNAL FUNCTIONS
+ ***********************************************************************/
+
+/* ****************** isUsable ***************************** */
+/* Return true if the connection has not been idle too long and the
+ * server has neither closed it nor sent anything unexpected on it.
+ */
+static bool
+isUsable(const conn_t* conn, const time_t now)
+{
+  if (now - conn->idleSince > IDLE_TIMEOUT) {
+    return false;
+  }
+
+  // peek without blocking: nothing to read (EAGAIN) is the healthy case
+  char c;
+  ssize_t n = recv(fileno(conn->fp), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+/* ****************** deleteConn ***************************** */
+/* Close (if still held) and free a connection entry.
+ */
+static void
+deleteConn(conn_t* conn)
+{
+  if (conn->fp != NULL) {
+    fclose(conn->fp);
+  }
+  free(conn->hostname);
+  free(conn);
+}
@@ -0,0 +1,75 @@
+/*
+ * connpool - pool of idle, persistent connections to web servers
+ *
+ * After an HTTP/1.1 exchange that leaves its connection open, the caller
+ * can park the connection here; the next fetch from the same host and
+ * port takes it back instead of opening a new TCP connection.
+ * Connections are kept as FILE* open for reading on the socket
+ * (so that anything already buffered stays with its connection);
+ * callers write requests directly to fileno(fp).
+ *
+ * All functions are safe to call from several threads at once.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#ifndef __CONNPOOL_H
+#define __CONNPOOL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/***********************************************************************/
+/* connpool_t: opaque struct holding idle connections, by host and port.
+ */
+typedef struct connpool connpool_t;
+
+/**************** connpool_new ****************/
+/* Create a new, empty pool.
+ *
+ * Caller provides:
+ *   maxPerHost  most idle connections kept for one host and port (must be > 0)
+ *   maxIdle     most idle connections kept overall (must be > 0)
+ *
+ * We return:
+ *   pointer to new connpool_t, or NULL on any error.
+ *
+ * Caller is responsible for:
+ *   later calling connpool_delete with the returned pointer.
+ */
+connpool_t* connpool_new(const int maxPerHost, const int maxIdle);
+
+/**************** connpool_get ****************/
+/* Take an idle connection to hostname:port out of the pool.
+ *
+ * We return:
+ *   the connection, which now belongs to the caller, or
+ *   NULL if the pool has no usable connection to that host.
+ *
+ * Notes:
+ *   connections idle for too long, or that the server has closed,
+ *   are discarded rather than returned.  The server may still close a
+ *   returned connection before the caller gets to use it; callers
+ *   should be prepared to retry on a new connection.
+ */
+FILE* connpool_get(connpool_t* pool, const char* hostname, const int port);
+
+/**************** connpool_put ****************/
+/* Return a connection to hostname:port to the pool, for later reuse.
+ *
+ * Caller provides:
+ *   a connection that is positioned at the start of the next response,
+ *   i.e., the previous response has been read in full.
+ *
+ * We guarantee:
+ *   the pool takes the connection over, in all cases; if there is no
+ *   room for it (or any argument is NULL), we close it.
+ */
+void connpool_put(connpool_t* pool, const char* hostname, const int port, FILE* conn);
+
+/**************** connpool_delete ****************/
+/* Close all idle connections and delete the pool.
+ */
+void connpool_delete(connpool_t* pool);
+
+#endif // __CONNPOOL_H
@@ -0,0 +1,916 @@
+/*
+ * fetcher - event-driven engine to fetch many web pages at once.
+ *           See fetcher.h for usage.
+ *
+ * Each fetch goes through four states: RESOLVING (its host name being
+ * looked up, unless the resolver has the answer cached), CONNECTING (non-blocking connect
+ * in progress), SENDING (writing the request) and RECEIVING (reading the
+ * response until the server closes the connection or we have
+ * Content-Length bytes of body).  A response that is not HTML, or whose
+ * body is longer than webpage_getMaxBody allows, is cut short as soon as
+ * that is known, usually from its header alone.  A compressed body is
+ * decompressed once it is complete.  A single epoll instance watches the
+ * sockets of all fetches in flight; fetches beyond maxInFlight wait in a
+ * FIFO queue, and completed fetches wait in another queue until
+ * fetcher_poll hands them to their done functions.  A fetch that misses
+ * one of the deadlines of webpage_getDeadlines fails: epoll_wait never
+ * sleeps past the nearest deadline of an active fetch, and after each
+ * wait the active fetches whose deadline has passed are finished.
+ *
+ * Host names are looked up by LOOKUP_THREADS helper threads, since
+ * getaddrinfo blocks: a fetch whose host is not in the resolver's cache
+ * queues a lookup_t for them, and the helper that completes it queues it
+ * back and bumps an eventfd that the epoll instance watches alongside the
+ * sockets.  A fetch that fails (say, on its connect deadline, which counts
+ * the lookup) while its lookup is out just lets go of it; the lookup
+ * still completes, and fills the cache.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#define _GNU_SOURCE       // SOCK_NONBLOCK, MSG_NOSIGNAL, eventfd
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "http.h"
+#include "resolver.h"
+#include "webpage.h"
+#include "mem.h"
+#include "mstime.h"
+#include "fetcher.h"
+
+/* number of helper threads looking host names up, hence of hosts
+ * that can be looked up at once */
+#define LOOKUP_THREADS 4
+
+/* ***************************************** */
+/* Private types */
+
+typedef enum { RESOLVING, CONNECTING, SENDING, RECEIVING } fetchstate_t;
+
+/* lookup_t: one host name lookup, handed to the helper threads.
+ * Only the main thread touches fetch; only the helper that takes the
+ * lookup touches numAddrs and addrs, until it queues the lookup back.
+ */
+typedef struct lookup {
+  char* hostname;
+  int port;
+  struct fetch* fetch;          // fetch waiting for the answer, or NULL if it gave up
+  resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+  int numAddrs;
+  struct lookup* next;
+} lookup_t;
+
+/* fetch_t: one page download, from submission until done is called.
+ * A fetch is always in exactly one of the fetcher's three lists.
+ */
+typedef struct fetch {
+  webpage_t* page;              // page being fetched
+  fetcher_done_t done;          // whom to tell when it completes
+  void* arg;                    // ... and what to tell them
+  fetchstate_t state;
+  int sock;                     // socket, or -1 if none open
+  resolver_addr_t addrs[RESOLVER_MAX_ADDRS]; // addresses the host name resolved to
+  int numAddrs;
+  int addr;                     // index of address we are connecting to
+  lookup_t* lookup;             // host lookup in progress, if RESOLVING
+  char* request;                // HTTP request to send
+  size_t requestLen;
+  size_t sent;                  // bytes of request sent so far
+  char* buf;                    // bytes of response received so far
+  size_t len;
+  size_t cap;                   // allocated size of buf
+  long headerLen;               // length of response header, 0 until complete
+  http_response_t resp;         // parsed response header
+  size_t maxBody;               // longest body to read, or 0 for no limit
+  webpage_declined_t declined;  // why we turned the response down, if we did
+  long long connectBy;          // deadlines, in mstime_now() time, 0 meaning none:
+  long long firstByteBy;        // ... each applies only until the connect is done,
+  long long doneBy;             // ... the first byte is in, or the fetch finishes
+  webpage_deadline_t missed;    // which deadline we missed, if any
+  bool success;                 // result, once finished
+  struct fetch* prev;
+  struct fetch* next;
+} fetch_t;
+
+/* fetchlist_t: a doubly-linked list of fetches */
+typedef struct fetchlist {
+  fetch_t* head;
+  fetch_t* tail;
+} fetchlist_t;
+
+/* fetcher_t: structure to represent the engine and its fetches.
+ * The innards should not be visible to users of the fetcher module.
+ */
+typedef struct fetcher {
+  int epfd;                     // epoll instance watching the active sockets
+  resolver_t* resolver;         // cache of host lookups
+  int maxInFlight;              // most fetches active at once
+  fetchlist_t waiting;          // submitted, not yet started
+  fetchlist_t active;           // started, not yet finished
+  fetchlist_t finished;         // finished, done not yet called
+  int numActive;
+  int numPending;               // fetches in any of the three lists
+  pthread_t lookupThreads[LOOKUP_THREADS]; // helpers looking host names up
+  pthread_mutex_t lookupLock;   // guards the two lookup queues, and stopping
+  pthread_cond_t lookupQueued;  // signaled when a lookup is queued, or stopping is set
+  lookup_t* queuedHead;         // lookups for the helpers, oldest first
+  lookup_t* queuedTail;
+  lookup_t* answered;           // lookups the helpers have completed, in any order
+  bool stopping;                // helpers should exit
+  int lookupfd;                 // eventfd, readable when answered is not empty
+} fetcher_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static void listAppend(fetchlist_t* list, fetch_t* fetch);
+static void listRemove(fetchlist_t* list, fetch_t* fetch);
+static void startWaiting(fetcher_t* fetcher);
+static void startFetch(fetcher_t* fetcher, fetch_t* fetch);
+static void queueLookup(fetcher_t* fetcher, fetch_t* fetch, char* hostname, const int port);
+static void* lookupThread(void* arg);
+static void finishLookups(fetcher_t* fetcher);
+static void tryConnect(fetcher_t* fetcher, fetch_t* fetch);
+static void handleEvent(fetcher_t* fetcher, fetch_t* fetch, const unsigned int events);
+static void sendRequest(fetcher_t* fetcher, fetch_t* fetch);
+static void receiveResponse(fetcher_t* fetcher, fetch_t* fetch);
+static bool declineResponse(fetch_t* fetch);
+static void finishFetch(fetcher_t* fetcher, fetch_t* fetch, const bool success);
+static int nextDeadline(fetcher_t* fetcher);
+static void expireFetches(fetcher_t* fetcher);
+static char* extractBody(fetch_t* fetch);
+static int deliverFinished(fetcher_t* fetcher);
+static void closeFetch(fetcher_t* fetcher, fetch_t* fetch);
+static void deleteFetch(fetch_t* fetch);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const int MAX_EVENTS = 64;          // events handled per epoll_wait
+static const size_t INITIAL_BUF = 16384;   // initial response buffer size
+static const size_t MIN_READ = 4096;       // least room offered to each recv
+static const int HOST_TTL = 300;           // seconds to remember a host lookup
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** fetcher_new ****************/
+/* see fetcher.h for documentation */
+fetcher_t*
+fetcher_new(const int maxInFlight)
+{
+  if (maxInFlight <= 0) {
+    return NULL;
+  }
+
+  fetcher_t* fetcher = mem_assert(calloc(1, sizeof(fetcher_t)), "fetcher_t");
+  fetcher->maxInFlight = maxInFlight;
+  fetcher->epfd = epoll_create1(0);
+  if (fetcher->epfd < 0) {
+    free(fetcher);
+    return NULL;
+  }
+  fetcher->lookupfd = eventfd(0, EFD_NONBLOCK);
+  struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+  if (fetcher->lookupfd < 0 || epoll_ctl(fetcher->epfd, EPOLL_CTL_ADD, fetcher->lookupfd, &event) < 0) {
+    if (fetcher->lookupfd >= 0) {
+      close(fetcher->lookupfd);
+    }
+    close(fetcher->epfd);
+    free(fetcher);
+    return NULL;
+  }
+  fetcher->resolver = mem_assert(resolver_new(HOST_TTL), "fetcher resolver");
+
+  pthread_mutex_init(&fetcher->lookupLock, NULL);
+  pthread_cond_init(&fetcher->lookupQueued, NULL);
+  for (int i = 0; i < LOOKUP_THREADS; i++) {
+    if (pthread_create(&fetcher->lookupThreads[i], NULL, lookupThread, fetcher) != 0) {
+      fprintf(stderr, "fetcher: could not start lookup thread\n");
+      exit(1);
+    }
+  }
+
+  return fetcher;
+}
+
+/**************** fetcher_submit ****************/
+/* see fetcher.h for documentation */
+bool
+fetcher_submit(fetcher_t* fetcher, webpage_t* page, fetcher_done_t done, void* arg)
+{
+  if (fetcher == NULL || page == NULL || done == NULL
+      || webpage_getURL(page) == NULL || webpage_getHTML(page) != NULL) {
+    return false;
+  }
+
+  fetch_t* fetch = mem_assert(calloc(1, sizeof(fetch_t)), "fetch_t");
+  fetch->page = page;
+  fetch->done = done;
+  fetch->arg = arg;
+  fetch->sock = -1;
+  fetch->maxBody = webpage_getMaxBody();
+
+  listAppend(&fetcher->waiting, fetch);
+  fetcher->numPending++;
+  startWaiting(fetcher);
+
+  return true;
+}
+
+/**************** fetcher_pending ****************/
+/* see fetcher.h for documentation */
+int
+fetcher_pending(fetcher_t* fetcher)
+{
+  return fetcher ? fetcher->numPending : 0;
+}
+
+/**************** fetcher_poll ****************/
+/* see fetcher.h for documentation.
+ *
+ * Pseudocode:
+ *     1. hand over fetches that finished since the last call
+ *     2. wait for sockets to be ready (without waiting if step 1 did anything,
+ *        nor past the nearest deadline of an active fetch)
+ *     3. let each ready fetch make progress
+ *     4. fail the active fetches whose deadline has passed
+ *     5. start waiting fetches in the slots freed by steps 3 and 4
+ *     6. hand over fetches that finished in steps 3 to 5
+ */
+int
+fetcher_poll(fetcher_t* fetcher, const int timeoutMillis)
+{
+  if (fetcher == NULL) {
+    return -1;
+  }
+
+  int completed = deliverFinished(fetcher);
+  if (fetcher->numActive == 0) {
+    return completed;
+  }
+
+  int timeout = (completed > 0) ? 0 : timeoutMillis;
+  int untilDeadline = nextDeadline(fetcher);
+  if (untilDeadline >= 0 && (timeout < 0 || untilDeadline < timeout)) {
+    timeout = untilDeadline;
+  }
+
+  struct epoll_event events[MAX_EVENTS];
+  int numEvents = epoll_wait(fetcher->epfd, events, MAX_EVENTS, timeout);
+  if (numEvents < 0) {
+    return (errno == EINTR) ? completed : -1;
+  }
+
+  for (int i = 0; i < numEvents; i++) {
+    if (events[i].data.ptr == NULL) {
+      finishLookups(fetcher);
+    } else {
+      handleEvent(fetcher, events[i].data.ptr, events[i].events);
+    }
+  }
+  expireFetches(fetcher);
+  startWaiting(fetcher);
+
+  return completed + deliverFinished(fetcher);
+}
+
+/**************** fetcher_run ****************/
+/* see fetcher.h for documentation */
+void
+fetcher_run(fetcher_t* fetcher)
+{
+  while (fetcher_pending(fetcher) > 0) {
+    if (fetcher_poll(fetcher, -1) < 0) {
+      break;
+    }
+  }
+}
+
+/**************** fetcher_delete ****************/
+/* see fetcher.h for documentation */
+void
+fetcher_delete(fetcher_t* fetcher)
+{
+  if (fetcher == NULL) {
+    return;
+  }
+
+  // stop the helpers (waiting for any lookup in progress), then drop their lookups
+  pthread_mutex_lock(&fetcher->lookupLock);
+  fetcher->stopping = true;
+  pthread_cond_broadcast(&fetcher->lookupQueued);
+  pthread_mutex_unlock(&fetcher->lookupLock);
+  for (int i = 0; i < LOOKUP_THREADS; i++) {
+    pthread_join(fetcher->lookupThreads[i], NULL);
+  }
+  lookup_t* lookups[] = { fetcher->queuedHead, fetcher->answered };
+  for (int i = 0; i < 2; i++) {
+    lookup_t* next;
+    for (lookup_t* lookup = lookups[i]; lookup != NULL; lookup = next) {
+      next = lookup->next;
+      free(lookup->hostname);
+      free(lookup);
+    }
+  }
+  pthread_cond_destroy(&fetcher->lookupQueued);
+  pthread_mutex_destroy(&fetcher->lookupLock);
+
+  fetchlist_t* lists[] = { &fetcher->waiting, &fetcher->active, &fetcher->finished };
+  for (int i = 0; i < 3; i++) {
+    fetch_t* fetch;
+    while ((fetch = lists[i]->head) != NULL) {
+      listRemove(lists[i], fetch);
+      webpage_delete(fetch->page);
+      deleteFetch(fetch);
+    }
+  }
+
+  resolver_delete(fetcher->resolver);
+  close(fetcher->lookupfd);
+  close(fetcher->epfd);
+  free(fetcher);
+}
+
+/***********************************************************************
+ * INTERNAL FUNCTIONS
+ ***********************************************************************/
+
+/* ****************** listAppend, listRemove ****************** */
+/* add a fetch to the tail of a list; remove a fetch from a list */
+static void
+listAppend(fetchlist_t* list, fetch_t* fetch)
+{
+  fetch->prev = list->tail;
+  fetch->next = NULL;
+  if (list->tail != NULL) {
+    list->tail->next = fetch;
+  } else {
+    list->head = fetch;
+  }
+  list->tail = fetch;
+}
+
+static void
+listRemove(fetchlist_t* list, fetch_t* fetch)
+{
+  if (fetch->prev != NULL) {
+    fetch->prev->next = fetch->next;
+  } else {
+    list->head = fetch->next;
+  }
+  if (fetch->next != NULL) {
+    fetch->next->prev = fetch->prev;
+  } else {
+    list->tail = fetch->prev;
+  }
+  fetch->prev = fetch->next = NULL;
+}
+
+/* ****************** startWaiting ***************************** */
+/* Start waiting fetches, in order, while there is room for them.
+ */
+static void
+startWaiting(fetcher_t* fetcher)
+{
+  while (fetcher->numActive < fetcher->maxInFlight && fetcher->waiting.head != NULL) {
+    fetch_t* fetch = fetcher->waiting.head;
+    listRemove(&fetcher->waiting, fetch);
+    listAppend(&fetcher->active, fetch);
+    fetcher->numActive++;
+    startFetch(fetcher, fetch);
+  }
+}
+
+/* ****************** startFetch ***************************** */
+/* Set the fetch's deadlines, prepare the request, and look up the host:
+ * from the resolver's cache, then begin connecting; or else by queueing
+ * a lookup for the helper threads.
+ */
+static void
+startFetch(fetcher_t* fetcher, fetch_t* fetch)
+{
+  int connectMillis, totalMillis;
+  webpage_getDeadlines(&connectMillis, NULL, &totalMillis);
+  long long now = mstime_now();
+  fetch->connectBy = (connectMillis > 0) ? now + connectMillis : 0;
+  fetch->doneBy = (totalMillis > 0) ? now + totalMillis : 0;
+
+  char* hostname;
+  int port;
+  char* pathname;
+  if (!http_burstURL(webpage_getURL(fetch->page), &hostname, &port, &pathname)) {
+    finishFetch(fetcher, fetch, false);
+    return;
+  }
+
+  fetch->request = http_conditionalRequest(hostname, pathname, false, webpage_getETag(fetch->page),
+                                           webpage_getLastModified(fetch->page), &fetch->requestLen);
+
+  free(pathname);
+  if (fetch->request == NULL) {
+    free(hostname);
+    finishFetch(fetcher, fetch, false);
+    return;
+  }
+
+  fetch->numAddrs = resolver_peek(fetcher->resolver, hostname, port,
+                                  fetch->addrs, RESOLVER_MAX_ADDRS);
+  if (fetch->numAddrs < 0) {
+    queueLookup(fetcher, fetch, hostname, port);
+    return;
+  }
+  free(hostname);
+
+  if (fetch->numAddrs == 0) {
+    finishFetch(fetcher, fetch, false);
+    return;
+  }
+
+  fetch->addr = 0;
+  tryConnect(fetcher, fetch);
+}
+
+/* ****************** queueLookup ***************************** */
+/* Hand the lookup of hostname (which the lookup takes over) to the
+ * helper threads, leaving the fetch RESOLVING until finishLookups.
+ */
+static void
+queueLookup(fetcher_t* fetcher, fetch_t* fetch, char* hostname, const int port)
+{
+  lookup_t* lookup = mem_assert(calloc(1, sizeof(lookup_t)), "lookup_t");
+  lookup->hostname = hostname;
+  lookup->port = port;
+  lookup->fetch = fetch;
+  fetch->lookup = lookup;
+  fetch->state = RESOLVING;
+
+  pthread_mutex_lock(&fetcher->lookupLock);
+  if (fetcher->queuedTail != NULL) {
+    fetcher->queuedTail->next = lookup;
+  } else {
+    fetcher->queuedHead = lookup;
+  }
+  fetcher->queuedTail = lookup;
+  pthread_cond_signal(&fetcher->lookupQueued);
+  pthread_mutex_unlock(&fetcher->lookupLock);
+}
+
+/* ****************** lookupThread ***************************** */
+/* Body of a helper thread: take queued lookups, oldest first, do them
+ * (getaddrinfo, through the resolver, so the answer is cached), and
+ * queue them back, until the fetcher is stopping.
+ */
+static void*
+lookupThread(void* arg)
+{
+  fetcher_t* fetcher = arg;
+
+  pthread_mutex_lock(&fetcher->lookupLock);
+  while (true) {
+    while (!fetcher->stopping && fetcher->queuedHead == NULL) {
+      pthread_cond_wait(&fetcher->lookupQueued, &fetcher->lookupLock);
+    }
+    if (fetcher->stopping) {
+      break;
+    }
+    lookup_t* lookup = fetcher->queuedHead;
+    fetcher->queuedHead = lookup->next;
+    if (fetcher->queuedHead == NULL) {
+      fetcher->queuedTail = NULL;
+    }
+    pthread_mutex_unlock(&fetcher->lookupLock);
+
+    lookup->numAddrs = resolver_lookup(fetcher->resolver, lookup->hostname, lookup->port,
+                                       lookup->addrs, RESOLVER_MAX_ADDRS);
+
+    pthread_mutex_lock(&fetcher->lookupLock);
+    lookup->next = fetcher->answered;
+    fetcher->answered = lookup;
+    uint64_t one = 1;
+    if (write(fetcher->lookupfd, &one, sizeof(one)) < 0) {
+      // the counter is far from full; nothing to do
+    }
+  }
+  pthread_mutex_unlock(&fetcher->lookupLock);
+
+  return NULL;
+}
+
+/* ****************** finishLookups ***************************** */
+/* Take the lookups the helpers have completed, and begin connecting
+ * each fetch still waiting for one (or finish it, if its host has no
+ * addresses).
+ */
+static void
+finishLookups(fetcher_t* fetcher)
+{
+  uint64_t count;
+  if (read(fetcher->lookupfd, &count, sizeof(count)) < 0) {
+    // nothing to read: another call took the lookups already
+  }
+
+  pthread_mutex_lock(&fetcher->lookupLock);
+  lookup_t* answered = fetcher->answered;
+  fetcher->answered = NULL;
+  pthread_mutex_unlock(&fetcher->lookupLock);
+
+  lookup_t* next;
+  for (lookup_t* lookup = answered; lookup != NULL; lookup = next) {
+    next = lookup->next;
+    fetch_t* fetch = lookup->fetch;
+    if (fetch != NULL) {
+      fetch->lookup = NULL;
+      fetch->numAddrs = lookup->numAddrs;
+      memcpy(fetch->addrs, lookup->addrs, sizeof(fetch->addrs));
+      if (fetch->numAddrs == 0) {
+        finishFetch(fetcher, fetch, false);
+      } else {
+        fetch->addr = 0;
+        tryConnect(fetcher, fetch);
+      }
+    }
+    free(lookup->hostname);
+    free(lookup);
+  }
+}
+
+/* ****************** tryConnect ***************************** */
+/* Begin a non-blocking connect to fetch->addr, moving on to the next
+ * address whenever one fails outright; finish the fetch if none is left.
+ */
+static void
+tryConnect(fetcher_t* fetcher, fetch_t* fetch)
+{
+  for ( ; fetch->addr < fetch->numAddrs; fetch->addr++) {
+    resolver_addr_t* addr = &fetch->addrs[fetch->addr];
+    fetch->sock = socket(addr->family, addr->socktype | SOCK_NONBLOCK, addr->protocol);
+    if (fetch->sock < 0) {
+      continue;
+    }
+
+    if (connect(fetch->sock, (struct sockaddr*) &addr->addr, addr->len) == 0
+        || errno == EINPROGRESS) {
+      // writable once connected (or once the connect has failed)
+      struct epoll_event event = { .events = EPOLLOUT, .data.ptr = fetch };
+      if (epoll_ctl(fetcher->epfd, EPOLL_CTL_ADD, fetch->sock, &event) == 0) {
+        fetch->state = CONNECTING;
+        return;
+      }
+    }
+
+    close(fetch->sock);
+    fetch->sock = -1;
+  }
+
+  finishFetch(fetcher, fetch, false);
+}
+
+/* ****************** handleEvent ***************************** */
+/* Let a fetch whose socket is ready make as much progress as it can.
+ */
+static void
+handleEvent(fetcher_t* fetcher, fetch_t* fetch, const unsigned int events)
+{
+  switch (fetch->state) {
+  case RESOLVING:                          // no socket yet
+    break;
+  case CONNECTING: {
+    int error = 0;
+    socklen_t errorLen = sizeof(error);
+    if (getsockopt(fetch->sock, SOL_SOCKET, SO_ERROR, &error, &errorLen) < 0 || error != 0) {
+      // this address failed; try the next one
+      closeFetch(fetcher, fetch);
+      fetch->addr++;
+      tryConnect(fetcher, fetch);
+      return;
+    }
+    // connected: from now on, the clock is on the server's response
+    int firstByteMillis;
+    webpage_getDeadlines(NULL, &firstByteMillis, NULL);
+    fetch->connectBy = 0;
+    fetch->firstByteBy = (firstByteMillis > 0) ? mstime_now() + firstByteMillis : 0;
+    fetch->state = SENDING;
+    sendRequest(fetcher, fetch);
+    break;
+  }
+  case SENDING:
+    sendRequest(fetcher, fetch);
+    break;
+  case RECEIVING:
+    receiveResponse(fetcher, fetch);
+    break;
+  }
+}
+
+/* ****************** sendRequest ***************************** */
+/* Send as much of the request as the socket takes; once all of it is
+ * sent, switch to waiting for the response.
+ */
+static void
+sendRequest(fetcher_t* fetcher, fetch_t* fetch)
+{
+  while (fetch->sent < fetch->requestLen) {
+    ssize_t n = send(fetch->sock, &fetch->request[fetch->sent],
+                     fetch->requestLen - fetch->sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        finishFetch(fetcher, fetch, false);
+      }
+      return;
+    }
+    fetch->sent += n;
+  }
+
+  struct epoll_event event = { .events = EPOLLIN, .data.ptr = fetch };
+  if (epoll_ctl(fetcher->epfd, EPOLL_CTL_MOD, fetch->sock, &event) < 0) {
+    finishFetch(fetcher, fetch, false);
+    return;
+  }
+  fetch->state = RECEIVING;
+}
+
+/* ****************** receiveResponse ***************************** */
+/* Read whatever the socket has for us, parsing the header as soon as it
+ * is complete; finish the fetch when the body is complete, the server
+ * closes the connection, or anything goes wrong.
+ */
+static void
+receiveResponse(fetcher_t* fetcher, fetch_t* fetch)
+{
+  while (true) {
+    // make room to read into, growing the buffer geometrically
+    if (fetch->cap - fetch->len < MIN_READ) {
+      size_t cap = (fetch->cap == 0) ? INITIAL_BUF : 2 * fetch->cap;
+      char* buf = realloc(fetch->buf, cap);
+      if (buf == NULL) {
+        finishFetch(fetcher, fetch, false);
+        return;
+      }
+      fetch->buf = buf;
+      fetch->cap = cap;
+    }
+
+    ssize_t n = recv(fetch->sock, &fetch->buf[fetch->len], fetch->cap - fetch->len, 0);
+    if (n == 0) {                          // server closed: the body is complete
+      finishFetch(fetcher, fetch, fetch->headerLen > 0);
+      return;
+    } else if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        finishFetch(fetcher, fetch, false);
+      }
+      return;                              // nothing more for now
+    }
+    fetch->len += n;
+    fetch->firstByteBy = 0;
+
+    // parse the header, once we have all of it
+    if (fetch->headerLen == 0) {
+      fetch->headerLen = http_parseHeader(fetch->buf, fetch->len, &fetch->resp);
+      if (fetch->headerLen < 0 || (fetch->headerLen > 0 && fetch->resp.status != 200)) {
+        finishFetch(fetcher, fetch, false);
+        return;
+      }
+    }
+
+    // stop reading a page we do not want
+    if (fetch->headerLen > 0 && declineResponse(fetch)) {
+      finishFetch(fetcher, fetch, false);
+      return;
+    }
+
+    // with Content-Length, we need not wait for the server to close
+    if (fetch->headerLen > 0 && !fetch->resp.chunked && fetch->resp.contentLength >= 0
+        && fetch->len - fetch->headerLen >= fetch->resp.contentLength) {
+      finishFetch(fetcher, fetch, true);
+      return;
+    }
+  }
+}
+
+/* ****************** declineResponse ***************************** */
+/* Once the header of a 200 response is in, decide whether to read on:
+ * return true (setting fetch->declined) if the page is not HTML, or if
+ * its body is, or has grown, longer than fetch->maxBody; the body
+ * received so far counts whole, chunk framing included.  Also return
+ * true, as for any failure, if the body is compressed in a way we
+ * cannot decompress.
+ */
+static bool
+declineResponse(fetch_t* fetch)
+{
+  if (!http_isHTML(&fetch->resp)) {
+    fetch->declined = WEBPAGE_NOT_HTML;
+  } else if (!http_canDecode(fetch->resp.encoding)) {
+    return true;                           // not declined, just a failure
+  } else if (fetch->maxBody > 0 && (fetch->resp.contentLength > (long) fetch->maxBody
+                                    || fetch->len - fetch->headerLen > fetch->maxBody)) {
+    fetch->declined = WEBPAGE_TOO_LARGE;
+  }
+  return fetch->declined != WEBPAGE_ACCEPTED;
+}
+
+/* ****************** finishFetch ***************************** */
+/* Close the fetch's connection, give its page the response status and,
+ * if successful, the html and validators, and move it to the finished list.
+ */
+static void
+finishFetch(fetcher_t* fetcher, fetch_t* fetch, const bool success)
+{
+  closeFetch(fetcher, fetch);
+  listRemove(&fetcher->active, fetch);
+  fetcher->numActive--;
+  if (fetch->lookup != NULL) {             // let go of the lookup; finishLookups frees it
+    fetch->lookup->fetch = NULL;
+    fetch->lookup = NULL;
+  }
+
+  fetch->success = false;
+  if (fetch->headerLen > 0) {
+    webpage_setStatus(fetch->page, fetch->resp.status);
+  }
+  if (success) {
+    char* html = extractBody(fetch);
+    if (html != NULL) {
+      if (webpage_setHTML(fetch->page, html)) {
+        webpage_setValidators(fetch->page, fetch->resp.etag, fetch->resp.lastModified);
+        fetch->success = true;
+      } else {
+        free(html);
+      }
+    }
+  }
+  webpage_setDeclined(fetch->page, fetch->declined);
+  webpage_setMissed(fetch->page, fetch->missed);
+
+  listAppend(&fetcher->finished, fetch);
+}
+
+/* ****************** nextDeadline ***************************** */
+/* Return the milliseconds until the nearest deadline of an active fetch
+ * (0 if one has passed already), or -1 if no active fetch has any.
+ */
+static int
+nextDeadline(fetcher_t* fetcher)
+{
+  long long nearest = 0;
+  for (fetch_t* fetch = fetcher->active.head; fetch != NULL; fetch = fetch->next) {
+    long long deadlines[] = { fetch->connectBy, fetch->firstByteBy, fetch->doneBy };
+    for (int i = 0; i < 3; i++) {
+      if (deadlines[i] > 0 && (nearest == 0 || deadlines[i] < nearest)) {
+        nearest = deadlines[i];
+      }
+    }
+  }
+  if (nearest == 0) {
+    return -1;
+  }
+
+  long long left = nearest - mstime_now();
+  return (left > 0) ? left : 0;
+}
+
+/* ****************** expireFetches ***************************** */
+/* Fail each active fetch that has missed a deadline, noting which.
+ */
+static void
+expireFetches(fetcher_t* fetcher)
+{
+  long long now = mstime_now();
+  fetch_t* next;
+  for (fetch_t* fetch = fetcher->active.head; fetch != NULL; fetch = next) {
+    next = fetch->next;                    // finishFetch moves fetch to another list
+    if (fetch->doneBy > 0 && now >= fetch->doneBy) {
+      fetch->missed = WEBPAGE_TOTAL_MISSED;
+    } else if (fetch->connectBy > 0 && now >= fetch->connectBy) {
+      fetch->missed = WEBPAGE_CONNECT_MISSED;
+    } else if (fetch->firstByteBy > 0 && now >= fetch->firstByteBy) {
+      fetch->missed = WEBPAGE_FIRST_BYTE_MISSED;
+    } else {
+      continue;
+    }
+    finishFetch(fetcher, fetch, false);
+  }
+}
+
+/* ****************** extractBody ***************************** */
+/* Turn the response buffer into a null-terminated string holding just
+ * the body, decoding it if chunked and decompressing it if compressed;
+ * the fetch no longer owns the buffer.  Return NULL if the body is
+ * malformed, or (setting fetch->declined) too long once decompressed.
+ */
+static char*
+extractBody(fetch_t* fetch)
+{
+  char* body = &fetch->buf[fetch->headerLen];
+  long bodyLen = fetch->len - fetch->headerLen;
+  if (fetch->resp.chunked) {
+    bodyLen = http_dechunk(body, bodyLen);
+    if (bodyLen < 0) {
+      return NULL;
+    }
+  } else if (fetch->resp.contentLength >= 0 && fetch->resp.contentLength < bodyLen) {
+    bodyLen = fetch->resp.contentLength;
+  }
+
+  // decompress into a new buffer, which then replaces the response buffer
+  if (fetch->resp.encoding != HTTP_IDENTITY) {
+    char* decoded = NULL;
+    size_t decodedLen = 0;
+    size_t decodedCap = 0;
+    http_decoder_t* decoder = http_decoderNew(fetch->resp.encoding);
+    http_decode_t result = (decoder == NULL) ? HTTP_DECODE_ERROR
+      : http_decode(decoder, body, bodyLen, &decoded, &decodedLen, &decodedCap, fetch->maxBody);
+    http_decoderDelete(decoder);
+    if (result != HTTP_DECODE_END) {
+      if (result == HTTP_DECODE_TOO_LARGE) {
+        fetch->declined = WEBPAGE_TOO_LARGE;
+      }
+      free(decoded);
+      return NULL;
+    }
+    free(fetch->buf);
+    fetch->buf = decoded;
+    fetch->cap = decodedCap;
+    body = decoded;
+    bodyLen = decodedLen;
+  }
+
+  // move the body to the front; the header is never empty (and http_decode
+  // leaves room), so there is room for '\0'
+  memmove(fetch->buf, body, bodyLen);
+  fetch->buf[bodyLen] = '\0';
+  char* html = realloc(fetch->buf, bodyLen + 1);
+  if (html == NULL) {
+    html = fetch->buf;                     // shrinking failed; keep the larger buffer
+  }
+  fetch->buf = NULL;
+  fetch->len = fetch->cap = 0;
+  return html;
+}
+
+/* ****************** deliverFinished ***************************** */
+/* Call done for each finished fetch; return how many there were.
+ * Pages submitted by those calls wait for the next fetcher_poll.
+ */
+static int
+deliverFinished(fetcher_t* fetcher)
+{
+  // detach the list first, since done may cause more fetches to finish
+  fetchlist_t finished = fetcher->finished;
+  fetcher->finished.head = fetcher->finished.tail = NULL;
+
+  int completed = 0;
+  fetch_t* fetch;
+  while ((fetch = finished.head) != NULL) {
+    listRemove(&finished, fetch);
+    fetcher->numPending--;
+    completed++;
+
+    fetcher_done_t done = fetch->done;
+    void* arg = fetch->arg;
+    webpage_t* page = fetch->page;
+    bool success = fetch->success;
+    deleteFetch(fetch);
+    (*done)(arg, page, success);
+  }
+
+  return completed;
+}
+
+/* ****************** closeFetch ***************************** */
+/* Stop watching and close the fetch's socket, if open.
+ */
+static void
+closeFetch(fetcher_t* fetcher, fetch_t* fetch)
+{
+  if (fetch->sock >= 0) {
+    epoll_ctl(fetcher->epfd, EPOLL_CTL_DEL, fetch->sock, NULL);
+    close(fetch->sock);
+    fetch->sock = -1;
+  }
+}
+
+/* ****************** deleteFetch ***************************** */
+/* Free a fetch and everything it owns but its page.
+ */
+static void
+deleteFetch(fetch_t* fetch)
+{
+  if (fetch->sock >= 0) {
+    close(fetch->sock);
+  }
+  free(fetch->request);
+  free(fetch->buf);
+  free(fetch);
+}
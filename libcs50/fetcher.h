@@ -0,0 +1,126 @@
+/*
+ * fetcher - event-driven engine to fetch many web pages at once
+ *
+ * A fetcher drives any number of page downloads from a single thread,
+ * using non-blocking sockets and epoll, instead of dedicating a thread
+ * (blocked in webpage_fetch) to each one.  The caller submits webpages,
+ * then calls fetcher_poll (or fetcher_run) to let the downloads make
+ * progress; whenever one completes, the fetcher calls the function the
+ * caller submitted it with.
+ *
+ * Usage example: (fetch a batch of pages)
+ *  fetcher_t* fetcher = fetcher_new(100);
+ *  for (int i = 0; i < n; i++) {
+ *    fetcher_submit(fetcher, pages[i], pageDone, NULL);
+ *  }
+ *  fetcher_run(fetcher);       // pageDone is called once per page
+ *  fetcher_delete(fetcher);
+ *
+ * Limitations:
+ *   * same as webpage_fetch: http only, no redirects
+ *   * host names are looked up by a few helper threads (getaddrinfo
+ *     blocks), once per host every few minutes (see resolver); a slow
+ *     lookup holds up the fetches to that host, not the others, and
+ *     counts against their connect deadline
+ *   * unlike webpage_fetch, a failed connect is not retried
+ *   * like webpage_fetch, the fetcher does not pace requests; that is up
+ *     to the caller
+ *   * like webpage_fetch, requests for pages with an ETag or Last-Modified
+ *     are conditional; a 304 response is a failed fetch with
+ *     webpage_getStatus(page) == 304
+ *   * like webpage_fetch, a page that is not HTML, or longer than
+ *     webpage_setMaxBody allows, is turned down (see webpage_getDeclined);
+ *     the limit in force when a page is submitted is the one that applies
+ *   * like webpage_fetch, a fetch that misses a deadline of
+ *     webpage_setDeadlines fails (see webpage_getMissed); the connect
+ *     deadline bounds trying all of the host's addresses, rather than
+ *     each try, and the deadlines in force when a fetch starts apply
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#ifndef __FETCHER_H
+#define __FETCHER_H
+
+#include <stdbool.h>
+#include "webpage.h"
+
+/***********************************************************************/
+/* fetcher_t: opaque struct holding the fetches in progress.
+ */
+typedef struct fetcher fetcher_t;
+
+/* fetcher_done_t: called once per submitted page, when its fetch completes.
+ *   arg      the arg passed to fetcher_submit along with this page
+ *   page     the page; if success, its html is now set (see webpage_fetch)
+ *   success  whether the fetch succeeded
+ * The page belongs to the callee from then on.  The callee may submit
+ * more pages to the same fetcher.
+ */
+typedef void (*fetcher_done_t)(void* arg, webpage_t* page, bool success);
+
+/**************** fetcher_new ****************/
+/* Create a new fetcher.
+ *
+ * Caller provides:
+ *   maxInFlight  maximum number of connections open at once (must be > 0);
+ *                pages submitted beyond that wait their turn, in order.
+ *
+ * We return:
+ *   pointer to new fetcher_t, or NULL on any error.
+ *
+ * Caller is responsible for:
+ *   later calling fetcher_delete with the returned pointer.
+ */
+fetcher_t* fetcher_new(const int maxInFlight);
+
+/**************** fetcher_submit ****************/
+/* Queue a page for fetching.
+ *
+ * Caller provides:
+ *   fetcher  valid fetcher_t*
+ *   page     valid webpage_t* with a url and no html yet
+ *   done     function to call when the fetch completes (not NULL)
+ *   arg      anything; passed along to done
+ *
+ * We return:
+ *   true if the page was queued; false if any argument is invalid
+ *   (in which case the caller keeps the page and done is never called).
+ *
+ * Notes:
+ *   done is called from within fetcher_poll, never from fetcher_submit.
+ */
+bool fetcher_submit(fetcher_t* fetcher, webpage_t* page, fetcher_done_t done, void* arg);
+
+/**************** fetcher_pending ****************/
+/* Return the number of submitted pages whose done function has not
+ * been called yet (0 if fetcher is NULL).
+ */
+int fetcher_pending(fetcher_t* fetcher);
+
+/**************** fetcher_poll ****************/
+/* Wait for sockets to become ready and let the fetches make progress,
+ * calling done for each fetch that completes.
+ *
+ * Caller provides:
+ *   fetcher        valid fetcher_t*
+ *   timeoutMillis  longest time to wait for a socket, or -1 to wait indefinitely
+ *
+ * We return:
+ *   number of fetches completed during this call, or -1 on error.
+ */
+int fetcher_poll(fetcher_t* fetcher, const int timeoutMillis);
+
+/**************** fetcher_run ****************/
+/* Call fetcher_poll until no fetch is pending, including any pages
+ * submitted by the done functions along the way.
+ */
+void fetcher_run(fetcher_t* fetcher);
+
+/**************** fetcher_delete ****************/
+/* Delete a fetcher, abandoning (and deleting) any pages still pending
+ * without calling their done functions.
+ */
+void fetcher_delete(fetcher_t* fetcher);
+
+#endif // __FETCHER_H
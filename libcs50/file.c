@@ -41,8 +41,43 @@ static int never(int c) { return (0); }
 static int isnewline(int c) { return (c == '\n'); }
 
 /**************** file_readFile ****************/
-/* See file.h for documentation. */
-char* file_readFile(FILE* fp) { return file_readUntil(fp, never); }
+/* See file.h for documentation.
+ * Reads in large blocks with fread, doubling the buffer as needed,
+ * rather than a character at a time, since files may be big.
+ */
+char*
+file_readFile(FILE* fp)
+{
+  size_t len = 0;
+  size_t cap = 4096;
+  char* buf = malloc(cap);
+  if (buf == NULL) {
+    return NULL;
+  }
+
+  size_t n;
+  while ((n = fread(&buf[len], 1, cap - len - 1, fp)) > 0) {
+    len += n;
+    // keep room for at least one more byte and the terminating null
+    if (len + 1 == cap) {
+      char* newbuf = realloc(buf, 2 * cap);
+      if (newbuf == NULL) {
+        free(buf);
+        return NULL;
+      }
+      buf = newbuf;
+      cap *= 2;
+    }
+  }
+
+  if (len == 0 || ferror(fp)) {
+    // nothing read before EOF, or an error
+    free(buf);
+    return NULL;
+  }
+  buf[len] = '\0';
+  return buf;
+}
 
 /**************** file_readLine ****************/
 /* See file.h for documentation. */
@@ -69,15 +104,16 @@ file_readUntil(FILE* fp, int (*stopfunc)(int c))
   }
 
   // Read characters from file until stop-character or EOF, 
-  // expanding the buffer when needed to hold more.
+  // doubling the buffer when needed to hold more.
   int pos;
-  char c;
+  int c;
   for (pos = 0; (c = fgetc(fp)) != EOF && !(*stopfunc)(c); pos++) {
     // We need to save buf[pos+1] for the terminating null
     // and buf[len-1] is the last usable slot, 
     // so if pos+1 is past that slot, we need to grow the buffer.
     if (pos+1 > len-1) {
-      char* newbuf = realloc(buf, ++len * sizeof(char));
+      len *= 2;
+      char* newbuf = realloc(buf, len * sizeof(char));
       if (newbuf == NULL) {
         free(buf);
         return NULL;
@@ -0,0 +1,40 @@
+/*
+ * hash64 - 64-bit hashes of strings, for fingerprints and content hashes.
+ *          See hash64.h for usage.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#include <stdint.h>
+#include "hash64.h"
+
+/**************** hash64_fnv1a ****************/
+/* see hash64.h for documentation */
+uint64_t hash64_fnv1a(const char* str)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (const unsigned char* c = (const unsigned char*) str; *c != '\0'; c++) {
+    h ^= *c;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/**************** hash64_mix ****************/
+/* see hash64.h for documentation */
+uint64_t hash64_mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/**************** hash64_string ****************/
+/* see hash64.h for documentation */
+uint64_t hash64_string(const char* str)
+{
+  return hash64_mix(hash64_fnv1a(str));
+}
@@ -0,0 +1,33 @@
+/*
+ * hash64 - 64-bit hashes of strings, for fingerprints and content hashes
+ *
+ * Unlike hash_jenkins, which picks a hashtable slot, these keep all 64 bits, so that two different
+ * strings get the same hash only by (rare) chance: FNV-1a over the bytes of a string, and a final mix
+ * (from MurmurHash3) after which every bit of a hash depends on every bit of what was hashed.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#ifndef __HASH64_H
+#define __HASH64_H
+
+#include <stdint.h>
+
+/**************** hash64_fnv1a ****************/
+/* Return the 64-bit FNV-1a hash of a string (not NULL), without the final mix: cheap to combine with
+ * others, as its low bits are poorly spread.
+ */
+uint64_t hash64_fnv1a(const char* str);
+
+/**************** hash64_mix ****************/
+/* Return h through the final mix of MurmurHash3 (fmix64), which spreads every bit of h over all 64
+ * bits of the result; it maps 0 to 0 and no two values to the same one.
+ */
+uint64_t hash64_mix(uint64_t h);
+
+/**************** hash64_string ****************/
+/* Return the 64-bit hash of a string (not NULL): hash64_mix of its hash64_fnv1a.
+ */
+uint64_t hash64_string(const char* str);
+
+#endif // __HASH64_H
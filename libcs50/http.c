@@ -0,0 +1,546 @@
+/*
+ * http - helpers for speaking (a small subset of) HTTP/1.1 as a client.
+ *        See http.h for usage.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#define _GNU_SOURCE       // strncasecmp, strcasestr
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <stdint.h>
+#ifdef HTTP_ZLIB
+#include <zlib.h>
+#endif
+#include "http.h"
+
+/* http_decoder_t: state of a decompression; see http.h.
+ * The zlib stream is set up on the first input, since whether a deflate
+ * body has a zlib wrapper is only known from its first two bytes.
+ */
+typedef struct http_decoder {
+  http_encoding_t encoding;
+  bool started;                            // stream has been set up
+  bool ended;                              // compressed body is complete
+#ifdef HTTP_ZLIB
+  z_stream stream;
+#endif
+} http_decoder_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static bool isField(const char* line, const size_t lineLen, const char* name, const char** value);
+static void copyValue(const char* value, const char* eol, char* dest, const size_t size);
+static void copyMediaType(const char* value, const char* eol, char* dest, const size_t size);
+static http_encoding_t parseEncoding(const char* value, const char* eol);
+static int hexValue(const char c);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const int HTTP_PORT = 80;           // default web server port
+static const size_t MAX_HEADER = 65536;    // longest header we accept
+#ifdef HTTP_ZLIB
+static const size_t DECODE_ROOM = 16384;   // least room offered to each inflate
+static const char* ACCEPT_ENCODING = "Accept-Encoding: gzip, deflate\r\n";
+#else
+static const char* ACCEPT_ENCODING = "";
+#endif
+
+/* *********************************************************************** */
+/* Public methods */
+
+/* ****************** http_burstURL ********************* */
+/* see http.h for documentation.
+ *
+ * Each string is allocated enough space to hold the whole URL,
+ * which is more than necessary, allowing a little growth if needed.
+ *
+ * http_burstURL is much simpler than parseURL in webpage.c and is used
+ * for fetching because we can't handle anything other than simple
+ * http://hostname[:port][/path] forms of URL anyway.
+ */
+bool
+http_burstURL(const char* url, char** hostname, int* port, char** pathname)
+{
+  // make plenty of space for the resulting strings
+  int length = strlen(url);
+
+  // initialize hostname to empty string
+  *hostname = calloc(sizeof(char), length); // initialized to all nulls
+  if (*hostname == NULL) {
+    return false;
+  }
+
+  // initialize pathname to slash
+  *pathname = calloc(sizeof(char), length); // initialized to all nulls
+  if (*pathname == NULL) {
+    free(*hostname);
+    return false;
+  } else {
+    **pathname = '/';
+  }
+
+  // initialize port to default port
+  *port = HTTP_PORT;
+
+  // parse various forms of the URL
+  if (sscanf(url, "http://%[^:]:%d/%s", *hostname, port, *pathname+1) == 3) {
+    return true;
+  } else if (sscanf(url, "http://%[^/]/%s", *hostname, *pathname+1) == 2) {
+    return true;
+  } else if (sscanf(url, "http://%[^:]:%d", *hostname, port) == 2) {
+    return true;
+  } else if (sscanf(url, "http://%[^/]/", *hostname) == 1) {
+    return true;
+  } else if (sscanf(url, "http://%s", *hostname) == 1) {
+    return true;
+  } else {
+    free(*hostname); *hostname = NULL;
+    free(*pathname); *pathname = NULL;
+    return false;
+  }
+}
+
+/**************** http_request ****************/
+/* see http.h for documentation */
+char*
+http_request(const char* hostname, const char* pathname, const bool keepAlive, size_t* length)
+{
+  return http_conditionalRequest(hostname, pathname, keepAlive, NULL, NULL, length);
+}
+
+/**************** http_conditionalRequest ****************/
+/* see http.h for documentation */
+char*
+http_conditionalRequest(const char* hostname, const char* pathname, const bool keepAlive,
+                        const char* etag, const char* lastModified, size_t* length)
+{
+  if (hostname == NULL || pathname == NULL) {
+    return NULL;
+  }
+
+  const char* httpFormat = "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n%s%s%s%s%s%s%s\r\n";
+  const char* connection = keepAlive ? "keep-alive" : "close";
+  bool hasETag = (etag != NULL && *etag != '\0');
+  bool hasLastModified = (lastModified != NULL && *lastModified != '\0');
+  const char* etagField[] = { hasETag ? "If-None-Match: " : "", hasETag ? etag : "", hasETag ? "\r\n" : "" };
+  const char* sinceField[] = { hasLastModified ? "If-Modified-Since: " : "",
+                               hasLastModified ? lastModified : "", hasLastModified ? "\r\n" : "" };
+
+  // measure, then allocate and format the request
+  int requestLen = snprintf(NULL, 0, httpFormat, pathname, hostname, connection, ACCEPT_ENCODING,
+                            etagField[0], etagField[1], etagField[2], sinceField[0], sinceField[1], sinceField[2]);
+  char* request = malloc(requestLen + 1);
+  if (request == NULL) {
+    return NULL;
+  }
+  snprintf(request, requestLen + 1, httpFormat, pathname, hostname, connection, ACCEPT_ENCODING,
+           etagField[0], etagField[1], etagField[2], sinceField[0], sinceField[1], sinceField[2]);
+
+  if (length != NULL) {
+    *length = requestLen;
+  }
+  return request;
+}
+
+/**************** http_parseHeader ****************/
+/* see http.h for documentation.
+ *
+ * Pseudocode:
+ *     1. find the blank line that ends the header; if none yet, return 0
+ *     2. parse the status line for the version and status code
+ *     3. step through the header fields we care about
+ *        (Content-Length, Content-Type, Content-Encoding, Transfer-Encoding, Connection,
+ *        ETag, Last-Modified)
+ */
+long
+http_parseHeader(const char* buf, const size_t len, http_response_t* resp)
+{
+  if (buf == NULL || resp == NULL) {
+    return -1;
+  }
+
+  // find the end of the header: a line that is empty, or only "\r"
+  size_t headerLen = 0;
+  for (size_t pos = 0; pos < len && headerLen == 0; ) {
+    const char* eol = memchr(&buf[pos], '\n', len - pos);
+    if (eol == NULL) {
+      break;                               // line not complete yet
+    }
+    size_t lineLen = eol - &buf[pos];
+    if (pos > 0 && (lineLen == 0 || (lineLen == 1 && buf[pos] == '\r'))) {
+      headerLen = pos + lineLen + 1;
+    }
+    pos += lineLen + 1;
+  }
+  if (headerLen == 0) {
+    return (len > MAX_HEADER) ? -1 : 0;
+  }
+
+  // parse the status line, e.g. "HTTP/1.1 200 OK"
+  int minor = 0;
+  resp->status = 0;
+  if (sscanf(buf, "HTTP/1.%d %d", &minor, &resp->status) != 2) {
+    return -1;
+  }
+  resp->contentLength = -1;
+  resp->chunked = false;
+  resp->encoding = HTTP_IDENTITY;
+  resp->close = (minor == 0);              // HTTP/1.0 closes unless told otherwise
+  resp->etag[0] = '\0';
+  resp->lastModified[0] = '\0';
+  resp->contentType[0] = '\0';
+
+  // step through the header fields, one line at a time
+  const char* line = (const char*) memchr(buf, '\n', headerLen) + 1;
+  while (line < &buf[headerLen]) {
+    const char* eol = memchr(line, '\n', &buf[headerLen] - line);
+    size_t lineLen = eol - line;
+    const char* value = NULL;
+
+    if (isField(line, lineLen, "Content-Length", &value)) {
+      resp->contentLength = strtol(value, NULL, 10);
+    } else if (isField(line, lineLen, "Content-Type", &value)) {
+      copyMediaType(value, eol, resp->contentType, sizeof(resp->contentType));
+    } else if (isField(line, lineLen, "Content-Encoding", &value)) {
+      resp->encoding = parseEncoding(value, eol);
+    } else if (isField(line, lineLen, "Transfer-Encoding", &value)) {
+      resp->chunked = (strncasecmp(value, "chunked", strlen("chunked")) == 0);
+    } else if (isField(line, lineLen, "Connection", &value)) {
+      if (strncasecmp(value, "close", strlen("close")) == 0) {
+        resp->close = true;
+      } else if (strncasecmp(value, "keep-alive", strlen("keep-alive")) == 0) {
+        resp->close = false;
+      }
+    } else if (isField(line, lineLen, "ETag", &value)) {
+      copyValue(value, eol, resp->etag, sizeof(resp->etag));
+    } else if (isField(line, lineLen, "Last-Modified", &value)) {
+      copyValue(value, eol, resp->lastModified, sizeof(resp->lastModified));
+    }
+    line = eol + 1;
+  }
+
+  return headerLen;
+}
+
+/**************** http_hasBody ****************/
+/* see http.h for documentation */
+bool
+http_hasBody(const int status)
+{
+  return !((status >= 100 && status < 200) || status == 204 || status == 304);
+}
+
+/**************** http_isHTML ****************/
+/* see http.h for documentation */
+bool
+http_isHTML(const http_response_t* resp)
+{
+  if (resp == NULL) {
+    return false;
+  }
+  return resp->contentType[0] == '\0'
+    || strcmp(resp->contentType, "text/html") == 0
+    || strcmp(resp->contentType, "application/xhtml+xml") == 0;
+}
+
+/**************** http_canDecode ****************/
+/* see http.h for documentation */
+bool
+http_canDecode(const http_encoding_t encoding)
+{
+#ifdef HTTP_ZLIB
+  return encoding == HTTP_IDENTITY || encoding == HTTP_GZIP || encoding == HTTP_DEFLATE;
+#else
+  return encoding == HTTP_IDENTITY;
+#endif
+}
+
+/**************** http_decoderNew ****************/
+/* see http.h for documentation */
+http_decoder_t*
+http_decoderNew(const http_encoding_t encoding)
+{
+  if (encoding == HTTP_IDENTITY || !http_canDecode(encoding)) {
+    return NULL;
+  }
+
+  http_decoder_t* decoder = calloc(1, sizeof(http_decoder_t));
+  if (decoder == NULL) {
+    return NULL;
+  }
+  decoder->encoding = encoding;
+  return decoder;
+}
+
+/**************** http_decode ****************/
+/* see http.h for documentation.
+ *
+ * Pseudocode:
+ *     1. on the first input, set up a zlib stream for gzip, zlib-wrapped
+ *        deflate, or raw deflate, as the coding and first bytes say
+ *     2. feed the input to inflate, in slices zlib can count,
+ *        making room in the buffer whenever inflate has filled it
+ *     3. stop at the end of the compressed body, or when the input
+ *        is used up
+ */
+http_decode_t
+http_decode(http_decoder_t* decoder, const char* in, const size_t inLen,
+            char** out, size_t* outLen, size_t* outCap, const size_t maxOut)
+{
+  if (decoder == NULL || (in == NULL && inLen > 0) || out == NULL || outLen == NULL || outCap == NULL) {
+    return HTTP_DECODE_ERROR;
+  }
+  if (decoder->ended) {
+    return HTTP_DECODE_END;
+  }
+  if (inLen == 0) {
+    return HTTP_DECODE_MORE;
+  }
+
+#ifdef HTTP_ZLIB
+  z_stream* stream = &decoder->stream;
+  if (!decoder->started) {
+    // gzip has its own header; deflate may or may not have a zlib one
+    // (a zlib header is a multiple of 31, with compression method 8)
+    int windowBits = MAX_WBITS + 16;
+    if (decoder->encoding == HTTP_DEFLATE) {
+      const unsigned char* b = (const unsigned char*) in;
+      bool wrapped = (inLen < 2) || ((b[0] & 0x0f) == 8 && ((b[0] << 8) | b[1]) % 31 == 0);
+      windowBits = wrapped ? MAX_WBITS : -MAX_WBITS;
+    }
+    if (inflateInit2(stream, windowBits) != Z_OK) {
+      return HTTP_DECODE_ERROR;
+    }
+    decoder->started = true;
+  }
+
+  size_t consumed = 0;
+  while (consumed < inLen) {
+    size_t slice = inLen - consumed;
+    if (slice > UINT_MAX) {
+      slice = UINT_MAX;
+    }
+    stream->next_in = (Bytef*) &in[consumed];
+    stream->avail_in = slice;
+
+    do {
+      // make room for more output (and a '\0'), growing geometrically
+      if (*outCap < *outLen + DECODE_ROOM + 1) {
+        size_t cap = (2 * *outCap > *outLen + DECODE_ROOM + 1) ? 2 * *outCap : *outLen + DECODE_ROOM + 1;
+        char* bigger = realloc(*out, cap);
+        if (bigger == NULL) {
+          return HTTP_DECODE_ERROR;
+        }
+        *out = bigger;
+        *outCap = cap;
+      }
+      size_t room = *outCap - *outLen - 1;
+      if (room > UINT_MAX) {
+        room = UINT_MAX;
+      }
+      stream->next_out = (Bytef*) &(*out)[*outLen];
+      stream->avail_out = room;
+
+      int rc = inflate(stream, Z_NO_FLUSH);
+      *outLen += room - stream->avail_out;
+      if (maxOut > 0 && *outLen > maxOut) {
+        return HTTP_DECODE_TOO_LARGE;
+      }
+      if (rc == Z_STREAM_END) {
+        decoder->ended = true;
+        return HTTP_DECODE_END;
+      }
+      if (rc == Z_BUF_ERROR && stream->avail_out > 0) {
+        break;                             // no progress possible without more input
+      }
+      if (rc != Z_OK && rc != Z_BUF_ERROR) {
+        return HTTP_DECODE_ERROR;
+      }
+    } while (stream->avail_in > 0 || stream->avail_out == 0);
+
+    consumed += slice - stream->avail_in;
+    if (stream->avail_in > 0) {
+      return HTTP_DECODE_ERROR;            // inflate would take no more of the input
+    }
+  }
+  return HTTP_DECODE_MORE;
+#else
+  return HTTP_DECODE_ERROR;
+#endif
+}
+
+/**************** http_decoderDelete ****************/
+/* see http.h for documentation */
+void
+http_decoderDelete(http_decoder_t* decoder)
+{
+  if (decoder == NULL) {
+    return;
+  }
+#ifdef HTTP_ZLIB
+  if (decoder->started) {
+    inflateEnd(&decoder->stream);
+  }
+#endif
+  free(decoder);
+}
+
+/**************** http_dechunk ****************/
+/* see http.h for documentation.
+ *
+ * Each chunk is "hex-size[;extensions]\r\n" followed by that many bytes
+ * and "\r\n"; a chunk of size zero ends the body (any trailer is ignored).
+ * Decoded bytes are moved toward the front of body as we go, which is
+ * safe because the decoded form is never longer than the encoded one.
+ */
+long
+http_dechunk(char* body, const size_t len)
+{
+  if (body == NULL) {
+    return -1;
+  }
+
+  size_t in = 0;                           // read position
+  size_t out = 0;                          // write position
+  while (in < len) {
+    // read the chunk size, in hex, rejecting one too large for size_t (it would wrap)
+    size_t chunkLen = 0;
+    int digits = 0;
+    int value;
+    while (in < len && (value = hexValue(body[in])) >= 0) {
+      if (chunkLen > (SIZE_MAX - value) / 16) {
+        return -1;
+      }
+      chunkLen = chunkLen * 16 + value;
+      in++; digits++;
+    }
+    if (digits == 0) {
+      return -1;
+    }
+
+    // skip any chunk extensions and the end of the size line
+    const char* eol = memchr(&body[in], '\n', len - in);
+    if (eol == NULL) {
+      return -1;
+    }
+    in = eol - body + 1;
+
+    // the last chunk has size zero
+    if (chunkLen == 0) {
+      return out;
+    }
+
+    // move the chunk data into place and skip its trailing CRLF
+    if (chunkLen > len - in) {
+      return -1;
+    }
+    memmove(&body[out], &body[in], chunkLen);
+    out += chunkLen;
+    in += chunkLen;
+    if (in < len && body[in] == '\r') in++;
+    if (in < len && body[in] == '\n') in++;
+  }
+
+  return -1;                               // ran out before the last chunk
+}
+
+/***********************************************************************
+ * INTERNAL FUNCTIONS
+ ***********************************************************************/
+
+/* ****************** isField ***************************** */
+/* Return true if the header line (of lineLen bytes) is field 'name',
+ * in which case *value points to the first non-blank of its value.
+ */
+static bool
+isField(const char* line, const size_t lineLen, const char* name, const char** value)
+{
+  size_t nameLen = strlen(name);
+  if (lineLen <= nameLen || line[nameLen] != ':' || strncasecmp(line, name, nameLen) != 0) {
+    return false;
+  }
+
+  const char* v = &line[nameLen + 1];
+  while (v < &line[lineLen] && (*v == ' ' || *v == '\t')) {
+    v++;
+  }
+  *value = v;
+  return true;
+}
+
+/* ****************** copyValue ***************************** */
+/* Copy a header field's value, from value up to eol less any trailing
+ * blanks, into dest, which holds size bytes; if it does not fit,
+ * dest is left empty rather than holding part of it.
+ */
+static void
+copyValue(const char* value, const char* eol, char* dest, const size_t size)
+{
+  while (eol > value && isspace((unsigned char) eol[-1])) {
+    eol--;
+  }
+  size_t valueLen = eol - value;
+  if (valueLen >= size) {
+    valueLen = 0;
+  }
+  memcpy(dest, value, valueLen);
+  dest[valueLen] = '\0';
+}
+
+/* ****************** copyMediaType ***************************** */
+/* Copy the media type of a Content-Type value, e.g. "text/html" from
+ * "Text/HTML; charset=UTF-8", into dest in lower case, as copyValue
+ * does; the parameters after ';' are dropped.
+ */
+static void
+copyMediaType(const char* value, const char* eol, char* dest, const size_t size)
+{
+  const char* semicolon = memchr(value, ';', eol - value);
+  copyValue(value, (semicolon != NULL) ? semicolon : eol, dest, size);
+  for (char* c = dest; *c != '\0'; c++) {
+    *c = tolower((unsigned char) *c);
+  }
+}
+
+/* ****************** parseEncoding ***************************** */
+/* Return the coding named by a Content-Encoding value (up to eol).
+ */
+static http_encoding_t
+parseEncoding(const char* value, const char* eol)
+{
+  char name[16];
+  copyMediaType(value, eol, name, sizeof(name));   // trimmed and in lower case, or "" if too long
+  if (name[0] == '\0') {
+    while (value < eol && isspace((unsigned char) *value)) {
+      value++;
+    }
+    return (value == eol) ? HTTP_IDENTITY : HTTP_UNKNOWN_ENCODING;
+  } else if (strcmp(name, "identity") == 0) {
+    return HTTP_IDENTITY;
+  } else if (strcmp(name, "gzip") == 0 || strcmp(name, "x-gzip") == 0) {
+    return HTTP_GZIP;
+  } else if (strcmp(name, "deflate") == 0) {
+    return HTTP_DEFLATE;
+  }
+  return HTTP_UNKNOWN_ENCODING;
+}
+
+/* ****************** hexValue ***************************** */
+/* Return the value of hex digit c, or -1 if c is not a hex digit.
+ */
+static int
+hexValue(const char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
@@ -0,0 +1,207 @@
+/*
+ * http - helpers for speaking (a small subset of) HTTP/1.1 as a client
+ *
+ * These functions build requests and parse responses held in memory;
+ * they do no I/O themselves, so both the blocking webpage_fetch and the
+ * event-driven fetcher module can share them.
+ *
+ * Compiled with -DHTTP_ZLIB (and linked with -lz), requests ask for
+ * compressed bodies (Accept-Encoding: gzip, deflate), and an
+ * http_decoder_t decompresses them; without it, requests ask for none,
+ * and the build needs no zlib.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#ifndef __HTTP_H
+#define __HTTP_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* longest ETag or Last-Modified value kept, plus one for the '\0' */
+#define HTTP_MAX_VALIDATOR 128
+
+/* longest media type kept from Content-Type, plus one for the '\0' */
+#define HTTP_MAX_TYPE 64
+
+/* http_encoding_t: content coding of a response body (Content-Encoding)
+ *   HTTP_IDENTITY          none, i.e., the body is the page itself
+ *   HTTP_GZIP              gzip (or x-gzip)
+ *   HTTP_DEFLATE           deflate, in a zlib wrapper or (as some servers send it) raw
+ *   HTTP_UNKNOWN_ENCODING  anything else, including several codings at once
+ */
+typedef enum { HTTP_IDENTITY, HTTP_GZIP, HTTP_DEFLATE, HTTP_UNKNOWN_ENCODING } http_encoding_t;
+
+/* http_decode_t: outcome of http_decode
+ *   HTTP_DECODE_ERROR      the data is corrupt, or we ran out of memory
+ *   HTTP_DECODE_TOO_LARGE  the decoded body would be longer than allowed
+ *   HTTP_DECODE_MORE       all input decoded; the compressed body goes on
+ *   HTTP_DECODE_END        the compressed body is complete
+ */
+typedef enum { HTTP_DECODE_ERROR, HTTP_DECODE_TOO_LARGE, HTTP_DECODE_MORE, HTTP_DECODE_END } http_decode_t;
+
+/***********************************************************************/
+/* http_decoder_t: opaque struct holding the state of a decompression.
+ */
+typedef struct http_decoder http_decoder_t;
+
+/***********************************************************************/
+/* http_response_t: what we learned from the header of an HTTP response.
+ */
+typedef struct http_response {
+  int status;                 // status code, e.g. 200
+  long contentLength;         // value of Content-Length, or -1 if absent
+  bool chunked;               // body uses Transfer-Encoding: chunked
+  http_encoding_t encoding;   // body uses this Content-Encoding
+  bool close;                 // server closes the connection after the body
+  char etag[HTTP_MAX_VALIDATOR];          // value of ETag, or "" if absent (or too long)
+  char lastModified[HTTP_MAX_VALIDATOR];  // value of Last-Modified, or "" if absent (or too long)
+  char contentType[HTTP_MAX_TYPE];        // media type of Content-Type, lower case and without
+                                          // parameters (e.g. "text/html"), or "" if absent (or too long)
+} http_response_t;
+
+/**************** http_burstURL ****************/
+/* Burst the URL into components (hostname, port, pathname).
+ *
+ * Caller provides:
+ *   url       non-NULL, normalized URL of form http://hostname[:port][/path]
+ *   hostname  where to store a new string holding the hostname
+ *   port      where to store the port (80 if the URL has none)
+ *   pathname  where to store a new string holding the pathname ("/" if none)
+ *
+ * We return:
+ *   true if successful, false otherwise.
+ *
+ * Caller is responsible for:
+ *   on success, later free()ing *hostname and *pathname.
+ */
+bool http_burstURL(const char* url, char** hostname, int* port, char** pathname);
+
+/**************** http_request ****************/
+/* Build a GET request for pathname on hostname (asking for a compressed
+ * body, if compiled with HTTP_ZLIB).
+ *
+ * Caller provides:
+ *   hostname   non-NULL host name, sent in the Host header
+ *   pathname   non-NULL path to request
+ *   keepAlive  false to ask the server to close the connection after responding
+ *   length     where to store the length of the request, if not NULL
+ *
+ * We return:
+ *   new string holding the request, or NULL on error.
+ *
+ * Caller is responsible for:
+ *   later free()ing the returned string.
+ */
+char* http_request(const char* hostname, const char* pathname, const bool keepAlive, size_t* length);
+
+/**************** http_conditionalRequest ****************/
+/* Build a GET request, as http_request does, that asks the server to
+ * respond 304 (Not Modified), with no body, if the page still has the
+ * given ETag (If-None-Match) or has not changed since the given
+ * Last-Modified time (If-Modified-Since).
+ *
+ * Caller provides:
+ *   etag          ETag from an earlier response, or NULL or "" if none
+ *   lastModified  Last-Modified from an earlier response, or NULL or "" if none
+ *   the rest as for http_request
+ *
+ * We return, and the caller is responsible for, the same as http_request;
+ * with neither validator, the request is that of http_request.
+ */
+char* http_conditionalRequest(const char* hostname, const char* pathname, const bool keepAlive,
+                              const char* etag, const char* lastModified, size_t* length);
+
+/**************** http_parseHeader ****************/
+/* Parse the status line and header fields at the start of buf.
+ *
+ * Caller provides:
+ *   buf   bytes received so far for this response (need not be null-terminated)
+ *   len   number of bytes in buf
+ *   resp  where to store the parsed header
+ *
+ * We return:
+ *   length of the header, including the blank line that ends it, if complete;
+ *   0 if buf does not hold the whole header yet;
+ *   -1 if the header is malformed.
+ */
+long http_parseHeader(const char* buf, const size_t len, http_response_t* resp);
+
+/**************** http_hasBody ****************/
+/* Return false if a response with this status never has a body
+ * (1xx, 204 No Content, 304 Not Modified), true otherwise.
+ */
+bool http_hasBody(const int status);
+
+/**************** http_isHTML ****************/
+/* Return true if the response's Content-Type says its body is HTML
+ * (text/html or application/xhtml+xml), or if it has no Content-Type,
+ * in which case we give it the benefit of the doubt.
+ */
+bool http_isHTML(const http_response_t* resp);
+
+/**************** http_canDecode ****************/
+/* Return true if we can turn a body with this coding into the page:
+ * always for HTTP_IDENTITY, and for HTTP_GZIP and HTTP_DEFLATE if
+ * compiled with HTTP_ZLIB.
+ */
+bool http_canDecode(const http_encoding_t encoding);
+
+/**************** http_decoderNew ****************/
+/* Start decompressing a body with the given coding.
+ *
+ * We return:
+ *   pointer to new http_decoder_t, or NULL if http_canDecode(encoding)
+ *   is false, encoding is HTTP_IDENTITY (which needs no decoder), or
+ *   we are out of memory.
+ *
+ * Caller is responsible for:
+ *   later calling http_decoderDelete with the returned pointer.
+ */
+http_decoder_t* http_decoderNew(const http_encoding_t encoding);
+
+/**************** http_decode ****************/
+/* Decompress the next piece of a body, appending the result to a
+ * malloc'd buffer, which we grow (geometrically) as needed.
+ *
+ * Caller provides:
+ *   decoder  valid http_decoder_t*
+ *   in       next inLen bytes of the compressed body, as received
+ *   out      pointer to the buffer (may point to NULL at first)
+ *   outLen   pointer to number of bytes in the buffer
+ *   outCap   pointer to allocated size of the buffer (0 if NULL)
+ *   maxOut   most bytes of decoded body to allow, or 0 for no limit
+ *
+ * We return:
+ *   one of the http_decode_t values; any input after the end of the
+ *   compressed body is ignored.
+ *
+ * Notes:
+ *   the buffer always has room left for a '\0' after *outLen bytes,
+ *   but is not null-terminated; the caller still owns it, whatever
+ *   we return.
+ */
+http_decode_t http_decode(http_decoder_t* decoder, const char* in, const size_t inLen,
+                          char** out, size_t* outLen, size_t* outCap, const size_t maxOut);
+
+/**************** http_decoderDelete ****************/
+/* Free a decoder (NULL is fine).
+ */
+void http_decoderDelete(http_decoder_t* decoder);
+
+/**************** http_dechunk ****************/
+/* Decode, in place, a complete body sent with Transfer-Encoding: chunked.
+ *
+ * Caller provides:
+ *   body  the body, as received (chunk-size lines, data, and trailer)
+ *   len   number of bytes in body
+ *
+ * We return:
+ *   length of the decoded body, which now starts at body[0], or
+ *   -1 if the chunked encoding is malformed (a chunk size too large for
+ *   size_t included) or incomplete.
+ */
+long http_dechunk(char* body, const size_t len);
+
+#endif // __HTTP_H
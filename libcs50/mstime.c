@@ -0,0 +1,20 @@
+/*
+ * mstime - the current time in milliseconds, for deadlines and timeouts.
+ *          See mstime.h for usage.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#define _GNU_SOURCE       // clock_gettime
+
+#include <time.h>
+#include "mstime.h"
+
+/**************** mstime_now ****************/
+/* see mstime.h for documentation */
+long long mstime_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,19 @@
+/*
+ * mstime - the current time in milliseconds, for deadlines and timeouts
+ *
+ * The time comes from a clock that never goes backwards (CLOCK_MONOTONIC), so a deadline set as
+ * mstime_now() plus a timeout is unaffected by changes to the time of day; it means nothing
+ * across processes or reboots.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#ifndef __MSTIME_H
+#define __MSTIME_H
+
+/**************** mstime_now ****************/
+/* Return the current time, in milliseconds, from a clock that never goes backwards.
+ */
+long long mstime_now(void);
+
+#endif // __MSTIME_H
@@ -0,0 +1,401 @@
+/*
+ * resolver - cached host name lookups, and connecting to hosts.
+ *            See resolver.h for usage.
+ *
+ * The cache is a hashtable from host name to an entry holding the
+ * addresses (with port 0) and when they expire; the hashtable cannot
+ * remove items, so an expired entry is refreshed in place.  A mutex
+ * guards the cache, but is not held during getaddrinfo, so a slow
+ * lookup of one host does not hold up lookups of others.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#define _GNU_SOURCE       // SOCK_NONBLOCK
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "hashtable.h"
+#include "mem.h"
+#include "mstime.h"
+#include "resolver.h"
+
+/* ***************************************** */
+/* Private types */
+
+/* entry_t: the cached result of looking up one host */
+typedef struct entry {
+  time_t expires;                            // when to look it up again
+  int numAddrs;                              // 0 if the host does not exist
+  resolver_addr_t addrs[RESOLVER_MAX_ADDRS]; // ports are 0
+} entry_t;
+
+/* resolver_t: structure to represent the cache.
+ * The innards should not be visible to users of the resolver module.
+ */
+typedef struct resolver {
+  hashtable_t* cache;           // hostname -> entry_t
+  int ttl;                      // seconds an entry stays valid
+  pthread_mutex_t lock;
+} resolver_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+
+static bool lookupHost(const char* hostname, entry_t* entry);
+static int copyAddrs(const entry_t* entry, const int port,
+                     resolver_addr_t addrs[], const int maxAddrs);
+static int connectInTurn(const resolver_addr_t addrs[], const int numAddrs, const long long deadline);
+static int connectRace(const resolver_addr_t addrs[], const int numAddrs, const long long deadline);
+static bool connectFinished(const int sock);
+static int timeLeft(const long long deadline);
+static bool setBlocking(const int sock);
+
+/* *********************************************************************** */
+/* Private global variables */
+
+static const int CACHE_SLOTS = 101;        // hashtable slots; crawls visit few hosts
+static const int RACE_STAGGER = 250;       // milliseconds before racing the next address
+
+/* *********************************************************************** */
+/* Public methods */
+
+/**************** resolver_new ****************/
+/* see resolver.h for documentation */
+resolver_t*
+resolver_new(const int ttl)
+{
+  if (ttl <= 0) {
+    return NULL;
+  }
+
+  resolver_t* resolver = mem_assert(malloc(sizeof(resolver_t)), "resolver_t");
+  resolver->cache = mem_assert(hashtable_new(CACHE_SLOTS), "resolver cache");
+  resolver->ttl = ttl;
+  pthread_mutex_init(&resolver->lock, NULL);
+
+  return resolver;
+}
+
+/**************** resolver_lookup ****************/
+/* see resolver.h for documentation */
+int
+resolver_lookup(resolver_t* resolver, const char* hostname, const int port,
+                resolver_addr_t addrs[], const int maxAddrs)
+{
+  if (resolver == NULL || hostname == NULL || addrs == NULL || maxAddrs <= 0) {
+    return 0;
+  }
+
+  // answer from the cache, if we can
+  int numAddrs = resolver_peek(resolver, hostname, port, addrs, maxAddrs);
+  if (numAddrs >= 0) {
+    return numAddrs;
+  }
+
+  // otherwise, look it up (without holding the lock)
+  entry_t fresh;
+  if (!lookupHost(hostname, &fresh)) {
+    return 0;                              // temporary failure; don't remember
+  }
+  fresh.expires = time(NULL) + resolver->ttl;
+
+  // remember it; another thread may have added an entry meanwhile
+  pthread_mutex_lock(&resolver->lock);
+  entry_t* entry = hashtable_find(resolver->cache, hostname);
+  if (entry == NULL) {
+    entry = mem_assert(malloc(sizeof(entry_t)), "resolver entry");
+    hashtable_insert(resolver->cache, hostname, entry);
+  }
+  *entry = fresh;
+  numAddrs = copyAddrs(entry, port, addrs, maxAddrs);
+  pthread_mutex_unlock(&resolver->lock);
+
+  return numAddrs;
+}
+
+/**************** resolver_peek ****************/
+/* see resolver.h for documentation */
+int
+resolver_peek(resolver_t* resolver, const char* hostname, const int port,
+              resolver_addr_t addrs[], const int maxAddrs)
+{
+  if (resolver == NULL || hostname == NULL || addrs == NULL || maxAddrs <= 0) {
+    return 0;
+  }
+
+  int numAddrs = -1;
+  pthread_mutex_lock(&resolver->lock);
+  entry_t* entry = hashtable_find(resolver->cache, hostname);
+  if (entry != NULL && entry->expires > time(NULL)) {
+    numAddrs = copyAddrs(entry, port, addrs, maxAddrs);
+  }
+  pthread_mutex_unlock(&resolver->lock);
+
+  return numAddrs;
+}
+
+/**************** resolver_connect ****************/
+/* see resolver.h for documentation */
+int
+resolver_connect(resolver_t* resolver, const char* hostname, const int port,
+                 const bool race, const int timeoutMillis)
+{
+  long long deadline = (timeoutMillis >= 0) ? mstime_now() + timeoutMillis : 0;
+  resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+  int numAddrs = resolver_lookup(resolver, hostname, port, addrs, RESOLVER_MAX_ADDRS);
+  if (numAddrs == 0) {
+    return -1;
+  }
+
+  // with a single address there is nothing to race
+  if (race && numAddrs > 1) {
+    return connectRace(addrs, numAddrs, deadline);
+  }
+  return connectInTurn(addrs, numAddrs, deadline);
+}
+
+/**************** resolver_delete ****************/
+/* see resolver.h for documentation */
+void
+resolver_delete(resolver_t* resolver)
+{
+  if (resolver == NULL) {
+    return;
+  }
+
+  hashtable_delete(resolver->cache, free);
+  pthread_mutex_destroy(&resolver->lock);
+  free(resolver);
+}
+
+/***********************************************************************
+ * INTERNAL FUNCTIONS
+ ***********************************************************************/
+
+/* ****************** lookupHost ***************************** */
+/* Look hostname up with getaddrinfo, filling in entry's addresses.
+ * Return false if the lookup failed for a reason that may go away
+ * (so the result should not be cached); a host that does not exist
+ * yields true, with no addresses.
+ */
+static bool
+lookupHost(const char* hostname, entry_t* entry)
+{
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  entry->numAddrs = 0;
+
+  struct addrinfo* addrs = NULL;
+  int error = getaddrinfo(hostname, NULL, &hints, &addrs);
+  if (error != 0) {
+    return (error == EAI_NONAME);
+  }
+
+  for (struct addrinfo* ai = addrs; ai != NULL && entry->numAddrs < RESOLVER_MAX_ADDRS;
+       ai = ai->ai_next) {
+    if (ai->ai_addrlen > sizeof(struct sockaddr_storage)) {
+      continue;
+    }
+    resolver_addr_t* addr = &entry->addrs[entry->numAddrs++];
+    addr->family = ai->ai_family;
+    addr->socktype = ai->ai_socktype;
+    addr->protocol = ai->ai_protocol;
+    addr->len = ai->ai_addrlen;
+    memset(&addr->addr, 0, sizeof(addr->addr));
+    memcpy(&addr->addr, ai->ai_addr, ai->ai_addrlen);
+  }
+  freeaddrinfo(addrs);
+
+  return true;
+}
+
+/* ****************** copyAddrs ***************************** */
+/* Copy up to maxAddrs of the entry's addresses into addrs, setting
+ * their port; return how many were copied.
+ */
+static int
+copyAddrs(const entry_t* entry, const int port, resolver_addr_t addrs[], const int maxAddrs)
+{
+  int numAddrs = (entry->numAddrs < maxAddrs) ? entry->numAddrs : maxAddrs;
+  for (int i = 0; i < numAddrs; i++) {
+    addrs[i] = entry->addrs[i];
+    if (addrs[i].family == AF_INET) {
+      ((struct sockaddr_in*) &addrs[i].addr)->sin_port = htons(port);
+    } else if (addrs[i].family == AF_INET6) {
+      ((struct sockaddr_in6*) &addrs[i].addr)->sin6_port = htons(port);
+    }
+  }
+  return numAddrs;
+}
+
+/* ****************** connectInTurn ***************************** */
+/* Try to connect to each address in order, waiting for each connect
+ * to finish (but not past deadline, unless it is 0); return the first
+ * socket that connects, switched to blocking, or -1 (setting errno to
+ * ETIMEDOUT if the deadline passed).
+ */
+static int
+connectInTurn(const resolver_addr_t addrs[], const int numAddrs, const long long deadline)
+{
+  for (int i = 0; i < numAddrs; i++) {
+    int sock = socket(addrs[i].family, addrs[i].socktype | SOCK_NONBLOCK, addrs[i].protocol);
+    if (sock < 0) {
+      continue;
+    }
+
+    int ready = 1;
+    if (connect(sock, (const struct sockaddr*) &addrs[i].addr, addrs[i].len) != 0) {
+      if (errno != EINPROGRESS) {
+        close(sock);
+        continue;
+      }
+      struct pollfd fd = { .fd = sock, .events = POLLOUT };
+      while ((ready = poll(&fd, 1, timeLeft(deadline))) < 0 && errno == EINTR) {
+      }
+    }
+    if (ready > 0 && connectFinished(sock) && setBlocking(sock)) {
+      return sock;
+    }
+    close(sock);
+
+    if (ready == 0) {
+      errno = ETIMEDOUT;
+      return -1;
+    }
+  }
+
+  errno = ECONNREFUSED;
+  return -1;
+}
+
+/* ****************** connectRace ***************************** */
+/* Start a non-blocking connect to each address in order, RACE_STAGGER
+ * milliseconds apart (or at once, if the previous one has already
+ * failed), and return the first socket to connect, switched back to
+ * blocking; close the others.  Return -1 if none connects (setting
+ * errno to ETIMEDOUT if deadline, unless 0, passed first).
+ */
+static int
+connectRace(const resolver_addr_t addrs[], const int numAddrs, const long long deadline)
+{
+  struct pollfd fds[RESOLVER_MAX_ADDRS];
+  int numStarted = 0;                      // entries used in fds
+  int numOpen = 0;                         // of those, still connecting
+  int winner = -1;
+  bool timedOut = false;
+
+  for (int next = 0; winner < 0 && (next < numAddrs || numOpen > 0); ) {
+    // start the next connect
+    if (next < numAddrs) {
+      const resolver_addr_t* addr = &addrs[next++];
+      int sock = socket(addr->family, addr->socktype | SOCK_NONBLOCK, addr->protocol);
+      if (sock >= 0) {
+        if (connect(sock, (const struct sockaddr*) &addr->addr, addr->len) == 0) {
+          winner = sock;
+          break;
+        } else if (errno == EINPROGRESS) {
+          fds[numStarted].fd = sock;
+          fds[numStarted].events = POLLOUT;
+          numStarted++;
+          numOpen++;
+        } else {
+          close(sock);
+        }
+      }
+    }
+    if (numOpen == 0) {
+      continue;                            // nothing to wait for; try the next
+    }
+
+    // wait for one to finish; give up waiting when it's time for the next,
+    // or for good when the deadline passes
+    int left = timeLeft(deadline);
+    int timeout = (next < numAddrs && (left < 0 || left > RACE_STAGGER)) ? RACE_STAGGER : left;
+    int ready = poll(fds, numStarted, timeout);
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    if (ready == 0 && timeout == left && left >= 0) {
+      timedOut = true;
+      break;
+    }
+    for (int i = 0; i < numStarted && ready > 0 && winner < 0; i++) {
+      if (fds[i].fd < 0 || fds[i].revents == 0) {
+        continue;
+      }
+      if (connectFinished(fds[i].fd)) {
+        winner = fds[i].fd;
+      } else {
+        close(fds[i].fd);
+      }
+      fds[i].fd = -1;                      // poll ignores negative fds
+      numOpen--;
+    }
+  }
+
+  // close the losers
+  for (int i = 0; i < numStarted; i++) {
+    if (fds[i].fd >= 0) {
+      close(fds[i].fd);
+    }
+  }
+
+  if (winner >= 0 && !setBlocking(winner)) {
+    close(winner);
+    winner = -1;
+  }
+  if (winner < 0) {
+    errno = timedOut ? ETIMEDOUT : ECONNREFUSED;
+  }
+  return winner;
+}
+
+/* ****************** connectFinished ***************************** */
+/* Return true if the non-blocking connect on sock succeeded.
+ */
+static bool
+connectFinished(const int sock)
+{
+  int error = 0;
+  socklen_t errorLen = sizeof(error);
+  return (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &errorLen) == 0 && error == 0);
+}
+
+/* ****************** setBlocking ***************************** */
+/* Clear O_NONBLOCK on sock; return false on error.
+ */
+static bool
+setBlocking(const int sock)
+{
+  int flags = fcntl(sock, F_GETFL);
+  return (flags >= 0 && fcntl(sock, F_SETFL, flags & ~O_NONBLOCK) == 0);
+}
+
+/* ****************** timeLeft ***************************** */
+/* Return the milliseconds left until deadline (0 if it has passed),
+ * or -1 if deadline is 0, meaning none; suitable as a poll timeout.
+ */
+static int
+timeLeft(const long long deadline)
+{
+  if (deadline == 0) {
+    return -1;
+  }
+  long long left = deadline - mstime_now();
+  return (left > 0) ? left : 0;
+}
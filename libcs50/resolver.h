@@ -0,0 +1,115 @@
+/*
+ * resolver - cached host name lookups, and connecting to hosts
+ *
+ * A resolver looks host names up with getaddrinfo (IPv4 and IPv6) and
+ * remembers the answers for a fixed time-to-live (TTL), so that a crawl
+ * looks each host up once per TTL rather than once per page.
+ * getaddrinfo does not tell us the TTL of the DNS records themselves,
+ * so the caller picks one.
+ *
+ * A host may have several addresses; resolver_connect either tries them
+ * one after the other or races connects to them, taking whichever
+ * connects first.
+ *
+ * All functions are safe to call from several threads at once.
+ *
+ * By Rodrigo Vega Ayllon - November 2024
+ */
+
+#ifndef __RESOLVER_H
+#define __RESOLVER_H
+
+#include <stdbool.h>
+#include <sys/socket.h>
+
+/* most addresses we keep for one host */
+#define RESOLVER_MAX_ADDRS 8
+
+/***********************************************************************/
+/* resolver_t: opaque struct holding the cache of lookups.
+ */
+typedef struct resolver resolver_t;
+
+/* resolver_addr_t: one address of a host, ready to pass to socket()
+ * (family, socktype, protocol) and connect() (addr, len).
+ */
+typedef struct resolver_addr {
+  int family;
+  int socktype;
+  int protocol;
+  socklen_t len;
+  struct sockaddr_storage addr;   // address, with the port filled in
+} resolver_addr_t;
+
+/**************** resolver_new ****************/
+/* Create a new resolver, with an empty cache.
+ *
+ * Caller provides:
+ *   ttl  seconds for which a lookup is remembered (must be > 0).
+ *
+ * We return:
+ *   pointer to new resolver_t, or NULL on any error.
+ *
+ * Caller is responsible for:
+ *   later calling resolver_delete with the returned pointer.
+ */
+resolver_t* resolver_new(const int ttl);
+
+/**************** resolver_lookup ****************/
+/* Look up the addresses of hostname, from the cache if possible.
+ *
+ * Caller provides:
+ *   valid resolver, hostname, and port to put in the addresses;
+ *   an array addrs with room for maxAddrs addresses.
+ *
+ * We return:
+ *   the number of addresses stored in addrs (at most maxAddrs),
+ *   in the order getaddrinfo gave them; 0 if the host has none,
+ *   or on any error.
+ *
+ * Notes:
+ *   a host that does not exist is remembered as such, for the TTL;
+ *   a lookup that failed for a temporary reason is not.
+ */
+int resolver_lookup(resolver_t* resolver, const char* hostname, const int port,
+                    resolver_addr_t addrs[], const int maxAddrs);
+
+/**************** resolver_peek ****************/
+/* Look up the addresses of hostname in the cache only, never calling
+ * getaddrinfo, for callers that must not block (see fetcher).
+ *
+ * Caller provides, and we return, the same as resolver_lookup, except:
+ *   we return -1 if the cache has no unexpired answer for hostname.
+ */
+int resolver_peek(resolver_t* resolver, const char* hostname, const int port,
+                  resolver_addr_t addrs[], const int maxAddrs);
+
+/**************** resolver_connect ****************/
+/* Look up hostname (see resolver_lookup) and connect a stream socket
+ * to port on one of its addresses.
+ *
+ * Caller provides:
+ *   valid resolver, hostname, and port;
+ *   race: false to try the addresses one at a time, in order;
+ *         true to start a connect to each address in turn, a short
+ *         while apart, without waiting for the earlier ones to finish,
+ *         and keep whichever connects first;
+ *   timeoutMillis: longest time to spend connecting, over all addresses,
+ *         or -1 for no limit (other than the system's own).
+ *
+ * We return:
+ *   a connected (blocking) socket, or -1 if no address would connect,
+ *   in which case errno is ETIMEDOUT if the time ran out.
+ *
+ * Caller is responsible for:
+ *   later closing the socket.
+ */
+int resolver_connect(resolver_t* resolver, const char* hostname, const int port,
+                     const bool race, const int timeoutMillis);
+
+/**************** resolver_delete ****************/
+/* Forget all lookups and delete the resolver.
+ */
+void resolver_delete(resolver_t* resolver);
+
+#endif // __RESOLVER_H
@@ -12,7 +12,7 @@
 /* students shouldn't take advantage of the gnu extensions, 
  * but parsing html without them is a pain.
  */
-#define _GNU_SOURCE       // strncasecmp, strdup
+#define _GNU_SOURCE       // strncasecmp, strdup, random
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -20,10 +20,18 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
-#include <netdb.h>
-#include "file.h"
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include "http.h"
+#include "connpool.h"
+#include "resolver.h"
 #include "webpage.h"
 #include "mem.h"
+#include "mstime.h"
 
 /* ***************************************** */
 /* Private types */
@@ -43,21 +51,68 @@ typedef struct webpage {
   char* url;                               // url of the page
   char* html;                              // html code of the page
   size_t html_len;                         // length of html code
+  bool borrowed;                           // html is not ours to free (see webpage_newView)
+  void (*release)(void* arg);              // ... but to release by calling this, if not NULL
+  void* releaseArg;                        // ... with this
   int depth;                               // depth of crawl
+  char* etag;                              // ETag the page was served with, or NULL
+  char* lastModified;                      // Last-Modified the page was served with, or NULL
+  int status;                              // HTTP status of the last fetch, or 0
+  webpage_declined_t declined;             // why the last fetch turned down the response, if it did
+  webpage_deadline_t missed;               // which deadline the last fetch missed, if any
 } webpage_t;
 
+/* deadline_t: the times, in milliseconds on the monotonic clock, by which a fetch must get on
+ */
+typedef struct deadline {
+  long long firstByteBy;                   // response must start by then, or 0 for no limit
+  long long doneBy;                        // response must be complete by then, or 0 for no limit
+  bool gotByte;                            // response has started
+  webpage_deadline_t missed;               // which deadline passed, if any
+} deadline_t;
+
+/* body_t: the body of a response, as it is read (and decompressed, if need be)
+ */
+typedef struct body {
+  char* buf;                               // body so far, or NULL
+  size_t len;                              // bytes in buf
+  size_t cap;                              // allocated size of buf
+  http_decoder_t* decoder;                 // decompresses the body, or NULL if it is not compressed
+  size_t maxBody;                          // longest body allowed, or 0 for no limit
+  deadline_t* deadline;                    // when reading must be done
+  bool tooLarge;                           // body turned out longer than maxBody
+  bool failed;                             // body is unusable; read no further
+} body_t;
+
 /* *********************************************************************** */
 /* Private function prototypes */
 
-static FILE* connectToHost(const char* hostname, const int port);
+static FILE* connectToHost(const char* hostname, const int port, const long long connectBy);
+static connpool_t* connections(void);
+static resolver_t* resolver(void);
+static void backoff(const int try);
+static bool httpExchange(FILE* http_fp, const char* request, const size_t requestLen, deadline_t* deadline,
+                         http_response_t* resp, char** html, bool* reusable, webpage_declined_t* declined);
+static bool setString(char** field, const char* value);
+static bool sendRequest(FILE* http_fp, const char* request, const size_t requestLen, deadline_t* deadline);
+static char* readHeader(FILE* http_fp, deadline_t* deadline);
+static char* readBody(FILE* http_fp, const http_response_t* resp, const bool decode, const size_t maxBody,
+                      deadline_t* deadline, bool* framed, bool* tooLarge);
+static void readChunks(FILE* http_fp, body_t* body);
+static bool bodyGrow(body_t* body, const size_t more);
+static size_t bodyRead(body_t* body, FILE* http_fp, const size_t n);
+static char* bodyFinish(body_t* body);
+static char* readLine(FILE* http_fp, deadline_t* deadline);
+static size_t readBytes(char* buf, const size_t n, FILE* http_fp, deadline_t* deadline);
+static bool waitFor(FILE* http_fp, const short events, deadline_t* deadline);
 static inline bool isBlankLine(const char* line);
-static char* removeDotSegments(char* input);
-static void removeWhitespace(char* str);
-static char* fixRelativeURL(char* base, char* rel, size_t len);
+static size_t removeDotSegments(const char* input, const size_t len, char* out);
+static bool nextHref(const char* html, const size_t len, int* pos, const char** href, size_t* hrefLen);
+static const char* skipTag(const char* p, const char* end, const bool anchor, const char** href, size_t* hrefLen);
+static char* makeLink(const char* base, const char* href, const size_t len);
+static size_t resolveLink(const struct URL* base, const char* href, size_t len, char* out);
 static bool parseURL(const char* str, struct URL* url);
 static void freeURL(struct URL url);
-static bool burstURL(const char* url, char** hostname, 
-                     int* port, char** pathname);
 #ifdef DEBUG
 static void printURL(struct URL url);
 #endif // DEBUG
@@ -66,7 +121,23 @@ static void printURL(struct URL url);
 /* Private global variables */
 
 static const int MAX_TRY = 3;    // maximum attempts to fetch
-static const int HTTP_PORT = 80; // default web server port
+static const long BACKOFF_BASE = 250;    // milliseconds before the first retry
+static const int MAX_IDLE_PER_HOST = 64; // idle connections kept per host
+static const int MAX_IDLE = 128;         // idle connections kept overall
+
+static const int HOST_TTL = 300;         // seconds to remember a host lookup
+static const bool RACE_CONNECTS = true;  // race connects to a host's addresses
+
+// idle connections and host lookups shared by all fetches; created on first use
+static connpool_t* pool = NULL;
+static resolver_t* hosts = NULL;
+static pthread_mutex_t sharedLock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t maxBodyLen = 0;            // longest body read, or 0 for no limit
+static int connectMillis = 0;            // deadlines of a fetch (see webpage_setDeadlines),
+static int firstByteMillis = 0;          // ... in milliseconds, 0 meaning none
+static int totalMillis = 0;
+static const size_t READ_BLOCK = 16384;  // most bytes of body read at a time
 
 static const char* EXTS[] = {  // valid extensions
   "html",
@@ -88,9 +159,27 @@ int   webpage_getDepth(const webpage_t* page) {
 char* webpage_getHTML(const webpage_t* page)  { 
   return page ? page->html  : NULL;
 }
+size_t webpage_getHTMLLength(const webpage_t* page) {
+  return page ? page->html_len : 0;
+}
 char* webpage_getURL(const webpage_t* page)   { 
   return page ? page->url   : NULL; 
 }
+const char* webpage_getETag(const webpage_t* page) {
+  return page ? page->etag : NULL;
+}
+const char* webpage_getLastModified(const webpage_t* page) {
+  return page ? page->lastModified : NULL;
+}
+int   webpage_getStatus(const webpage_t* page) {
+  return page ? page->status : 0;
+}
+webpage_declined_t webpage_getDeclined(const webpage_t* page) {
+  return page ? page->declined : WEBPAGE_ACCEPTED;
+}
+webpage_deadline_t webpage_getMissed(const webpage_t* page) {
+  return page ? page->missed : WEBPAGE_IN_TIME;
+}
 
 /**************** webpage_new ****************/
 /* see webpage.h for documentation */
@@ -107,10 +196,131 @@ webpage_new(char* url, const int depth, char* html)
   page->depth = depth;
   page->html = html;
   page->html_len = html ? strlen(html) : 0;
+  page->borrowed = false;
+  page->release = NULL;
+  page->releaseArg = NULL;
+  page->etag = NULL;
+  page->lastModified = NULL;
+  page->status = 0;
+  page->declined = WEBPAGE_ACCEPTED;
+  page->missed = WEBPAGE_IN_TIME;
+
+  return page;
+}
+
+/**************** webpage_newView ****************/
+/* see webpage.h for documentation */
+webpage_t*
+webpage_newView(char* url, const int depth, const char* html, const size_t htmlLen,
+                void (*release)(void* arg), void* arg)
+{
+  if (html == NULL) {
+    return NULL;
+  }
 
+  webpage_t* page = webpage_new(url, depth, NULL);
+  if (page == NULL) {
+    return NULL;
+  }
+  page->html = (char*) html;
+  page->html_len = htmlLen;
+  page->borrowed = true;
+  page->release = release;
+  page->releaseArg = arg;
   return page;
 }
 
+/**************** webpage_setHTML ****************/
+/* see webpage.h for documentation */
+bool
+webpage_setHTML(webpage_t* page, char* html)
+{
+  if (page == NULL || html == NULL || page->html != NULL) {
+    return false;
+  }
+
+  page->html = html;
+  page->html_len = strlen(html);
+  return true;
+}
+
+/**************** webpage_setValidators ****************/
+/* see webpage.h for documentation */
+bool
+webpage_setValidators(webpage_t* page, const char* etag, const char* lastModified)
+{
+  if (page == NULL) {
+    return false;
+  }
+  return setString(&page->etag, etag) && setString(&page->lastModified, lastModified);
+}
+
+/**************** webpage_setStatus ****************/
+/* see webpage.h for documentation */
+void
+webpage_setStatus(webpage_t* page, const int status)
+{
+  if (page != NULL) {
+    page->status = status;
+  }
+}
+
+/**************** webpage_setDeclined ****************/
+/* see webpage.h for documentation */
+void
+webpage_setDeclined(webpage_t* page, const webpage_declined_t declined)
+{
+  if (page != NULL) {
+    page->declined = declined;
+  }
+}
+
+/**************** webpage_setMissed ****************/
+/* see webpage.h for documentation */
+void
+webpage_setMissed(webpage_t* page, const webpage_deadline_t missed)
+{
+  if (page != NULL) {
+    page->missed = missed;
+  }
+}
+
+/**************** webpage_setDeadlines ****************/
+/* see webpage.h for documentation */
+void
+webpage_setDeadlines(const int connect, const int firstByte, const int total)
+{
+  connectMillis = (connect > 0) ? connect : 0;
+  firstByteMillis = (firstByte > 0) ? firstByte : 0;
+  totalMillis = (total > 0) ? total : 0;
+}
+
+/**************** webpage_getDeadlines ****************/
+/* see webpage.h for documentation */
+void
+webpage_getDeadlines(int* connect, int* firstByte, int* total)
+{
+  if (connect != NULL) *connect = connectMillis;
+  if (firstByte != NULL) *firstByte = firstByteMillis;
+  if (total != NULL) *total = totalMillis;
+}
+
+/**************** webpage_setMaxBody ****************/
+/* see webpage.h for documentation */
+void
+webpage_setMaxBody(const size_t maxBody)
+{
+  maxBodyLen = maxBody;
+}
+
+/**************** webpage_getMaxBody ****************/
+/* see webpage.h for documentation */
+size_t
+webpage_getMaxBody(void)
+{
+  return maxBodyLen;
+}
+
 /**************** webpage_delete ****************/
 /* see webpage.h for documentation */
 void
@@ -119,7 +329,10 @@ webpage_delete(void* data)
   webpage_t* page = data;
   if (page != NULL) {
     if (page->url) free(page->url);
-    if (page->html) free(page->html);
+    if (page->html && !page->borrowed) free(page->html);
+    if (page->release) (*page->release)(page->releaseArg);
+    if (page->etag) free(page->etag);
+    if (page->lastModified) free(page->lastModified);
     free(page);
   }
 }
@@ -136,10 +349,16 @@ webpage_delete(void* data)
  * Pseudocode:
  *     1. check for valid page 
  *     2. parse url into hostname, port, and filename
- *     3. open a connection to the given host
- *     4. send http request
- *     5. fetch html response
- *     6. cleanup
+ *     3. take an idle connection to the host from the pool, if any,
+ *        and try the request on it (conditional, if the page has an
+ *        ETag or Last-Modified from an earlier fetch)
+ *     4. if that did not get a response, open a new connection
+ *        to the given host and send the request on it
+ *        (unless the server was too slow to respond: see webpage_setDeadlines)
+ *     5. fetch html response, unless its header shows it is not HTML
+ *        or is too long
+ *     6. return the connection to the pool if it can be reused;
+ *        cleanup
  */
 bool 
 webpage_fetch(webpage_t* page)
@@ -151,77 +370,115 @@ webpage_fetch(webpage_t* page)
 
   // burst the URL into its components;
   // all we care about are hostname, port, and pathname
-  char* hostname; // will be initialized by burstURL
-  int port;       // will be initialized by burstURL
-  char* pathname; // will be initialized by burstURL
-  if (!burstURL(page->url, &hostname, &port, &pathname)) {
+  char* hostname; // will be initialized by http_burstURL
+  int port;       // will be initialized by http_burstURL
+  char* pathname; // will be initialized by http_burstURL
+  if (!http_burstURL(page->url, &hostname, &port, &pathname)) {
     return false;
   }
 
-  // attempt to connect to server 
-  FILE* http_fp = NULL; 
-  for (int try = 0;  http_fp == NULL && try < MAX_TRY; try++) {
-    // open connection - exit on error
-    http_fp = connectToHost(hostname, port);
-
-#ifndef NOSLEEP // CS50 students: please don't turn off the sleep!
-    sleep(1);   // sleep one second between fetches, to lighten load on server
-#endif
-  }
-
-  // failed to connect?
-  if (http_fp == NULL) {
+  // prepare HTTP request, asking the server to keep the connection open,
+  // and not to send the page again if it has not changed
+  size_t requestLen = 0;
+  char* request = http_conditionalRequest(hostname, pathname, true, page->etag, page->lastModified,
+                                          &requestLen);
+  free(pathname);
+  if (request == NULL) {
+    free(hostname);
     return false;
   }
 
-  // prepare and send HTTP request; receive response
-  char* httpResponse = NULL;
-  const char* httpFormat =
-    "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n";
-  if (fprintf(http_fp, httpFormat, pathname, hostname) >= 0) {
-    // ensure stdio buffer is flushed to socket
-    fflush(http_fp);
-    // read the server's response
-    httpResponse = file_readLine(http_fp);
+  http_response_t resp;    // header of the response, if any
+  resp.status = 0;
+  char* html = NULL;       // page content, if we get it
+  bool reusable = false;   // can the connection take another request?
+  bool responded = false;  // did the server respond at all?
+  webpage_declined_t declined = WEBPAGE_ACCEPTED;  // why we turned the response down, if we did
+
+  // the whole fetch, connects and retries included, must be done by doneBy
+  deadline_t deadline = { .firstByteBy = 0, .gotByte = false, .missed = WEBPAGE_IN_TIME };
+  deadline.doneBy = (totalMillis > 0) ? mstime_now() + totalMillis : 0;
+
+  // try an idle connection to this host first; the server may have
+  // closed it meanwhile, in which case we won't get a response on it
+  FILE* http_fp = connpool_get(connections(), hostname, port);
+  if (http_fp != NULL) {
+    deadline.firstByteBy = (firstByteMillis > 0) ? mstime_now() + firstByteMillis : 0;
+    responded = httpExchange(http_fp, request, requestLen, &deadline, &resp, &html, &reusable, &declined);
+    if (!responded) {
+      fclose(http_fp);
+      http_fp = NULL;
+    }
   }
 
-  free(hostname);
-  free(pathname);
-
-  // did we succeed? check the response
-  bool success = false;
-
-  if (httpResponse != NULL) {
-    // check response code to see whether we succeeded
-    int httpResponseCode = 0;
-    if (sscanf(httpResponse, "HTTP/1.1 %d", &httpResponseCode) == 1
-        && httpResponseCode == 200) {
-      // success! ignore the rest of the header, then grab the page
-      // read lines until we read a blank line or fail to read a line
-      char* line = file_readLine(http_fp);
-      while (line != NULL && !isBlankLine(line)) {
-        free(line);
-        line = file_readLine(http_fp);
+  // (a server too slow to respond would be as slow on a new connection)
+  if (!responded && deadline.missed == WEBPAGE_IN_TIME) {
+    // attempt to connect to server, backing off before each retry,
+    // each attempt within the connect deadline and all within the total one
+    bool timedOut = false;
+    for (int try = 0;  http_fp == NULL && try < MAX_TRY; try++) {
+      if (try > 0) {
+        backoff(try);
+      }
+      long long connectBy = (connectMillis > 0) ? mstime_now() + connectMillis : 0;
+      if (deadline.doneBy > 0 && (connectBy == 0 || connectBy > deadline.doneBy)) {
+        connectBy = deadline.doneBy;
       }
-      // did we exit the loop because we read an empty line?
-      if (line != NULL) {
-        free(line); // the blank line
-
-        // then grab everything else - that should be the page content
-        char* html = file_readFile(http_fp);
-        if (html != NULL) {
-          page->html = html;
-          success = true;
-        } 
+      http_fp = connectToHost(hostname, port, connectBy);
+      timedOut = (http_fp == NULL && errno == ETIMEDOUT);
+      if (deadline.doneBy > 0 && mstime_now() >= deadline.doneBy) {
+        break;
       }
     }
-    free(httpResponse);
+    if (http_fp == NULL && timedOut) {
+      deadline.missed = (deadline.doneBy > 0 && mstime_now() >= deadline.doneBy)
+        ? WEBPAGE_TOTAL_MISSED : WEBPAGE_CONNECT_MISSED;
+    }
+
+    // send HTTP request; receive response
+    if (http_fp != NULL) {
+      deadline.firstByteBy = (firstByteMillis > 0) ? mstime_now() + firstByteMillis : 0;
+      deadline.gotByte = false;
+      responded = httpExchange(http_fp, request, requestLen, &deadline, &resp, &html, &reusable, &declined);
+    }
+  }
+
+  // keep the connection for the next fetch from this host, if we can
+  if (http_fp != NULL) {
+    if (reusable) {
+      connpool_put(connections(), hostname, port, http_fp);
+    } else {
+      fclose(http_fp);
+    }
   }
 
   // clean up
-  fclose(http_fp);
+  free(hostname);
+  free(request);
+
+  page->status = resp.status;
+  page->declined = declined;
+  page->missed = deadline.missed;
+  if (html == NULL) {
+    return false;
+  }
+  page->html = html;
+  page->html_len = strlen(html);
+  webpage_setValidators(page, resp.etag, resp.lastModified);
+  return true;
+}
 
-  return success;
+/**************** webpage_closeConnections ****************/
+/* see webpage.h for documentation */
+void
+webpage_closeConnections(void)
+{
+  pthread_mutex_lock(&sharedLock);
+  connpool_delete(pool);
+  pool = NULL;
+  resolver_delete(hosts);
+  hosts = NULL;
+  pthread_mutex_unlock(&sharedLock);
 }
 
 /**************** webpage_getNextWord ****************/
@@ -244,26 +501,31 @@ webpage_fetch(webpage_t* page)
  *     1. webpage has html
  *     2. don't care about opening/closing tags: ignore anything between <...>
  *     3. if the html is malformed, we don't care: match '<' with next '>'
+ *
+ * The html is read no further than html_len, so that it need not be
+ * null-terminated, as that of a view is not.
  */
 char* 
 webpage_getNextWord(webpage_t* page, int* pos)
 {
   // make sure we have something to search, and a place for the result
-  if (page == NULL || page->html == NULL || pos == NULL) {
+  if (page == NULL || page->html == NULL || pos == NULL
+      || *pos < 0 || (size_t) *pos > page->html_len) {
     return NULL;
   }
 
   const char* doc = page->html;            // the html document
+  const int len = page->html_len;          // its length
   const char* beg;                         // beginning of word
   const char* end;                         // end of word
 
   // consume any non-alphabetic characters
-  while (doc[*pos] != '\0' && !isalpha(doc[*pos])) {
+  while (*pos < len && !isalpha((unsigned char) doc[*pos])) {
     // if we find a tag, i.e., <...tag...>, skip it
     if (doc[*pos] == '<') {
-      end = strchr(&doc[*pos], '>');          // find the close
+      end = memchr(&doc[*pos], '>', len - *pos);  // find the close
       
-      if (end == NULL || *(++end) == '\0') { // ran out of html
+      if (end == NULL || ++end == doc + len) { // ran out of html
         return NULL;
       }
 
@@ -274,7 +536,7 @@ webpage_getNextWord(webpage_t* page, int* pos)
   }
 
   // ran out of html
-  if (doc[*pos] == '\0') {
+  if (*pos == len) {
     return NULL;
   }
 
@@ -282,7 +544,7 @@ webpage_getNextWord(webpage_t* page, int* pos)
   beg = &(doc[*pos]);
 
   // consume word
-  while (doc[*pos] != '\0' && isalpha(doc[*pos])) {
+  while (*pos < len && isalpha((unsigned char) doc[*pos])) {
     (*pos)++;
   }
 
@@ -314,221 +576,227 @@ webpage_getNextWord(webpage_t* page, int* pos)
  *
  * Pseudocode:
  *     1. check arguments
- *     2. if *pos = 0 (first call for this page): remove whitespace from html
- *     3. find hyperlink starting tags "<a" or "<A"
- *     4. find next href attribute "href="
- *     5. find next end tag ">"
- *     6. check that href comes before end tag
- *     7. deal with quoted and unquoted urls
- *     8. determine if url is absolute
- *     9. fixup relative links
- *    10. update *pos to position after the URL
- *    11. create new character buffer for result and return it
+ *     2. find the href of the next <a> tag at or after *pos (see nextHref),
+ *        which also moves *pos past that tag
+ *     3. turn it into an absolute URL (see makeLink); if it is not a link
+ *        worth following, go back to step 2
+ *     4. return the URL, or NULL when no <a> tag is left
  */
 char* 
 webpage_getNextURL(webpage_t* page, int* pos)
 {
   // make sure we have text and base url, and valid arg
-  if (page == NULL || page->html == NULL || page->url == NULL || pos == NULL) {
+  if (page == NULL || page->html == NULL || page->url == NULL || pos == NULL
+      || *pos < 0 || (size_t) *pos > page->html_len) {
     return NULL;
   }
 
-  char* html = page->html;                 // the html document
-  char* base_url = page->url;              // the base URL for this html
-  int bad_link;                            // is this link ill formatted?
-  int relative;                            // is this link relative?
-  char delim;                              // url delimiter: ' ', ''', '"'
-  char* lnk;                               // hyperlink tags
-  char* href;                              // href in a tag
-  char* end;                               // end of hyperlink tag or url
-  char* ptr;                               // absolute vs. relative
-  char* hash;                              // hash mark character
-
-  // condense html, makes parsing easier
-  if (*pos == 0) {
-    removeWhitespace(html);
+  const char* href;                        // href value in the html
+  size_t hrefLen;                          // ... and its length
+  while (nextHref(page->html, page->html_len, pos, &href, &hrefLen)) {
+    char* url = makeLink(page->url, href, hrefLen);
+    if (url != NULL) {
+      return url;
+    }
   }
+  return NULL;
+}
 
-  // parse for hyperlinks
-  do {
-    relative = 0;                        // assume absolute link
-    bad_link = 0;                        // assume valid link
-
-    // find tag "<a" or "<A""
-    lnk = strcasestr(&html[*pos], "<a");
-
-    // no more links on this page
-    if (!lnk) { return NULL; }
-
-    // find next href after hyperlink tag
-    href = strcasestr(lnk, "href=");
-
-    // no more links on this page
-    if (!href) { return NULL; }
-
-    // find end of hyperlink tag
-    end = strchr(lnk, '>');
+/**************** webpage_getAllURLs ****************/
+/* see webpage.h for documentation.
+ *
+ * The page's URL is parsed once, and each link resolved against it straight
+ * into a buffer that grows geometrically; the URLs are then moved, behind
+ * the array of pointers to them, into the single block we return.
+ */
+char**
+webpage_getAllURLs(webpage_t* page, int* numURLs)
+{
+  if (numURLs != NULL) {
+    *numURLs = 0;
+  }
+  if (page == NULL || page->html == NULL || page->url == NULL || numURLs == NULL) {
+    return NULL;
+  }
 
-    // if the href we have is outside the current tag, continue
-    if (end && (end < href)) {
-      bad_link = 1; (*pos) += 2; continue;
+  struct URL base;                         // pieces of the page's url, if it parses
+  bool haveBase = parseURL(page->url, &base);
+  size_t baseLen = strlen(page->url);
+
+  char* text = NULL;                       // the URLs, each null-terminated
+  size_t textLen = 0, textCap = 0;
+  size_t* starts = NULL;                   // where each URL starts in text
+  int count = 0, startsCap = 0;
+  bool failed = false;
+
+  // one pass over the html, collecting the links as we go
+  int pos = 0;
+  const char* href;
+  size_t hrefLen;
+  while (!failed && nextHref(page->html, page->html_len, &pos, &href, &hrefLen)) {
+    // room for the longest URL this href could resolve to (each byte percent-encoded, at worst)
+    size_t most = baseLen + 3 * hrefLen + 2;
+    if (textCap - textLen < most) {
+      size_t cap = (textCap == 0) ? 4096 : 2 * textCap;
+      while (cap - textLen < most) {
+        cap *= 2;
+      }
+      char* bigger = realloc(text, cap);
+      if (bigger == NULL) {
+        failed = true;
+        break;
+      }
+      text = bigger;
+      textCap = cap;
     }
 
-    // move href to beginning of url
-    href+=5;
-
-    // something went wrong, just continue
-    if (!href) { bad_link=1; (*pos) += 2; continue; }
-
-    // is the url quoted?
-    if (*href == '\'' || *href == '"') {  // yes, href="url" or href='url'
-      delim = *(href++);               // remember delimiter
-      end = strchr(href, delim);       // find next of same delimiter
-    } else {             // no, href=url
-      end = strchr(href, '>');         // hope: <a ... href=url>
-      // since we've stripped whitespace
-      // this could mangle things like:
-      // <a ... href=url name=val>
+    size_t len = resolveLink(haveBase ? &base : NULL, href, hrefLen, &text[textLen]);
+    if (len == 0) {
+      continue;                            // not a link worth following
     }
 
-    // if there is a # before the end of the url, exclude the #fragment
-    hash = strchr(href, '#');
-    if (hash && hash < end) {
-      end = hash;
+    if (count == startsCap) {
+      int cap = (startsCap == 0) ? 64 : 2 * startsCap;
+      size_t* bigger = realloc(starts, cap * sizeof(size_t));
+      if (bigger == NULL) {
+        failed = true;
+        break;
+      }
+      starts = bigger;
+      startsCap = cap;
     }
-
-    // if we don't know where to end the url, continue
-    if (!end) {
-      bad_link = 1; (*pos) += 2; continue;
+    starts[count++] = textLen;
+    textLen += len + 1;
+  }
+  freeURL(base);
+
+  // one block: count + 1 pointers, then the URLs they point to
+  char** urls = failed ? NULL : malloc((count + 1) * sizeof(char*) + textLen);
+  if (urls != NULL) {
+    char* copy = (char*) &urls[count + 1];
+    if (textLen > 0) {
+      memcpy(copy, text, textLen);
     }
-
-    // have a link now
-    if (*href == '#') {                   // internal reference
-      bad_link = 1; (*pos) += 2; continue;
+    for (int k = 0; k < count; k++) {
+      urls[k] = &copy[starts[k]];
     }
+    urls[count] = NULL;
+    *numURLs = count;
+  }
 
-    // is the url absolute, i.e, ':' must precede any '/', '?', or '#'
-    ptr = strpbrk(href, ":/?#");
-    if (!ptr || *ptr != ':') { 
-      relative = 1; 
-    } else if (strncasecmp(href, "http", 4)) { // absolute, but not http(s)
-      bad_link = 1; (*pos) += 2; continue;
-    }
-  } while (bad_link);                       // keep parsing
+  free(text);
+  free(starts);
+  return urls;
+}
 
-  // update position after the end of the url
-  *pos = end - html;
+/******************** normalizeURL *******************************/
+/* see webpage.h for documentation. */
+char*
+normalizeURL(const char* url)
+{
+  if (url == NULL) {
+    return NULL;
+  }
 
-  // have a good link now
-  if (relative) {                           // need to fixup relative links
-    char* result = fixRelativeURL(base_url, href, end - href);
-    return result; // may be NULL if Fixup failed.
-  } else {
-    // create new buffer
-    char* result = calloc(end-href+1, sizeof(char));
-    if (result == NULL) {
-      // out of memory
-      return NULL;
-    } else {
-      // copy over absolute url
-      strncpy(result, href, end - href);
-      return result;
-    }
+  size_t size = strlen(url) + 1;           // the result is no longer than url
+  char* result = malloc(size);
+  if (result == NULL) {
+    return NULL;
+  }
+  if (normalizeURLInto(url, result, size) == 0) {
+    free(result);
+    return NULL;
   }
+  return result;
 }
 
-/******************** normalizeURL *******************************/
+/******************** normalizeURLInto *******************************/
 /* Normalize the url according to RFC 3986 chapter 3.
  * see webpage.h for documentation.
  *
  * Pseudocode:
  *     1. check arguments
- *     2. try to parse url
- *     3. check any file extensions
- *     4. clear the url
- *     5. remove dot segments and lowercase scheme and host
- *     6. allocate space for the new url string
- *     7. assemble the new url from pieces
+ *     2. find where scheme, user info, host, and path end; the query and
+ *        fragment (if any) are whatever follows the path
+ *     3. check any file extension
+ *     4. lowercase scheme and host, copy user info, remove dot segments
+ *        from the path, and copy query and fragment, left to right:
+ *        what we write never gets ahead of what we read, so buf may be url
  */
-char*
-normalizeURL(const char* url)
+size_t
+normalizeURLInto(const char* url, char* buf, const size_t bufSize)
 {
-  if (url == NULL) {
-    return NULL;
+  if (url == NULL || buf == NULL) {
+    return 0;
   }
-
-  // try to parse the url
-  struct URL tmp;               // pieces of the parsed url
-  if (!parseURL(url, &tmp)) {
-    freeURL(tmp);
-    return NULL;
+  size_t len = strlen(url);
+  if (bufSize <= len) {
+    return 0;
   }
 
-  // check file extension
-  if (tmp.path != NULL) {               // if we have a path
-    char* dot = strrchr(tmp.path, '.');   // where is last '.' within string
-    char* slash = strrchr(tmp.path, '/'); // where is last '/' within string
-
-    // We expect to see URL of form /path/to/file.ext
-    if (dot != NULL && slash != NULL && dot > slash) {
-      char* ext = dot+1;                  // extension begins after '.'
-
-      // check against list of known extensions
-      if (strlen(ext) > 0) {
-        bool isKnownExt = false;      // is the extension valid?
-        for (int i = 0; EXTS[i] != NULL; i++) {
-          if (strncasecmp(ext, EXTS[i], strlen(EXTS[i])) == 0) {
-            isKnownExt = true;
-            break;
-          }
-        }
-
-        // no recognized extension found
-        if (!isKnownExt) {
-          freeURL(tmp);
-          return NULL;
-        }
-      }
-    }
+  // make sure absolute url, i.e., ':' must precede any '/', '?', or '#'
+  size_t schemeEnd = strcspn(url, ":/?#");
+  if (url[schemeEnd] != ':') {
+    return 0;
   }
-
-  // Allocate space for resulting URL - which will be no longer than url.
-  char* result = malloc(strlen(url)+1);
-  if (result == NULL) {
-    freeURL(tmp);
-    return NULL;
-  } else {
-    // initialize it to empty string
-    *result = '\0';
+  schemeEnd++;                             // consume ':'
+  if (strncmp(&url[schemeEnd], "//", 2) == 0) {
+    schemeEnd += 2;                        // consume "//"
   }
 
-  // put normalized url back together
-  if (tmp.scheme) {                         // scheme
-    strcat(result, tmp.scheme);
-  }
-  if (tmp.user) {                           // user
-    strcat(result, tmp.user);
+  // user information, anything up to an '@' before the first '/'
+  size_t userEnd = schemeEnd + strcspn(&url[schemeEnd], "@/");
+  userEnd = (url[userEnd] == '@') ? userEnd + 1 : schemeEnd;
+
+  // host, up to the first '/'; we need a path, before any query or fragment
+  size_t hostEnd = schemeEnd + strcspn(&url[schemeEnd], "/");
+  size_t pathEnd = schemeEnd + strcspn(&url[schemeEnd], "?#");
+  if (url[hostEnd] != '/' || pathEnd < hostEnd) {
+    return 0;
   }
-  if (tmp.host) {                           // host
-    strcat(result, tmp.host);
+
+  // check file extension: we expect to see a path of form /path/to/file.ext
+  const char* path = &url[hostEnd];
+  size_t pathLen = pathEnd - hostEnd;
+  const char* dot = NULL;                  // where is last '.' after last '/'
+  for (size_t k = pathLen; k > 0 && path[k - 1] != '/'; k--) {
+    if (path[k - 1] == '.') {
+      dot = &path[k - 1];
+      break;
+    }
   }
-  if (tmp.path) {                           // path
-    // remove . and .. segments
-    char* path = removeDotSegments(tmp.path);
-    if (path == NULL) {
-      freeURL(tmp);
-      return NULL;
-    } else {
-      strcat(result, path);
-      free(path);
+  if (dot != NULL && dot + 1 < path + pathLen) {
+    const char* ext = dot + 1;             // extension begins after '.'
+    size_t extLen = path + pathLen - ext;
+    bool isKnownExt = false;               // is the extension valid?
+    for (int k = 0; EXTS[k] != NULL; k++) {
+      size_t n = strlen(EXTS[k]);
+      if (extLen >= n && strncasecmp(ext, EXTS[k], n) == 0) {
+        isKnownExt = true;
+        break;
+      }
+    }
+    if (!isKnownExt) {                     // no recognized extension found
+      return 0;
     }
   }
-  if (tmp.query) {                          // query
-    strcat(result, tmp.query);
+
+  // put normalized url together, in place if buf is url
+  size_t out = 0;
+  for (size_t k = 0; k < schemeEnd; k++) {          // scheme, lowercase
+    buf[out++] = tolower((unsigned char) url[k]);
+  }
+  for (size_t k = schemeEnd; k < userEnd; k++) {    // user
+    buf[out++] = url[k];
   }
-  if (tmp.fragment) {                       // fragment
-    strcat(result, tmp.fragment);
+  for (size_t k = userEnd; k < hostEnd; k++) {      // host, lowercase
+    buf[out++] = tolower((unsigned char) url[k]);
   }
+  out += removeDotSegments(path, pathLen, &buf[out]); // path
+  size_t tailLen = len - pathEnd;                   // query and fragment
+  memmove(&buf[out], &url[pathEnd], tailLen);
+  out += tailLen;
+  buf[out] = '\0';
 
 #ifdef REMOVE_SLASH
   // Remove trailing slash [DFK 2017].
@@ -537,16 +805,12 @@ normalizeURL(const char* url)
   // but doing so actually prevents the crawler from following the 
   // server's implicit redirect to http://www.cs.dartmouth.edu/index.html
   // So, I've decided not to include it.
-  if (*result != '\0') {
-    char* last = result + strlen(result) - 1;
-    if (*last == '/'){
-      *last = '\0';
-    }
+  if (out > 0 && buf[out - 1] == '/') {
+    buf[--out] = '\0';
   }
 #endif // REMOVE_SLASH
 
-  freeURL(tmp);
-  return result;
+  return out;
 }
 
 /***********************************************************************
@@ -558,7 +822,7 @@ isInternalURL(const char* url)
   if (url == NULL) {
     return false;
   } else {
-    return (strncmp(url, INTERNAL_PREFIX, strlen(INTERNAL_PREFIX)) == 0);
+    return (strncmp(url, INTERNAL_PREFIX, sizeof(INTERNAL_PREFIX) - 1) == 0);
   }
 }
 
@@ -779,117 +1043,550 @@ printURL(struct URL url)
 }
 #endif // DEBUG
 
-/* ****************** burstURL ********************* */
-/* Burst the URL into components (hostname, port, pathname).
+/* ********************* connectToHost ************************** */
+/* Connect to the given hostname and port, 
+ * returning a FILE* open for reading on the (non-blocking) socket
+ * (requests are written straight to its file descriptor),
+ * or NULL on failure, with errno ETIMEDOUT if connectBy (unless 0)
+ * passed first.
  *
- * Input: URL, assumed non-NULL and already normalized.
- * 
- * Output: fill in the other parameters:
- *   a pointer to new string containing the hostname
- *   an integer representing the port
- *   a pointer to new string containing the pathname.
- * and
- *   return true if successful. 
- * 
- * If success, the hostname and pathname must be free'd later.
- * Each string is allocated enough space to hold the whole URL, 
- * which is more than necessary, allowing a little growth if needed.
- * 
- * burstURL is much simpler than parseURL and is used by 
- * webpage_fetch because it can't handle anything other than simple
- * http://hostname[:port][/path] forms of URL anyway.
+ * The hostname is looked up through a resolver that caches lookups,
+ * so that a crawl does not look up the same host for every page.
+ */
+static FILE* 
+connectToHost(const char* hostname, const int port, const long long connectBy)
+{
+  // Create a socket (a file descriptor) connected to the server, within the deadline
+  int timeout = -1;
+  if (connectBy > 0) {
+    long long left = connectBy - mstime_now();
+    timeout = (left > 0) ? left : 0;
+  }
+  int comm_sock = resolver_connect(resolver(), hostname, port, RACE_CONNECTS, timeout);
+  if (comm_sock < 0) {
+    return NULL;
+  }
+
+  // to make it easier to read responses, switch to stdio; the socket is
+  // non-blocking, so that no read waits past the fetch's deadlines (see waitFor)
+  int flags = fcntl(comm_sock, F_GETFL);
+  FILE* http_fp = NULL;
+  if (flags < 0 || fcntl(comm_sock, F_SETFL, flags | O_NONBLOCK) < 0
+      || (http_fp = fdopen(comm_sock, "r")) == NULL) {
+    close(comm_sock);
+    return NULL;
+  }
+
+  return http_fp;
+}
+
+/* ********************* connections ************************** */
+/* Return the pool of idle connections, creating it if needed.
+ */
+static connpool_t*
+connections(void)
+{
+  pthread_mutex_lock(&sharedLock);
+  if (pool == NULL) {
+    pool = connpool_new(MAX_IDLE_PER_HOST, MAX_IDLE);
+  }
+  pthread_mutex_unlock(&sharedLock);
+  return pool;
+}
+
+/* ********************* resolver ************************** */
+/* Return the cache of host lookups, creating it if needed.
+ */
+static resolver_t*
+resolver(void)
+{
+  pthread_mutex_lock(&sharedLock);
+  if (hosts == NULL) {
+    hosts = resolver_new(HOST_TTL);
+  }
+  pthread_mutex_unlock(&sharedLock);
+  return hosts;
+}
+
+/* ********************* backoff ************************** */
+/* Sleep before retry number 'try' (1, 2, ...): exponential backoff
+ * with jitter, i.e., a random time between half and all of
+ * BACKOFF_BASE * 2^(try-1) milliseconds, so that fetches that failed
+ * together do not all retry at the same moment.
+ */
+static void
+backoff(const int try)
+{
+  long millis = BACKOFF_BASE << (try - 1);
+  millis = millis / 2 + random() % (millis / 2 + 1);
+
+  struct timespec delay = { .tv_sec = millis / 1000, .tv_nsec = (millis % 1000) * 1000000 };
+  nanosleep(&delay, NULL);
+}
+
+/* ********************* httpExchange ************************** */
+/* Send the request on an open connection and read the response.
+ *
+ * Returns false if the server did not respond at all (e.g., because it
+ * had already closed the connection).  Otherwise returns true, with
+ *   *resp set to the header of the response (status 0 if malformed);
+ *   *html set to the (malloc'd) body if the status was 200, NULL otherwise;
+ *   *reusable set if the response was read in full and the server
+ *     leaves the connection open for another request;
+ *   *declined set if the status was 200 but we did not read the body,
+ *     because the header says it is not HTML or it is too long.
+ * Either way, deadline->missed is set if the response did not start,
+ * or finish, in time (see deadline_t).
  */
 static bool
-burstURL(const char* url, char** hostname, int* port, char** pathname)
+httpExchange(FILE* http_fp, const char* request, const size_t requestLen, deadline_t* deadline,
+             http_response_t* resp, char** html, bool* reusable, webpage_declined_t* declined)
 {
-  // make plenty of space for the resulting strings
-  int length = strlen(url);
+  *html = NULL;
+  *reusable = false;
+  *declined = WEBPAGE_ACCEPTED;
+  resp->status = 0;
 
-  // initialize hostname to empty string
-  *hostname = calloc(sizeof(char), length); // initialized to all nulls
-  if (*hostname == NULL) {
+  // send the request; read the status line and header of the response
+  if (!sendRequest(http_fp, request, requestLen, deadline)) {
     return false;
   }
-
-  // initialize pathname to slash
-  *pathname = calloc(sizeof(char), length); // initialized to all nulls
-  if (*pathname == NULL) {
-    free(*hostname);
+  char* header = readHeader(http_fp, deadline);
+  if (header == NULL) {
     return false;
-  } else {
-    **pathname = '/';
   }
 
-  // initialize port to default port
-  *port = HTTP_PORT;
+  long headerLen = http_parseHeader(header, strlen(header), resp);
+  free(header);
+  if (headerLen <= 0) {
+    resp->status = 0;
+    return true;             // a response, but not one we understand
+  }
 
-  // parse various forms of the URL
-  if (sscanf(url, "http://%[^:]:%d/%s", *hostname, port, *pathname+1) == 3) {
+  // a 304 (say) has no body, whatever its header says
+  if (!http_hasBody(resp->status)) {
+    *reusable = !resp->close;
     return true;
-  } else if (sscanf(url, "http://%[^/]/%s", *hostname, *pathname+1) == 2) {
-    return true;
-  } else if (sscanf(url, "http://%[^:]:%d", *hostname, port) == 2) {
+  }
+
+  // turn down a page that is not HTML, or too long, without reading it;
+  // the connection is left mid-response, so it cannot be reused
+  size_t maxBody = maxBodyLen;
+  if (resp->status == 200 && !http_isHTML(resp)) {
+    *declined = WEBPAGE_NOT_HTML;
     return true;
-  } else if (sscanf(url, "http://%[^/]/", *hostname) == 1) {
+  }
+  if (maxBody > 0 && resp->contentLength > (long) maxBody) {
+    *declined = (resp->status == 200) ? WEBPAGE_TOO_LARGE : WEBPAGE_ACCEPTED;
     return true;
-  } else if (sscanf(url, "http://%s", *hostname) == 1) {
+  }
+
+  // read the body even if we don't want it, to get to the next response
+  // (decompressing only a page we want; one we cannot decompress is given up on)
+  bool framed = false;
+  bool tooLarge = false;
+  char* body = readBody(http_fp, resp, resp->status == 200, maxBody, deadline, &framed, &tooLarge);
+  *reusable = (framed && body != NULL && !resp->close);
+
+  if (resp->status == 200) {
+    *html = body;
+    if (tooLarge) {
+      *declined = WEBPAGE_TOO_LARGE;
+    }
+  } else {
+    free(body);
+  }
+  return true;
+}
+
+/* ********************* setString ************************** */
+/* Replace *field with a (malloc'd) copy of value, or with NULL if value
+ * is NULL or empty; return false if out of memory (leaving *field NULL).
+ */
+static bool
+setString(char** field, const char* value)
+{
+  free(*field);
+  *field = NULL;
+  if (value == NULL || *value == '\0') {
     return true;
+  }
+  *field = strdup(value);
+  return *field != NULL;
+}
+
+/* ********************* sendRequest ************************** */
+/* Write the whole request to the connection's socket, waiting for room
+ * as need be (within the deadline); return false on error or timeout.
+ * MSG_NOSIGNAL: a connection the server has closed must not kill us.
+ */
+static bool
+sendRequest(FILE* http_fp, const char* request, const size_t requestLen, deadline_t* deadline)
+{
+  size_t sent = 0;
+  while (sent < requestLen) {
+    ssize_t n = send(fileno(http_fp), &request[sent], requestLen - sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitFor(http_fp, POLLOUT, deadline)) {
+        continue;
+      }
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+/* ********************* readHeader ************************** */
+/* Read the status line and header fields of a response, up to and
+ * including the blank line that ends them.  Returns them as one
+ * (malloc'd) string, lines ending in '\n', or NULL if the connection
+ * ends (or the deadline passes) first.
+ */
+static char*
+readHeader(FILE* http_fp, deadline_t* deadline)
+{
+  char* header = NULL;
+  size_t len = 0;
+
+  char* line;
+  while ((line = readLine(http_fp, deadline)) != NULL) {
+    size_t lineLen = strlen(line);
+    char* bigger = realloc(header, len + lineLen + 2);
+    if (bigger == NULL) {
+      free(line);
+      break;
+    }
+    header = bigger;
+    memcpy(&header[len], line, lineLen);
+    len += lineLen;
+    header[len++] = '\n';
+    header[len] = '\0';
+
+    // a blank line after the status line ends the header
+    bool blank = isBlankLine(line);
+    free(line);
+    if (blank && len > lineLen + 1) {
+      return header;
+    }
+  }
+
+  free(header);
+  return NULL;
+}
+
+/* ********************* readBody ************************** */
+/* Read the body of a response whose header is resp, as a (malloc'd)
+ * null-terminated string, or NULL on error, decompressing it if resp
+ * says it is compressed and decode is true.  Sets *framed if the body
+ * had a known length, i.e., we did not rely on the server closing the
+ * connection to find its end.  With maxBody > 0, gives up (returning
+ * NULL, with *tooLarge set) once the (decompressed) body proves longer
+ * than that; the caller has already turned down a Content-Length over
+ * maxBody.  Gives up, too, if the deadline passes.
+ */
+static char*
+readBody(FILE* http_fp, const http_response_t* resp, const bool decode, const size_t maxBody,
+         deadline_t* deadline, bool* framed, bool* tooLarge)
+{
+  body_t body = { .buf = NULL, .len = 0, .cap = 0, .decoder = NULL, .maxBody = maxBody,
+                  .deadline = deadline, .tooLarge = false, .failed = false };
+  if (decode && resp->encoding != HTTP_IDENTITY) {
+    if ((body.decoder = http_decoderNew(resp->encoding)) == NULL) {
+      *framed = false;
+      *tooLarge = false;
+      return NULL;
+    }
+  }
+
+  *framed = true;
+  if (resp->chunked) {
+    readChunks(http_fp, &body);
+  } else if (resp->contentLength >= 0) {
+    // known length: one allocation, one read (unless compressed)
+    if (body.decoder == NULL && !bodyGrow(&body, resp->contentLength)) {
+      body.failed = true;
+    } else if (bodyRead(&body, http_fp, resp->contentLength) != resp->contentLength) {
+      body.failed = true;
+    }
   } else {
-    free(*hostname); *hostname = NULL;
-    free(*pathname); *pathname = NULL;
-    return false;
+    // no length given: the body is everything until the server closes
+    *framed = false;
+    size_t got;
+    do {
+      got = bodyRead(&body, http_fp, READ_BLOCK);
+    } while (got == READ_BLOCK);
+    if (ferror(http_fp) || deadline->missed != WEBPAGE_IN_TIME || (body.len == 0 && body.decoder == NULL)) {
+      body.failed = true;
+    }
   }
+
+  *tooLarge = body.tooLarge;
+  return bodyFinish(&body);
 }
 
+/* ********************* readChunks ************************** */
+/* Read a body sent with Transfer-Encoding: chunked into body, marking
+ * it failed if the chunked encoding is malformed or cut short.
+ */
+static void
+readChunks(FILE* http_fp, body_t* body)
+{
+  while (!body->failed) {
+    // read the chunk size, in hex, ignoring any chunk extensions
+    char* sizeLine = readLine(http_fp, body->deadline);
+    if (sizeLine == NULL) {
+      break;
+    }
+    char* end = NULL;
+    errno = 0;
+    long chunkLen = strtol(sizeLine, &end, 16);
+    bool valid = (end != sizeLine && chunkLen >= 0 && errno != ERANGE);
+    free(sizeLine);
+    if (!valid) {
+      break;
+    }
 
-/* ********************* connectToHost ************************** */
-/* Connect to the given hostname and port, 
- * returning an open FILE* for the socket,
- * or NULL on failure.
+    // the last chunk has size zero; skip the trailer, up to a blank line
+    if (chunkLen == 0) {
+      char* line;
+      while ((line = readLine(http_fp, body->deadline)) != NULL && !isBlankLine(line)) {
+        free(line);
+      }
+      if (line == NULL) {
+        break;
+      }
+      free(line);
+      return;
+    }
+
+    // read the chunk data, then the CRLF that follows it
+    if (bodyRead(body, http_fp, chunkLen) != chunkLen) {
+      break;
+    }
+    char* crlf = readLine(http_fp, body->deadline);
+    if (crlf == NULL) {
+      break;
+    }
+    free(crlf);
+  }
+
+  body->failed = true;
+}
+
+/* ********************* bodyGrow ************************** */
+/* Make room in body's buffer for more bytes and a final '\0', growing
+ * it geometrically; return false if out of memory.
  */
-static FILE* 
-connectToHost(const char* hostname, const int port)
+static bool
+bodyGrow(body_t* body, const size_t more)
 {
-  // Look up the hostname specified on command line
-  struct hostent *hostp = gethostbyname(hostname);
-  if (hostp == NULL) {
-    return NULL;
+  if (body->len + more + 1 <= body->cap) {
+    return true;
+  }
+  size_t cap = (2 * body->cap > body->len + more + 1) ? 2 * body->cap : body->len + more + 1;
+  char* bigger = realloc(body->buf, cap);
+  if (bigger == NULL) {
+    return false;
   }
+  body->buf = bigger;
+  body->cap = cap;
+  return true;
+}
 
-  // Initialize fields of the server address
-  struct sockaddr_in server;  // address of the server
-  server.sin_family = AF_INET;
-  bcopy(hostp->h_addr_list[0], &server.sin_addr, hostp->h_length);
-  server.sin_port = htons(port);
+/* ********************* bodyRead ************************** */
+/* Read up to n bytes of body from the connection, appending them to
+ * body's buffer, or decompressing them into it.  Return the number of
+ * bytes read, which is less than n at the end of the connection, or if
+ * the body fails, is too large, or is complete while more was expected.
+ */
+static size_t
+bodyRead(body_t* body, FILE* http_fp, const size_t n)
+{
+  size_t total = 0;
+  while (total < n && !body->failed) {
+    size_t want = (n - total < READ_BLOCK) ? n - total : READ_BLOCK;
+    size_t got;
+
+    if (body->decoder == NULL) {
+      // as is: straight into the buffer
+      if (!bodyGrow(body, want)) {
+        body->failed = true;
+        break;
+      }
+      got = readBytes(&body->buf[body->len], want, http_fp, body->deadline);
+      body->len += got;
+      if (body->maxBody > 0 && body->len > body->maxBody) {
+        body->tooLarge = body->failed = true;
+      }
+    } else {
+      // compressed: through a block on the stack, then the decoder
+      char block[READ_BLOCK];
+      got = readBytes(block, want, http_fp, body->deadline);
+      http_decode_t result = http_decode(body->decoder, block, got,
+                                         &body->buf, &body->len, &body->cap, body->maxBody);
+      if (result == HTTP_DECODE_TOO_LARGE) {
+        body->tooLarge = true;
+      }
+      if (result == HTTP_DECODE_ERROR || result == HTTP_DECODE_TOO_LARGE) {
+        body->failed = true;
+      }
+    }
 
-  // Create socket (a file descriptor)
-  int comm_sock = socket(AF_INET, SOCK_STREAM, 0);
-  if (comm_sock < 0) {
+    total += got;
+    if (got < want) {
+      break;
+    }
+  }
+  return total;
+}
+
+/* ********************* bodyFinish ************************** */
+/* Null-terminate body's buffer and return it, or, if the body failed
+ * (or, compressed, was cut short), free it and return NULL.
+ */
+static char*
+bodyFinish(body_t* body)
+{
+  if (body->decoder != NULL) {
+    // the compressed body must be complete (a call without input says whether it is)
+    if (!body->failed && http_decode(body->decoder, NULL, 0, &body->buf, &body->len, &body->cap, 0)
+                         != HTTP_DECODE_END) {
+      body->failed = true;
+    }
+    http_decoderDelete(body->decoder);
+    body->decoder = NULL;
+  }
+
+  if (body->failed || !bodyGrow(body, 0)) {
+    free(body->buf);
     return NULL;
   }
+  body->buf[body->len] = '\0';
+  return body->buf;
+}
 
-  // And connect that socket to that server   
-  if (connect(comm_sock, (struct sockaddr *) &server, sizeof(server)) < 0) {
+/* ********************* readLine ************************** */
+/* Read a line from the connection, as file_readLine does: return it as
+ * a (malloc'd) string without its '\n', or NULL if the connection ends
+ * before any of it, on error, or if the deadline passes mid-way.
+ */
+static char*
+readLine(FILE* http_fp, deadline_t* deadline)
+{
+  size_t len = 0;
+  size_t cap = 81;                         // big enough for typical lines
+  char* line = malloc(cap);
+  if (line == NULL) {
     return NULL;
   }
 
-  // to make it easier to work with, switch to stdio
-  FILE* http_fp = fdopen(comm_sock, "r+");
-  if (http_fp == NULL) {
+  char c = '\0';
+  while (readBytes(&c, 1, http_fp, deadline) == 1 && c != '\n') {
+    if (len + 2 > cap) {
+      char* bigger = realloc(line, 2 * cap);
+      if (bigger == NULL) {
+        free(line);
+        return NULL;
+      }
+      line = bigger;
+      cap *= 2;
+    }
+    line[len++] = c;
+  }
+
+  if ((len == 0 && c != '\n') || ferror(http_fp) || deadline->missed != WEBPAGE_IN_TIME) {
+    free(line);
     return NULL;
   }
+  line[len] = '\0';
+  return line;
+}
 
-  return http_fp;
+/* ********************* readBytes ************************** */
+/* Read n bytes from the connection into buf, waiting for them (within
+ * the deadline) as the socket is non-blocking.  Return the number read,
+ * which is less than n at the end of the connection, on error (with the
+ * error indicator of http_fp set), or if the deadline passes.
+ */
+static size_t
+readBytes(char* buf, const size_t n, FILE* http_fp, deadline_t* deadline)
+{
+  size_t total = 0;
+  while (total < n) {
+    size_t got = fread(&buf[total], 1, n - total, http_fp);
+    total += got;
+    if (got > 0) {
+      deadline->gotByte = true;
+    }
+    if (total == n || feof(http_fp)) {
+      break;
+    }
+
+    // nothing more to read just now: wait for more, unless that was a real error
+    if (!(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      break;
+    }
+    clearerr(http_fp);
+    if (!waitFor(http_fp, POLLIN, deadline)) {
+      break;
+    }
+  }
+  return total;
+}
+
+/* ********************* waitFor ************************** */
+/* Wait until the connection's socket is ready for events (POLLIN or
+ * POLLOUT), but not past the deadline that applies: the first-byte one
+ * until the response has started, and the total one throughout.
+ * Return true if ready; false on error or if the deadline passes, in
+ * which case deadline->missed says which.
+ */
+static bool
+waitFor(FILE* http_fp, const short events, deadline_t* deadline)
+{
+  while (true) {
+    long long by = deadline->doneBy;
+    webpage_deadline_t missed = WEBPAGE_TOTAL_MISSED;
+    if (!deadline->gotByte && deadline->firstByteBy > 0 && (by == 0 || deadline->firstByteBy < by)) {
+      by = deadline->firstByteBy;
+      missed = WEBPAGE_FIRST_BYTE_MISSED;
+    }
+
+    int timeout = -1;
+    if (by > 0) {
+      long long left = by - mstime_now();
+      timeout = (left > 0) ? left : 0;
+    }
+
+    struct pollfd fd = { .fd = fileno(http_fp), .events = events };
+    int ready = poll(&fd, 1, timeout);
+    if (ready > 0) {
+      return true;
+    } else if (ready == 0) {
+      deadline->missed = missed;
+      return false;
+    } else if (errno != EINTR) {
+      return false;
+    }
+  }
 }
 
 
 /* ***************************************************************** */
 /*
  * removeDotSegments - removes . and .. segments from url paths
- * @input: the character buffer to cleanse
+ * @input: the path to cleanse (not null-terminated)
+ * @len: its length, at least 1
+ * @out: where to write the cleansed path, which is no longer than input;
+ *       may be input itself, as we never write ahead of what we read
  *
- * Returns a newly allocated character buffer with . and .. segments removed
- * according to the algorithm in RFC 3986 section 5.2.4 "Remove Dot Segments".
+ * Returns the length of the path written to out (not null-terminated),
+ * with . and .. segments removed according to the algorithm in RFC 3986
+ * section 5.2.4 "Remove Dot Segments".
  * See: http://www.ietf.org/rfc/rfc1738.txt
  *
  * Should have no use outside of this file, thus declared static.
@@ -916,58 +1613,35 @@ connectToHost(const char* hostname, const int port)
  * be used in advertising or otherwise to promote the sale, use or other dealings
  * in this Software without prior written authorization of the copyright holder.
  */
-static char* 
-removeDotSegments(char* input)
+static size_t
+removeDotSegments(const char* input, const size_t len, char* out)
 {
-  size_t in_len;                           // input length
-  size_t copy_len;                         // copy length
-  char* copy;                              // copy of input that is modified
-  char* copyptr;                           // handle for free'ing copy'
-  char* out;                               // output buffer
-  char* outptr;                            // pointer to current write point
-
-  if (!input || strlen(input) < 1)
-    return NULL;
-
-  // save lengths
-  in_len = copy_len = strlen(input);
-
-  // create output buffer
-  out = outptr = calloc(in_len + 1, sizeof(char));
-  if (!out)
-    return NULL; /* out of memory */
-
-  // copy the input buffer
-  copy = copyptr = strdup(input);
-  if (!copy) {
-    free(out);
-    return NULL;
-  }
+  size_t in = 0;                           // input read so far
+  size_t outLen = 0;                       // output written so far
 
   // 2.  While the input buffer is not empty, loop as follows:
-  do {
+  while (in < len) {
+    const char* copy = &input[in];         // rest of the input
+    size_t left = len - in;
+
     // A. If the input buffer begins with a prefix of "../" or "./",
     //    then remove that prefix from the input buffer; otherwise,
-    if (!strncmp("./", copy, 2)) {
-      copy += 2;
-      copy_len -= 2;
+    if (left >= 2 && strncmp("./", copy, 2) == 0) {
+      in += 2;
     }
-    else if (!strncmp("../", copy, 3)) {
-      copy += 3;
-      copy_len -= 3;
+    else if (left >= 3 && strncmp("../", copy, 3) == 0) {
+      in += 3;
     }
 
     // B. if the input buffer begins with a prefix of "/./" or "/.",
     //    where "." is a complete path segment, then replace that
     //    prefix with "/" in the input buffer; otherwise,
-    else if (!strncmp("/./", copy, 3)) {
-      copy += 2;
-      copy_len -= 2;
+    else if (left >= 3 && strncmp("/./", copy, 3) == 0) {
+      in += 2;
     }
-    else if (!strcmp("/.", copy)) {
-      copy[1] = '/';
-      copy++;
-      copy_len -= 1;
+    else if (left == 2 && strncmp("/.", copy, 2) == 0) {
+      out[outLen++] = '/';                 // (all that is left is "/")
+      in = len;
     }
 
     // C. if the input buffer begins with a prefix of "/../" or "/..",
@@ -975,169 +1649,301 @@ removeDotSegments(char* input)
     //    prefix with "/" in the input buffer and remove the last
     //    segment and its preceding "/" (if any) from the output
     //    buffer; otherwise,
-    else if (!strncmp("/../", copy, 4)) {
-      copy += 3;
-      copy_len -= 3;
-
-      // remove the last segment
-      while (outptr > out) {
-        outptr--;
-        if (*outptr == '/')
-          break;
+    else if (left >= 4 && strncmp("/../", copy, 4) == 0) {
+      in += 3;
+      while (outLen > 0 && out[--outLen] != '/') {
+        ;                                  // remove the last segment
       }
-      *outptr = 0;
-    }
-    else if (!strcmp("/..", copy)) {
-      copy[2] = '/';
-      copy += 2;
-      copy_len -= 2;
-
-      // remove the last segment
-      while (outptr > out) {
-        outptr--;
-        if (*outptr == '/')
-          break;
+    }
+    else if (left == 3 && strncmp("/..", copy, 3) == 0) {
+      while (outLen > 0 && out[--outLen] != '/') {
+        ;                                  // remove the last segment
       }
-      *outptr = 0;
+      out[outLen++] = '/';                 // (all that is left is "/")
+      in = len;
     }
 
     // D. if the input buffer consists only of "." or "..", then remove
-    //    that from the input buffer; otherwise, */
-    else if (!strcmp(".", copy) || !strcmp("..", copy)) {
-      *copy = 0;
+    //    that from the input buffer; otherwise,
+    else if ((left == 1 && *copy == '.') || (left == 2 && strncmp("..", copy, 2) == 0)) {
+      in = len;
     }
 
     // E. move the first path segment in the input buffer to the end of
     //    the output buffer, including the initial "/" character (if
     //    any) and any subsequent characters up to, but not including,
-    //    the next "/" character or the end of the input buffer. */
+    //    the next "/" character or the end of the input buffer.
     else {
       do {
-        *outptr++ = *copy++;
-        copy_len--;
-      } while (*copy && (*copy != '/'));
-      *outptr = '\0';
+        out[outLen++] = input[in++];
+      } while (in < len && input[in] != '/');
     }
-  } while (*copy != '\0');    // keep going
-
-  // cleanup copy
-  free(copyptr);
+  }
 
-  return out;
+  return outLen;
 }
 
 /* ***************************************************************** */
 /*
- * fixRelativeURL - resolves a relative url to an absolute url
- * @base: base url to resolve from
- * @rel: relative url to resolve
- * @len: length of the relative url
+ * nextHref - finds the href of the next <a> tag in html
+ * @html: html document (need not be null-terminated)
+ * @len: its length
+ * @pos: where to start looking; moved past the tag found
+ * @href: set to the start of the tag's href value, within html
+ * @hrefLen: set to the length of that value
  *
- * Returns a newly allocated character buffer that represents the
- * absolute url from the base and relative urls. Returns NULL if
- * an absolute url cannot be established.
+ * Returns true if it found one; false, with *pos at the end of html, if not.
  *
- * This is a quick attempt at RFC 3986 section 5.2.
+ * One pass, left to right, tokenizing just enough HTML to get tags right:
+ * a '<' not followed by a letter, '/', '!' or '?' is text; attribute
+ * values may be quoted (and then hold '>') or not; comments, and the
+ * contents of <script> and <style>, hold no tags.  The html is not
+ * changed, and no byte of it is looked at more than a few times, nor
+ * any byte past len.
  */
-
-static char* 
-fixRelativeURL(char* base, char* rel, size_t len)
+static bool
+nextHref(const char* html, const size_t len, int* pos, const char** href, size_t* hrefLen)
 {
-  char* abs_url;                           // absolute url to build
-  char* slash;                             // right-most '/' in a path
-  struct URL tmp;                          // parsed url
+  const char* end = html + len;            // end of the html
+  const char* p = &html[*pos];
+
+  while ((p = memchr(p, '<', end - p)) != NULL) {
+    p++;
+    if (end - p >= 3 && memcmp(p, "!--", 3) == 0) {   // comment
+      const char* close = memmem(p + 3, end - p - 3, "-->", 3);
+      p = (close != NULL) ? close + 3 : end;
+      continue;
+    }
+    if (p == end || (!isalpha((unsigned char) *p) && *p != '/' && *p != '!' && *p != '?')) {
+      continue;                                        // just a '<' in the text
+    }
 
-  // we need a base url to work with
-  if (!base) {
-    return NULL;
-  }
+    // the tag's name, which tells whether it is an anchor, or holds raw text
+    const char* name = p;
+    while (p < end && !isspace((unsigned char) *p) && *p != '>' && *p != '/') {
+      p++;
+    }
+    if (p == name && *p == '/') {                      // end tag: name follows the '/'
+      name = ++p;
+      while (p < end && !isspace((unsigned char) *p) && *p != '>') {
+        p++;
+      }
+    }
+    size_t nameLen = p - name;
+    bool anchor = (nameLen == 1 && name[-1] == '<' && (*name == 'a' || *name == 'A'));
 
-  // allocate new absolute url
-  abs_url = calloc(strlen(base) + len + 2, sizeof(char));
-  if (!abs_url) {
-    return NULL;
-  }
+    *href = NULL;
+    p = skipTag(p, end, anchor, href, hrefLen);
 
-  // attempt to parse the base url
-  if (!parseURL(base, &tmp)) {
-    free(abs_url);                       // cleanup the absolute url
+    if (*href != NULL) {
+      *pos = p - html;
+      return true;
+    }
 
-    abs_url = NULL;                      // going to return NULL
-    goto cleanup;                        // sorry Dijkstra
+    // raw text: no tags until the matching end tag
+    if (name[-1] == '<' && ((nameLen == 6 && strncasecmp(name, "script", 6) == 0)
+                            || (nameLen == 5 && strncasecmp(name, "style", 5) == 0))) {
+      const char* close;
+      while ((close = memmem(p, end - p, "</", 2)) != NULL
+             && ((size_t) (end - close - 2) < nameLen || strncasecmp(close + 2, name, nameLen) != 0)) {
+        p = close + 2;
+      }
+      p = (close != NULL) ? close : end;
+    }
   }
 
-  // put absolute url back together
-  if (tmp.scheme) {                         // scheme
-    strcat(abs_url, tmp.scheme);
-  }
+  *pos = end - html;
+  return false;
+}
 
-  if (tmp.user) {                           // user
-    strcat(abs_url, tmp.user);
-  }
+/* ***************************************************************** */
+/*
+ * skipTag - skips the attributes of a tag, and its closing '>'
+ * @p: just after the tag's name
+ * @end: end of the html
+ * @anchor: is it an <a> tag?
+ * @href: if anchor, set to the start of its (first) href value, if any
+ * @hrefLen: set to the length of that value
+ *
+ * Returns a pointer just past the tag (or to the end of the html, if the
+ * tag never closes; an unterminated quoted value yields no href).
+ */
+static const char*
+skipTag(const char* p, const char* end, const bool anchor, const char** href, size_t* hrefLen)
+{
+  while (true) {
+    while (p < end && (isspace((unsigned char) *p) || *p == '/')) {
+      p++;
+    }
+    if (p == end) {
+      return p;
+    }
+    if (*p == '>') {
+      return p + 1;
+    }
 
-  if (tmp.host) {                           // host
-    strcat(abs_url, tmp.host);              // always ends in slash
-  }
+    // attribute name
+    const char* attr = p;
+    while (p < end && !isspace((unsigned char) *p) && *p != '=' && *p != '>' && *p != '/') {
+      p++;
+    }
+    size_t attrLen = p - attr;
+    while (p < end && isspace((unsigned char) *p)) {
+      p++;
+    }
+    if (p == end || *p != '=') {
+      if (attrLen == 0) {
+        p++;                                           // a stray character; make progress
+      }
+      continue;                                        // attribute without a value
+    }
+    p++;
+    while (p < end && isspace((unsigned char) *p)) {
+      p++;
+    }
 
-  // do we have a relative url?
-  if (rel) { // yes, add it to the abs_url
-    // is the relative URL relative to domain root, or relative to base?
-    if (rel[0] == '/') {
-      // relative to domain root
-      strncat(abs_url, rel, len);      // add relative url
+    // attribute value, quoted or not
+    const char* value = p;
+    size_t valueLen;
+    if (p < end && (*p == '"' || *p == '\'')) {
+      const char* close = memchr(p + 1, *p, end - p - 1);
+      if (close == NULL) {
+        *href = NULL;
+        return end;
+      }
+      value = p + 1;
+      valueLen = close - value;
+      p = close + 1;
     } else {
-      // relative to base_url
-      // add the base path up to the right-most '/'
-      if (tmp.path
-          && (slash = strrchr(tmp.path, '/'))
-          && (slash != tmp.path)) {
-        strncat(abs_url, tmp.path, slash - tmp.path);
+      while (p < end && !isspace((unsigned char) *p) && *p != '>') {
+        p++;
       }
-      strcat(abs_url, "/");            // separate base and relative path
-      strncat(abs_url, rel, len);      // add relative url
+      valueLen = p - value;
     }
-  } else { // no relative url; finish the abs_url
-    // DFK: not sure this case occurs, or if it does, what action to take.
-    // add the base path up to the right-most '/'
-    if (tmp.path
-        && (slash = strrchr(tmp.path, '/'))
-        && (slash != tmp.path)) {
-      strncat(abs_url, tmp.path, slash - tmp.path);
+
+    if (anchor && *href == NULL && attrLen == 4 && strncasecmp(attr, "href", 4) == 0) {
+      *href = value;
+      *hrefLen = valueLen;
     }
   }
+}
 
-  // we can ignore the base query and fragment, they shouldn't apply
+/* ***************************************************************** */
+/*
+ * makeLink - turns an href value into an absolute URL worth following
+ * @base: url of the page the href is on
+ * @href: href value (not null-terminated)
+ * @len: its length
+ *
+ * Returns a newly allocated absolute URL (see resolveLink), or NULL if
+ * the href is not a link worth following, or out of memory.
+ */
+static char*
+makeLink(const char* base, const char* href, const size_t len)
+{
+  struct URL tmp;                          // parsed base url
+  bool haveBase = parseURL(base, &tmp);
 
- cleanup:                                     // cleanup memory
-  freeURL(tmp);
+  char* result = malloc(strlen(base) + 3 * len + 2);
+  if (result != NULL && resolveLink(haveBase ? &tmp : NULL, href, len, result) == 0) {
+    free(result);
+    result = NULL;
+  }
 
-  return abs_url;
+  freeURL(tmp);
+  return result;
 }
 
-
 /* ***************************************************************** */
 /*
- * removeWhitespace - removes whitespace from str
- * @str: char buffer to modify
+ * resolveLink - resolves an href value to an absolute URL worth following
+ * @base: parsed url of the page the href is on, or NULL if it did not parse
+ * @href: href value (not null-terminated)
+ * @len: its length
+ * @out: where to write the URL, with room for the length of the base
+ *       url plus 3 times len plus 2
  *
- * Eliminates whitespace by shifting and condensing all the non-whitespace
- * toward the beginning of the buffer. This does not alter the size of the
- * buffer.
+ * Returns the length of the null-terminated URL written to out, without
+ * any #fragment; or 0 if the href is only a fragment, has a scheme other
+ * than http(s), or is relative to a base we do not have.  Surrounding
+ * whitespace is ignored, tabs and newlines within the href are dropped,
+ * and any other space or control character within it is percent-encoded
+ * (a space becomes %20), since it cannot go into a request line as is.
  *
- * Should have no use outside of this file, thus declared static.
+ * Relative hrefs are resolved as a quick attempt at RFC 3986 section 5.2:
+ * one starting with '/' is relative to the base's host, any other to the
+ * base's path up to its right-most '/'.
  */
-static void
-removeWhitespace(char* str)
+static size_t
+resolveLink(const struct URL* base, const char* href, size_t len, char* out)
 {
-  char* prev;                              // previous whitespace
-  char* cur;                               // current non-whitespace
+  // trim whitespace
+  while (len > 0 && isspace((unsigned char) *href)) {
+    href++;
+    len--;
+  }
+  while (len > 0 && isspace((unsigned char) href[len - 1])) {
+    len--;
+  }
 
-  // start at beginning of str
-  cur = prev = str;
+  // drop the #fragment, and links that are nothing but one
+  const char* hash = memchr(href, '#', len);
+  if (hash != NULL) {
+    if (hash == href) {
+      return 0;
+    }
+    len = hash - href;
+  }
+
+  // is the url absolute, i.e., ':' must precede any '/', '?', or '#'
+  size_t scheme = 0;
+  while (scheme < len && strchr(":/?#", href[scheme]) == NULL) {
+    scheme++;
+  }
 
-  do {
-    while (isspace(*cur)) cur++;           // consume any whitespace
-  } while ((*prev++ = *cur++));            // condense to front of str
+  size_t outLen = 0;
+  if (scheme < len && href[scheme] == ':') {
+    if (strncasecmp(href, "http", 4) != 0) {
+      return 0;                            // absolute, but not http(s)
+    }
+  } else {
+    if (base == NULL) {
+      return 0;                            // relative, to nothing
+    }
+    // put the base back together, up to where the href goes
+    const char* pieces[] = { base->scheme, base->user, base->host };
+    for (int k = 0; k < 3; k++) {
+      if (pieces[k] != NULL) {
+        size_t n = strlen(pieces[k]);
+        memcpy(&out[outLen], pieces[k], n);
+        outLen += n;
+      }
+    }
+    if (len == 0 || href[0] != '/') {     // relative to base path
+      // add the base path up to the right-most '/'
+      const char* slash = (base->path != NULL) ? strrchr(base->path, '/') : NULL;
+      if (slash != NULL && slash != base->path) {
+        memcpy(&out[outLen], base->path, slash - base->path);
+        outLen += slash - base->path;
+      }
+      out[outLen++] = '/';                 // separate base and relative path
+    }
+  }
+
+  // the href itself, without tabs and newlines, and with spaces and controls percent-encoded
+  for (size_t k = 0; k < len; k++) {
+    unsigned char c = href[k];
+    if (c == '\t' || c == '\r' || c == '\n') {
+      continue;
+    }
+    if (c <= ' ' || c == 0x7f) {
+      outLen += sprintf(&out[outLen], "%%%02X", c);
+    } else {
+      out[outLen++] = c;
+    }
+  }
+  out[outLen] = '\0';
+  return outLen;
 }
 
 /* **************** isBlankLine ******************/
@@ -15,6 +15,10 @@
  * Othertimes, you have fetched the HTML and want to work with it;
  * then, the webpage object has a non-null HTML pointer.
  *
+ * A "view" (see webpage_newView) is a webpage whose HTML it does not own:
+ * it points into memory someone else keeps, e.g., a memory-mapped page
+ * file, and need not be null-terminated; it is read, not changed.
+ *
  * Original by Ira Ray Jenkins - April 2014
  * 
  * Updated by David Kotz - April 2016, July 2017, April 2019, 2021
@@ -33,10 +37,32 @@
  */
 typedef struct webpage webpage_t;
 
+/* webpage_declined_t: why a fetch turned down the response it got, without reading its body
+ *   WEBPAGE_ACCEPTED  it did not (the response may still have failed for other reasons)
+ *   WEBPAGE_NOT_HTML  its Content-Type is not HTML (see http_isHTML)
+ *   WEBPAGE_TOO_LARGE its body is longer than webpage_setMaxBody allows
+ */
+typedef enum { WEBPAGE_ACCEPTED, WEBPAGE_NOT_HTML, WEBPAGE_TOO_LARGE } webpage_declined_t;
+
+/* webpage_deadline_t: which deadline (see webpage_setDeadlines) a fetch missed, if any
+ *   WEBPAGE_IN_TIME             none (the fetch may still have failed for other reasons)
+ *   WEBPAGE_CONNECT_MISSED      it could not connect in time
+ *   WEBPAGE_FIRST_BYTE_MISSED   the server did not start responding in time
+ *   WEBPAGE_TOTAL_MISSED        the whole fetch took too long
+ */
+typedef enum { WEBPAGE_IN_TIME, WEBPAGE_CONNECT_MISSED,
+               WEBPAGE_FIRST_BYTE_MISSED, WEBPAGE_TOTAL_MISSED } webpage_deadline_t;
+
 /* getter methods */
 int   webpage_getDepth(const webpage_t* page);
 char* webpage_getURL(const webpage_t* page);
-char* webpage_getHTML(const webpage_t* page);
+char* webpage_getHTML(const webpage_t* page);  // not null-terminated in a view
+size_t webpage_getHTMLLength(const webpage_t* page);  // 0 if no HTML
+const char* webpage_getETag(const webpage_t* page);          // NULL if none
+const char* webpage_getLastModified(const webpage_t* page);  // NULL if none
+int   webpage_getStatus(const webpage_t* page);  // HTTP status of the last fetch, 0 if none
+webpage_declined_t webpage_getDeclined(const webpage_t* page); // why the last fetch turned down the response
+webpage_deadline_t webpage_getMissed(const webpage_t* page);   // which deadline the last fetch missed
 
 /**************** webpage_new ****************/
 /* Allocate and initialize a new webpage_t structure.
@@ -62,6 +88,133 @@ char* webpage_getHTML(const webpage_t* page);
  */
 webpage_t* webpage_new(char* url, const int depth, char* html);
 
+/**************** webpage_newView ****************/
+/* Allocate and initialize a read-only webpage_t structure whose HTML
+ * is borrowed, not adopted.
+ *
+ * Caller provides:
+ *   url      must be a non-null pointer to malloc'd memory (adopted, as
+ *            by webpage_new).
+ *   depth    must be non-negative.
+ *   html     non-null pointer to htmlLen bytes of HTML, which need not be
+ *            null-terminated, nor be writable.
+ *   release  function called with arg by webpage_delete, once html is no
+ *            longer needed (e.g., to unmap it), or NULL if there is none.
+ *
+ * We return:
+ *   pointer to new webpage_t, or NULL on any error (in which case the
+ *   caller still owns url and html, and release is not called).
+ *
+ * Caller is responsible for:
+ *   keeping html as it is until release is called (or, if release is
+ *   NULL, until the page is deleted); later calling webpage_delete.
+ *
+ * IMPORTANT:
+ *   webpage_getNextWord, webpage_getNextURL and webpage_getAllURLs read
+ *   no further than htmlLen; code that takes webpage_getHTML for a
+ *   string must not be given a view.
+ */
+webpage_t* webpage_newView(char* url, const int depth, const char* html, const size_t htmlLen,
+                           void (*release)(void* arg), void* arg);
+
+/**************** webpage_setHTML ****************/
+/* Give a webpage the HTML retrieved for it by some other means than
+ * webpage_fetch(), e.g., by the fetcher module.
+ *
+ * Caller provides:
+ *   page  valid webpage_t* whose html is still NULL.
+ *   html  non-null pointer to malloc'd, null-terminated string.
+ *
+ * We return:
+ *   true if html was stored into page; false on any error
+ *   (in which case the caller still owns html).
+ *
+ * IMPORTANT:
+ *   as with webpage_new, the webpage adopts html and will free() it
+ *   in webpage_delete().
+ */
+bool webpage_setHTML(webpage_t* page, char* html);
+
+/**************** webpage_setValidators ****************/
+/* Give a webpage the ETag and Last-Modified values it was served with,
+ * e.g., as remembered from an earlier crawl; a later webpage_fetch then
+ * asks the server for the page only if it has changed since.
+ *
+ * Caller provides:
+ *   page          valid webpage_t*.
+ *   etag          ETag value, or NULL or "" for none.
+ *   lastModified  Last-Modified value, or NULL or "" for none.
+ *
+ * We return:
+ *   true on success; false on NULL page or if out of memory.
+ *
+ * IMPORTANT:
+ *   unlike webpage_new, we copy the strings.
+ */
+bool webpage_setValidators(webpage_t* page, const char* etag, const char* lastModified);
+
+/**************** webpage_setStatus ****************/
+/* Record the HTTP status of a response for a webpage fetched by some
+ * other means than webpage_fetch(), e.g., by the fetcher module.
+ */
+void webpage_setStatus(webpage_t* page, const int status);
+
+/**************** webpage_setDeclined ****************/
+/* Record why a webpage fetched by some other means than webpage_fetch()
+ * was turned down, e.g., by the fetcher module.
+ */
+void webpage_setDeclined(webpage_t* page, const webpage_declined_t declined);
+
+/**************** webpage_setMissed ****************/
+/* Record which deadline a webpage fetched by some other means than
+ * webpage_fetch() missed, e.g., by the fetcher module.
+ */
+void webpage_setMissed(webpage_t* page, const webpage_deadline_t missed);
+
+/**************** webpage_setDeadlines ****************/
+/* Bound how long webpage_fetch (and the fetcher module) may take over
+ * each page, for all pages from now on.
+ *
+ * Caller provides, each in milliseconds, or 0 for no limit (the default):
+ *   connect    to connect to the server (each try, if a connect is retried)
+ *   firstByte  from sending the request to the first byte of the response
+ *   total      for the whole fetch, connecting included
+ *
+ * Notes:
+ *   a fetch that misses a deadline fails, its connection closed, and
+ *   webpage_getMissed tells which; a server that trickles a response
+ *   out slowly is caught by the total deadline.
+ *   Call it before fetching starts; it is not meant to change mid-crawl.
+ */
+void webpage_setDeadlines(const int connect, const int firstByte, const int total);
+
+/**************** webpage_getDeadlines ****************/
+/* Store the deadlines set by webpage_setDeadlines (0 if none) into
+ * whichever of connect, firstByte, and total are not NULL.
+ */
+void webpage_getDeadlines(int* connect, int* firstByte, int* total);
+
+/**************** webpage_setMaxBody ****************/
+/* Limit the length of the bodies that webpage_fetch (and the fetcher
+ * module) will read, for all pages from now on.
+ *
+ * Caller provides:
+ *   maxBody  most bytes of body to read, or 0 for no limit (the default).
+ *
+ * Notes:
+ *   a response whose Content-Length is over the limit is turned down
+ *   before any of its body is read; one without a Content-Length is
+ *   turned down as soon as it has sent more than that.  Either way the
+ *   connection is closed rather than read to the end.
+ *   Call it before fetching starts; it is not meant to change mid-crawl.
+ */
+void webpage_setMaxBody(const size_t maxBody);
+
+/**************** webpage_getMaxBody ****************/
+/* Return the limit set by webpage_setMaxBody, or 0 if none.
+ */
+size_t webpage_getMaxBody(void);
+
 /**************** webpage_delete ****************/
 /* Delete a webpage_t structure created by webpage_new().
  *
@@ -70,7 +223,9 @@ webpage_t* webpage_new(char* url, const int depth, char* html);
  *   (parameter is void* so this function can be used as an itemdelete()).
  *
  * IMPORTANT:
- *   we call free() on both the url and the html, if not NULL.
+ *   we call free() on both the url and the html, if not NULL
+ *   (and on the copies made by webpage_setValidators); but for a view,
+ *   we leave the html alone, and call its release function, if any.
  */
 void webpage_delete(void* data);
 
@@ -84,7 +239,15 @@ void webpage_delete(void* data);
  *
  * We return:
  *   true if the fetch was successful; otherwise, false;
- *   if the fetch succeeded, page->html will contain the content retrieved.
+ *   if the fetch succeeded, page->html will contain the content retrieved,
+ *   and the page's ETag and Last-Modified those of the response (if any).
+ *   Either way, webpage_getStatus tells the HTTP status of the response
+ *   (0 if there was none).  A 200 response whose Content-Type is not HTML,
+ *   or whose body is longer than webpage_setMaxBody allows, is turned down
+ *   without reading (the rest of) its body: we return false, and
+ *   webpage_getDeclined tells why.  A fetch that misses one of the
+ *   deadlines set by webpage_setDeadlines fails, and webpage_getMissed
+ *   tells which.
  *
  * Caller is responsible for:
  *   If this function is successful, a new, null-terminated character
@@ -103,9 +266,39 @@ void webpage_delete(void* data);
  *   * can only handle http (not https or other schemes)
  *   * can only handle URLs of form http://host[:port][/pathname]
  *   * cannot handle redirects (HTTP 301 or 302 response codes)
+ *   * does not pace requests: the caller decides how often to fetch
+ *     from a given server (a failed connect is retried, after a short,
+ *     exponentially growing and randomly jittered backoff)
+ *
+ * Connections:
+ *   the request asks the server to keep the connection open (HTTP/1.1
+ *   keep-alive); if the response allows it, the connection is kept in
+ *   a pool and reused by the next fetch from the same host and port.
+ *   Host names are looked up once and remembered for a few minutes,
+ *   and connects to a host with several addresses are raced (see resolver).
+ *   Call webpage_closeConnections() when done fetching.
+ *
+ * Conditional requests:
+ *   if the page has an ETag or Last-Modified (from webpage_setValidators),
+ *   the request is conditional: a server whose copy has not changed
+ *   responds 304 (Not Modified), without the page, and we return false
+ *   with webpage_getStatus(page) == 304.
+ *
+ * Concurrency:
+ *   safe to call from several threads at once, on distinct pages.
  */
 bool webpage_fetch(webpage_t* page);
 
+/**************** webpage_closeConnections ****************/
+/* Close the idle connections that webpage_fetch keeps for reuse,
+ * and forget the host lookups it remembers.
+ *
+ * Caller must ensure:
+ *   no webpage_fetch is in progress at the time;
+ *   later fetches are fine, and start afresh.
+ */
+void webpage_closeConnections(void);
+
 
 /**************** webpage_getNextWord ***********************************/
 /* return the next word from page->html[pos]
@@ -119,8 +312,9 @@ bool webpage_fetch(webpage_t* page);
  * We return:
  *   pointer to string containing the next word, if any; otherwise NULL.
  * 
- * Side effect:
- *   page->html will be compressed to remove white space.
+ * Notes:
+ *   page->html is not changed, nor read past its length (so it may be
+ *   that of a view).
  *
  * Caller is responsible for:
  *   later free()ing the string returned.
@@ -144,13 +338,20 @@ char* webpage_getNextWord(webpage_t* page, int* pos);
  *   page: pointer to valid webpage_t with page->html not NULL.
  *   pos: pointer to an int representing current position in html buffer;
  *        should be 0 on the initial call.
- *        After return, *pos is the index after the URL returned.
+ *        After return, *pos is the index after the tag holding the URL returned.
  *
  * We return:
  *   pointer to string containing the next URL, if any; otherwise NULL.
+ *   URLs are those of the href attributes of <a> tags, made absolute,
+ *   without any #fragment; hrefs that are only a fragment, or whose
+ *   scheme is not http(s), are skipped.
  *
- * Side effect:
- *   page->html will be compressed to remove white space.
+ * Notes:
+ *   page->html is not changed, nor read past its length (so it may be
+ *   that of a view).  Tags are found in one left-to-right pass
+ *   (quoted attribute values may hold '>'; comments, and the contents of
+ *   <script> and <style>, are skipped), so getting all the URLs of a
+ *   page takes time linear in its length.
  *
  * Caller is responsible for:
  *   later free()ing the string returned.
@@ -173,6 +374,26 @@ char* webpage_getNextWord(webpage_t* page, int* pos);
 
 char* webpage_getNextURL(webpage_t* page, int* pos);
 
+/****************** webpage_getAllURLs ***********************************/
+/* return all the urls of page->html at once, in the order
+ * webpage_getNextURL would return them
+ *
+ * Caller provides:
+ *   page: pointer to valid webpage_t with page->html not NULL.
+ *   numURLs: pointer to an int, set to the number of URLs returned.
+ *
+ * We return:
+ *   a NULL-terminated array of *numURLs strings; or NULL (with *numURLs
+ *   0) on NULL arguments, or if memory could not be allocated.
+ *   The strings live in the same allocated block as the array, so the
+ *   caller may change them in place (e.g., with normalizeURLInto), but
+ *   not free them one by one.
+ *
+ * Caller is responsible for:
+ *   later free()ing the array (which frees the strings too).
+ */
+char** webpage_getAllURLs(webpage_t* page, int* numURLs);
+
 /***********************************************************************
  * normalizeURL - returns a normalized form of the url
  *
@@ -195,6 +416,29 @@ char* webpage_getNextURL(webpage_t* page, int* pos);
  */
 char* normalizeURL(const char* url);
 
+/***********************************************************************
+ * normalizeURLInto - normalizes the url into a buffer the caller provides
+ *
+ * Caller provides:
+ *    url: string containing absolute url to normalize
+ *    buf: where to write the normalized url; may be url itself, to
+ *         normalize it in place
+ *    bufSize: size of buf, which must be more than strlen(url)
+ *         (a normalized url is never longer than the url)
+ *
+ * Returns:
+ *  the length of the normalized url now in buf, or
+ *  0 for any reason normalizeURL would return NULL (but memory: we
+ *  allocate none), or if buf is NULL or bufSize too small.
+ *
+ * Usage example:
+ *   char url[] = "HTTP://www.EXAMPLE.com/a/../b.html";
+ *   if (normalizeURLInto(url, url, sizeof(url)) > 0) {
+ *     // url is now "http://www.example.com/b.html"
+ *   }
+ */
+size_t normalizeURLInto(const char* url, char* buf, const size_t bufSize);
+
 
 /***********************************************************************
  * isInternalURL - verify whether the given url is 'internal' to CS50
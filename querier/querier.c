@@ -8,35 +8,59 @@
 #include <ctype.h>
 #include <string.h>
 #include "tokens.h"
-#include "../libcs50/counters.h"
 #include "../libcs50/hashtable.h"
 #include "../libcs50/mem.h"
 #include "../libcs50/file.h"
 #include "../common/index.c"
 #include "../common/index.h"
+#include "../common/doccounts.h"
 #include "../common/pagedir.h"
+#include "../common/docstore.h"
 
 int fileno(FILE* stream);
 
+/* scored_t: a page and its score, as rankPages looks for the highest */
+typedef struct scored {
+  docid_t docID;
+  int score;
+} scored_t;
+
+/* lookup_t: where the URLs of pages are found: the docstore saved by the Indexer next to the index, if it
+ * has one (see docstore.h), otherwise the page files themselves
+ */
+typedef struct lookup {
+  char* pageDirectory;
+  docstore_t* docs;           // NULL if there is no docstore
+} lookup_t;
+
 static void parseArgs(char* pageDirectory, char* indexFilename);
 static bool parseQuery(char* query);
 static bool parseTokens(tokens_t* tokens);
-static counters_t* processQuery(tokens_t* tokens, index_t* index);
-static void rankPages(counters_t* pages, char* pageDirectory);
-static int respondQuery(index_t* index, char* pageDirectory);
+static doccounts_t* processQuery(tokens_t* tokens, index_t* index);
+static void rankPages(doccounts_t* pages, hashtable_t* aliases, lookup_t* lookup);
+static int respondQuery(index_t* index, hashtable_t* aliases, lookup_t* lookup);
+static char* pageURL(lookup_t* lookup, const docid_t docID);
 
 static void prompt(void);
-static void intersectWords(counters_t** wordACounters, counters_t* wordBCounters);
-static void unionWords(counters_t* wordACounters, counters_t* wordBCounters);
+static void intersectWords(doccounts_t** wordACounters, doccounts_t* wordBCounters);
+static void unionWords(doccounts_t* wordACounters, doccounts_t* wordBCounters);
 
-static void countermin(void* arg, const int key, const int count);
-static void countersum(void* arg, const int key, const int count);
-static void countermax(void* arg, const int key, const int count);
-static void countercount(void* arg, const int key, const int count);
+static void countermin(void* arg, const docid_t key, const int count);
+static void countersum(void* arg, const docid_t key, const int count);
+static void countermax(void* arg, const docid_t key, const int count);
+static void countercount(void* arg, const docid_t key, const int count);
+static void aliasset(void* arg, const docid_t docID, const docid_t canonicalDocID);
+static void aliasadd(void* arg, const char* key, void* item);
+static void aliasprint(void* arg, const docid_t key, const int count);
+static void aliasesdelete(void* item);
+
+static const int ALIAS_SLOTS = 1009;  // hashtable slots for aliases
 
 /**************** main ****************/
 /* Entry point of the program. Validate correct usage of and parse command-line arguments, load index from
- * indexFilename, then receive, process, and satisfy each query from stdin
+ * indexFilename, the docstore saved next to it (indexFilename.docstore) if any, and the aliases (pages saved
+ * by the crawler as exact duplicates of others) from pageDirectory, then receive, process, and satisfy each
+ * query from stdin
  *
  * Caller provides: 
  *  argc  number of command-line arguments
@@ -65,12 +89,33 @@ int main(const int argc, char* argv[])
   // Load index from indexFilename
   index_t* index = index_load(argv[2]);
 
+  // Map the docstore of the index, to look up the URLs of results in; an index saved before the Indexer
+  // wrote docstores has none, and its results' URLs are read from their page files
+  char* docsFilename = mem_assert(malloc(strlen(argv[2]) + strlen(".docstore") + 1),
+                                  "failed allocating memory for docstore filename");
+  sprintf(docsFilename, "%s.docstore", argv[2]);
+  lookup_t lookup = { argv[1], docstore_load(docsFilename) };
+  free(docsFilename);
+
+  // Load which docID holds the content of each page, then turn that around into the aliases of each
+  // page holding content, so that they can be listed with it
+  hashtable_t* canonicals = mem_assert(hashtable_new(ALIAS_SLOTS), "failed allocating memory for aliases");
+  if (pagedir_loadAliases(argv[1], canonicals, aliasset) == false) {
+    fprintf(stderr, "failed reading aliases in pageDirectory %s\n", argv[1]);
+    exit(1);
+  }
+  hashtable_t* aliases = mem_assert(hashtable_new(ALIAS_SLOTS), "failed allocating memory for aliases");
+  hashtable_iterate(canonicals, aliases, aliasadd);
+  hashtable_delete(canonicals, free);
+
   // Receive queries until we receive EOF as input
   int responseStatus = 0;
   while (responseStatus != 2) {
-    responseStatus = respondQuery(index, argv[1]);
+    responseStatus = respondQuery(index, aliases, &lookup);
   }
 
+  hashtable_delete(aliases, aliasesdelete);
+  docstore_delete(lookup.docs);
   index_delete(index);
 }
 
@@ -187,23 +232,23 @@ static bool parseTokens(tokens_t* tokens)
  *  index pointer to index_t struct built from indexFilename
  *
  * We return:
- *  pointer to counters_t struct with pages as keys and scores as counts
+ *  pointer to doccounts_t struct with pages as keys and scores as counts
  */
-static counters_t* processQuery(tokens_t* tokens, index_t* index)
+static doccounts_t* processQuery(tokens_t* tokens, index_t* index)
 {
   int tokensLength = tokens_getLength(tokens);
 
   // Create page-score counters and iterate over query tokens
-  counters_t* pages = counters_new();
+  doccounts_t* pages = doccounts_new();
   char* token = "";
   for (int i = 0; i < tokensLength; i++) {
     token = tokens_get(tokens, i);
 
     // Create counters that will temporarily hold the counters intersection of the 'andsequence'
-    counters_t* temp = counters_new();
+    doccounts_t* temp = doccounts_new();
 
     // Since no "intersect identity", assign counters of first token to 'temp'
-    counters_t* wordCounters = index_get(index, token);
+    doccounts_t* wordCounters = index_get(index, token);
     unionWords(temp, wordCounters);
 
     // Get next token
@@ -228,47 +273,52 @@ static counters_t* processQuery(tokens_t* tokens, index_t* index)
     unionWords(pages, temp);
 
     // Clean up
-    counters_delete(temp);
+    doccounts_delete(temp);
   }
 
   return pages;
 }
 
 /**************** rankPages ****************/
-/* Rank pages according to their scores and print them to stdout.
+/* Rank pages according to their scores and print them to stdout, each followed by its aliases, if any
+ * (they have the same content, so they match the same way; only the page holding it is indexed).
  *
  * Caller provides: 
- *  pages         pointer to counters_t struct with pages as keys and scores as counts
- *  pageDirectory string pathname of crawler-produced directory
+ *  pages         pointer to doccounts_t struct with pages as keys and scores as counts
+ *  aliases       pointer to hashtable_t struct from docIDs holding content to doccounts_t sets of their aliases
+ *  lookup        pointer to lookup_t struct of where to find the URLs of pages
+ *
+ * Notes:
+ *  a page whose URL cannot be found (its page file gone, with no docstore) is skipped
  */
-static void rankPages(counters_t* pages, char* pageDirectory)
+static void rankPages(doccounts_t* pages, hashtable_t* aliases, lookup_t* lookup)
 {
-  int maxPageCount[2] = { 0, 0 }; 
+  scored_t max = { 0, 0 };
 
-  // Populate 'maxPageCount' with ID and score of highest-ranking page
-  counters_iterate(pages, maxPageCount, countermax);
+  // Populate 'max' with ID and score of highest-ranking page
+  doccounts_iterate(pages, &max, countermax);
 
   // Set score of page to 0 in 'page' counters (so next time we get second-highest)
-  counters_set(pages, maxPageCount[0], 0);
+  doccounts_set(pages, max.docID, 0);
 
   // Repeat until all pages scores have been set to 0
-  while (maxPageCount[1] != 0) {
-    // Read URL of page
-    FILE* pageFile = pagedir_open(pageDirectory, maxPageCount[0], "r");
-    char* pageURL = file_readLine(pageFile);
-
-    // Print result entry
-    printf("score\t%d doc\t%d: %s\n", maxPageCount[1], maxPageCount[0], pageURL);
-
-    // Clean up
-    fclose(pageFile);
-    free(pageURL);
+  while (max.score != 0) {
+    // Look up URL of page, then print result entry and its aliases
+    char* URL = pageURL(lookup, max.docID);
+    if (URL != NULL) {
+      printf("score\t%d doc\t%" PRIdocid ": %s\n", max.score, max.docID, URL);
+
+      char docIDString[DOCID_CHARS];
+      snprintf(docIDString, sizeof(docIDString), "%" PRIdocid, max.docID);
+      doccounts_iterate(hashtable_find(aliases, docIDString), lookup, aliasprint);
+      free(URL);
+    }
 
     // Set up next iteration
-    maxPageCount[0] = 0;
-    maxPageCount[1] = 0;
-    counters_iterate(pages, maxPageCount, countermax);
-    counters_set(pages, maxPageCount[0], 0);
+    max.docID = 0;
+    max.score = 0;
+    doccounts_iterate(pages, &max, countermax);
+    doccounts_set(pages, max.docID, 0);
   }
 }
 
@@ -277,13 +327,15 @@ static void rankPages(counters_t* pages, char* pageDirectory)
  *
  * Caller provides: 
  *   index  pointer to a (populated) index_t struct 
+ *   aliases  pointer to hashtable_t struct of aliases, as loaded by main
+ *   lookup  pointer to lookup_t struct of where to find the URLs of pages
  *
  * We return:
  *   0 if query was responded to successfully
  *   1 if query was invalid or an error occurred
  *   2 if query was 'EOF'
  */
-static int respondQuery(index_t* index, char* pageDirectory)
+static int respondQuery(index_t* index, hashtable_t* aliases, lookup_t* lookup)
 {
   // Prompt for query and read it
   prompt();
@@ -326,11 +378,11 @@ static int respondQuery(index_t* index, char* pageDirectory)
   printf("%s\n", tokens_get(tokens, i));
 
   // Get all pages that match query
-  counters_t* queryPages = processQuery(tokens, index);
+  doccounts_t* queryPages = processQuery(tokens, index);
 
   // Count number of pages
   int pageCount = 0;
-  counters_iterate(queryPages, &pageCount, countercount);
+  doccounts_iterate(queryPages, &pageCount, countercount);
 
   // Check if there are any pages or not
   if (pageCount == 0) {
@@ -338,7 +390,7 @@ static int respondQuery(index_t* index, char* pageDirectory)
     printf("----------------------------------\n");
     free(query);
     tokens_delete(tokens);
-    counters_delete(queryPages);
+    doccounts_delete(queryPages);
     return 0;
   }
   else {
@@ -346,36 +398,64 @@ static int respondQuery(index_t* index, char* pageDirectory)
   }
 
   // Rank the pages by their score and print them to stdout
-  rankPages(queryPages, pageDirectory);
+  rankPages(queryPages, aliases, lookup);
 
   // Clean up
   free(query);
   tokens_delete(tokens);
-  counters_delete(queryPages);
+  doccounts_delete(queryPages);
   printf("----------------------------------\n");
 
   return 0;
 }
 
+/**************** pageURL ****************/
+/* Look up the URL of docID: in the docstore, without touching the page file, if there is one and docID is
+ * in it; otherwise in the header of its page file.
+ *
+ * Caller provides:
+ *  lookup  pointer to lookup_t struct of where to find the URLs of pages
+ *  docID   the docID of the page
+ *
+ * We return:
+ *  the page's URL, which the caller must later free; or NULL if it cannot be found
+ */
+static char* pageURL(lookup_t* lookup, const docid_t docID)
+{
+  char* URL = docstore_find(lookup->docs, docID, NULL, NULL);
+  if (URL != NULL) {
+    return URL;
+  }
+
+  webpage_t* page = pagedir_loadHeader(lookup->pageDirectory, docID);
+  if (page == NULL) {
+    return NULL;
+  }
+  URL = mem_assert(malloc(strlen(webpage_getURL(page)) + 1), "failed allocating memory for URL");
+  strcpy(URL, webpage_getURL(page));
+  webpage_delete(page);
+  return URL;
+}
+
 /**************** intersectWords ****************/
 /* Intersect the (docID, # of occurrences) counters corresponding to words.
  *
  * Caller provides: 
- *  wordACounters pointer to pointer to counters_t struct corresponding to a word
- *  wordBCounters pointer to counters_t struct corresponding to another word
+ *  wordACounters pointer to pointer to doccounts_t struct corresponding to a word
+ *  wordBCounters pointer to doccounts_t struct corresponding to another word
  */
-static void intersectWords(counters_t** wordACounters, counters_t* wordBCounters)
+static void intersectWords(doccounts_t** wordACounters, doccounts_t* wordBCounters)
 {
   // Create variable to hold intersection
-  counters_t* result = counters_new();
+  doccounts_t* result = doccounts_new();
 
   // Iterate over 'wordBCounters'
   // If any counters in common (by key) with 'wordACounters', assign minimum (by count) to 'result'
-  counters_t* bundle[2] = { *wordACounters, result };
-  counters_iterate(wordBCounters, bundle, countermin);
+  doccounts_t* bundle[2] = { *wordACounters, result };
+  doccounts_iterate(wordBCounters, bundle, countermin);
 
   // Delete wordACounters pointer
-  counters_delete(*wordACounters);
+  doccounts_delete(*wordACounters);
 
   // Set pointer to wordACounters to result
   *wordACounters = result;
@@ -385,14 +465,14 @@ static void intersectWords(counters_t** wordACounters, counters_t* wordBCounters
 /* Union the (docID, # of occurrences) counters corresponding to words.
  *
  * Caller provides: 
- *  wordACounters pointer to counters_t struct corresponding to a word
- *  wordBCounters pointer to counters_t struct corresponding to another word
+ *  wordACounters pointer to doccounts_t struct corresponding to a word
+ *  wordBCounters pointer to doccounts_t struct corresponding to another word
  */
-static void unionWords(counters_t* wordACounters, counters_t* wordBCounters)
+static void unionWords(doccounts_t* wordACounters, doccounts_t* wordBCounters)
 {
   // Iterate over 'wordBCounters'
   // Assign the sum of each counter + the corresponding counter in 'wordACounters' to 'wordBCounters'
-  counters_iterate(wordBCounters, wordACounters, countersum);
+  doccounts_iterate(wordBCounters, wordACounters, countersum);
 }
 
 /**************** prompt ****************/
@@ -405,48 +485,108 @@ static void prompt(void)
 }
 
 /**************** countermin ****************/
-/* Helper counters_iterate 'itemfunc' function for intersectWords. */
-static void countermin(void* arg, const int key, const int count)
+/* Helper doccounts_iterate 'itemfunc' function for intersectWords. */
+static void countermin(void* arg, const docid_t key, const int count)
 {
   // Cast accordingly
-  counters_t** bundle = (counters_t**) arg;
-  counters_t* countersB = bundle[0];
-  counters_t* result = bundle[1];
+  doccounts_t** bundle = (doccounts_t**) arg;
+  doccounts_t* countersB = bundle[0];
+  doccounts_t* result = bundle[1];
 
   // Check that key is in countersB
   int countB = 0;
-  if ((countB = counters_get(countersB, key)) > 0) {
+  if ((countB = doccounts_get(countersB, key)) > 0) {
     // Set the key to the lower count in result
     int minCount = (count < countB) ? count : countB;
-    counters_set(result, key, minCount);
+    doccounts_set(result, key, minCount);
   }
 }
 
 /**************** countersum ****************/
-/* Helper counters_iterate 'itemfunc' function for unionWords. */
-static void countersum(void* arg, const int key, const int count)
+/* Helper doccounts_iterate 'itemfunc' function for unionWords. */
+static void countersum(void* arg, const docid_t key, const int count)
 {
-  counters_t* countersB = (counters_t*) arg;
-  int sumCount = counters_get(countersB, key) + count;
-  counters_set(countersB, key, sumCount);
+  doccounts_t* countersB = (doccounts_t*) arg;
+  int sumCount = doccounts_get(countersB, key) + count;
+  doccounts_set(countersB, key, sumCount);
 }
 
 /**************** countermax ****************/
-/* Helper counters_iterate 'itemfunc' function for rankPages. */
-static void countermax(void* arg, const int key, const int count)
+/* Helper doccounts_iterate 'itemfunc' function for rankPages. */
+static void countermax(void* arg, const docid_t key, const int count)
 {
-  int* maxKeyCount = (int*) arg; 
+  scored_t* max = (scored_t*) arg;
 
-  if (count > maxKeyCount[1]) {
-    maxKeyCount[0] = key;
-    maxKeyCount[1] = count;
+  if (count > max->score) {
+    max->docID = key;
+    max->score = count;
   }
 }
 
 /**************** countercount ****************/
-/* Helper counters_iterate 'itemfunc' function for respondQuery. */
-static void countercount(void* arg, const int key, const int count)
+/* Helper doccounts_iterate 'itemfunc' function for respondQuery. */
+static void countercount(void* arg, const docid_t key, const int count)
 {
   int* ccount = (int*) arg;
   *ccount += 1;
 }
+
+/**************** aliasset ****************/
+/* pagedir_loadAliases itemfunc: record in the hashtable (arg) from docIDs to docid_t* that docID's content is
+ * held by canonicalDocID; a docID saved again replaces what was recorded before.
+ */
+static void aliasset(void* arg, const docid_t docID, const docid_t canonicalDocID)
+{
+  char docIDString[DOCID_CHARS];
+  snprintf(docIDString, sizeof(docIDString), "%" PRIdocid, docID);
+  docid_t* canonical = hashtable_find(arg, docIDString);
+  if (canonical == NULL) {
+    canonical = mem_assert(malloc(sizeof(docid_t)), "failed allocating memory for aliases");
+    hashtable_insert(arg, docIDString, canonical);
+  }
+  *canonical = canonicalDocID;
+}
+
+/**************** aliasadd ****************/
+/* hashtable_iterate itemfunc over what aliasset recorded: if docID key is an alias, add it to the set of
+ * aliases of the docID holding its content, in the hashtable (arg) from docIDs to doccounts_t sets.
+ */
+static void aliasadd(void* arg, const char* key, void* item)
+{
+  docid_t docID = strtoll(key, NULL, 10);
+  docid_t canonical = *(docid_t*) item;
+  if (canonical == docID) {
+    return;
+  }
+
+  char canonicalString[DOCID_CHARS];
+  snprintf(canonicalString, sizeof(canonicalString), "%" PRIdocid, canonical);
+  doccounts_t* aliases = hashtable_find(arg, canonicalString);
+  if (aliases == NULL) {
+    aliases = mem_assert(doccounts_new(), "failed allocating memory for aliases");
+    hashtable_insert(arg, canonicalString, aliases);
+  }
+  doccounts_add(aliases, docID);
+}
+
+/**************** aliasprint ****************/
+/* Print the URL of alias docID key, looked up through the lookup_t struct (arg); an alias whose URL cannot
+ * be found is skipped.
+ */
+static void aliasprint(void* arg, const docid_t key, const int count)
+{
+  char* URL = pageURL(arg, key);
+  if (URL == NULL) {
+    return;
+  }
+  printf("\talso doc\t%" PRIdocid ": %s\n", key, URL);
+  free(URL);
+}
+
+/**************** aliasesdelete ****************/
+/* hashtable_delete itemdelete: free a doccounts_t set of aliases.
+ */
+static void aliasesdelete(void* item)
+{
+  doccounts_delete(item);
+}
@@ -82,3 +82,9 @@ valgrind --leak-check=full --show-leak-kinds=all ./querier ../data/toscrape-1 ..
 
 # wikipedia at depth 1
 ./querier ~/cs50-dev/shared/tse/output/wikipedia-1 ../data/wikipedia-1.index < fuzzquery_files/fq11
+
+# letters at depth 3, with an index saved without its docstore: the URLs are read from the page files
+# instead, with the same results
+cp ../data/letters-3.index ../data/letters-3-nodocstore.index
+./querier ~/cs50-dev/shared/tse/output/letters-3 ../data/letters-3-nodocstore.index < fuzzquery_files/fq5 > ../data/letters-3-nodocstore.out
+./querier ~/cs50-dev/shared/tse/output/letters-3 ../data/letters-3.index < fuzzquery_files/fq5 | diff - ../data/letters-3-nodocstore.out